@@ -199,6 +199,16 @@
 #define OFCONNECTIONMANAGER_CONFIG_FIPS_CIPHER_LIST "TLSv1.2:kRSA:!eNULL:!aNULL"
 #endif
 
+/**
+ * OFCONNECTIONMANAGER_CONFIG_IO_THREADS
+ *
+ * Number of threads performing socket and TLS I/O for established connections. Zero handles all I/O on the event loop thread. */
+
+
+#ifndef OFCONNECTIONMANAGER_CONFIG_IO_THREADS
+#define OFCONNECTIONMANAGER_CONFIG_IO_THREADS 0
+#endif
+
 
 
 /**
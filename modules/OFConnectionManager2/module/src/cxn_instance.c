@@ -275,6 +275,11 @@ clear_write_ready(connection_t *cxn)
 static void
 set_cxn_read_write_events(connection_t *cxn)
 {
+    if (cxn->io) {
+        /* The socket belongs to an I/O thread */
+        return;
+    }
+
     switch (cxn->ssl_state) {
     case CXN_SSL_WANT_READ:
         set_read_ready(cxn);
@@ -1130,40 +1135,52 @@ send_parse_error_message(connection_t *cxn, uint8_t *buf, int len)
 #define OFVERSION_IS_SET(cxn) ((cxn)->status.negotiated_version > 0)
 
 /**
- * Process a message from the read buffer
+ * Process a raw message received from a connection
  *
- * The read buffer must have a valid message in it to be processed
+ * The buffer must hold exactly one complete message
  *
- * The LOCI object is created on the stack and points directly to the read
+ * The LOCI object is created on the stack and points directly to the
  * buffer, so its lifetime is limited to this stack frame. Message handlers
  * that need to keep it around for longer must copy it with of_object_dup.
  */
-static inline void
-process_message(connection_t *cxn)
+void
+ind_cxn_process_raw_message(connection_t *cxn, uint8_t *buf, int len)
 {
     of_object_t *obj;
-    int len;
     of_object_storage_t obj_storage;
 
-    /* Clear read buffer for next read */
-    len = cxn->read_bytes;
-    cxn->read_bytes = 0;
-    cxn->bytes_needed = OF_MESSAGE_HEADER_LENGTH;
-
-    obj = of_object_new_from_message_preallocated(&obj_storage, cxn->read_buffer, len);
+    obj = of_object_new_from_message_preallocated(&obj_storage, buf, len);
     if (obj == NULL) {
         LOG_WARN(cxn, "Failed to parse OpenFlow message version=%u type=%u length=%u xid=%u",
-                 of_message_version_get(cxn->read_buffer),
-                 of_message_type_get(cxn->read_buffer),
-                 of_message_length_get(cxn->read_buffer),
-                 of_message_xid_get(cxn->read_buffer));
-        send_parse_error_message(cxn, cxn->read_buffer, len);
+                 of_message_version_get(buf),
+                 of_message_type_get(buf),
+                 of_message_length_get(buf),
+                 of_message_xid_get(buf));
+        send_parse_error_message(cxn, buf, len);
         return;
     }
 
     ind_cxn_process_message(cxn, obj);
 }
 
+/**
+ * Process a message from the read buffer
+ *
+ * The read buffer must have a valid message in it to be processed
+ */
+static inline void
+process_message(connection_t *cxn)
+{
+    int len;
+
+    /* Clear read buffer for next read */
+    len = cxn->read_bytes;
+    cxn->read_bytes = 0;
+    cxn->bytes_needed = OF_MESSAGE_HEADER_LENGTH;
+
+    ind_cxn_process_raw_message(cxn, cxn->read_buffer, len);
+}
+
 /* exposed for process_message and message bundling code to call */
 void
 ind_cxn_process_message(connection_t *cxn, of_object_t *obj)
@@ -1244,9 +1261,9 @@ cxn_process_read_buffer(connection_t *cxn)
  * Connection instance write buffer management
  *------------------------------------------------------------*/
 
-/* helper function */
-static int
-ssl_writev(connection_t *cxn, const struct iovec *iov, int iovcnt)
+/* helper function, also used by the I/O threads */
+int
+ind_cxn_ssl_writev(connection_t *cxn, const struct iovec *iov, int iovcnt)
 {
     int i;
     int total = 0;
@@ -1342,7 +1359,7 @@ cxn_process_write_buffer(connection_t *cxn)
         }
 
         if (cxn->ssl) {
-            written = ssl_writev(cxn, iovecs, num_iovecs);
+            written = ind_cxn_ssl_writev(cxn, iovecs, num_iovecs);
             if (written < 0) {
                 return INDIGO_ERROR_UNKNOWN;
             }
@@ -1426,6 +1443,11 @@ ind_cxn_instance_enqueue(connection_t *cxn, uint8_t *data, int len)
 {
     int msg_len;
 
+    if (cxn->io) {
+        /* Pick up messages the I/O thread has finished sending */
+        ind_cxn_io_reconcile(cxn);
+    }
+
     LOG_TRACE(cxn, "Enqueuing %d bytes", len);
     LOG_TRACE(cxn, "Cur len %d bytes, %d pkts",
               cxn->bytes_enqueued, cxn->pkts_enqueued);
@@ -1446,7 +1468,13 @@ ind_cxn_instance_enqueue(connection_t *cxn, uint8_t *data, int len)
         return INDIGO_ERROR_UNKNOWN;
     }
 
-    if (bigring_count(cxn->write_queue) < bigring_size(cxn->write_queue)) {
+    if (cxn->io) {
+        if (ind_cxn_io_enqueue(cxn, data) < 0) {
+            LOG_ERROR(cxn, "Dropping message due to full I/O ring (%d bytes in %d messages enqueued)",
+                      cxn->bytes_enqueued, cxn->pkts_enqueued);
+            return INDIGO_ERROR_RESOURCE;
+        }
+    } else if (bigring_count(cxn->write_queue) < bigring_size(cxn->write_queue)) {
         bigring_push(cxn->write_queue, data);
     } else {
         LOG_ERROR(cxn, "Dropping message due to full ringbuffer (%d bytes in %d messages enqueued)",
@@ -1532,6 +1560,30 @@ cxn_try_to_tls_handshake(connection_t *cxn)
 #define IS_TLS_REHANDSHAKING(cxn) \
     ((cxn->ssl) && SSL_renegotiate_pending(cxn->ssl))
 
+/**
+ * Hand an established connection over to an I/O thread
+ *
+ * Only done once TCP is connected and any TLS handshake has completed;
+ * after this the state thread no longer touches the socket.
+ */
+static void
+cxn_maybe_offload(connection_t *cxn)
+{
+    if (!ind_cxn_io_enabled() || cxn->io != NULL) {
+        return;
+    }
+
+    if (!CXN_TCP_CONNECTED(cxn) || cxn->sd < 0) {
+        return;
+    }
+
+    if (IS_TLS_INIT_HANDSHAKING(cxn) || IS_TLS_REHANDSHAKING(cxn)) {
+        return;
+    }
+
+    ind_cxn_io_attach(cxn);
+}
+
 /**
  * @brief Callback to process "socket ready"
  *
@@ -1590,8 +1642,11 @@ cxn_socket_ready(
         (IS_TLS_INIT_HANDSHAKING(cxn) || IS_TLS_REHANDSHAKING(cxn))) {
         LOG_VERBOSE(cxn, "handle TLS handshaking");
         switch (cxn_try_to_tls_handshake(cxn)) {
-        case INDIGO_ERROR_NONE:  /* fall-through */
-            /* done; wait for next iteration */
+        case INDIGO_ERROR_NONE:
+            /* done; move the connection to an I/O thread if enabled */
+            set_cxn_read_write_events(cxn);
+            cxn_maybe_offload(cxn);
+            break;
         case INDIGO_ERROR_PENDING:
             /* do nothing, wait for next iteration of cxn_socket_ready */
             set_cxn_read_write_events(cxn);
@@ -1623,6 +1678,7 @@ cxn_socket_ready(
             } else {
                 LOG_INTERNAL(cxn, "Error trying to connect, resetting");
                 controller_disconnect(cxn->controller);
+                return;
             }
         } else {
             if ((rv = cxn_process_write_buffer(cxn)) < 0) {
@@ -1632,6 +1688,8 @@ cxn_socket_ready(
             }
         }
     }
+
+    cxn_maybe_offload(cxn);
 }
 
 
@@ -1839,6 +1897,10 @@ cxn_state_set(connection_t *cxn, cxn_state_t new_state)
             AIM_ASSERT(rv == INDIGO_ERROR_NONE,
                        "Failed to register periodic keepalive for %s",
                        cxn->desc);
+            /* Echoes need not be punctual; share wakeups with other timers */
+            (void) ind_soc_timer_event_slack_set(
+                periodic_keepalive, (void *)cxn,
+                cxn->keepalive.period_ms / IND_CXN_KEEPALIVE_SLACK_DIVISOR);
         }
 
         cxn->status.is_connected = true;
@@ -1869,7 +1931,12 @@ cxn_state_set(connection_t *cxn, cxn_state_t new_state)
 
         AIM_ASSERT(cxn->sd >= 0);
         LOG_VERBOSE(cxn, "Closing socket %d", cxn->sd);
-        ind_soc_socket_unregister(cxn->sd);
+        if (cxn->io) {
+            /* Wait for the I/O thread to let go of the socket */
+            ind_cxn_io_detach(cxn);
+        } else {
+            ind_soc_socket_unregister(cxn->sd);
+        }
         close(cxn->sd);
         cxn->sd = -1;
         break;
@@ -2111,6 +2178,7 @@ ind_cxn_start(connection_t *cxn)
          * connections started from the listener will also return 0 */
         cxn_state_set(cxn, CXN_S_HANDSHAKING);
         set_read_ready(cxn);
+        cxn_maybe_offload(cxn);
     } else if (rv == INDIGO_ERROR_PENDING) {
         /* connect is in-flight, register timeout */
         rv = ind_soc_timer_event_register_with_priority(
@@ -2159,6 +2227,10 @@ ind_cxn_resume(connection_t *cxn)
 {
     AIM_ASSERT(cxn->pause_refcount > 0);
     if (--cxn->pause_refcount == 0) {
+        if (cxn->io) {
+            /* Resume draining messages already received by the I/O thread */
+            ind_cxn_io_kick(cxn);
+        }
         set_cxn_read_write_events(cxn);
     }
 }
@@ -2382,6 +2454,11 @@ ind_cxn_stats_show(aim_pvs_t *pvs, int details)
         aim_printf(pvs, "    Threshold: %d\n", cxn->keepalive.threshold);
         aim_printf(pvs, "    Outstanding Echo Count: %d\n", 
                    cxn->keepalive.outstanding_echo_cnt);
+        if (cxn->io) {
+            ind_cxn_io_reconcile(cxn);
+            aim_printf(pvs, "    I/O thread: %d\n",
+                       ind_cxn_io_thread_index(cxn));
+        }
 
         aim_printf(pvs, "    Messages in, current connection: %"PRIu64"\n",
                    cxn->status.messages_in);
@@ -34,6 +34,7 @@
 #include <debug_counter/debug_counter.h>
 #include <BigRing/bigring.h>
 #include <openssl/ssl.h>
+#include <sys/uio.h>
 
 #define READ_BUFFER_SIZE (64 * 1024)
 
@@ -257,8 +258,17 @@ typedef struct connection_s {
 
     cxn_ssl_state_t ssl_state;  /* tracks SSL_WANT_READ/SSL_WANT_WRITE */
     SSL *ssl;  /* TLS connection */
+
+    /*
+     * Non-NULL while the socket is owned by an I/O thread. The read
+     * buffer and write queue are then unused by the state thread.
+     * See cxn_io.c.
+     */
+    struct cxn_io_s *io;
 } connection_t;
 
+typedef struct cxn_io_s cxn_io_t;
+
 /**
  * How many bytes in buffer are free
  * See notes above about WRITE_BUFFER_SIZE.
@@ -342,6 +352,9 @@ void ind_cxn_pause(connection_t *cxn);
 void ind_cxn_resume(connection_t *cxn);
 
 void ind_cxn_process_message(connection_t *cxn, of_object_t *obj);
+void ind_cxn_process_raw_message(connection_t *cxn, uint8_t *buf, int len);
+
+int ind_cxn_ssl_writev(connection_t *cxn, const struct iovec *iov, int iovcnt);
 
 void
 ind_cxn_populate_connection_list(of_list_bsn_controller_connection_t *list);
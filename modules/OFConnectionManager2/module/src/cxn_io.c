@@ -0,0 +1,1002 @@
+/****************************************************************
+ *
+ *        Copyright 2017, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/**
+ * @file
+ * @brief Connection I/O threads
+ *
+ * When OFCONNECTIONMANAGER_CONFIG_IO_THREADS is nonzero, established
+ * connections are handed off to a pool of I/O threads. An I/O thread owns
+ * the socket, the TLS session and the connection read buffer: it performs
+ * all reads and writes, including encryption and OpenFlow framing.
+ *
+ * Complete messages are exchanged with the state thread (the thread
+ * running ind_soc_select_and_run) over two bounded SPSC rings per
+ * connection:
+ *
+ *  - rx_ring: I/O thread -> state thread, malloc'd received messages
+ *  - tx_ring: state thread -> I/O thread, stolen LOCI wire buffers
+ *
+ * Each I/O thread has a "wake" eventfd it polls alongside its sockets and
+ * a "notify" eventfd registered with SocketManager on the state thread.
+ * Both are written at most once per drain, using an atomic pending flag.
+ *
+ * The state thread parses and dispatches messages exactly as before, so
+ * OFStateManager and Forwarding are still only called from one thread.
+ * Pausing a connection simply stops draining its rx_ring; once the ring
+ * fills the I/O thread stops reading and TCP flow control takes over.
+ *
+ * Attach and detach are rare and go through a mutex and condition
+ * variable. Detach is synchronous so the state thread can close the
+ * socket and free the TLS session as soon as it returns.
+ */
+
+#include "ofconnectionmanager_log.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "ofconnectionmanager_int.h"
+
+#include <SocketManager/socketmanager.h>
+#include <OFConnectionManager/ofconnectionmanager.h>
+
+#include <indigo/memory.h>
+#include <indigo/assert.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#include "cxn_instance.h"
+#include "spsc_ring.h"
+
+#if OFCONNECTIONMANAGER_CONFIG_IO_THREADS > 0
+
+/* Both rings must hold at least WRITE_QUEUE_SIZE entries */
+#define IO_RX_RING_SIZE 1024
+#define IO_TX_RING_SIZE 1024
+
+/* Maximum number of messages to send per writev */
+#define IO_MAX_WRITE_MSGS 32
+
+typedef enum cxn_io_state_e {
+    CXN_IO_PENDING,     /* Waiting for the I/O thread to pick it up */
+    CXN_IO_RUNNING,     /* Owned by the I/O thread */
+    CXN_IO_DETACHED,    /* Released by the I/O thread */
+} cxn_io_state_t;
+
+typedef struct cxn_io_thread_s cxn_io_thread_t;
+
+struct cxn_io_s {
+    connection_t *cxn;
+    cxn_io_thread_t *thread;
+
+    spsc_ring_t *rx_ring;
+    spsc_ring_t *tx_ring;
+
+    /* Protected by thread->lock */
+    cxn_io_state_t state;
+    bool detach_requested;
+
+    /* Owned by the I/O thread */
+    uint8_t *tx_batch[IO_MAX_WRITE_MSGS];
+    int tx_batch_count;
+    int tx_head_offset; /* Bytes already sent from tx_batch[0] */
+
+    /* Written by the I/O thread, read by the state thread */
+    uint64_t tx_msgs_done;
+    uint64_t tx_bytes_done;
+    int rx_blocked;     /* I/O thread stopped reading because rx_ring is full */
+    int error;          /* indigo_error_t; nonzero once the socket has failed */
+
+    /* Owned by the state thread */
+    uint64_t tx_msgs_seen;
+    uint64_t tx_bytes_seen;
+};
+
+struct cxn_io_thread_s {
+    int index;
+    pthread_t thread;
+    int wake_fd;        /* Polled by the I/O thread */
+    int notify_fd;      /* Polled by the state thread */
+    int wake_pending;
+    int notify_pending;
+    int stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    cxn_io_t *pending[MAX_CONNECTIONS]; /* Protected by lock */
+    int num_pending;
+
+    /* Owned by the I/O thread */
+    cxn_io_t *cxns[MAX_CONNECTIONS];
+    int num_cxns;
+    struct pollfd pollfds[MAX_CONNECTIONS+1];
+
+    /* Owned by the state thread */
+    cxn_io_t *attached[MAX_CONNECTIONS];
+    int num_attached;
+};
+
+static cxn_io_thread_t io_threads[OFCONNECTIONMANAGER_CONFIG_IO_THREADS];
+static bool io_threads_running;
+
+
+/*------------------------------------------------------------
+ * Wakeups
+ *------------------------------------------------------------*/
+
+static void
+eventfd_signal(int fd, int *pending)
+{
+    uint64_t value = 1;
+
+    /*
+     * SEQ_CST orders the caller's ring push before the load of the flag,
+     * pairing with the exchange in eventfd_drain
+     */
+    if (__atomic_exchange_n(pending, 1, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    if (write(fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        AIM_LOG_ERROR("Failed to signal eventfd %d: %s", fd, strerror(errno));
+    }
+}
+
+static void
+eventfd_drain(int fd, int *pending)
+{
+    uint64_t value;
+
+    if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        AIM_LOG_ERROR("Failed to read eventfd %d: %s", fd, strerror(errno));
+    }
+
+    /*
+     * Clear before looking at the rings so that no push is missed. A
+     * release store could be reordered after the caller's ring loads, so
+     * the producer might still see the flag set and skip the write.
+     */
+    (void) __atomic_exchange_n(pending, 0, __ATOMIC_SEQ_CST);
+}
+
+/* State thread -> I/O thread */
+static void
+io_thread_wake(cxn_io_thread_t *thread)
+{
+    eventfd_signal(thread->wake_fd, &thread->wake_pending);
+}
+
+/* I/O thread -> state thread */
+static void
+io_thread_notify(cxn_io_thread_t *thread)
+{
+    eventfd_signal(thread->notify_fd, &thread->notify_pending);
+}
+
+
+/*------------------------------------------------------------
+ * I/O thread
+ *------------------------------------------------------------*/
+
+static void
+io_fail(cxn_io_t *io, indigo_error_t err)
+{
+    __atomic_store_n(&io->error, err, __ATOMIC_RELEASE);
+}
+
+/*
+ * Read up to 'len' bytes from the connection
+ *
+ * Returns the number of bytes read, 0 if the read would block, or an
+ * error code.
+ */
+static int
+io_recv(cxn_io_t *io, uint8_t *buf, int len)
+{
+    connection_t *cxn = io->cxn;
+    int bytes_in;
+
+    if (cxn->ssl) {
+        ERR_clear_error();
+        bytes_in = SSL_read(cxn->ssl, buf, len);
+        if (bytes_in > 0) {
+            return bytes_in;
+        } else if (bytes_in == 0) {
+            AIM_LOG_VERBOSE("cxn %s: Connection closed", cxn->desc);
+            return INDIGO_ERROR_CONNECTION;
+        }
+
+        switch (SSL_get_error(cxn->ssl, bytes_in)) {
+        case SSL_ERROR_WANT_READ:
+            return 0;
+        case SSL_ERROR_WANT_WRITE:
+            AIM_LOG_ERROR("cxn %s: SSL_read returns WANT_WRITE, aborting rehandshake",
+                          cxn->desc);
+            return INDIGO_ERROR_CONNECTION;
+        case SSL_ERROR_SYSCALL:
+            AIM_LOG_ERROR("cxn %s: TLS syscall: %s", cxn->desc, strerror(errno));
+            return INDIGO_ERROR_CONNECTION;
+        default: {
+            char errbuf[IND_SSL_ERR_LEN];
+            ERR_error_string(ERR_get_error(), errbuf);
+            AIM_LOG_ERROR("cxn %s: TLS error: %s", cxn->desc, errbuf);
+            return INDIGO_ERROR_CONNECTION;
+        }
+        }
+    } else {
+        bytes_in = read(cxn->sd, buf, len);
+        if (bytes_in > 0) {
+            return bytes_in;
+        } else if (bytes_in == 0) {
+            if (!CXN_LOCAL(cxn)) {
+                AIM_LOG_VERBOSE("cxn %s: Connection closed by remote host",
+                                cxn->desc);
+            }
+            return INDIGO_ERROR_CONNECTION;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+
+        AIM_LOG_ERROR("cxn %s: Error reading from socket: %s",
+                      cxn->desc, strerror(errno));
+        return INDIGO_ERROR_CONNECTION;
+    }
+}
+
+/*
+ * Move complete messages from the read buffer to rx_ring
+ *
+ * Returns true if any message was queued.
+ */
+static bool
+io_frame(cxn_io_t *io)
+{
+    connection_t *cxn = io->cxn;
+    int offset = 0;
+    bool queued = false;
+
+    while (cxn->read_bytes - offset >= OF_MESSAGE_HEADER_LENGTH) {
+        uint8_t *msg = &cxn->read_buffer[offset];
+        int msg_bytes = of_message_length_get(msg);
+        uint8_t *copy;
+
+        if (msg_bytes < OF_MESSAGE_HEADER_LENGTH) {
+            AIM_LOG_TRACE("cxn %s: Illegal msg length %d. Framing error?",
+                          cxn->desc, msg_bytes);
+            io_fail(io, INDIGO_ERROR_PROTOCOL);
+            return queued;
+        }
+
+        if (cxn->read_bytes - offset < msg_bytes) {
+            break;
+        }
+
+        if (spsc_ring_full(io->rx_ring)) {
+            __atomic_store_n(&io->rx_blocked, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        /* Cannot fail, only this thread pushes to rx_ring */
+        copy = aim_memdup(msg, msg_bytes);
+        (void) spsc_ring_push(io->rx_ring, copy);
+        offset += msg_bytes;
+        queued = true;
+    }
+
+    if (offset > 0) {
+        cxn->read_bytes -= offset;
+        memmove(cxn->read_buffer, &cxn->read_buffer[offset], cxn->read_bytes);
+    }
+
+    return queued;
+}
+
+/*
+ * Read and frame until the socket is drained or rx_ring is full
+ *
+ * Returns true if any message was queued.
+ */
+static bool
+io_read(cxn_io_t *io)
+{
+    connection_t *cxn = io->cxn;
+    bool queued = io_frame(io);
+
+    while (!io->error && !spsc_ring_full(io->rx_ring)) {
+        int rv = io_recv(io, &cxn->read_buffer[cxn->read_bytes],
+                         READ_BUFFER_SIZE - cxn->read_bytes);
+        if (rv < 0) {
+            io_fail(io, rv);
+            break;
+        } else if (rv == 0) {
+            break;
+        }
+
+        cxn->read_bytes += rv;
+        queued |= io_frame(io);
+    }
+
+    if (spsc_ring_full(io->rx_ring)) {
+        __atomic_store_n(&io->rx_blocked, 1, __ATOMIC_RELEASE);
+    }
+
+    return queued;
+}
+
+/*
+ * Send queued messages until the socket buffer is full
+ *
+ * Returns true if any message was completely sent.
+ */
+static bool
+io_write(cxn_io_t *io)
+{
+    connection_t *cxn = io->cxn;
+    bool sent = false;
+
+    while (!io->error) {
+        struct iovec iovecs[IO_MAX_WRITE_MSGS];
+        uint64_t msgs_done = 0, bytes_done = 0;
+        int total = 0, written, left, i;
+
+        while (io->tx_batch_count < IO_MAX_WRITE_MSGS) {
+            uint8_t *data = spsc_ring_pop(io->tx_ring);
+            if (data == NULL) {
+                break;
+            }
+            io->tx_batch[io->tx_batch_count++] = data;
+        }
+
+        if (io->tx_batch_count == 0) {
+            break;
+        }
+
+        for (i = 0; i < io->tx_batch_count; i++) {
+            iovecs[i].iov_base = io->tx_batch[i];
+            iovecs[i].iov_len = of_message_length_get(io->tx_batch[i]);
+            if (i == 0) {
+                /* First buffer may be partially written */
+                iovecs[i].iov_base += io->tx_head_offset;
+                iovecs[i].iov_len -= io->tx_head_offset;
+            }
+            total += iovecs[i].iov_len;
+        }
+
+        if (cxn->ssl) {
+            written = ind_cxn_ssl_writev(cxn, iovecs, io->tx_batch_count);
+            if (written < 0) {
+                io_fail(io, INDIGO_ERROR_CONNECTION);
+                break;
+            }
+        } else {
+            written = writev(cxn->sd, iovecs, io->tx_batch_count);
+            if (written < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    written = 0;
+                } else {
+                    AIM_LOG_ERROR("cxn %s: Error writing to socket: %s",
+                                  cxn->desc, strerror(errno));
+                    io_fail(io, INDIGO_ERROR_CONNECTION);
+                    break;
+                }
+            }
+        }
+
+        /* Free completely sent messages */
+        left = written;
+        for (i = 0; i < io->tx_batch_count; i++) {
+            int to_write = iovecs[i].iov_len;
+            if (left < to_write) {
+                io->tx_head_offset += left;
+                break;
+            }
+            left -= to_write;
+            msgs_done++;
+            bytes_done += of_message_length_get(io->tx_batch[i]);
+            aim_free(io->tx_batch[i]);
+            io->tx_head_offset = 0;
+        }
+
+        if (msgs_done > 0) {
+            io->tx_batch_count -= msgs_done;
+            memmove(io->tx_batch, &io->tx_batch[msgs_done],
+                    io->tx_batch_count * sizeof(io->tx_batch[0]));
+            __atomic_add_fetch(&io->tx_bytes_done, bytes_done, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&io->tx_msgs_done, msgs_done, __ATOMIC_RELEASE);
+            sent = true;
+        }
+
+        if (written != total) {
+            /* Short write, the socket buffer is full */
+            break;
+        }
+    }
+
+    return sent;
+}
+
+/* Apply pending attach and detach requests */
+static void
+io_thread_process_control(cxn_io_thread_t *thread)
+{
+    int i;
+
+    pthread_mutex_lock(&thread->lock);
+
+    for (i = 0; i < thread->num_pending; i++) {
+        cxn_io_t *io = thread->pending[i];
+        AIM_ASSERT(io->state == CXN_IO_PENDING);
+        AIM_ASSERT(thread->num_cxns < MAX_CONNECTIONS);
+        thread->cxns[thread->num_cxns++] = io;
+        io->state = CXN_IO_RUNNING;
+    }
+    thread->num_pending = 0;
+
+    for (i = 0; i < thread->num_cxns; ) {
+        cxn_io_t *io = thread->cxns[i];
+        if (io->detach_requested) {
+            io->state = CXN_IO_DETACHED;
+            thread->cxns[i] = thread->cxns[--thread->num_cxns];
+        } else {
+            i++;
+        }
+    }
+
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+static void *
+io_thread_main(void *arg)
+{
+    cxn_io_thread_t *thread = arg;
+
+    while (!__atomic_load_n(&thread->stop, __ATOMIC_ACQUIRE)) {
+        bool notify = false;
+        int i, rv;
+
+        io_thread_process_control(thread);
+
+        thread->pollfds[0].fd = thread->wake_fd;
+        thread->pollfds[0].events = POLLIN;
+        thread->pollfds[0].revents = 0;
+
+        for (i = 0; i < thread->num_cxns; i++) {
+            cxn_io_t *io = thread->cxns[i];
+            struct pollfd *pfd = &thread->pollfds[i+1];
+
+            pfd->fd = io->cxn->sd;
+            pfd->events = 0;
+            pfd->revents = 0;
+
+            /* Failed connections are idle until the state thread detaches them */
+            if (!io->error) {
+                if (!spsc_ring_full(io->rx_ring)) {
+                    pfd->events |= POLLIN;
+                }
+
+                if (io->tx_batch_count > 0 || !spsc_ring_empty(io->tx_ring)) {
+                    pfd->events |= POLLOUT;
+                }
+            }
+
+            /*
+             * poll reports POLLERR and POLLHUP even with no events
+             * requested, so leave the socket out entirely. The state thread
+             * wakes us when it drains rx_ring, queues a message, or detaches
+             * the connection.
+             */
+            if (pfd->events == 0) {
+                pfd->fd = -1;
+            }
+        }
+
+        rv = poll(thread->pollfds, thread->num_cxns + 1, -1);
+        if (rv < 0) {
+            if (errno != EINTR) {
+                AIM_LOG_ERROR("I/O thread %d: error in poll: %s",
+                              thread->index, strerror(errno));
+            }
+            continue;
+        }
+
+        if (thread->pollfds[0].revents & POLLIN) {
+            eventfd_drain(thread->wake_fd, &thread->wake_pending);
+        }
+
+        for (i = 0; i < thread->num_cxns; i++) {
+            cxn_io_t *io = thread->cxns[i];
+            struct pollfd *pfd = &thread->pollfds[i+1];
+            bool readable;
+
+            if (io->error) {
+                continue;
+            }
+
+            /*
+             * Also frame messages left in the read buffer after rx_ring
+             * filled up, and decrypted data buffered inside OpenSSL.
+             */
+            readable = (pfd->revents & (POLLIN|POLLERR|POLLHUP)) ||
+                io->cxn->read_bytes >= OF_MESSAGE_HEADER_LENGTH ||
+                (io->cxn->ssl && SSL_pending(io->cxn->ssl) > 0);
+
+            if (readable && !spsc_ring_full(io->rx_ring)) {
+                notify |= io_read(io);
+            }
+
+            if (!io->error && (pfd->revents & POLLOUT)) {
+                notify |= io_write(io);
+            }
+
+            if (io->error) {
+                notify = true;
+            }
+        }
+
+        if (notify) {
+            io_thread_notify(thread);
+        }
+    }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    ERR_remove_thread_state(NULL);
+#endif
+
+    return NULL;
+}
+
+
+/*------------------------------------------------------------
+ * State thread
+ *------------------------------------------------------------*/
+
+/* Account for messages the I/O thread has finished sending */
+void
+ind_cxn_io_reconcile(connection_t *cxn)
+{
+    cxn_io_t *io = cxn->io;
+    uint64_t msgs = __atomic_load_n(&io->tx_msgs_done, __ATOMIC_ACQUIRE);
+    uint64_t bytes = __atomic_load_n(&io->tx_bytes_done, __ATOMIC_ACQUIRE);
+
+    cxn->pkts_enqueued -= msgs - io->tx_msgs_seen;
+    cxn->bytes_enqueued -= bytes - io->tx_bytes_seen;
+    cxn->status.messages_out += msgs - io->tx_msgs_seen;
+
+    io->tx_msgs_seen = msgs;
+    io->tx_bytes_seen = bytes;
+}
+
+/* Process received messages and errors for one connection */
+static void
+io_service(connection_t *cxn)
+{
+    cxn_io_t *io = cxn->io;
+    int processed = 0;
+    indigo_error_t err;
+
+    ind_cxn_io_reconcile(cxn);
+
+    while (cxn->pause_refcount == 0) {
+        uint8_t *data;
+        int len;
+
+        if (processed >= OFCONNECTIONMANAGER_CONFIG_MAX_MSGS_PER_TICK ||
+                (processed > 0 && ind_soc_should_yield())) {
+            /* Come back on the next iteration of the event loop */
+            if (!spsc_ring_empty(io->rx_ring)) {
+                io_thread_notify(io->thread);
+            }
+            break;
+        }
+
+        if ((data = spsc_ring_pop(io->rx_ring)) == NULL) {
+            break;
+        }
+
+        if (__atomic_exchange_n(&io->rx_blocked, 0, __ATOMIC_ACQ_REL)) {
+            io_thread_wake(io->thread);
+        }
+
+        len = of_message_length_get(data);
+        cxn->status.bytes_in += len;
+        ind_cxn_process_raw_message(cxn, data, len);
+        aim_free(data);
+        processed++;
+
+        if (cxn->io != io) {
+            /* The connection was closed by a message handler */
+            return;
+        }
+    }
+
+    err = __atomic_load_n(&io->error, __ATOMIC_ACQUIRE);
+    if (err != INDIGO_ERROR_NONE && spsc_ring_empty(io->rx_ring)) {
+        if (err == INDIGO_ERROR_PROTOCOL) {
+            ++ind_cxn_read_errors;
+        }
+        AIM_LOG_VERBOSE("cxn %s: I/O error (%s), resetting",
+                        cxn->desc, indigo_strerror(err));
+        controller_disconnect(cxn->controller);
+    }
+}
+
+static void
+io_notify_ready(
+    int socket_id,
+    void *cookie,
+    int read_ready,
+    int write_ready,
+    int error_seen)
+{
+    cxn_io_thread_t *thread = cookie;
+    indigo_cxn_id_t cxn_ids[MAX_CONNECTIONS];
+    int i, count;
+
+    eventfd_drain(thread->notify_fd, &thread->notify_pending);
+
+    /* Servicing may disconnect connections, so work from a snapshot */
+    count = thread->num_attached;
+    for (i = 0; i < count; i++) {
+        cxn_ids[i] = thread->attached[i]->cxn->cxn_id;
+    }
+
+    for (i = 0; i < count; i++) {
+        connection_t *cxn = ind_cxn_id_to_connection(cxn_ids[i]);
+        if (cxn != NULL && cxn->io != NULL) {
+            io_service(cxn);
+        }
+    }
+}
+
+bool
+ind_cxn_io_enabled(void)
+{
+    return io_threads_running;
+}
+
+void
+ind_cxn_io_attach(connection_t *cxn)
+{
+    cxn_io_thread_t *thread = &io_threads[0];
+    cxn_io_t *io;
+    int i;
+
+    AIM_ASSERT(cxn->io == NULL);
+    AIM_ASSERT(io_threads_running);
+
+    /* Pick the least loaded thread */
+    for (i = 1; i < OFCONNECTIONMANAGER_CONFIG_IO_THREADS; i++) {
+        if (io_threads[i].num_attached < thread->num_attached) {
+            thread = &io_threads[i];
+        }
+    }
+
+    io = aim_zmalloc(sizeof(*io));
+    io->cxn = cxn;
+    io->thread = thread;
+    io->rx_ring = spsc_ring_create(IO_RX_RING_SIZE);
+    io->tx_ring = spsc_ring_create(IO_TX_RING_SIZE);
+    io->state = CXN_IO_PENDING;
+
+    /*
+     * Carry over anything queued while the state thread owned the socket.
+     * The I/O thread reports whole messages, so restore the bytes already
+     * subtracted for a partially written head.
+     */
+    io->tx_head_offset = cxn->write_queue_head_offset;
+    cxn->bytes_enqueued += cxn->write_queue_head_offset;
+    while (bigring_count(cxn->write_queue) > 0) {
+        if (!spsc_ring_push(io->tx_ring, bigring_shift(cxn->write_queue))) {
+            AIM_DIE("cxn %s: I/O ring smaller than write queue", cxn->desc);
+        }
+    }
+    cxn->write_queue_head_offset = 0;
+
+    ind_soc_socket_unregister(cxn->sd);
+    cxn->io = io;
+
+    AIM_ASSERT(thread->num_attached < MAX_CONNECTIONS);
+    thread->attached[thread->num_attached++] = io;
+
+    AIM_LOG_VERBOSE("cxn %s: Moved socket %d to I/O thread %d",
+                    cxn->desc, cxn->sd, thread->index);
+
+    pthread_mutex_lock(&thread->lock);
+    thread->pending[thread->num_pending++] = io;
+    pthread_mutex_unlock(&thread->lock);
+
+    io_thread_wake(thread);
+}
+
+void
+ind_cxn_io_detach(connection_t *cxn)
+{
+    cxn_io_t *io = cxn->io;
+    cxn_io_thread_t *thread = io->thread;
+    void *data;
+    int i;
+
+    pthread_mutex_lock(&thread->lock);
+    io->detach_requested = true;
+    io_thread_wake(thread);
+    while (io->state != CXN_IO_DETACHED) {
+        pthread_cond_wait(&thread->cond, &thread->lock);
+    }
+    pthread_mutex_unlock(&thread->lock);
+
+    for (i = 0; i < thread->num_attached; i++) {
+        if (thread->attached[i] == io) {
+            thread->attached[i] = thread->attached[--thread->num_attached];
+            break;
+        }
+    }
+
+    ind_cxn_io_reconcile(cxn);
+
+    while ((data = spsc_ring_pop(io->rx_ring)) != NULL) {
+        aim_free(data);
+    }
+
+    while ((data = spsc_ring_pop(io->tx_ring)) != NULL) {
+        aim_free(data);
+    }
+
+    for (i = 0; i < io->tx_batch_count; i++) {
+        aim_free(io->tx_batch[i]);
+    }
+
+    spsc_ring_destroy(io->rx_ring);
+    spsc_ring_destroy(io->tx_ring);
+
+    /* Unsent messages were dropped above */
+    cxn->bytes_enqueued = 0;
+    cxn->pkts_enqueued = 0;
+
+    AIM_LOG_VERBOSE("cxn %s: Released socket %d from I/O thread %d",
+                    cxn->desc, cxn->sd, thread->index);
+
+    cxn->io = NULL;
+    aim_free(io);
+}
+
+indigo_error_t
+ind_cxn_io_enqueue(connection_t *cxn, uint8_t *data)
+{
+    cxn_io_t *io = cxn->io;
+
+    if (!spsc_ring_push(io->tx_ring, data)) {
+        return INDIGO_ERROR_RESOURCE;
+    }
+
+    io_thread_wake(io->thread);
+
+    return INDIGO_ERROR_NONE;
+}
+
+void
+ind_cxn_io_kick(connection_t *cxn)
+{
+    io_thread_notify(cxn->io->thread);
+}
+
+int
+ind_cxn_io_thread_index(connection_t *cxn)
+{
+    return cxn->io ? cxn->io->thread->index : -1;
+}
+
+
+/*------------------------------------------------------------
+ * OpenSSL locking
+ *------------------------------------------------------------*/
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static pthread_mutex_t *ssl_locks;
+
+static void
+ssl_locking_callback(int mode, int n, const char *file, int line)
+{
+    if (mode & CRYPTO_LOCK) {
+        pthread_mutex_lock(&ssl_locks[n]);
+    } else {
+        pthread_mutex_unlock(&ssl_locks[n]);
+    }
+}
+
+static void
+ssl_locks_init(void)
+{
+    int i;
+
+    if (CRYPTO_get_locking_callback() != NULL) {
+        /* Installed by the application */
+        return;
+    }
+
+    ssl_locks = aim_zmalloc(CRYPTO_num_locks() * sizeof(*ssl_locks));
+    for (i = 0; i < CRYPTO_num_locks(); i++) {
+        pthread_mutex_init(&ssl_locks[i], NULL);
+    }
+    CRYPTO_set_locking_callback(ssl_locking_callback);
+}
+
+static void
+ssl_locks_finish(void)
+{
+    int i;
+
+    if (ssl_locks == NULL) {
+        return;
+    }
+
+    CRYPTO_set_locking_callback(NULL);
+    for (i = 0; i < CRYPTO_num_locks(); i++) {
+        pthread_mutex_destroy(&ssl_locks[i]);
+    }
+    aim_free(ssl_locks);
+    ssl_locks = NULL;
+}
+#else
+static void ssl_locks_init(void) {}
+static void ssl_locks_finish(void) {}
+#endif
+
+
+/*------------------------------------------------------------
+ * Module init
+ *------------------------------------------------------------*/
+
+indigo_error_t
+ind_cxn_io_init(void)
+{
+    int i;
+
+    ssl_locks_init();
+
+    for (i = 0; i < OFCONNECTIONMANAGER_CONFIG_IO_THREADS; i++) {
+        cxn_io_thread_t *thread = &io_threads[i];
+        indigo_error_t rv;
+
+        INDIGO_MEM_CLEAR(thread, sizeof(*thread));
+        thread->index = i;
+        pthread_mutex_init(&thread->lock, NULL);
+        pthread_cond_init(&thread->cond, NULL);
+
+        thread->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        thread->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (thread->wake_fd < 0 || thread->notify_fd < 0) {
+            AIM_DIE("Failed to create eventfd for I/O thread %d: %s",
+                    i, strerror(errno));
+        }
+
+        rv = ind_soc_socket_register_with_priority(
+            thread->notify_fd, io_notify_ready, thread, IND_CXN_EVENT_PRIORITY);
+        AIM_ASSERT(rv == INDIGO_ERROR_NONE,
+                   "Unable to register notify socket for I/O thread %d", i);
+
+        if (pthread_create(&thread->thread, NULL, io_thread_main, thread) != 0) {
+            AIM_DIE("Failed to create I/O thread %d", i);
+        }
+    }
+
+    io_threads_running = true;
+
+    AIM_LOG_VERBOSE("Started %d connection I/O threads",
+                    OFCONNECTIONMANAGER_CONFIG_IO_THREADS);
+
+    return INDIGO_ERROR_NONE;
+}
+
+void
+ind_cxn_io_finish(void)
+{
+    int i;
+
+    if (!io_threads_running) {
+        return;
+    }
+
+    for (i = 0; i < OFCONNECTIONMANAGER_CONFIG_IO_THREADS; i++) {
+        cxn_io_thread_t *thread = &io_threads[i];
+
+        AIM_ASSERT(thread->num_attached == 0,
+                   "I/O thread %d still has %d connections",
+                   i, thread->num_attached);
+
+        __atomic_store_n(&thread->stop, 1, __ATOMIC_RELEASE);
+        io_thread_wake(thread);
+        pthread_join(thread->thread, NULL);
+
+        ind_soc_socket_unregister(thread->notify_fd);
+        close(thread->notify_fd);
+        close(thread->wake_fd);
+        pthread_cond_destroy(&thread->cond);
+        pthread_mutex_destroy(&thread->lock);
+    }
+
+    io_threads_running = false;
+
+    ssl_locks_finish();
+}
+
+#else /* OFCONNECTIONMANAGER_CONFIG_IO_THREADS == 0 */
+
+indigo_error_t
+ind_cxn_io_init(void)
+{
+    return INDIGO_ERROR_NONE;
+}
+
+void
+ind_cxn_io_finish(void)
+{
+}
+
+bool
+ind_cxn_io_enabled(void)
+{
+    return false;
+}
+
+void
+ind_cxn_io_attach(connection_t *cxn)
+{
+    AIM_DIE("Connection I/O threads are not enabled");
+}
+
+void
+ind_cxn_io_detach(connection_t *cxn)
+{
+    AIM_DIE("Connection I/O threads are not enabled");
+}
+
+indigo_error_t
+ind_cxn_io_enqueue(connection_t *cxn, uint8_t *data)
+{
+    AIM_DIE("Connection I/O threads are not enabled");
+}
+
+void
+ind_cxn_io_reconcile(connection_t *cxn)
+{
+}
+
+void
+ind_cxn_io_kick(connection_t *cxn)
+{
+}
+
+int
+ind_cxn_io_thread_index(connection_t *cxn)
+{
+    return -1;
+}
+
+#endif /* OFCONNECTIONMANAGER_CONFIG_IO_THREADS */
@@ -1778,6 +1778,12 @@ ind_cxn_init(ind_cxn_config_t *config)
 
     tls_init();
 
+    if (ind_cxn_io_init() < 0) {
+        AIM_LOG_ERROR("Failed to start connection I/O threads");
+        tls_deinit();
+        return INDIGO_ERROR_INIT;
+    }
+
     init_done = 1;
 
     return INDIGO_ERROR_NONE;
@@ -1841,6 +1847,7 @@ ind_cxn_finish(void)
     ind_cxn_enable_set(0);
     ind_cfg_unregister(&ind_cxn_cfg_ops);
     ind_cxn_async_channel_selector_handler = NULL;
+    ind_cxn_io_finish();
     tls_deinit();
     return INDIGO_ERROR_NONE;
 }
@@ -2371,3 +2378,17 @@ int unit_test_cxn_events_get(indigo_controller_id_t controller_id,
     return unit_test_soc_socket_events_get(controller->cxns[aux_id]->sd);
 }
 
+int unit_test_cxn_io_thread_get(indigo_controller_id_t controller_id,
+                                uint8_t aux_id)
+{
+    controller_t *controller;
+
+    AIM_ASSERT(CONTROLLER_ID_VALID(controller_id) &&
+               CONTROLLER_ID_ACTIVE(controller_id));
+    controller = ID_TO_CONTROLLER(controller_id);
+
+    AIM_ASSERT(aux_id < MAX_AUX_CONNECTIONS);
+
+    return ind_cxn_io_thread_index(controller->cxns[aux_id]);
+}
+
@@ -66,6 +66,12 @@ extern uint64_t ind_cxn_generation_id;
  */
 #define IND_CXN_EVENT_PRIORITY IND_SOC_HIGH_PRIORITY
 
+/*
+ * Keepalive timers may run up to period/divisor late so they can be
+ * coalesced with other timers.
+ */
+#define IND_CXN_KEEPALIVE_SLACK_DIVISOR 8
+
 uint32_t ind_cxn_xid_get(void);
 
 void ind_controller_change_master(indigo_cxn_id_t master_id);
@@ -116,6 +122,17 @@ void ind_cxn_bundle_cleanup(connection_t *cxn);
 void ind_cxn_bundle_ctrl_handle(connection_t *cxn, of_object_t *_obj);
 void ind_cxn_bundle_add_handle(connection_t *cxn, of_object_t *_obj);
 
+/* I/O thread interfaces */
+indigo_error_t ind_cxn_io_init(void);
+void ind_cxn_io_finish(void);
+bool ind_cxn_io_enabled(void);
+void ind_cxn_io_attach(connection_t *cxn);
+void ind_cxn_io_detach(connection_t *cxn);
+indigo_error_t ind_cxn_io_enqueue(connection_t *cxn, uint8_t *data);
+void ind_cxn_io_reconcile(connection_t *cxn);
+void ind_cxn_io_kick(connection_t *cxn);
+int ind_cxn_io_thread_index(connection_t *cxn);
+
 /*
  * populate destbuf with useful connection identifying info.
  * destbuf has maximum length destbuflen.
@@ -137,4 +154,7 @@ int unit_test_connection_count_get(void);
 int unit_test_cxn_events_get(indigo_controller_id_t controller_id,
                              uint8_t aux_id);
 
+int unit_test_cxn_io_thread_get(indigo_controller_id_t controller_id,
+                                uint8_t aux_id);
+
 #endif /* __OFCONNECTIONMANAGER_INT_H__ */
@@ -0,0 +1,150 @@
+/****************************************************************
+ *
+ *        Copyright 2017, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/**
+ * @file
+ * @brief Bounded lock-free single-producer/single-consumer ring
+ *
+ * Used to hand complete messages between a connection I/O thread and
+ * the state thread. Exactly one thread may push and exactly one thread
+ * may pop. The producer owns the tail index and the consumer owns the
+ * head index; each publishes its index with release semantics and reads
+ * the other's with acquire semantics, so an entry is fully written
+ * before the consumer can observe it.
+ */
+
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <AIM/aim.h>
+#include <indigo/assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPSC_RING_CACHELINE 64
+
+typedef struct spsc_ring_s {
+    uint32_t size; /* Power of two */
+    uint32_t mask;
+    uint32_t head __attribute__((aligned(SPSC_RING_CACHELINE))); /* Written by consumer */
+    uint32_t tail __attribute__((aligned(SPSC_RING_CACHELINE))); /* Written by producer */
+    void *entries[] __attribute__((aligned(SPSC_RING_CACHELINE)));
+} spsc_ring_t;
+
+/**
+ * Create a ring holding up to 'size' entries
+ *
+ * 'size' must be a power of two.
+ */
+static inline spsc_ring_t *
+spsc_ring_create(uint32_t size)
+{
+    spsc_ring_t *ring;
+
+    AIM_ASSERT(size > 0 && (size & (size - 1)) == 0,
+               "SPSC ring size %u is not a power of two", size);
+
+    ring = aim_zmalloc(sizeof(*ring) + size * sizeof(ring->entries[0]));
+    ring->size = size;
+    ring->mask = size - 1;
+
+    return ring;
+}
+
+/**
+ * Destroy a ring
+ *
+ * The ring must be drained by the caller; entries are not freed.
+ */
+static inline void
+spsc_ring_destroy(spsc_ring_t *ring)
+{
+    aim_free(ring);
+}
+
+/**
+ * Append an entry (producer only)
+ *
+ * @returns false if the ring is full
+ */
+static inline bool
+spsc_ring_push(spsc_ring_t *ring, void *entry)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (tail - head == ring->size) {
+        return false;
+    }
+
+    ring->entries[tail & ring->mask] = entry;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * Remove the oldest entry (consumer only)
+ *
+ * @returns NULL if the ring is empty
+ */
+static inline void *
+spsc_ring_pop(spsc_ring_t *ring)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    void *entry;
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    entry = ring->entries[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return entry;
+}
+
+/**
+ * Number of entries currently in the ring
+ *
+ * Exact when called by either side while the other is idle, otherwise a
+ * snapshot that may be stale by the time it is used.
+ */
+static inline uint32_t
+spsc_ring_count(spsc_ring_t *ring)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
+
+static inline bool
+spsc_ring_empty(spsc_ring_t *ring)
+{
+    return spsc_ring_count(ring) == 0;
+}
+
+static inline bool
+spsc_ring_full(spsc_ring_t *ring)
+{
+    return spsc_ring_count(ring) == ring->size;
+}
+
+#endif /* _SPSC_RING_H_ */
@@ -55,6 +55,10 @@
 #include <openssl/err.h>
 
 #include "ofconnectionmanager_int.h"
+#include "spsc_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
 
 
 #define OK(op)  INDIGO_ASSERT((op) == INDIGO_ERROR_NONE)
@@ -836,9 +840,12 @@ indigo_teardown(void)
                   "actual connection count %d, expected 0", 
                   unit_test_connection_count_get());
 
-    INDIGO_ASSERT(unit_test_soc_socket_count_get() == 0,
-                  "actual soc event count %d, expected 0", 
-                  unit_test_soc_socket_count_get());
+    /* Each I/O thread keeps its notify eventfd registered until finish */
+    INDIGO_ASSERT(unit_test_soc_socket_count_get() ==
+                  OFCONNECTIONMANAGER_CONFIG_IO_THREADS,
+                  "actual soc event count %d, expected %d",
+                  unit_test_soc_socket_count_get(),
+                  OFCONNECTIONMANAGER_CONFIG_IO_THREADS);
     INDIGO_ASSERT(unit_test_soc_timer_event_count_get() == 0,
                   "actual soc timer count %d, expected 0", 
                   unit_test_soc_timer_event_count_get());
@@ -2167,6 +2174,155 @@ test_bad_controller_name(bool use_tls, int domain, char *addr)
 }
 
 
+#define SPSC_TEST_COUNT 1000000
+
+static void *
+spsc_producer(void *arg)
+{
+    spsc_ring_t *ring = arg;
+    uintptr_t i;
+
+    for (i = 1; i <= SPSC_TEST_COUNT; i++) {
+        while (!spsc_ring_push(ring, (void *)i)) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void
+test_spsc_ring(void)
+{
+    spsc_ring_t *ring;
+    pthread_t producer;
+    uintptr_t i, expected;
+
+    printf("***Start %s\n", __FUNCTION__);
+
+    /* Single thread */
+    ring = spsc_ring_create(4);
+    INDIGO_ASSERT(spsc_ring_empty(ring));
+    INDIGO_ASSERT(spsc_ring_pop(ring) == NULL);
+    for (i = 1; i <= 4; i++) {
+        INDIGO_ASSERT(spsc_ring_push(ring, (void *)i));
+    }
+    INDIGO_ASSERT(spsc_ring_full(ring));
+    INDIGO_ASSERT(!spsc_ring_push(ring, (void *)5));
+    INDIGO_ASSERT(spsc_ring_count(ring) == 4);
+    for (i = 1; i <= 4; i++) {
+        INDIGO_ASSERT(spsc_ring_pop(ring) == (void *)i);
+    }
+    INDIGO_ASSERT(spsc_ring_empty(ring));
+    spsc_ring_destroy(ring);
+
+    /* Producer and consumer on different threads, entries stay in order */
+    ring = spsc_ring_create(64);
+    INDIGO_ASSERT(pthread_create(&producer, NULL, spsc_producer, ring) == 0);
+    expected = 1;
+    while (expected <= SPSC_TEST_COUNT) {
+        void *entry = spsc_ring_pop(ring);
+        if (entry == NULL) {
+            sched_yield();
+            continue;
+        }
+        INDIGO_ASSERT(entry == (void *)expected);
+        expected++;
+    }
+    pthread_join(producer, NULL);
+    INDIGO_ASSERT(spsc_ring_empty(ring));
+    spsc_ring_destroy(ring);
+
+    printf("***Stop %s\n", __FUNCTION__);
+}
+
+#define IO_TEST_ECHO_COUNT 200
+
+static void
+of_send_echo_request(bool is_tls, intptr_t tl)
+{
+    of_sendmsg(is_tls, tl, of_echo_request_new(of_version));
+}
+
+/*
+ * Push a burst of messages through an established connection so that the
+ * I/O thread and the event loop repeatedly hand work to each other through
+ * the rings and eventfds. Replies must all arrive, in order.
+ */
+static void
+test_io_threads(bool use_tls)
+{
+    indigo_controller_id_t id;
+    int lsd;
+    intptr_t tl;
+    of_object_t *obj;
+    of_object_storage_t storage;
+    uint8_t buf[512];  /* may need to be increased */
+    uint32_t xid, last_xid;
+    int i;
+
+    printf("***Start %s, %s\n", __FUNCTION__, get_tcp_tls(use_tls));
+
+    lsd = setup_server(AF_INET, CONTROLLER_IP, CONTROLLER_PORT1);
+    indigo_setup(use_tls, CIPHER_LIST, NULL,
+                 SWITCH_CERT_FILE, SWITCH_PRIV_KEY_FILE, NULL);
+
+    id = setup_cxn(use_tls, CONTROLLER_IP, CONTROLLER_PORT1);
+    INDIGO_ASSERT(id >= 0);
+    OK(ind_soc_select_and_run(1));
+
+    tl = advance_to_handshake_complete(use_tls, false, id, 0, lsd);
+    INDIGO_ASSERT(unit_test_connection_count_get() == 1);
+
+    if (OFCONNECTIONMANAGER_CONFIG_IO_THREADS > 0) {
+        INDIGO_ASSERT(unit_test_cxn_io_thread_get(id, 0) >= 0,
+                      "connection was not moved to an I/O thread");
+    } else {
+        INDIGO_ASSERT(unit_test_cxn_io_thread_get(id, 0) == -1);
+    }
+
+    /* Written by the I/O thread once the handshake completed */
+    obj = of_recvmsg(use_tls, tl, buf, sizeof(buf), &storage);
+    INDIGO_ASSERT(obj->object_id == OF_BSN_CONTROLLER_CONNECTIONS_REPLY,
+                  "did not receive OF_BSN_CONTROLLER_CONNECTIONS_REPLY");
+
+    for (i = 0; i < IO_TEST_ECHO_COUNT; i++) {
+        of_send_echo_request(use_tls, tl);
+    }
+    for (i = 0; i < 20; i++) {
+        OK(ind_soc_select_and_run(50));
+    }
+
+    last_xid = 0;
+    for (i = 0; i < IO_TEST_ECHO_COUNT; i++) {
+        obj = of_recvmsg(use_tls, tl, buf, sizeof(buf), &storage);
+        INDIGO_ASSERT(obj->object_id == OF_ECHO_REPLY,
+                      "did not receive OF_ECHO_REPLY, got %s",
+                      of_class_name(obj));
+        of_echo_reply_xid_get(obj, &xid);
+        INDIGO_ASSERT(xid > last_xid,
+                      "echo reply xid 0x%x out of order after 0x%x",
+                      xid, last_xid);
+        last_xid = xid;
+    }
+
+    /* The I/O thread sees the close and reports it to the event loop */
+    tl_close(use_tls, tl);
+    for (i = 0; i < 100 && cxn_is_connected[id][0]; i++) {
+        OK(ind_soc_select_and_run(10));
+    }
+    INDIGO_ASSERT(!cxn_is_connected[id][0]);
+
+    OK(indigo_controller_remove(id));
+    OK(ind_soc_select_and_run(5));
+
+    indigo_teardown();
+
+    close(lsd);
+
+    printf("***Stop %s, %s\n", __FUNCTION__, get_tcp_tls(use_tls));
+}
+
 void run_all_tests(bool use_tls)
 {
     test_bad_controller(use_tls);
@@ -2206,6 +2362,8 @@ void run_all_tests(bool use_tls)
     if (!use_tls) {
         test_listener(use_tls, AF_UNIX);
     }
+
+    test_io_threads(use_tls);
 }
 
 
@@ -2215,6 +2373,18 @@ int aim_main(int argc, char* argv[])
 
     basedir = dirname(argv[0]);
 
+    test_spsc_ring();
+
+    if (OFCONNECTIONMANAGER_CONFIG_IO_THREADS > 0) {
+        /*
+         * The remaining tests inspect socket registration on the event
+         * loop, which no longer owns established connections
+         */
+        test_io_threads(false);
+        test_io_threads(true);
+        return 0;
+    }
+
     use_tls = false;
     run_all_tests(use_tls);
 
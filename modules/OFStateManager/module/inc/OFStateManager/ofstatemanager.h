@@ -109,5 +109,10 @@ void ind_core_ft_show(aim_pvs_t* pvs);
  */
 void ind_core_ft_stats(aim_pvs_t* pvs);
 
+/**
+ * Show entry counts and memory usage of each gentable
+ */
+void ind_core_gentable_stats(aim_pvs_t* pvs);
+
 #endif /* __OFSTATEMANAGER_H__ */
 /** @} */
@@ -30,6 +30,7 @@
 #include <indigo/port_manager.h>
 #include <loci/loci.h>
 #include "handlers.h"
+#include "port.h"
 
 /* TODO move into LOXI */
 #define OF_BSN_VLAN_ALL 0xffff
@@ -45,46 +46,57 @@ append_uint64(of_list_uint64_t *list, uint64_t value)
     of_uint64_value_set(&elem, value);
 }
 
-/*
- * Truncate the object to its initial length.
- *
- * This is called by the stats handlers to reuse a single allocated entry.
- */
-static void
-truncate_of_object(of_object_t *obj)
-{
-    of_object_init_map[obj->object_id](obj, obj->version, -1, 0);
-    obj->wbuf->current_bytes = obj->length;
-}
-
 /* Returns true if the entry should be sent to the controller */
 static bool
 ind_core_bsn_vlan_counter_stats_entry_populate(of_bsn_vlan_counter_stats_entry_t *entry,
-                                               uint16_t vlan_vid)
+                                               uint16_t vlan_vid,
+                                               const indigo_fi_vlan_stats_t *stats)
 {
-    indigo_fi_vlan_stats_t stats;
     of_list_uint64_t values;
 
-    /* Default to "counter not supported" */
-    memset(&stats, 0xff, sizeof(stats));
-
-    indigo_fwd_vlan_stats_get(vlan_vid, &stats);
-
-    if (!memcmp(&stats, &zero_vlan_stats, sizeof(stats))) {
+    if (!memcmp(stats, &zero_vlan_stats, sizeof(*stats))) {
         return false;
     }
 
     of_bsn_vlan_counter_stats_entry_vlan_vid_set(entry, vlan_vid);
     of_bsn_vlan_counter_stats_entry_values_bind(entry, &values);
 
-    append_uint64(&values, stats.rx_bytes);
-    append_uint64(&values, stats.rx_packets);
-    append_uint64(&values, stats.tx_bytes);
-    append_uint64(&values, stats.tx_packets);
+    append_uint64(&values, stats->rx_bytes);
+    append_uint64(&values, stats->rx_packets);
+    append_uint64(&values, stats->tx_bytes);
+    append_uint64(&values, stats->tx_packets);
 
     return true;
 }
 
+/*
+ * Returns the VLANs included in an OF_BSN_VLAN_ALL request
+ *
+ * These are the registered VLANs, or every VLAN if Forwarding hasn't
+ * registered any.
+ */
+static int
+ind_core_bsn_vlan_counter_stats_vlans(uint16_t *vlan_vids)
+{
+    int count = 0;
+
+    if (ind_core_vlans_registered > 0) {
+        struct slot_allocator_iter iter;
+        slot_allocator_iter_init(ind_core_vlan_allocator, &iter);
+        uint32_t slot;
+        while ((slot = slot_allocator_iter_next(&iter)) != SLOT_INVALID) {
+            vlan_vids[count++] = ind_core_vlans[slot].vlan_vid;
+        }
+    } else {
+        uint16_t vlan_vid;
+        for (vlan_vid = 1; vlan_vid < 4096; vlan_vid++) {
+            vlan_vids[count++] = vlan_vid;
+        }
+    }
+
+    return count;
+}
+
 void
 ind_core_bsn_vlan_counter_stats_request_handler(of_object_t *_obj,
                                                 indigo_cxn_id_t cxn_id)
@@ -117,8 +129,19 @@ ind_core_bsn_vlan_counter_stats_request_handler(of_object_t *_obj,
     AIM_TRUE_OR_DIE(entry != NULL);
 
     if (vlan_vid == OF_BSN_VLAN_ALL) {
-        for (vlan_vid = 1; vlan_vid < 4096; vlan_vid++) {
-            if (!ind_core_bsn_vlan_counter_stats_entry_populate(entry, vlan_vid)) {
+        uint16_t *vlan_vids = aim_malloc(IND_CORE_MAX_VLANS * sizeof(*vlan_vids));
+        int count = ind_core_bsn_vlan_counter_stats_vlans(vlan_vids);
+        indigo_fi_vlan_stats_t *stats = aim_malloc(count * sizeof(*stats));
+        int i;
+
+        /* Default to "counter not supported" */
+        memset(stats, 0xff, count * sizeof(*stats));
+
+        indigo_fwd_vlan_stats_get_many(vlan_vids, count, stats);
+
+        for (i = 0; i < count; i++) {
+            if (!ind_core_bsn_vlan_counter_stats_entry_populate(entry, vlan_vids[i],
+                                                                &stats[i])) {
                 continue;
             }
 
@@ -142,8 +165,18 @@ ind_core_bsn_vlan_counter_stats_request_handler(of_object_t *_obj,
 
             truncate_of_object(entry);
         }
+
+        aim_free(stats);
+        aim_free(vlan_vids);
     } else {
-        ind_core_bsn_vlan_counter_stats_entry_populate(entry, vlan_vid);
+        indigo_fi_vlan_stats_t stats;
+
+        /* Default to "counter not supported" */
+        memset(&stats, 0xff, sizeof(stats));
+
+        indigo_fwd_vlan_stats_get(vlan_vid, &stats);
+
+        ind_core_bsn_vlan_counter_stats_entry_populate(entry, vlan_vid, &stats);
 
         if (of_list_append(&entries, entry) < 0) {
             AIM_DIE("unexpected failure appending single bsn_vlan_counter stats entry");
@@ -157,79 +190,74 @@ ind_core_bsn_vlan_counter_stats_request_handler(of_object_t *_obj,
 
 static void
 ind_core_bsn_port_counter_stats_entry_populate(of_bsn_port_counter_stats_entry_t *entry,
-                                               of_port_no_t port_no)
+                                               of_port_no_t port_no,
+                                               const indigo_fi_port_stats_t *stats)
 {
-    indigo_fi_port_stats_t stats;
     of_list_uint64_t values;
 
-    /* Default to "counter not supported" */
-    memset(&stats, 0xff, sizeof(stats));
-
-    indigo_port_extended_stats_get(port_no, &stats);
-
     of_bsn_port_counter_stats_entry_port_no_set(entry, port_no);
     of_bsn_port_counter_stats_entry_values_bind(entry, &values);
 
-    append_uint64(&values, stats.rx_bytes);
-    append_uint64(&values, stats.rx_packets_unicast);
-    append_uint64(&values, stats.rx_packets_broadcast);
-    append_uint64(&values, stats.rx_packets_multicast);
-    append_uint64(&values, stats.rx_dropped);
-    append_uint64(&values, stats.rx_errors);
-    append_uint64(&values, stats.tx_bytes);
-    append_uint64(&values, stats.tx_packets_unicast);
-    append_uint64(&values, stats.tx_packets_broadcast);
-    append_uint64(&values, stats.tx_packets_multicast);
-    append_uint64(&values, stats.tx_dropped);
-    append_uint64(&values, stats.tx_errors);
-
-    append_uint64(&values, stats.rx_runts);
-    append_uint64(&values, stats.rx_giants);
-    append_uint64(&values, stats.rx_crc_errors);
-    append_uint64(&values, stats.rx_alignment_errors);
-    append_uint64(&values, stats.rx_symbol_errors);
-    append_uint64(&values, stats.rx_pause_input);
-    append_uint64(&values, stats.tx_collisions);
-    append_uint64(&values, stats.tx_late_collisions);
-    append_uint64(&values, stats.tx_deferred);
-    append_uint64(&values, stats.tx_pause_output);
-
-    append_uint64(&values, stats.rx_packets);
-    append_uint64(&values, stats.tx_packets);
-    append_uint64(&values, stats.rx_length_errors);
-    append_uint64(&values, stats.rx_overflow_errors);
-    append_uint64(&values, stats.tx_carrier_errors);
-    append_uint64(&values, stats.rx_bad_vlan);
-
-    append_uint64(&values, stats.link_up_count);
-    append_uint64(&values, stats.link_down_count);
-
-    append_uint64(&values, stats.rx_pfc_control_frame);
-    append_uint64(&values, stats.tx_pfc_control_frame);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_0);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_1);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_2);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_3);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_4);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_5);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_6);
-    append_uint64(&values, stats.rx_pfc_frame_xon_priority_7);
-    append_uint64(&values, stats.rx_pfc_frame_priority_0);
-    append_uint64(&values, stats.rx_pfc_frame_priority_1);
-    append_uint64(&values, stats.rx_pfc_frame_priority_2);
-    append_uint64(&values, stats.rx_pfc_frame_priority_3);
-    append_uint64(&values, stats.rx_pfc_frame_priority_4);
-    append_uint64(&values, stats.rx_pfc_frame_priority_5);
-    append_uint64(&values, stats.rx_pfc_frame_priority_6);
-    append_uint64(&values, stats.rx_pfc_frame_priority_7);
-    append_uint64(&values, stats.tx_pfc_frame_priority_0);
-    append_uint64(&values, stats.tx_pfc_frame_priority_1);
-    append_uint64(&values, stats.tx_pfc_frame_priority_2);
-    append_uint64(&values, stats.tx_pfc_frame_priority_3);
-    append_uint64(&values, stats.tx_pfc_frame_priority_4);
-    append_uint64(&values, stats.tx_pfc_frame_priority_5);
-    append_uint64(&values, stats.tx_pfc_frame_priority_6);
-    append_uint64(&values, stats.tx_pfc_frame_priority_7);
+    append_uint64(&values, stats->rx_bytes);
+    append_uint64(&values, stats->rx_packets_unicast);
+    append_uint64(&values, stats->rx_packets_broadcast);
+    append_uint64(&values, stats->rx_packets_multicast);
+    append_uint64(&values, stats->rx_dropped);
+    append_uint64(&values, stats->rx_errors);
+    append_uint64(&values, stats->tx_bytes);
+    append_uint64(&values, stats->tx_packets_unicast);
+    append_uint64(&values, stats->tx_packets_broadcast);
+    append_uint64(&values, stats->tx_packets_multicast);
+    append_uint64(&values, stats->tx_dropped);
+    append_uint64(&values, stats->tx_errors);
+
+    append_uint64(&values, stats->rx_runts);
+    append_uint64(&values, stats->rx_giants);
+    append_uint64(&values, stats->rx_crc_errors);
+    append_uint64(&values, stats->rx_alignment_errors);
+    append_uint64(&values, stats->rx_symbol_errors);
+    append_uint64(&values, stats->rx_pause_input);
+    append_uint64(&values, stats->tx_collisions);
+    append_uint64(&values, stats->tx_late_collisions);
+    append_uint64(&values, stats->tx_deferred);
+    append_uint64(&values, stats->tx_pause_output);
+
+    append_uint64(&values, stats->rx_packets);
+    append_uint64(&values, stats->tx_packets);
+    append_uint64(&values, stats->rx_length_errors);
+    append_uint64(&values, stats->rx_overflow_errors);
+    append_uint64(&values, stats->tx_carrier_errors);
+    append_uint64(&values, stats->rx_bad_vlan);
+
+    append_uint64(&values, stats->link_up_count);
+    append_uint64(&values, stats->link_down_count);
+
+    append_uint64(&values, stats->rx_pfc_control_frame);
+    append_uint64(&values, stats->tx_pfc_control_frame);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_0);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_1);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_2);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_3);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_4);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_5);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_6);
+    append_uint64(&values, stats->rx_pfc_frame_xon_priority_7);
+    append_uint64(&values, stats->rx_pfc_frame_priority_0);
+    append_uint64(&values, stats->rx_pfc_frame_priority_1);
+    append_uint64(&values, stats->rx_pfc_frame_priority_2);
+    append_uint64(&values, stats->rx_pfc_frame_priority_3);
+    append_uint64(&values, stats->rx_pfc_frame_priority_4);
+    append_uint64(&values, stats->rx_pfc_frame_priority_5);
+    append_uint64(&values, stats->rx_pfc_frame_priority_6);
+    append_uint64(&values, stats->rx_pfc_frame_priority_7);
+    append_uint64(&values, stats->tx_pfc_frame_priority_0);
+    append_uint64(&values, stats->tx_pfc_frame_priority_1);
+    append_uint64(&values, stats->tx_pfc_frame_priority_2);
+    append_uint64(&values, stats->tx_pfc_frame_priority_3);
+    append_uint64(&values, stats->tx_pfc_frame_priority_4);
+    append_uint64(&values, stats->tx_pfc_frame_priority_5);
+    append_uint64(&values, stats->tx_pfc_frame_priority_6);
+    append_uint64(&values, stats->tx_pfc_frame_priority_7);
 }
 
 void
@@ -257,6 +285,9 @@ ind_core_bsn_port_counter_stats_request_handler(of_object_t *_obj,
 
     if (port_no == OF_PORT_DEST_ALL) {
         indigo_port_info_t *port_list, *port_info;
+        of_port_no_t *port_nos;
+        indigo_fi_port_stats_t *stats;
+        int count = 0, i;
 
         if (indigo_port_interface_list(&port_list) < 0) {
             of_object_delete(reply);
@@ -268,9 +299,26 @@ ind_core_bsn_port_counter_stats_request_handler(of_object_t *_obj,
         }
 
         for (port_info = port_list; port_info; port_info = port_info->next) {
-            port_no = port_info->of_port;
+            count++;
+        }
 
-            ind_core_bsn_port_counter_stats_entry_populate(entry, port_no);
+        /* Avoid a zero-size allocation */
+        port_nos = aim_malloc(sizeof(*port_nos) * (count + 1));
+        stats = aim_malloc(sizeof(*stats) * (count + 1));
+
+        for (port_info = port_list, i = 0; port_info; port_info = port_info->next, i++) {
+            port_nos[i] = port_info->of_port;
+        }
+
+        indigo_port_interface_list_destroy(port_list);
+
+        /* Default to "counter not supported" */
+        memset(stats, 0xff, sizeof(*stats) * count);
+
+        indigo_port_extended_stats_get_many(port_nos, count, stats);
+
+        for (i = 0; i < count; i++) {
+            ind_core_bsn_port_counter_stats_entry_populate(entry, port_nos[i], &stats[i]);
 
             if (of_list_append(&entries, entry) < 0) {
                 /* This entry didn't fit, send out the current message and
@@ -293,9 +341,17 @@ ind_core_bsn_port_counter_stats_request_handler(of_object_t *_obj,
             truncate_of_object(entry);
         }
 
-        indigo_port_interface_list_destroy(port_list);
+        aim_free(stats);
+        aim_free(port_nos);
     } else {
-        ind_core_bsn_port_counter_stats_entry_populate(entry, port_no);
+        indigo_fi_port_stats_t stats;
+
+        /* Default to "counter not supported" */
+        memset(&stats, 0xff, sizeof(stats));
+
+        indigo_port_extended_stats_get(port_no, &stats);
+
+        ind_core_bsn_port_counter_stats_entry_populate(entry, port_no, &stats);
 
         if (of_list_append(&entries, entry) < 0) {
             AIM_DIE("unexpected failure appending single bsn_port_counter stats entry");
@@ -0,0 +1,304 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Checksum tree generic stats handlers
+ *
+ * The "gentable_checksum_tree" and "flow_checksum_tree" generic stats
+ * requests return the checksums of a subtree of the binary tree built over
+ * a table's checksum buckets. Level 0 is the root, which covers the whole
+ * table, and the deepest level holds the buckets themselves. A controller
+ * resyncs by comparing the root and descending only into the subtrees
+ * whose checksums differ, instead of fetching every bucket.
+ *
+ * The request has a single uint64_list TLV containing the table id, and
+ * the level, index and depth of the subtree. The reply has a single entry
+ * with two uint64_list TLVs. The first contains the depth of the tree, the
+ * level of the returned nodes and the index of the first node. The second
+ * contains the checksums of the nodes 'depth' levels below the requested
+ * node, in order. Gentable checksums are 128 bits and are returned as
+ * (hi, lo) pairs.
+ *
+ * The depth is truncated at the bucket level and so that at most
+ * CHECKSUM_TREE_MAX_NODES nodes are returned.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <loci/loci.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+#include "ft.h"
+
+#define CHECKSUM_TREE_MAX_NODES 1024
+#define CHECKSUM_TREE_MAX_NODES_LOG2 10
+
+struct checksum_tree_request {
+    uint64_t table_id;
+    uint64_t level;
+    uint64_t index;
+    uint64_t depth;
+};
+
+static void handle_gentable_checksum_tree_request(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req, void *priv);
+static void handle_flow_checksum_tree_request(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req, void *priv);
+
+void
+ind_core_checksum_tree_handlers_init(void)
+{
+    indigo_core_generic_stats_register("gentable_checksum_tree",
+                                       handle_gentable_checksum_tree_request, NULL);
+    indigo_core_generic_stats_register("flow_checksum_tree",
+                                       handle_flow_checksum_tree_request, NULL);
+}
+
+/*
+ * Parse the request TLVs
+ *
+ * Sends an error and returns false if the request is malformed.
+ */
+static bool
+parse_request(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req,
+              struct checksum_tree_request *request)
+{
+    of_object_t tlvs;
+    of_bsn_generic_stats_request_tlvs_bind(req, &tlvs);
+
+    of_object_t tlv;
+    if (of_list_bsn_tlv_first(&tlvs, &tlv) < 0 ||
+            tlv.object_id != OF_BSN_TLV_UINT64_LIST) {
+        indigo_cxn_send_bsn_error(cxn_id, req, "Expected uint64_list TLV");
+        return false;
+    }
+
+    uint64_t params[4];
+    int num_params = 0;
+
+    of_list_uint64_t uint64s;
+    of_bsn_tlv_uint64_list_value_bind(&tlv, &uint64s);
+
+    of_object_t elem;
+    int loop_rv;
+    OF_LIST_UINT64_ITER(&uint64s, &elem, loop_rv) {
+        if (num_params < AIM_ARRAYSIZE(params)) {
+            of_uint64_value_get(&elem, &params[num_params]);
+        }
+        num_params++;
+    }
+
+    if (num_params != AIM_ARRAYSIZE(params)) {
+        indigo_cxn_send_bsn_error(cxn_id, req,
+            "Expected table id, level, index and depth in uint64_list TLV");
+        return false;
+    }
+
+    if (of_list_bsn_tlv_next(&tlvs, &tlv) == 0) {
+        char err[128];
+        snprintf(err, sizeof(err), "Expected end of TLV list, found %s", of_class_name(&tlv));
+        indigo_cxn_send_bsn_error(cxn_id, req, err);
+        return false;
+    }
+
+    request->table_id = params[0];
+    request->level = params[1];
+    request->index = params[2];
+    request->depth = params[3];
+
+    return true;
+}
+
+/*
+ * Find the nodes to return for a tree of the given depth
+ *
+ * Sends an error and returns false if the requested node doesn't exist.
+ */
+static bool
+select_nodes(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req,
+             const struct checksum_tree_request *request, uint32_t tree_depth,
+             uint32_t *level, uint32_t *index, uint32_t *count)
+{
+    uint64_t depth = request->depth;
+
+    if (request->level > tree_depth || request->index >= (1ull << request->level)) {
+        indigo_cxn_send_bsn_error(cxn_id, req, "Checksum tree node out of range");
+        return false;
+    }
+
+    if (depth > tree_depth - request->level) {
+        depth = tree_depth - request->level;
+    }
+
+    if (depth > CHECKSUM_TREE_MAX_NODES_LOG2) {
+        depth = CHECKSUM_TREE_MAX_NODES_LOG2;
+    }
+
+    *level = request->level + depth;
+    *index = request->index << depth;
+    *count = 1u << depth;
+
+    return true;
+}
+
+/*
+ * Allocate a reply with one entry and return the uint64_list for the
+ * checksums
+ */
+static of_object_t *
+alloc_reply(of_bsn_generic_stats_request_t *req, uint32_t tree_depth,
+            uint32_t level, uint32_t index, of_list_uint64_t *checksums)
+{
+    uint32_t xid;
+    of_bsn_generic_stats_request_xid_get(req, &xid);
+
+    of_object_t *reply = of_bsn_generic_stats_reply_new(req->version);
+    if (reply == NULL) {
+        AIM_LOG_ERROR("Failed to allocate bsn_generic_stats_reply");
+        return NULL;
+    }
+
+    of_bsn_generic_stats_reply_xid_set(reply, xid);
+
+    of_object_t entries;
+    of_bsn_generic_stats_reply_entries_bind(reply, &entries);
+
+    of_object_t entry;
+    of_bsn_generic_stats_entry_init(&entry, entries.version, -1, 1);
+    of_list_bsn_generic_stats_entry_append_bind(&entries, &entry);
+
+    of_object_t tlvs;
+    of_bsn_generic_stats_entry_tlvs_bind(&entry, &tlvs);
+
+    of_object_t tlv;
+    of_bsn_tlv_uint64_list_init(&tlv, tlvs.version, -1, 1);
+    of_list_bsn_tlv_append_bind(&tlvs, &tlv);
+
+    of_list_uint64_t header;
+    of_bsn_tlv_uint64_list_value_bind(&tlv, &header);
+
+    uint64_t header_values[] = { tree_depth, level, index };
+    int i;
+    for (i = 0; i < AIM_ARRAYSIZE(header_values); i++) {
+        of_uint64_t elem;
+        of_uint64_init(&elem, header.version, -1, 1);
+        of_list_uint64_append_bind(&header, &elem);
+        of_uint64_value_set(&elem, header_values[i]);
+    }
+
+    of_bsn_tlv_uint64_list_init(&tlv, tlvs.version, -1, 1);
+    of_list_bsn_tlv_append_bind(&tlvs, &tlv);
+    of_bsn_tlv_uint64_list_value_bind(&tlv, checksums);
+
+    return reply;
+}
+
+static void
+append_uint64(of_list_uint64_t *list, uint64_t value)
+{
+    of_uint64_t elem;
+    of_uint64_init(&elem, list->version, -1, 1);
+    of_list_uint64_append_bind(list, &elem);
+    of_uint64_value_set(&elem, value);
+}
+
+static void
+handle_gentable_checksum_tree_request(
+    indigo_cxn_id_t cxn_id,
+    of_bsn_generic_stats_request_t *req,
+    void *priv)
+{
+    struct checksum_tree_request request;
+    uint32_t tree_depth, level, index, count, i;
+    of_checksum_128_t checksums[CHECKSUM_TREE_MAX_NODES];
+    of_list_uint64_t list;
+    of_object_t *reply;
+
+    if (!parse_request(cxn_id, req, &request)) {
+        return;
+    }
+
+    if (request.table_id > UINT16_MAX ||
+            ind_core_gentable_checksum_tree_depth(request.table_id, &tree_depth) < 0) {
+        indigo_cxn_send_bsn_error(cxn_id, req, "Nonexistent gentable");
+        return;
+    }
+
+    if (!select_nodes(cxn_id, req, &request, tree_depth, &level, &index, &count)) {
+        return;
+    }
+
+    if (ind_core_gentable_checksum_tree_get(request.table_id, level, index,
+                                            count, checksums) < 0) {
+        AIM_LOG_INTERNAL("Failed to read gentable checksum tree");
+        return;
+    }
+
+    reply = alloc_reply(req, tree_depth, level, index, &list);
+    if (reply == NULL) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        append_uint64(&list, checksums[i].hi);
+        append_uint64(&list, checksums[i].lo);
+    }
+
+    indigo_cxn_send_controller_message(cxn_id, reply);
+}
+
+static void
+handle_flow_checksum_tree_request(
+    indigo_cxn_id_t cxn_id,
+    of_bsn_generic_stats_request_t *req,
+    void *priv)
+{
+    struct checksum_tree_request request;
+    uint32_t tree_depth, level, index, count, i;
+    of_list_uint64_t list;
+    of_object_t *reply;
+    ft_table_t *table;
+
+    if (!parse_request(cxn_id, req, &request)) {
+        return;
+    }
+
+    if (request.table_id >= FT_MAX_TABLES) {
+        indigo_cxn_send_bsn_error(cxn_id, req, "Invalid table ID");
+        return;
+    }
+
+    table = &ind_core_ft->tables[request.table_id];
+    tree_depth = aim_log2_u32(table->checksum_buckets_size);
+
+    if (!select_nodes(cxn_id, req, &request, tree_depth, &level, &index, &count)) {
+        return;
+    }
+
+    reply = alloc_reply(req, tree_depth, level, index, &list);
+    if (reply == NULL) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        append_uint64(&list, ft_checksum_tree_node(table, level, index + i));
+    }
+
+    indigo_cxn_send_controller_message(cxn_id, reply);
+}
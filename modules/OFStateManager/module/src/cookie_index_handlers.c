@@ -0,0 +1,133 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Flow cookie index configuration and generic stats handler
+ *
+ * Flow queries whose cookie mask covers the configured bit range
+ * ("flow_cookie_index.bits" bits starting at "flow_cookie_index.shift")
+ * only visit one cookie bucket, and queries with a full cookie mask only
+ * visit the flows with that exact cookie. See ft_set_cookie_index.
+ *
+ * The "flow_cookie_index" generic stats request takes no TLVs. The reply
+ * has a single entry with a uint64_list TLV containing the bits, shift,
+ * number of buckets, number of non-empty buckets, size of the largest
+ * bucket, number of distinct cookies, and number of flows with the most
+ * common cookie. Operators use it to check that the bucket index spreads
+ * their flows out.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <loci/loci.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+#include "ft.h"
+
+static void handle_cookie_index_request(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req, void *priv);
+
+void
+ind_core_cookie_index_handlers_init(void)
+{
+    indigo_core_generic_stats_register("flow_cookie_index",
+                                       handle_cookie_index_request, NULL);
+}
+
+void
+ind_core_cookie_index_config_set(int bits, int shift)
+{
+    indigo_error_t rv = ft_set_cookie_index(ind_core_ft, bits, shift);
+
+    if (rv == INDIGO_ERROR_PENDING) {
+        AIM_LOG_VERBOSE("Deferring cookie index change until active flow queries finish");
+    } else if (rv < 0) {
+        AIM_LOG_ERROR("Failed to set cookie index to %d bits at shift %d: %s",
+                      bits, shift, indigo_strerror(rv));
+    }
+}
+
+static void
+handle_cookie_index_request(
+    indigo_cxn_id_t cxn_id,
+    of_bsn_generic_stats_request_t *req,
+    void *priv)
+{
+    ft_cookie_index_stats_t stats;
+    uint32_t xid;
+
+    of_bsn_generic_stats_request_xid_get(req, &xid);
+
+    of_object_t tlvs;
+    of_bsn_generic_stats_request_tlvs_bind(req, &tlvs);
+
+    of_object_t tlv;
+    if (of_list_bsn_tlv_first(&tlvs, &tlv) == 0) {
+        char err[128];
+        snprintf(err, sizeof(err), "Expected empty TLV list, found %s", of_class_name(&tlv));
+        indigo_cxn_send_bsn_error(cxn_id, req, err);
+        return;
+    }
+
+    ft_cookie_index_stats_get(ind_core_ft, &stats);
+
+    of_object_t *reply = of_bsn_generic_stats_reply_new(req->version);
+    if (reply == NULL) {
+        AIM_LOG_ERROR("Failed to allocate bsn_generic_stats_reply");
+        return;
+    }
+
+    of_bsn_generic_stats_reply_xid_set(reply, xid);
+
+    of_object_t entries;
+    of_bsn_generic_stats_reply_entries_bind(reply, &entries);
+
+    of_object_t entry;
+    of_bsn_generic_stats_entry_init(&entry, entries.version, -1, 1);
+    of_list_bsn_generic_stats_entry_append_bind(&entries, &entry);
+
+    of_bsn_generic_stats_entry_tlvs_bind(&entry, &tlvs);
+
+    of_bsn_tlv_uint64_list_init(&tlv, tlvs.version, -1, 1);
+    of_list_bsn_tlv_append_bind(&tlvs, &tlv);
+
+    of_list_uint64_t uint64s;
+    of_bsn_tlv_uint64_list_value_bind(&tlv, &uint64s);
+
+    uint64_t values[] = {
+        stats.bits,
+        stats.shift,
+        stats.buckets,
+        stats.nonempty_buckets,
+        stats.max_bucket_count,
+        stats.exact_cookies,
+        stats.max_exact_cookie_count,
+    };
+
+    int i;
+    for (i = 0; i < AIM_ARRAYSIZE(values); i++) {
+        of_uint64_t elem;
+        of_uint64_init(&elem, uint64s.version, -1, 1);
+        of_list_uint64_append_bind(&uint64s, &elem);
+        of_uint64_value_set(&elem, values[i]);
+    }
+
+    indigo_cxn_send_controller_message(cxn_id, reply);
+}
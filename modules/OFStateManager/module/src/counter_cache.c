@@ -0,0 +1,228 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Flow counter cache
+ *
+ * Every flow's most recently read counters are kept in its ft_entry. When
+ * the cache is enabled (max_age_ms > 0), flow and aggregate stats requests
+ * use the cached counters if they are younger than max_age_ms instead of
+ * reading them from Forwarding. Multiple clients polling the same flows
+ * then cost at most one driver read per flow per max_age_ms. Overwriting or
+ * modifying a flow drops its cached counters. Idle timeout checks always
+ * ask Forwarding.
+ *
+ * If refresh_rate is also set, a low priority timer walks the flowtable
+ * and refreshes at most refresh_rate flows per second, so stats requests
+ * usually find fresh counters. Each pass resumes where the previous timer
+ * tick stopped.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <SocketManager/socketmanager.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+#include "ft.h"
+#include "table.h"
+
+#define REFRESH_PERIOD_MS 100
+
+static int max_age_ms;
+static int refresh_rate; /* flows per second */
+static bool refresh_running;
+static bool refresh_iter_valid;
+static ft_iterator_t refresh_iter;
+
+static void refresh_timer(void *cookie);
+
+void
+ind_core_counter_cache_config_set(int new_max_age_ms, int new_refresh_rate)
+{
+    bool run = new_max_age_ms > 0 && new_refresh_rate > 0;
+
+    max_age_ms = new_max_age_ms;
+    refresh_rate = new_refresh_rate;
+
+    if (run && !refresh_running) {
+        if (ind_soc_timer_event_register_with_priority(
+                refresh_timer, NULL, REFRESH_PERIOD_MS,
+                IND_SOC_LOW_PRIORITY) < 0) {
+            AIM_LOG_ERROR("Failed to register flow counter cache timer");
+            return;
+        }
+        refresh_running = true;
+    } else if (!run && refresh_running) {
+        ind_soc_timer_event_unregister(refresh_timer, NULL);
+        refresh_running = false;
+    }
+}
+
+void
+ind_core_counter_cache_finish(void)
+{
+    ind_core_counter_cache_config_set(0, 0);
+
+    if (refresh_iter_valid) {
+        ft_iterator_cleanup(&refresh_iter);
+        refresh_iter_valid = false;
+    }
+}
+
+static bool
+counter_cache_get(ft_entry_t *entry, indigo_time_t now,
+                  indigo_fi_flow_stats_t *flow_stats)
+{
+    if (max_age_ms <= 0 || entry->cached_stats_time == 0 ||
+            INDIGO_TIME_DIFF_ms(entry->cached_stats_time, now) > max_age_ms) {
+        return false;
+    }
+
+    *flow_stats = entry->cached_stats;
+    return true;
+}
+
+static void
+counter_cache_update(ft_entry_t *entry, indigo_time_t now,
+                     const indigo_fi_flow_stats_t *flow_stats)
+{
+    if (max_age_ms > 0) {
+        entry->cached_stats = *flow_stats;
+        entry->cached_stats_time = now;
+    }
+}
+
+void
+ind_core_flow_stats_get_batch(indigo_cxn_id_t cxn_id, ft_entry_t **entries,
+                              int count, indigo_fi_flow_stats_t *flow_stats,
+                              indigo_error_t *rvs, bool use_cache)
+{
+    void *privs[FT_ITER_TASK_BATCH_SIZE];
+    indigo_fi_flow_stats_t group_stats[FT_ITER_TASK_BATCH_SIZE];
+    int group[FT_ITER_TASK_BATCH_SIZE];
+    bool done[FT_ITER_TASK_BATCH_SIZE];
+    indigo_time_t now = INDIGO_CURRENT_TIME;
+    int i, j, n;
+
+    AIM_ASSERT(count <= FT_ITER_TASK_BATCH_SIZE);
+
+    for (i = 0; i < count; i++) {
+        done[i] = use_cache && counter_cache_get(entries[i], now, &flow_stats[i]);
+        if (done[i]) {
+            rvs[i] = INDIGO_ERROR_NONE;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (done[i]) {
+            continue;
+        }
+
+        ind_core_table_t *table = ind_core_table_get(entries[i]->table_id);
+        AIM_ASSERT(table != NULL);
+
+        /* Collect the remaining flows in this table */
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (!done[j] && entries[j]->table_id == entries[i]->table_id) {
+                done[j] = true;
+                group[n] = j;
+                privs[n] = entries[j]->priv;
+                group_stats[n] = (indigo_fi_flow_stats_t) {
+                    .packets = -1,
+                    .bytes = -1,
+                };
+                n++;
+            }
+        }
+
+        if (table->ops->entry_stats_get_bulk != NULL &&
+                table->ops->entry_stats_get_bulk(table->priv, cxn_id, privs,
+                                                 n, group_stats) == INDIGO_ERROR_NONE) {
+            for (j = 0; j < n; j++) {
+                flow_stats[group[j]] = group_stats[j];
+                rvs[group[j]] = INDIGO_ERROR_NONE;
+                counter_cache_update(entries[group[j]], now, &group_stats[j]);
+            }
+            continue;
+        }
+
+        for (j = 0; j < n; j++) {
+            flow_stats[group[j]] = (indigo_fi_flow_stats_t) {
+                .packets = -1,
+                .bytes = -1,
+            };
+            rvs[group[j]] = table->ops->entry_stats_get(
+                table->priv, cxn_id, privs[j], &flow_stats[group[j]]);
+            if (rvs[group[j]] == INDIGO_ERROR_NONE) {
+                counter_cache_update(entries[group[j]], now, &flow_stats[group[j]]);
+            }
+        }
+    }
+}
+
+/*
+ * Refresh up to refresh_rate * REFRESH_PERIOD_MS / 1000 flows
+ */
+static void
+refresh_timer(void *cookie)
+{
+    ft_entry_t *entries[FT_ITER_TASK_BATCH_SIZE];
+    indigo_fi_flow_stats_t flow_stats[FT_ITER_TASK_BATCH_SIZE];
+    indigo_error_t rvs[FT_ITER_TASK_BATCH_SIZE];
+    int budget = refresh_rate * REFRESH_PERIOD_MS / 1000;
+
+    if (budget < 1) {
+        budget = 1;
+    }
+
+    while (budget > 0 && !ind_soc_should_yield()) {
+        bool finished = false;
+        int count = 0;
+
+        if (!refresh_iter_valid) {
+            ft_iterator_init(&refresh_iter, ind_core_ft, NULL);
+            refresh_iter_valid = true;
+        }
+
+        while (count < FT_ITER_TASK_BATCH_SIZE && count < budget) {
+            ft_entry_t *entry = ft_iterator_next(&refresh_iter);
+            if (entry == NULL) {
+                finished = true;
+                break;
+            }
+            entries[count++] = entry;
+        }
+
+        if (count > 0) {
+            ind_core_flow_stats_get_batch(INDIGO_CXN_ID_UNSPECIFIED, entries,
+                                          count, flow_stats, rvs, false);
+            budget -= count;
+        }
+
+        if (finished) {
+            /* Start the next pass on the next tick */
+            ft_iterator_cleanup(&refresh_iter);
+            refresh_iter_valid = false;
+            break;
+        }
+    }
+}
@@ -20,20 +20,36 @@
 /**
  * @file
  * @brief Flow expiration
+ *
+ * The expiration queue is sorted by expiration time. Each timer tick drains
+ * every due flow, continuing in a low priority task across as many slices
+ * as needed instead of stopping at a fixed number of flows. Hard timeouts
+ * are collected into batches so tables with an entry_delete_bulk op delete
+ * them with one Forwarding call. Idle timeouts still check the hit status
+ * of each flow.
+ *
+ * The delay between each flow's scheduled expiration time and when it is
+ * actually removed is recorded in the "ofstatemanager.expiration_lag"
+ * histogram, in milliseconds. Idle flows that were hit or only notified
+ * are not recorded.
  */
 
 #include <OFStateManager/ofstatemanager_config.h>
 #include <indigo/indigo.h>
 #include <SocketManager/socketmanager.h>
+#include <histogram/histogram.h>
 
 #include "ofstatemanager_log.h"
 #include "ofstatemanager_decs.h"
-#include "ft_entry.h"
+#include "ofstatemanager_int.h"
+#include "ft.h"
 #include "table.h"
 
 static void send_idle_notification(ft_entry_t *entry);
 
 static LIST_DEFINE(expiration_queue);
+static bool expiration_task_running;
+static struct histogram *lag_histogram;
 
 static indigo_time_t
 calc_expiration_time(ft_entry_t *entry, int *reason)
@@ -92,7 +108,7 @@ ind_core_expiration_remove(ft_entry_t *entry)
  * For idle timeouts, will check with the hardware to see if the flow has been
  * hit since the last time it was checked.
  *
- * Returns true if the flow actually expired.
+ * Returns true if the flow was removed.
  */
 static bool
 expire_flow(ft_entry_t *entry, int reason)
@@ -107,7 +123,10 @@ expire_flow(ft_entry_t *entry, int reason)
         int rv;
         bool hit;
 
-        /* Get hit status for idle timeouts */
+        /*
+         * Get hit status for idle timeouts. The counter cache is not used:
+         * a flow could be removed on cached counters that missed a hit.
+         */
         ind_core_table_t *table = ind_core_table_get(entry->table_id);
         AIM_ASSERT(table != NULL);
 
@@ -118,6 +137,10 @@ expire_flow(ft_entry_t *entry, int reason)
             AIM_LOG_INTERNAL("Failed to get hit status for flow "
                              INDIGO_FLOW_ID_PRINTF_FORMAT": %s",
                              entry->id, indigo_strerror(rv));
+            /* Retry after another idle period rather than spinning */
+            entry->last_counter_change = INDIGO_CURRENT_TIME;
+            ind_core_expiration_remove(entry);
+            ind_core_expiration_add(entry);
             return false;
         }
 
@@ -136,39 +159,146 @@ expire_flow(ft_entry_t *entry, int reason)
                               entry->idle_timeout,
                               INDIGO_FLOW_ID_PRINTF_ARG(entry->id));
                 ind_core_flow_entry_delete(entry, reason, INDIGO_CXN_ID_UNSPECIFIED);
+                return true;
             }
-
-            return true;
-        } else {
-            return false;
         }
+
+        return false;
     } else {
         AIM_TRUE_OR_DIE(0);
     }
 }
 
+/*
+ * Process due flows until none are left or the current slice is used up
+ *
+ * Returns true if there is nothing more to do before the next timer tick:
+ * either no flows are due, or the flow notification queue is full and
+ * expiration is paused until it drains.
+ */
+bool
+ind_core_expiration_run(indigo_time_t now)
+{
+    ft_entry_t *batch[FT_ITER_TASK_BATCH_SIZE];
+
+    while (true) {
+        list_links_t *cur, *next;
+        int count = 0;
+        int work = 0;
+        bool done = false;
+        bool yield = false;
+
+        /*
+         * Collect a batch of due hard timeouts. Idle timeouts are handled
+         * immediately; they are either deleted or requeued at a later time,
+         * behind the cursor. Each flow looked at counts toward the batch.
+         */
+        for (cur = expiration_queue.links.next;
+             cur != &expiration_queue.links && work < FT_ITER_TASK_BATCH_SIZE;
+             cur = next) {
+            ft_entry_t *entry = FT_ENTRY_CONTAINER(cur, expiration);
+            int reason;
+            indigo_time_t expiration_time = calc_expiration_time(entry, &reason);
+
+            next = cur->next;
+
+            if (ind_soc_should_yield()) {
+                yield = true;
+                break;
+            }
+
+            if (ind_core_flow_notification_full()) {
+                /* Let the controllers catch up, resume on the next tick */
+                done = true;
+                break;
+            }
+
+            work++;
+
+            if (ft_entry_dead(ind_core_ft, entry)) {
+                /* Already gone from Forwarding, see ind_core_table_clear */
+                ft_delete(ind_core_ft, entry);
+                continue;
+            }
+
+            if (expiration_time > now) {
+                done = true;
+                break;
+            }
+
+            if (reason == INDIGO_FLOW_REMOVED_HARD_TIMEOUT) {
+                AIM_LOG_TRACE("Hard TO (%d): " INDIGO_FLOW_ID_PRINTF_FORMAT,
+                              entry->hard_timeout,
+                              INDIGO_FLOW_ID_PRINTF_ARG(entry->id));
+                histogram_inc(lag_histogram, now - expiration_time);
+                batch[count++] = entry;
+            } else if (expire_flow(entry, reason)) {
+                histogram_inc(lag_histogram, now - expiration_time);
+            }
+        }
+
+        if (count > 0) {
+            ind_core_flow_entry_delete_batch(batch, count,
+                                             INDIGO_FLOW_REMOVED_HARD_TIMEOUT,
+                                             INDIGO_CXN_ID_UNSPECIFIED);
+        }
+
+        if (yield) {
+            return false;
+        }
+
+        if (done || cur == &expiration_queue.links) {
+            return true;
+        }
+    }
+}
+
+static ind_soc_task_status_t
+expiration_task(void *cookie)
+{
+    if (ind_core_expiration_run(INDIGO_CURRENT_TIME)) {
+        expiration_task_running = false;
+        return IND_SOC_TASK_FINISHED;
+    }
+
+    return IND_SOC_TASK_CONTINUE;
+}
+
 void
 ind_core_expiration_timer(void *cookie)
 {
-    indigo_time_t now = INDIGO_CURRENT_TIME;
-    int expired_flows = 0; /* Limit the number of messages sent to the controller each tick */
-
-    while (expired_flows < 32 &&
-            !ind_soc_should_yield() &&
-            !list_empty(&expiration_queue)) {
-        int reason;
-        list_links_t *links = expiration_queue.links.next;
-        ft_entry_t *entry = FT_ENTRY_CONTAINER(links, expiration);
-        if (calc_expiration_time(entry, &reason) <= now) {
-            if (expire_flow(entry, reason)) {
-                expired_flows++;
-            }
+    if (expiration_task_running) {
+        /* Still draining the previous tick's flows */
+        return;
+    }
+
+    if (!ind_core_expiration_run(INDIGO_CURRENT_TIME)) {
+        if (ind_soc_task_register(expiration_task, NULL, IND_SOC_LOW_PRIORITY) < 0) {
+            AIM_LOG_INTERNAL("Failed to spawn expiration task");
         } else {
-            break;
+            expiration_task_running = true;
         }
     }
 }
 
+void
+ind_core_expiration_init(void)
+{
+    lag_histogram = histogram_create("ofstatemanager.expiration_lag");
+}
+
+void
+ind_core_expiration_finish(void)
+{
+    if (expiration_task_running) {
+        (void) ind_soc_task_unregister(expiration_task, NULL);
+        expiration_task_running = false;
+    }
+
+    histogram_destroy(lag_histogram);
+    lag_histogram = NULL;
+}
+
 /**
  * @brief Send a idle notification for the given entry
  * @param entry The local flow table entry
@@ -193,14 +323,16 @@ send_idle_notification(ft_entry_t *entry)
     of_bsn_flow_idle_priority_set(msg, entry->priority);
     of_bsn_flow_idle_table_id_set(msg, entry->table_id);
 
-    of_match_t match;
-    minimatch_expand(&entry->minimatch, &match);
+    if (ind_core_match_wire_set(msg, BSN_FLOW_IDLE_MATCH_OFFSET, &entry->minimatch) < 0) {
+        of_match_t match;
+        minimatch_expand(&entry->minimatch, &match);
 
-    if (of_bsn_flow_idle_match_set(msg, &match)) {
-        AIM_LOG_INTERNAL("Failed to set match in idle notification");
-        of_object_delete(msg);
-        return;
+        if (of_bsn_flow_idle_match_set(msg, &match)) {
+            AIM_LOG_INTERNAL("Failed to set match in idle notification");
+            of_object_delete(msg);
+            return;
+        }
     }
 
-    indigo_cxn_send_async_message(msg);
+    ind_core_flow_notification_send(msg, INDIGO_CXN_ID_UNSPECIFIED);
 }
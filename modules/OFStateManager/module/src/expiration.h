@@ -47,8 +47,19 @@ void ind_core_expiration_remove(ft_entry_t *entry);
 /**
  * Expire flows that have exceeded their timeout
  *
- * Should be called periodically.
+ * Should be called periodically. Spawns a task to finish the job if there
+ * are too many due flows for one slice.
  */
 void ind_core_expiration_timer(void *cookie);
 
+/**
+ * Expire flows due at 'now' until the current slice is used up
+ *
+ * Returns true if no due flows are left.
+ */
+bool ind_core_expiration_run(indigo_time_t now);
+
+void ind_core_expiration_init(void);
+void ind_core_expiration_finish(void);
+
 #endif /* _OFSTATEMANAGER_EXPIRATION_H_ */
@@ -0,0 +1,257 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Coalesced flow-removed and idle notifications
+ *
+ * A wildcard flow delete or a mass expiry can generate a notification for
+ * every flow in the table. Instead of handing each one to the connection
+ * manager as it is generated, they are queued and flushed from an
+ * immediate timer once the current task slice ends. The connection
+ * manager then sees them back to back and writes them out together.
+ *
+ * If "flow_notification.rate" is set, the flush is shaped by a token
+ * bucket allowing that many notifications per second with a burst of one
+ * second's worth, so that mass expiries drain at a pace the controllers
+ * can absorb rather than filling their write buffers.
+ *
+ * Only notifications not tied to a connection are shaped. A flow-removed
+ * caused by a controller's own delete is sent right away, so the barrier
+ * reply after that delete is never held behind the shaper.
+ *
+ * Notifications are never dropped. The queue holds at most
+ * "flow_notification.max_queue" messages; pushing onto a full queue sends
+ * the oldest one unshaped. Expiration checks ind_core_flow_notification_full
+ * and stops its scan until the queue drains, so in steady state the bound
+ * is enforced by pausing the producer.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <indigo/of_connection_manager.h>
+#include <SocketManager/socketmanager.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+
+#define FLOW_NOTIFICATION_INITIAL_QUEUE 256
+
+static int rate; /* notifications per second, 0 for unlimited */
+static int max_queue = FLOW_NOTIFICATION_DEFAULT_MAX_QUEUE;
+static int tokens;
+static indigo_time_t last_refill;
+static bool timer_registered;
+
+/* Ring of pending messages */
+static of_object_t **queue;
+static int queue_size;
+static int queue_head;
+static int queue_count;
+
+static of_object_t *queue_shift(void);
+static void flush_timer(void *cookie);
+
+void
+ind_core_flow_notification_config_set(int new_rate, int new_max_queue)
+{
+    if (new_rate != rate) {
+        /* Start with a full bucket */
+        tokens = new_rate;
+        last_refill = INDIGO_CURRENT_TIME;
+    }
+
+    rate = new_rate;
+    max_queue = new_max_queue > 0 ? new_max_queue : FLOW_NOTIFICATION_DEFAULT_MAX_QUEUE;
+
+    /* Bring the queue back under a lowered limit */
+    while (queue_count > max_queue) {
+        indigo_cxn_send_async_message(queue_shift());
+    }
+
+    if (queue_count > 0) {
+        /* Don't wait out a delay computed for the old rate */
+        if (ind_soc_timer_event_register(flush_timer, NULL,
+                                         IND_SOC_TIMER_IMMEDIATE) == 0) {
+            timer_registered = true;
+        }
+    }
+}
+
+static void
+queue_push(of_object_t *msg)
+{
+    if (queue_count == queue_size) {
+        int new_size = queue_size ? queue_size * 2 : FLOW_NOTIFICATION_INITIAL_QUEUE;
+        of_object_t **new_queue = aim_malloc(new_size * sizeof(*new_queue));
+        int i;
+
+        for (i = 0; i < queue_count; i++) {
+            new_queue[i] = queue[(queue_head + i) % queue_size];
+        }
+
+        aim_free(queue);
+        queue = new_queue;
+        queue_size = new_size;
+        queue_head = 0;
+    }
+
+    queue[(queue_head + queue_count) % queue_size] = msg;
+    queue_count++;
+}
+
+static of_object_t *
+queue_shift(void)
+{
+    of_object_t *msg;
+
+    if (queue_count == 0) {
+        return NULL;
+    }
+
+    msg = queue[queue_head];
+    queue_head = (queue_head + 1) % queue_size;
+    queue_count--;
+    return msg;
+}
+
+void
+ind_core_flow_notification_send(of_object_t *msg, indigo_cxn_id_t cxn_id)
+{
+    if (cxn_id != INDIGO_CXN_ID_UNSPECIFIED) {
+        /* Caused by a controller request, don't delay its barriers */
+        indigo_cxn_send_async_message(msg);
+        return;
+    }
+
+    if (queue_count >= max_queue) {
+        /* Make room by sending the oldest message ahead of the shaper */
+        AIM_LOG_TRACE("Flow notification queue full, sending unshaped");
+        indigo_cxn_send_async_message(queue_shift());
+    }
+
+    queue_push(msg);
+
+    if (!timer_registered) {
+        if (ind_soc_timer_event_register(flush_timer, NULL,
+                                         IND_SOC_TIMER_IMMEDIATE) < 0) {
+            /* Fall back to sending everything now */
+            AIM_LOG_ERROR("Failed to register flow notification timer");
+            while ((msg = queue_shift()) != NULL) {
+                indigo_cxn_send_async_message(msg);
+            }
+            return;
+        }
+        timer_registered = true;
+    }
+}
+
+static void
+refill_tokens(indigo_time_t now)
+{
+    int elapsed_ms = INDIGO_TIME_DIFF_ms(last_refill, now);
+    int added = (int64_t)elapsed_ms * rate / 1000;
+
+    if (added > 0) {
+        tokens += added;
+        last_refill += (int64_t)added * 1000 / rate;
+    }
+
+    if (tokens >= rate) {
+        /* Burst of at most one second */
+        tokens = rate;
+        last_refill = now;
+    }
+}
+
+static void
+flush_timer(void *cookie)
+{
+    of_object_t *msg;
+    int delay_ms = IND_SOC_TIMER_IMMEDIATE;
+
+    if (rate > 0) {
+        refill_tokens(INDIGO_CURRENT_TIME);
+    }
+
+    while (queue_count > 0) {
+        if (rate > 0 && tokens <= 0) {
+            /* Wait for the next token */
+            delay_ms = (1000 + rate - 1) / rate;
+            break;
+        }
+
+        if (ind_soc_should_yield()) {
+            break;
+        }
+
+        msg = queue_shift();
+        indigo_cxn_send_async_message(msg);
+        if (rate > 0) {
+            tokens--;
+        }
+    }
+
+    if (queue_count > 0) {
+        /* Re-registering also replaces an earlier delayed timer */
+        if (ind_soc_timer_event_register(flush_timer, NULL, delay_ms) < 0) {
+            AIM_LOG_ERROR("Failed to register flow notification timer");
+            timer_registered = false;
+        }
+    } else {
+        /* No-op if this was an immediate timer */
+        (void) ind_soc_timer_event_unregister(flush_timer, NULL);
+        timer_registered = false;
+    }
+}
+
+int
+ind_core_flow_notification_pending(void)
+{
+    return queue_count;
+}
+
+bool
+ind_core_flow_notification_full(void)
+{
+    return queue_count >= max_queue;
+}
+
+void
+ind_core_flow_notification_finish(void)
+{
+    of_object_t *msg;
+
+    if (timer_registered) {
+        (void) ind_soc_timer_event_unregister(flush_timer, NULL);
+        timer_registered = false;
+    }
+
+    while ((msg = queue_shift()) != NULL) {
+        of_object_delete(msg);
+    }
+
+    aim_free(queue);
+    queue = NULL;
+    queue_size = 0;
+    queue_head = 0;
+
+    rate = 0;
+    max_queue = FLOW_NOTIFICATION_DEFAULT_MAX_QUEUE;
+}
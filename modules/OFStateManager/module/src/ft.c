@@ -30,13 +30,18 @@
 #include "ft.h"
 #include "expiration.h"
 
-static indigo_error_t ft_entry_create(indigo_flow_id_t id, of_flow_add_t *flow_add, minimatch_t *minimatch, ft_entry_t **entry_p);
+static indigo_error_t ft_entry_create(ft_instance_t ft, indigo_flow_id_t id, of_flow_add_t *flow_add, minimatch_t *minimatch, ft_entry_t **entry_p);
 static void ft_entry_destroy(ft_instance_t ft, ft_entry_t *entry);
-static indigo_error_t ft_entry_set_effects(ft_entry_t *entry, of_flow_modify_t *flow_mod);
+static indigo_error_t ft_entry_set_effects(ft_instance_t ft, ft_entry_t *entry, of_flow_modify_t *flow_mod);
+static void ft_effects_release(ft_instance_t ft, ft_effects_t *effects);
+static void ft_entry_stats_template_clear(ft_entry_t *entry);
 static void ft_entry_link(ft_instance_t ft, ft_entry_t *entry);
 static void ft_entry_unlink(ft_instance_t ft, ft_entry_t *entry);
 static void ft_checksum_add(ft_instance_t ft, ft_entry_t *entry);
 static void ft_checksum_subtract(ft_instance_t ft, ft_entry_t *entry);
+static void ft_checksum_buckets_alloc(ft_table_t *table, uint32_t buckets_size);
+static void ft_checksum_buckets_free(ft_table_t *table);
+static void ft_cookie_buckets_alloc(ft_instance_t ft, int bits, int shift);
 
 #define FT_HASH_SEED 0
 #define FT_MAX_CHECKSUM_BUCKETS 65536
@@ -52,17 +57,44 @@ ft_strict_match_hash(ft_instance_t ft,
     return h;
 }
 
+static uint64_t
+ft_cookie_index_mask(ft_instance_t ft)
+{
+    return ((((uint64_t)1) << ft->cookie_index_bits) - 1) << ft->cookie_index_shift;
+}
+
 static int
 ft_cookie_to_bucket_index(ft_instance_t ft, uint64_t cookie)
 {
-    return cookie >> (64-FT_COOKIE_PREFIX_LEN);
+    return (cookie & ft_cookie_index_mask(ft)) >> ft->cookie_index_shift;
+}
+
+static uint32_t
+ft_exact_cookie_hash(uint64_t cookie)
+{
+    return murmur_hash(&cookie, sizeof(cookie), FT_HASH_SEED);
+}
+
+static ft_cookie_group_t *
+ft_cookie_group_lookup(ft_instance_t ft, uint64_t cookie)
+{
+    bighash_entry_t *hash_entry;
+
+    for (hash_entry = bighash_first(ft->exact_cookie_hashtable, ft_exact_cookie_hash(cookie));
+         hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
+        ft_cookie_group_t *group = container_of(hash_entry, hash_entry, ft_cookie_group_t);
+        if (group->cookie == cookie) {
+            return group;
+        }
+    }
+
+    return NULL;
 }
 
 ft_instance_t
 ft_create(void)
 {
     ft_instance_t ft;
-    int bytes;
     int idx;
 
     /* Allocate the flow table itself */
@@ -72,18 +104,16 @@ ft_create(void)
 
     /* Allocate and init buckets for each search type */
     ft->strict_match_hashtable = bighash_table_create(BIGHASH_AUTOGROW);
+    ft->effects_hashtable = bighash_table_create(BIGHASH_AUTOGROW);
+    ft->exact_cookie_hashtable = bighash_table_create(BIGHASH_AUTOGROW);
 
-    bytes = sizeof(ft->cookie_buckets[0]) * (1 << FT_COOKIE_PREFIX_LEN);
-    ft->cookie_buckets = aim_zmalloc(bytes);
-    for (idx = 0; idx < (1 << FT_COOKIE_PREFIX_LEN); idx++) {
-        list_init(&ft->cookie_buckets[idx].head);
-    }
+    ft_cookie_buckets_alloc(ft, FT_COOKIE_INDEX_DEFAULT_BITS,
+                            FT_COOKIE_INDEX_DEFAULT_SHIFT);
+    ft->cookie_index_pending_bits = -1;
 
     for (idx = 0; idx < FT_MAX_TABLES; idx++) {
-        ft_table_t *table = &ft->tables[idx];
-        table->checksum_buckets_size = 128;
-        table->checksum_shift = 64 - aim_log2_u32(table->checksum_buckets_size);
-        table->checksum_buckets = aim_zmalloc(table->checksum_buckets_size * sizeof(uint64_t));
+        ft_checksum_buckets_alloc(&ft->tables[idx], 128);
+        list_init(&ft->tables[idx].flows);
     }
 
     return ft;
@@ -109,13 +139,21 @@ ft_destroy(ft_instance_t ft)
         bighash_table_destroy(ft->strict_match_hashtable, NULL);
         ft->strict_match_hashtable = NULL;
     }
+    if (ft->effects_hashtable != NULL) {
+        bighash_table_destroy(ft->effects_hashtable, NULL);
+        ft->effects_hashtable = NULL;
+    }
+    if (ft->exact_cookie_hashtable != NULL) {
+        bighash_table_destroy(ft->exact_cookie_hashtable, NULL);
+        ft->exact_cookie_hashtable = NULL;
+    }
     if (ft->cookie_buckets != NULL) {
         aim_free(ft->cookie_buckets);
         ft->cookie_buckets = NULL;
     }
 
     for (i = 0; i < FT_MAX_TABLES; i++) {
-        aim_free(ft->tables[i].checksum_buckets);
+        ft_checksum_buckets_free(&ft->tables[i]);
     }
 
     aim_free(ft);
@@ -131,7 +169,7 @@ ft_add(ft_instance_t ft, indigo_flow_id_t id,
 
     AIM_LOG_TRACE("Adding flow " INDIGO_FLOW_ID_PRINTF_FORMAT, id);
 
-    if ((rv = ft_entry_create(id, flow_add, minimatch, &entry)) < 0) {
+    if ((rv = ft_entry_create(ft, id, flow_add, minimatch, &entry)) < 0) {
         return rv;
     }
 
@@ -177,8 +215,10 @@ ft_overwrite(ft_instance_t ft, ft_entry_t *entry, of_flow_add_t *flow_add)
     of_flow_add_idle_timeout_get(flow_add, &entry->idle_timeout);
     of_flow_add_hard_timeout_get(flow_add, &entry->hard_timeout);
 
-    indigo_error_t err = ft_entry_set_effects(entry, flow_add);
+    indigo_error_t err = ft_entry_set_effects(ft, entry, flow_add);
     AIM_ASSERT(err == INDIGO_ERROR_NONE);
+    ft_entry_stats_template_clear(entry);
+    entry->cached_stats_time = 0;
 
     entry->insert_time = INDIGO_CURRENT_TIME;
     entry->last_counter_change = entry->insert_time;
@@ -187,6 +227,51 @@ ft_overwrite(ft_instance_t ft, ft_entry_t *entry, of_flow_add_t *flow_add)
     ft_checksum_add(ft, entry);
 }
 
+bool
+ft_overwrite_is_noop(ft_entry_t *entry, of_flow_add_t *flow_add)
+{
+    uint64_t cookie;
+    uint16_t flags;
+    of_list_instruction_t instructions;
+
+    if (flow_add->version == OF_VERSION_1_0 ||
+            entry->effects.instructions->version != flow_add->version) {
+        return false;
+    }
+
+    of_flow_add_cookie_get(flow_add, &cookie);
+    of_flow_add_flags_get(flow_add, &flags);
+    if (cookie != entry->cookie || (uint8_t)flags != entry->flags) {
+        return false;
+    }
+
+    of_flow_add_instructions_bind(flow_add, &instructions);
+
+    return instructions.length == entry->effects.instructions->length &&
+        !memcmp(OF_OBJECT_BUFFER_INDEX(&instructions, 0),
+                OF_OBJECT_BUFFER_INDEX(entry->effects.instructions, 0),
+                instructions.length);
+}
+
+void
+ft_overwrite_timeouts(ft_instance_t ft, ft_entry_t *entry, of_flow_add_t *flow_add)
+{
+    if (entry->idle_timeout || entry->hard_timeout) {
+        ind_core_expiration_remove(entry);
+    }
+
+    of_flow_add_idle_timeout_get(flow_add, &entry->idle_timeout);
+    of_flow_add_hard_timeout_get(flow_add, &entry->hard_timeout);
+    ft_entry_stats_template_clear(entry);
+
+    entry->insert_time = INDIGO_CURRENT_TIME;
+    entry->last_counter_change = entry->insert_time;
+
+    if (entry->idle_timeout || entry->hard_timeout) {
+        ind_core_expiration_add(entry);
+    }
+}
+
 indigo_error_t
 ft_strict_match(ft_instance_t instance,
                of_meta_match_t *query,
@@ -202,7 +287,7 @@ ft_strict_match(ft_instance_t instance,
     for (hash_entry = bighash_first(instance->strict_match_hashtable, hash);
          hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
         ft_entry_t *entry = container_of(hash_entry, strict_match_hash_entry, ft_entry_t);
-        if (ft_entry_meta_match(query, entry)) {
+        if (ft_entry_meta_match(query, entry) && !ft_entry_dead(instance, entry)) {
             *entry_ptr = entry;
             return INDIGO_ERROR_NONE;
         }
@@ -232,11 +317,9 @@ ft_set_checksum_buckets_size(ft_instance_t ft, uint8_t table_id, uint32_t bucket
         return INDIGO_ERROR_NONE;
     }
 
-    aim_free(table->checksum_buckets);
+    ft_checksum_buckets_free(table);
     table->checksum = 0;
-    table->checksum_buckets_size = buckets_size;
-    table->checksum_shift = 64 - aim_log2_u32(buckets_size);
-    table->checksum_buckets = aim_zmalloc(sizeof(uint64_t) * buckets_size);
+    ft_checksum_buckets_alloc(table, buckets_size);
 
     list_links_t *cur;
     LIST_FOREACH(&ft->all_list, cur) {
@@ -249,6 +332,97 @@ ft_set_checksum_buckets_size(ft_instance_t ft, uint8_t table_id, uint32_t bucket
     return INDIGO_ERROR_NONE;
 }
 
+static void
+ft_cookie_buckets_alloc(ft_instance_t ft, int bits, int shift)
+{
+    int idx;
+
+    ft->cookie_index_bits = bits;
+    ft->cookie_index_shift = shift;
+
+    if (bits == 0) {
+        ft->cookie_buckets = NULL;
+        return;
+    }
+
+    ft->cookie_buckets = aim_zmalloc(sizeof(ft->cookie_buckets[0]) << bits);
+    for (idx = 0; idx < (1 << bits); idx++) {
+        list_init(&ft->cookie_buckets[idx].head);
+    }
+}
+
+indigo_error_t
+ft_set_cookie_index(ft_instance_t ft, int bits, int shift)
+{
+    if (bits < 0 || bits > FT_COOKIE_INDEX_MAX_BITS ||
+            shift < 0 || bits + shift > 64) {
+        return INDIGO_ERROR_PARAM;
+    }
+
+    if (ft->cookie_index_iterators > 0) {
+        ft->cookie_index_pending_bits = bits;
+        ft->cookie_index_pending_shift = shift;
+        return INDIGO_ERROR_PENDING;
+    }
+
+    ft->cookie_index_pending_bits = -1;
+
+    if (bits == ft->cookie_index_bits &&
+            (bits == 0 || shift == ft->cookie_index_shift)) {
+        return INDIGO_ERROR_NONE;
+    }
+
+    aim_free(ft->cookie_buckets);
+    ft_cookie_buckets_alloc(ft, bits, shift);
+
+    if (ft->cookie_buckets != NULL) {
+        list_links_t *cur;
+        LIST_FOREACH(&ft->all_list, cur) {
+            ft_entry_t *entry = FT_ENTRY_CONTAINER(cur, table);
+            ft_cookie_bucket_t *bucket =
+                &ft->cookie_buckets[ft_cookie_to_bucket_index(ft, entry->cookie)];
+            list_push(&bucket->head, &entry->cookie_links);
+            bucket->count++;
+        }
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+void
+ft_cookie_index_stats_get(ft_instance_t ft, ft_cookie_index_stats_t *stats)
+{
+    bighash_iter_t iter;
+    bighash_entry_t *hash_entry;
+    uint32_t idx;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->bits = ft->cookie_index_bits;
+    stats->shift = ft->cookie_index_shift;
+
+    if (ft->cookie_buckets != NULL) {
+        stats->buckets = 1 << ft->cookie_index_bits;
+        for (idx = 0; idx < stats->buckets; idx++) {
+            uint32_t count = ft->cookie_buckets[idx].count;
+            if (count > 0) {
+                stats->nonempty_buckets++;
+            }
+            if (count > stats->max_bucket_count) {
+                stats->max_bucket_count = count;
+            }
+        }
+    }
+
+    for (hash_entry = bighash_iter_start(ft->exact_cookie_hashtable, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        ft_cookie_group_t *group = container_of(hash_entry, hash_entry, ft_cookie_group_t);
+        stats->exact_cookies++;
+        if (group->bucket.count > stats->max_exact_cookie_count) {
+            stats->max_exact_cookie_count = group->bucket.count;
+        }
+    }
+}
+
 int
 ft_entry_meta_match(of_meta_match_t *query, ft_entry_t *entry)
 {
@@ -306,8 +480,10 @@ ft_entry_modify_effects(ft_instance_t instance,
     AIM_LOG_TRACE("Modifying effects of entry " INDIGO_FLOW_ID_PRINTF_FORMAT,
                   entry->id);
 
-    err = ft_entry_set_effects(entry, flow_mod);
+    err = ft_entry_set_effects(instance, entry, flow_mod);
     if (err == INDIGO_ERROR_NONE) {
+        ft_entry_stats_template_clear(entry);
+        entry->cached_stats_time = 0;
         debug_counter_inc(&ft_modify_counter);
     }
 
@@ -327,6 +503,7 @@ ft_entry_modify_effects(ft_instance_t instance,
 
 struct ft_iter_task_state {
     ft_iter_task_callback_f callback;
+    ft_iter_task_batch_callback_f batch_callback;
     void *cookie;
     ft_iterator_t iter;
 };
@@ -342,7 +519,7 @@ ft_iter_task_callback(void *cookie)
          * so process many entries between checking if we should yield.
          */
         int i;
-        for (i = 0; i < 32; i++) {
+        for (i = 0; i < FT_ITER_TASK_BATCH_SIZE; i++) {
             ft_entry_t *entry = ft_iterator_next(&state->iter);
             if (entry == NULL) {
                 /* Finished */
@@ -359,6 +536,62 @@ ft_iter_task_callback(void *cookie)
     return IND_SOC_TASK_CONTINUE;
 }
 
+static ind_soc_task_status_t
+ft_batch_iter_task_callback(void *cookie)
+{
+    struct ft_iter_task_state *state = cookie;
+    ft_entry_t *entries[FT_ITER_TASK_BATCH_SIZE];
+
+    do {
+        ft_entry_t *entry = NULL;
+        int count = 0;
+
+        /*
+         * The iterator only pins the entry it will return next, but nothing
+         * else runs between collecting the batch and the callback
+         */
+        while (count < FT_ITER_TASK_BATCH_SIZE &&
+                (entry = ft_iterator_next(&state->iter)) != NULL) {
+            entries[count++] = entry;
+        }
+
+        if (count > 0) {
+            state->batch_callback(state->cookie, entries, count);
+        }
+
+        if (entry == NULL) {
+            /* Finished */
+            state->batch_callback(state->cookie, NULL, 0);
+            ft_iterator_cleanup(&state->iter);
+            aim_free(state);
+            return IND_SOC_TASK_FINISHED;
+        }
+    } while (!ind_soc_should_yield());
+
+    return IND_SOC_TASK_CONTINUE;
+}
+
+static indigo_error_t
+ft_spawn_iter_task_common(ft_instance_t instance,
+                          of_meta_match_t *query,
+                          struct ft_iter_task_state *state,
+                          ind_soc_task_callback_f task_callback,
+                          int priority)
+{
+    indigo_error_t rv;
+
+    ft_iterator_init(&state->iter, instance, query);
+
+    rv = ind_soc_task_register(task_callback, state, priority);
+    if (rv != INDIGO_ERROR_NONE) {
+        ft_iterator_cleanup(&state->iter);
+        aim_free(state);
+        return rv;
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
 indigo_error_t
 ft_spawn_iter_task(ft_instance_t instance,
                    of_meta_match_t *query,
@@ -366,14 +599,30 @@ ft_spawn_iter_task(ft_instance_t instance,
                    void *cookie,
                    int priority)
 {
-    indigo_error_t rv;
+    struct ft_iter_task_state *state = aim_zmalloc(sizeof(*state));
 
-    struct ft_iter_task_state *state = aim_malloc(sizeof(*state));
+    state->callback = callback;
+    state->cookie = cookie;
+
+    return ft_spawn_iter_task_common(instance, query, state,
+                                     ft_iter_task_callback, priority);
+}
+
+indigo_error_t
+ft_spawn_dead_iter_task(ft_instance_t instance,
+                        uint8_t table_id,
+                        ft_iter_task_callback_f callback,
+                        void *cookie,
+                        int priority)
+{
+    struct ft_iter_task_state *state = aim_zmalloc(sizeof(*state));
+    indigo_error_t rv;
 
     state->callback = callback;
     state->cookie = cookie;
 
-    ft_iterator_init(&state->iter, instance, query);
+    ft_iterator_init(&state->iter, instance, NULL);
+    state->iter.dead_table_id = table_id;
 
     rv = ind_soc_task_register(ft_iter_task_callback, state, priority);
     if (rv != INDIGO_ERROR_NONE) {
@@ -385,6 +634,22 @@ ft_spawn_iter_task(ft_instance_t instance,
     return INDIGO_ERROR_NONE;
 }
 
+indigo_error_t
+ft_spawn_batch_iter_task(ft_instance_t instance,
+                         of_meta_match_t *query,
+                         ft_iter_task_batch_callback_f callback,
+                         void *cookie,
+                         int priority)
+{
+    struct ft_iter_task_state *state = aim_zmalloc(sizeof(*state));
+
+    state->batch_callback = callback;
+    state->cookie = cookie;
+
+    return ft_spawn_iter_task_common(instance, query, state,
+                                     ft_batch_iter_task_callback, priority);
+}
+
 static ft_entry_t *
 ft_iterator_links_to_entry(ft_iterator_t *iter, list_links_t *links)
 {
@@ -397,6 +662,81 @@ ft_iterator_entry_to_links(ft_iterator_t *iter, ft_entry_t *entry)
     return (list_links_t *)(((char *)entry) + iter->links_offset);
 }
 
+/*
+ * Choose the shortest list containing every flow the query could match
+ *
+ * Returns NULL if no flow has the query's exact cookie. Otherwise
+ * *links_offset is set to the offset of the entry links used by the list.
+ */
+static list_head_t *
+ft_query_list(ft_instance_t ft, of_meta_match_t *query,
+              int *links_offset, int *count)
+{
+    list_head_t *head;
+
+    if (query != NULL && query->cookie_mask == ~(uint64_t)0) {
+        ft_cookie_group_t *group = ft_cookie_group_lookup(ft, query->cookie);
+        *links_offset = offsetof(ft_entry_t, exact_cookie_links);
+        if (group == NULL) {
+            *count = 0;
+            return NULL;
+        }
+        *count = group->bucket.count;
+        return &group->bucket.head;
+    }
+
+    if (query != NULL && ft->cookie_buckets != NULL &&
+            (query->cookie_mask & ft_cookie_index_mask(ft)) == ft_cookie_index_mask(ft)) {
+        ft_cookie_bucket_t *bucket =
+            &ft->cookie_buckets[ft_cookie_to_bucket_index(ft, query->cookie)];
+        *links_offset = offsetof(ft_entry_t, cookie_links);
+        *count = bucket->count;
+        head = &bucket->head;
+    } else {
+        *links_offset = offsetof(ft_entry_t, table_links);
+        *count = ft->current_count;
+        head = &ft->all_list;
+    }
+
+    if (query != NULL && query->table_id < FT_MAX_TABLES &&
+            ft->tables[query->table_id].flow_count < *count) {
+        ft_table_t *table = &ft->tables[query->table_id];
+        *links_offset = offsetof(ft_entry_t, table_flow_links);
+        *count = table->flow_count;
+        head = &table->flows;
+    }
+
+    return head;
+}
+
+int
+ft_query_candidates(ft_instance_t ft, of_meta_match_t *query)
+{
+    int links_offset, count;
+    (void) ft_query_list(ft, query, &links_offset, &count);
+    return count;
+}
+
+void
+ft_iterate(ft_instance_t ft,
+           of_meta_match_t *query,
+           ft_iter_task_callback_f callback,
+           void *cookie)
+{
+    ft_iterator_t iter;
+    ft_entry_t *entry;
+
+    ft_iterator_init(&iter, ft, query);
+
+    while ((entry = ft_iterator_next(&iter)) != NULL) {
+        callback(cookie, entry);
+    }
+
+    ft_iterator_cleanup(&iter);
+
+    callback(cookie, NULL);
+}
+
 void
 ft_iterator_init(ft_iterator_t *iter, ft_instance_t ft, of_meta_match_t *query)
 {
@@ -407,16 +747,18 @@ ft_iterator_init(ft_iterator_t *iter, ft_instance_t ft, of_meta_match_t *query)
         iter->use_query = false;
     }
 
-    if (query && (query->cookie_mask & FT_COOKIE_PREFIX_MASK) == FT_COOKIE_PREFIX_MASK) {
-        /* Using cookie bucket */
-        iter->head = &ft->cookie_buckets[ft_cookie_to_bucket_index(ft, query->cookie)].head;
-        iter->links_offset = offsetof(ft_entry_t, cookie_links);
-    } else {
-        iter->head = &ft->all_list;
-        iter->links_offset = offsetof(ft_entry_t, table_links);
+    int count;
+    iter->ft = ft;
+    iter->dead_table_id = -1;
+    iter->head = ft_query_list(ft, query, &iter->links_offset, &count);
+
+    /* Bucket heads move if the cookie index is rebuilt */
+    iter->cookie_index = iter->links_offset == offsetof(ft_entry_t, cookie_links);
+    if (iter->cookie_index) {
+        ft->cookie_index_iterators++;
     }
 
-    if (list_empty(iter->head)) {
+    if (iter->head == NULL || list_empty(iter->head)) {
         iter->next_entry = NULL;
     } else {
         iter->next_entry = ft_iterator_links_to_entry(iter, iter->head->links.next);
@@ -442,6 +784,15 @@ ft_iterator_next(ft_iterator_t *iter)
             iter->next_entry = ft_iterator_links_to_entry(iter, next_links);
         }
 
+        if (iter->dead_table_id >= 0) {
+            if (entry->table_id != iter->dead_table_id ||
+                    !ft_entry_dead(iter->ft, entry)) {
+                continue;
+            }
+        } else if (ft_entry_dead(iter->ft, entry)) {
+            continue;
+        }
+
         if (iter->use_query && !ft_entry_meta_match(&iter->query, entry)) {
             continue;
         }
@@ -467,6 +818,15 @@ ft_iterator_cleanup(ft_iterator_t *iter)
     if (iter->use_query) {
         metamatch_cleanup(&iter->query);
     }
+
+    if (iter->cookie_index) {
+        ft_instance_t ft = iter->ft;
+        iter->cookie_index = false;
+        if (--ft->cookie_index_iterators == 0 && ft->cookie_index_pending_bits >= 0) {
+            (void) ft_set_cookie_index(ft, ft->cookie_index_pending_bits,
+                                       ft->cookie_index_pending_shift);
+        }
+    }
 }
 
 /**
@@ -486,16 +846,40 @@ ft_entry_link(ft_instance_t ft, ft_entry_t *entry)
     /* Link to full table iteration */
     list_push(&ft->all_list, &entry->table_links);
 
+    if (entry->table_id < FT_MAX_TABLES) {
+        ft_table_t *table = &ft->tables[entry->table_id];
+        entry->table_generation = table->generation;
+        if (entry->flags & OF_FLOW_MOD_FLAG_SEND_FLOW_REM) {
+            table->send_flow_rem_count++;
+        }
+        list_push(&table->flows, &entry->table_flow_links);
+        table->flow_count++;
+    }
+
     /* Strict match hash */
     bighash_insert(
         ft->strict_match_hashtable,
         &entry->strict_match_hash_entry,
         ft_strict_match_hash(ft, &entry->minimatch, entry->priority));
 
-    if (ft->cookie_buckets) { /* Cookie prefix */
+    if (ft->cookie_buckets) { /* Cookie bit range */
         idx = ft_cookie_to_bucket_index(ft, entry->cookie);
         list_push(&ft->cookie_buckets[idx].head, &entry->cookie_links);
+        ft->cookie_buckets[idx].count++;
+    }
+
+    /* Exact cookie */
+    entry->cookie_group = ft_cookie_group_lookup(ft, entry->cookie);
+    if (entry->cookie_group == NULL) {
+        entry->cookie_group = aim_zmalloc(sizeof(*entry->cookie_group));
+        entry->cookie_group->cookie = entry->cookie;
+        list_init(&entry->cookie_group->bucket.head);
+        bighash_insert(ft->exact_cookie_hashtable,
+                       &entry->cookie_group->hash_entry,
+                       ft_exact_cookie_hash(entry->cookie));
     }
+    list_push(&entry->cookie_group->bucket.head, &entry->exact_cookie_links);
+    entry->cookie_group->bucket.count++;
 
     list_init(&entry->iterators);
 
@@ -527,14 +911,37 @@ ft_entry_unlink(ft_instance_t ft, ft_entry_t *entry)
     /* Remove from full table iteration */
     list_remove(&entry->table_links);
 
+    if (entry->table_id < FT_MAX_TABLES) {
+        ft_table_t *table = &ft->tables[entry->table_id];
+        if ((entry->flags & OF_FLOW_MOD_FLAG_SEND_FLOW_REM) &&
+                !ft_entry_dead(ft, entry)) {
+            table->send_flow_rem_count--;
+        }
+        list_remove(&entry->table_flow_links);
+        table->flow_count--;
+    }
+
     /* Strict match hash */
     bighash_remove(ft->strict_match_hashtable, &entry->strict_match_hash_entry);
 
-    if (ft->cookie_buckets) { /* Cookie prefix */
-        INDIGO_ASSERT(!list_empty(&ft->cookie_buckets[ft_cookie_to_bucket_index(ft,
-            entry->cookie)].head));
+    if (ft->cookie_buckets) { /* Cookie bit range */
+        ft_cookie_bucket_t *bucket =
+            &ft->cookie_buckets[ft_cookie_to_bucket_index(ft, entry->cookie)];
+        INDIGO_ASSERT(!list_empty(&bucket->head));
         list_remove(&entry->cookie_links);
+        bucket->count--;
+    }
+
+    /*
+     * Exact cookie. Iterators over the group that pointed to this entry
+     * were advanced above, so none reference the group once it is empty.
+     */
+    list_remove(&entry->exact_cookie_links);
+    if (--entry->cookie_group->bucket.count == 0) {
+        bighash_remove(ft->exact_cookie_hashtable, &entry->cookie_group->hash_entry);
+        aim_free(entry->cookie_group);
     }
+    entry->cookie_group = NULL;
 
     if (entry->idle_timeout || entry->hard_timeout) {
         ind_core_expiration_remove(entry);
@@ -544,6 +951,7 @@ ft_entry_unlink(ft_instance_t ft, ft_entry_t *entry)
 /**
  * Allocate and initialize a new flowtable entry
  *
+ * @param ft The flow table handle, which owns the interned effects
  * @param id The flow ID to use
  * @param flow_add Pointer to the flow add object for the entry
  * @param minimatch Pointer to the minimatch already extracted from the flow
@@ -554,7 +962,7 @@ ft_entry_unlink(ft_instance_t ft, ft_entry_t *entry)
  * The minimatch is moved.
  */
 static indigo_error_t
-ft_entry_create(indigo_flow_id_t id, of_flow_add_t *flow_add,
+ft_entry_create(ft_instance_t ft, indigo_flow_id_t id, of_flow_add_t *flow_add,
                 minimatch_t *minimatch, ft_entry_t **entry_p)
 {
     indigo_error_t err;
@@ -574,7 +982,7 @@ ft_entry_create(indigo_flow_id_t id, of_flow_add_t *flow_add,
     of_flow_add_idle_timeout_get(flow_add, &entry->idle_timeout);
     of_flow_add_hard_timeout_get(flow_add, &entry->hard_timeout);
 
-    err = ft_entry_set_effects(entry, flow_add);
+    err = ft_entry_set_effects(ft, entry, flow_add);
     if (err < 0) {
         aim_free(entry);
         minimatch_cleanup(&entry->minimatch);
@@ -605,37 +1013,112 @@ ft_entry_create(indigo_flow_id_t id, of_flow_add_t *flow_add,
 static void
 ft_entry_destroy(ft_instance_t ft, ft_entry_t *entry)
 {
-    if (entry->effects.actions != NULL) {
-        of_list_action_delete(entry->effects.actions);
-        entry->effects.actions = NULL;
-    }
+    ft_effects_release(ft, entry->shared_effects);
+    entry->shared_effects = NULL;
+    entry->effects.actions = NULL;
+    ft_entry_stats_template_clear(entry);
 
     minimatch_cleanup(&entry->minimatch);
     aim_free(entry);
 }
 
-/* Populate the output port list and effects */
-static indigo_error_t
-ft_entry_set_effects(ft_entry_t *entry,
-                    of_flow_modify_t *flow_mod)
+static uint32_t
+ft_effects_hash(of_object_t *list)
 {
-    if (flow_mod->version == OF_VERSION_1_0)
-    {
-        of_list_action_t *actions;
-        if ((actions = of_flow_modify_actions_get(flow_mod)) == NULL) {
+    uint32_t h = FT_HASH_SEED;
+    h = murmur_hash(&list->version, sizeof(list->version), h);
+    h = murmur_hash(OF_OBJECT_BUFFER_INDEX(list, 0), list->length, h);
+    return h;
+}
+
+/*
+ * Find or create the interned copy of a flow-mod's actions or instructions
+ *
+ * Takes a reference on the returned effects.
+ */
+static ft_effects_t *
+ft_effects_intern(ft_instance_t ft, of_flow_modify_t *flow_mod)
+{
+    of_object_t list;
+    bighash_entry_t *hash_entry;
+    ft_effects_t *effects;
+    uint32_t hash;
+
+    if (flow_mod->version == OF_VERSION_1_0) {
+        of_flow_modify_actions_bind(flow_mod, &list);
+    } else {
+        of_flow_modify_instructions_bind(flow_mod, &list);
+    }
+
+    hash = ft_effects_hash(&list);
+
+    for (hash_entry = bighash_first(ft->effects_hashtable, hash);
+         hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
+        effects = container_of(hash_entry, hash_entry, ft_effects_t);
+        if (effects->list->version == list.version &&
+                effects->list->length == list.length &&
+                !memcmp(OF_OBJECT_BUFFER_INDEX(effects->list, 0),
+                        OF_OBJECT_BUFFER_INDEX(&list, 0), list.length)) {
+            effects->refcount++;
+            return effects;
+        }
+    }
+
+    effects = aim_zmalloc(sizeof(*effects));
+
+    if (flow_mod->version == OF_VERSION_1_0) {
+        if ((effects->list = of_flow_modify_actions_get(flow_mod)) == NULL) {
             AIM_DIE("Failed to allocate action list");
         }
-        of_list_action_delete(entry->effects.actions);
-        entry->effects.actions = actions;
     } else {
-        of_list_instruction_t *instructions;
-        if ((instructions = of_flow_modify_instructions_get(flow_mod)) == NULL) {
+        if ((effects->list = of_flow_modify_instructions_get(flow_mod)) == NULL) {
             AIM_DIE("Failed to allocate instruction list");
         }
-        of_list_instruction_delete(entry->effects.instructions);
-        entry->effects.instructions = instructions;
     }
 
+    effects->refcount = 1;
+    bighash_insert(ft->effects_hashtable, &effects->hash_entry, hash);
+    debug_counter_inc(&ft_effects_created_counter);
+
+    return effects;
+}
+
+static void
+ft_effects_release(ft_instance_t ft, ft_effects_t *effects)
+{
+    if (effects == NULL || --effects->refcount > 0) {
+        return;
+    }
+
+    bighash_remove(ft->effects_hashtable, &effects->hash_entry);
+    of_object_delete(effects->list);
+    aim_free(effects);
+    debug_counter_inc(&ft_effects_freed_counter);
+}
+
+/* Drop the cached flow stats entry after the entry changes */
+static void
+ft_entry_stats_template_clear(ft_entry_t *entry)
+{
+    if (entry->stats_template != NULL) {
+        of_object_delete(entry->stats_template);
+        entry->stats_template = NULL;
+    }
+}
+
+/* Populate the output port list and effects */
+static indigo_error_t
+ft_entry_set_effects(ft_instance_t ft,
+                     ft_entry_t *entry,
+                     of_flow_modify_t *flow_mod)
+{
+    /* Intern first so unchanged effects aren't freed and recreated */
+    ft_effects_t *effects = ft_effects_intern(ft, flow_mod);
+
+    ft_effects_release(ft, entry->shared_effects);
+    entry->shared_effects = effects;
+    entry->effects.actions = effects->list;
+
     return INDIGO_ERROR_NONE;
 }
 
@@ -650,6 +1133,10 @@ ft_checksum_add(ft_instance_t ft, ft_entry_t *entry)
     table->checksum += entry->cookie;
     int bucket = table->checksum_shift < 64 ? entry->cookie >> table->checksum_shift : 0;
     table->checksum_buckets[bucket] += entry->cookie;
+    int node;
+    for (node = (bucket + table->checksum_buckets_size) / 2; node >= 1; node /= 2) {
+        table->checksum_tree[node] += entry->cookie;
+    }
 }
 
 static void
@@ -663,6 +1150,52 @@ ft_checksum_subtract(ft_instance_t ft, ft_entry_t *entry)
     table->checksum -= entry->cookie;
     int bucket = table->checksum_shift < 64 ? entry->cookie >> table->checksum_shift : 0;
     table->checksum_buckets[bucket] -= entry->cookie;
+    int node;
+    for (node = (bucket + table->checksum_buckets_size) / 2; node >= 1; node /= 2) {
+        table->checksum_tree[node] -= entry->cookie;
+    }
+}
+
+static void
+ft_checksum_buckets_alloc(ft_table_t *table, uint32_t buckets_size)
+{
+    table->checksum_buckets_size = buckets_size;
+    table->checksum_shift = 64 - aim_log2_u32(buckets_size);
+    table->checksum_buckets = aim_zmalloc(sizeof(uint64_t) * buckets_size);
+    /* Interior nodes only, node 1 is the root and index 0 is unused */
+    table->checksum_tree = aim_zmalloc(sizeof(uint64_t) * buckets_size);
+}
+
+static void
+ft_checksum_buckets_free(ft_table_t *table)
+{
+    aim_free(table->checksum_buckets);
+    aim_free(table->checksum_tree);
+}
+
+void
+ft_table_kill(ft_instance_t ft, uint8_t table_id)
+{
+    ft_table_t *table;
+
+    AIM_ASSERT(table_id < FT_MAX_TABLES);
+
+    table = &ft->tables[table_id];
+    table->generation++;
+    table->send_flow_rem_count = 0;
+}
+
+uint64_t
+ft_checksum_tree_node(ft_table_t *table, uint32_t level, uint32_t index)
+{
+    uint32_t node = (1u << level) + index;
+
+    if (node >= table->checksum_buckets_size) {
+        /* Leaves are the buckets themselves */
+        return table->checksum_buckets[node - table->checksum_buckets_size];
+    }
+
+    return table->checksum_tree[node];
 }
 
 void
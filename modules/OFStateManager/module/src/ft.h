@@ -61,10 +61,14 @@
 #define FT_MAX_TABLES 32
 
 /**
- * Length of the prefix used for bucketing flows by cookie.
+ * Bit range of the cookie used for bucketing flows by cookie
+ *
+ * By default the top byte of the cookie selects one of 256 buckets. See
+ * ft_set_cookie_index.
  */
-#define FT_COOKIE_PREFIX_LEN 8
-#define FT_COOKIE_PREFIX_MASK (~(uint64_t)0 << (64-FT_COOKIE_PREFIX_LEN))
+#define FT_COOKIE_INDEX_DEFAULT_BITS 8
+#define FT_COOKIE_INDEX_DEFAULT_SHIFT 56
+#define FT_COOKIE_INDEX_MAX_BITS 16
 
 /**
  * Forward declaration of flowtable handle for other typedefs
@@ -80,8 +84,34 @@ typedef ft_public_t *ft_instance_t;
 
 typedef struct ft_cookie_bucket_s {
     list_head_t head;
+    int count;
 } ft_cookie_bucket_t;
 
+/**
+ * The flows with one exact cookie
+ *
+ * Created in the exact cookie hashtable by the first flow with the cookie
+ * and freed along with the last one.
+ */
+typedef struct ft_cookie_group_s {
+    bighash_entry_t hash_entry;
+    uint64_t cookie;
+    ft_cookie_bucket_t bucket;     /* Linked through exact_cookie_links */
+} ft_cookie_group_t;
+
+/**
+ * Occupancy of the cookie indexes, see ft_cookie_index_stats_get
+ */
+typedef struct ft_cookie_index_stats_s {
+    uint32_t bits;                 /* Current cookie bucket index bit range */
+    uint32_t shift;
+    uint32_t buckets;
+    uint32_t nonempty_buckets;
+    uint32_t max_bucket_count;
+    uint32_t exact_cookies;        /* Distinct cookies */
+    uint32_t max_exact_cookie_count;
+} ft_cookie_index_stats_t;
+
 /**
  * Per-table bookkeeping
  *
@@ -89,6 +119,13 @@ typedef struct ft_cookie_bucket_s {
  * bucketed by checksum prefix and their cookies XORed into the bucket. The
  * per-table checksum field is the XOR of the cookies of every flow in the
  * table.
+ *
+ * The checksum tree holds the sums of the interior nodes of a binary tree
+ * over the buckets, see ft_checksum_tree_node.
+ *
+ * send_flow_rem_count is the number of live flows with
+ * OF_FLOW_MOD_FLAG_SEND_FLOW_REM. Flows linked under an older generation
+ * are dead, see ft_table_kill.
  */
 
 typedef struct ft_table_s {
@@ -96,6 +133,11 @@ typedef struct ft_table_s {
     int checksum_buckets_size;
     int checksum_shift;
     uint64_t *checksum_buckets;
+    uint64_t *checksum_tree;
+    uint32_t send_flow_rem_count;
+    uint32_t generation;
+    list_head_t flows;             /* Entries with this table ID */
+    int flow_count;
 } ft_table_t;
 
 /**
@@ -110,11 +152,28 @@ struct ft_public_s {
     list_head_t all_list;          /* Single list of all current entries */
 
     bighash_table_t *strict_match_hashtable;
-    ft_cookie_bucket_t *cookie_buckets;   /* Array of cookie (prefix) based buckets */
+    ft_cookie_bucket_t *cookie_buckets;   /* Array of cookie bit range based buckets */
+    int cookie_index_bits;         /* Width of the bucket index, 0 if disabled */
+    int cookie_index_shift;        /* Position of the bucket index in the cookie */
+    int cookie_index_iterators;    /* Iterators walking a cookie bucket */
+    int cookie_index_pending_bits; /* Deferred ft_set_cookie_index, or -1 */
+    int cookie_index_pending_shift;
+    bighash_table_t *exact_cookie_hashtable; /* ft_cookie_group_t by cookie */
+    bighash_table_t *effects_hashtable;   /* Interned ft_effects_t */
 
     ft_table_t tables[FT_MAX_TABLES];
 };
 
+/**
+ * Whether a flow was hidden by ft_table_kill and is waiting to be deleted
+ */
+static inline bool
+ft_entry_dead(ft_instance_t ft, ft_entry_t *entry)
+{
+    return entry->table_id < FT_MAX_TABLES &&
+        entry->table_generation != ft->tables[entry->table_id].generation;
+}
+
 /**
  * Safe iterator for the flowtable
  *
@@ -123,12 +182,15 @@ struct ft_public_s {
  * This struct should be treated as opaque.
  */
 typedef struct ft_iterator_s {
+    ft_instance_t ft;
     list_head_t *head;             /* List head for this iteration */
     ft_entry_t *next_entry;        /* Entry to be returned on next() */
     int links_offset;              /* Offset of the links we're using in the flowtable entry */
+    bool cookie_index;             /* Counted in ft->cookie_index_iterators */
     list_links_t entry_links;      /* Linked into next_entry->iterators if next_entry != NULL */
     bool use_query;                /* Whether 'query' is valid */
     of_meta_match_t query;         /* Optional query to filter by */
+    int dead_table_id;             /* Only dead flows of this table, or -1 */
 } ft_iterator_t;
 
 /**
@@ -207,6 +269,26 @@ void ft_delete(ft_instance_t ft, ft_entry_t *entry);
  */
 void ft_overwrite(ft_instance_t ft, ft_entry_t *entry, of_flow_add_t *flow_add);
 
+/**
+ * Check whether an overwrite would leave Forwarding's view unchanged
+ * @param entry Pointer to the entry to be overwritten
+ * @param flow_add The LOCI flow mod object resulting in the overwrite
+ *
+ * Returns true if the cookie, flags and instructions are identical. The
+ * instructions are compared as wire bytes.
+ */
+bool ft_overwrite_is_noop(ft_entry_t *entry, of_flow_add_t *flow_add);
+
+/**
+ * Overwrite only the timeouts and creation time of a flow entry
+ * @param ft The flow table handle
+ * @param entry Pointer to the entry to be overwritten
+ * @param flow_add The LOCI flow mod object resulting in the overwrite
+ *
+ * Used instead of ft_overwrite when ft_overwrite_is_noop returns true.
+ */
+void ft_overwrite_timeouts(ft_instance_t ft, ft_entry_t *entry, of_flow_add_t *flow_add);
+
 /**
  * Query the flow table (strict match) and return the first match if found
  * @param ft Handle for a flow table instance
@@ -219,6 +301,45 @@ indigo_error_t ft_strict_match(ft_instance_t instance,
                                of_meta_match_t *query,
                                ft_entry_t **entry_ptr);
 
+/**
+ * Change the bit range of the cookie used to bucket flows
+ * @param ft Handle for a flow table instance
+ * @param bits Width of the bucket index, 0 to only use the exact cookie index
+ * @param shift Position of the least significant bit of the index
+ *
+ * A query uses the bucket index if its cookie mask covers the whole bit
+ * range. Controllers that put an application ID in the low cookie bits, for
+ * example, should index on those bits.
+ *
+ * The buckets are rebuilt immediately unless an iterator is walking one of
+ * them, in which case INDIGO_ERROR_PENDING is returned and they are rebuilt
+ * once the last such iterator is cleaned up.
+ */
+
+indigo_error_t
+ft_set_cookie_index(ft_instance_t ft, int bits, int shift);
+
+/**
+ * Get the occupancy of the cookie bucket and exact cookie indexes
+ *
+ * This walks every bucket and cookie, so it is meant for operators tuning
+ * the cookie index rather than the datapath.
+ */
+
+void
+ft_cookie_index_stats_get(ft_instance_t ft, ft_cookie_index_stats_t *stats);
+
+/**
+ * Get the checksum of a node in a table's checksum tree
+ *
+ * Level 0 is the root and level log2(checksum_buckets_size) holds the
+ * buckets. Each node's checksum is the sum of its children's, so a
+ * controller can find differing buckets by descending only into
+ * differing subtrees. 'index' must be less than 2^level.
+ */
+uint64_t
+ft_checksum_tree_node(ft_table_t *table, uint32_t level, uint32_t index);
+
 /**
  * Resize the checksum buckets array for a table
  */
@@ -270,6 +391,74 @@ ft_spawn_iter_task(ft_instance_t instance,
                    void *cookie,
                    int priority);
 
+/*
+ * Spawn a task that iterates over the dead flows of a table
+ *
+ * Like ft_spawn_iter_task, but only visits flows hidden by ft_table_kill,
+ * which no other iterator returns. The callback is expected to delete them.
+ */
+indigo_error_t
+ft_spawn_dead_iter_task(ft_instance_t instance,
+                        uint8_t table_id,
+                        ft_iter_task_callback_f callback,
+                        void *cookie,
+                        int priority);
+
+/*
+ * Spawn a task that iterates over the flowtable in batches
+ *
+ * Like ft_spawn_iter_task, but the callback is passed up to
+ * FT_ITER_TASK_BATCH_SIZE entries at a time so it can amortize per-call
+ * costs such as driver reads across them. The callback will be called with
+ * a count of zero at the end of the iteration. It may delete entries in the
+ * batch it was passed.
+ */
+
+#define FT_ITER_TASK_BATCH_SIZE 32
+
+typedef void (*ft_iter_task_batch_callback_f)(void *cookie, ft_entry_t **entries, int count);
+
+indigo_error_t
+ft_spawn_batch_iter_task(ft_instance_t instance,
+                         of_meta_match_t *query,
+                         ft_iter_task_batch_callback_f callback,
+                         void *cookie,
+                         int priority);
+
+/*
+ * Estimate the cost of iterating over the flowtable with a query
+ *
+ * Returns the number of entries an iterator would visit, which depends on
+ * the index the query can use. Not all of them necessarily match.
+ */
+int
+ft_query_candidates(ft_instance_t instance, of_meta_match_t *query);
+
+/*
+ * Iterate over the flowtable synchronously
+ *
+ * Same semantics as ft_spawn_iter_task, including the final call with a
+ * NULL entry and moving the metamatch, but runs to completion before
+ * returning. Only suitable when ft_query_candidates is small.
+ */
+void
+ft_iterate(ft_instance_t instance,
+           of_meta_match_t *query,
+           ft_iter_task_callback_f callback,
+           void *cookie);
+
+/**
+ * Hide every flow currently in a table
+ *
+ * Used once Forwarding has removed all of a table's flows in one call. The
+ * flows become dead: ft_strict_match and iterators skip them and they no
+ * longer count in send_flow_rem_count, but they stay in the checksums and
+ * current_count until deleted with ft_delete. Flows added afterwards are
+ * unaffected.
+ */
+void
+ft_table_kill(ft_instance_t instance, uint8_t table_id);
+
 /**
  * Initialize a flowtable iterator
  *
@@ -304,6 +493,9 @@ extern debug_counter_t ft_flow_counter;
 extern debug_counter_t ft_add_counter;
 extern debug_counter_t ft_delete_counter;
 extern debug_counter_t ft_modify_counter;
+extern debug_counter_t ft_overwrite_elided_counter;
+extern debug_counter_t ft_effects_created_counter;
+extern debug_counter_t ft_effects_freed_counter;
 extern debug_counter_t ft_forwarding_add_error_counter;
 
 #endif /* _OFSTATEMANAGER_FT_H_ */
@@ -31,6 +31,19 @@
  * The flow entry structure
  ****************************************************************/
 
+/**
+ * Interned actions or instructions
+ *
+ * Flows with byte-identical effects share one of these, so the LOCI list
+ * must not be modified. Owned by the flowtable, see ft_entry_set_effects.
+ */
+
+typedef struct ft_effects_s {
+    bighash_entry_t hash_entry;
+    uint32_t refcount;
+    of_object_t *list;             /* of_list_action_t or of_list_instruction_t */
+} ft_effects_t;
+
 /**
  * The data in a flow table entry
  *
@@ -41,26 +54,37 @@
  * @param hard_timeout The hard_timeout, from the original add
  * @param flags The flags, from the original add
  * @param table_id The table id, from the original add
+ * @param table_generation The table's generation when linked, see ft_table_kill
  * @param priv Opaque data returned by the entry_create operation
  * @param cookie The cookie, from the original or as updated
  * @param effects The actions or instructions from the add or as updated.
  * See below.
+ * @param shared_effects The interned copy that effects points into
+ * @param stats_template Cached flow stats entry, see below
+ * @param cached_stats Counters last read from Forwarding, see counter_cache.c
+ * @param cached_stats_time When cached_stats was read, or 0
  * @param insert_time The timestamp when the entry was inserted
  * @param last_counter_change Last update when counters changed
  * @param table_links For iterating across the flow table
  * @param strict_match_hash_entry Search by strict match
- * @param cookie_links Search by cookie
+ * @param cookie_links Search by cookie bucket
+ * @param exact_cookie_links Search by exact cookie, linked into cookie_group
  * @param expiration_links Linked into expiration_queue if a timeout was specified
  * @param iterators List of ft_iterator_t objects pointing to this entry
  *
  * The effects (actions or instructions) are tied to a specific OpenFlow
  * version. For example, a flow may be added using OpenFlow 1.0 but
  * modified using OpenFlow 1.3. Either union member may be used to check
- * the version and LOCI object type.
+ * the version and LOCI object type. The lists are shared between entries
+ * with identical effects and are read-only.
  *
  * The match, priority, and table-id are invariant once the entry has been
  * added to the table. The timeouts and flags may be updated by overwriting the
  * entry with a flow-add. The cookie and effects may be updated by a flow-modify.
+ *
+ * The stats template is built by the first flow stats request to return the
+ * entry and holds everything but the duration and counters. The flowtable
+ * frees it whenever the entry changes.
  */
 
 typedef struct ft_entry_s {
@@ -71,6 +95,7 @@ typedef struct ft_entry_s {
     uint16_t hard_timeout;
     uint8_t flags;
     uint8_t table_id;
+    uint32_t table_generation;
     void *priv;
 
     /* May be changed by flow-modify */
@@ -79,15 +104,22 @@ typedef struct ft_entry_s {
         of_list_action_t *actions;
         of_list_instruction_t *instructions;
     } effects;
+    ft_effects_t *shared_effects;
 
     /* Updated by implementation */
+    of_object_t *stats_template;
+    indigo_fi_flow_stats_t cached_stats;
+    indigo_time_t cached_stats_time;
     indigo_time_t insert_time;
     indigo_time_t last_counter_change;
 
     /* Datastructure links */
     list_links_t table_links;      /* For iterating across the flow table */
+    list_links_t table_flow_links; /* For iterating across one table */
     bighash_entry_t strict_match_hash_entry;  /* Search by strict match */
-    list_links_t cookie_links;     /* Search by cookie */
+    list_links_t cookie_links;     /* Search by cookie bucket */
+    list_links_t exact_cookie_links; /* Search by exact cookie */
+    struct ft_cookie_group_s *cookie_group;
     list_links_t expiration_links; /* Expiration list entry */
     list_head_t iterators;         /* List of ft_iterator_t objects
                                       pointing to this entry */
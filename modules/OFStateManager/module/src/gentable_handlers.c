@@ -24,8 +24,6 @@
  * See detailed documentation in the Indigo architecture headers.
  *
  * TODO:
- *  - Reduce LOCI allocation overhead per entry.
- *  - Reuse stats entry during stats tasks.
  *  - Automatically resize key hashtable buckets.
  */
 
@@ -37,32 +35,87 @@
 #include "ofstatemanager_decs.h"
 #include "ofstatemanager_int.h"
 #include "handlers.h"
+#include "occupancy_bitmap.h"
 #include <murmur/murmur.h>
 
 #define MAX_GENTABLES 128
 
+/* Maximum number of entries passed to one get_stats_bulk call */
+#define ENTRY_STATS_BATCH_SIZE 16
+
 struct ind_core_gentable_entry;
 
 typedef void (*ind_core_gentable_iter_task_callback_f)(
     void *cookie, indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
 
+typedef void (*ind_core_gentable_iter_task_flush_f)(
+    void *cookie, indigo_core_gentable_t *gentable);
+
 static indigo_core_gentable_t *find_gentable_by_id(uint32_t table_id);
 static uint16_t alloc_table_id(void);
 static uint8_t calc_checksum_buckets_shift(uint32_t checksum_buckets_size);
+static struct ind_core_gentable_checksum_bucket *alloc_checksum_buckets(uint32_t checksum_buckets_size);
 static struct ind_core_gentable_checksum_bucket *find_checksum_bucket(indigo_core_gentable_t *gentable, of_checksum_128_t *checksum);
+static void bucket_insert(indigo_core_gentable_t *gentable, struct ind_core_gentable_checksum_bucket *bucket, struct ind_core_gentable_entry *entry);
+static void bucket_remove(indigo_core_gentable_t *gentable, struct ind_core_gentable_checksum_bucket *bucket, struct ind_core_gentable_entry *entry);
+static void migrate_checksum_bucket(indigo_core_gentable_t *gentable);
+static void finish_resize(indigo_core_gentable_t *gentable);
+static void add_unmigrated_checksums(indigo_core_gentable_t *gentable, uint32_t level, uint32_t index, uint32_t count, of_checksum_128_t *checksums);
 static void add_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src);
 static void subtract_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src);
 static uint32_t hash_key(of_list_bsn_tlv_t *key);
+static indigo_error_t clear_all_entries(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable);
 static indigo_error_t delete_entry(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
 static struct ind_core_gentable_entry *find_entry_by_key(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key);
-static bool key_equality(of_list_bsn_tlv_t *a, of_list_bsn_tlv_t *b);
-static indigo_error_t ind_core_gentable_spawn_iter_task(indigo_core_gentable_t *gentable, ind_core_gentable_iter_task_callback_f callback, void *cookie, int priority, of_checksum_128_t checksum_prefix, of_checksum_128_t checksum_mask);
+static struct ind_core_gentable_entry *find_entry_by_key_hash(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key, uint32_t hash);
+static bool key_equality(of_list_bsn_tlv_t *key, struct ind_core_gentable_entry *entry);
+static struct ind_core_gentable_entry *alloc_entry(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value);
+static void free_entry(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
+static void set_entry_value(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry, of_list_bsn_tlv_t *value);
+static of_list_bsn_tlv_t *entry_key(struct ind_core_gentable_entry *entry, of_object_storage_t *storage);
+static of_list_bsn_tlv_t *entry_value(struct ind_core_gentable_entry *entry, of_object_storage_t *storage);
+static void index_insert_entry(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
+static void index_remove_entry(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
+static void index_update_entry(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry);
+static bool entry_unchanged(struct ind_core_gentable_entry *entry, of_object_t *obj, of_list_bsn_tlv_t *value);
+static indigo_error_t ind_core_gentable_spawn_iter_task(indigo_core_gentable_t *gentable, ind_core_gentable_iter_task_callback_f callback, ind_core_gentable_iter_task_flush_f flush, void *cookie, int priority, of_checksum_128_t checksum_prefix, of_checksum_128_t checksum_mask);
 
 struct ind_core_gentable_checksum_bucket {
     of_checksum_128_t checksum;
     list_head_t entries;
 };
 
+/*
+ * Secondary index
+ *
+ * Each entry has one ind_core_gentable_index_node per index, allocated
+ * together in entry->index_nodes. Nodes for which the extract function
+ * returned true are linked into the index hashtable by secondary key.
+ */
+struct ind_core_gentable_index {
+    indigo_core_gentable_index_extract_f extract;
+    bighash_table_t *hashtable;
+};
+
+struct ind_core_gentable_index_node {
+    bighash_entry_t hash_entry;
+    struct ind_core_gentable_entry *entry;
+    uint64_t index_key;
+    bool present; /* linked into the index hashtable */
+};
+
+/*
+ * A set_buckets_size request received while another resize is in progress
+ *
+ * The connection is paused and the request applied by the resize task
+ * once the current migration is done.
+ */
+struct ind_core_gentable_pending_resize {
+    struct ind_core_gentable_pending_resize *next;
+    indigo_cxn_id_t cxn_id;
+    uint32_t buckets_size;
+};
+
 struct indigo_core_gentable {
     const indigo_core_gentable_ops_t *ops;
     void *priv;
@@ -72,20 +125,59 @@ struct indigo_core_gentable {
     uint32_t max_entries;
     uint32_t num_entries;
     uint32_t checksum_buckets_size; /* always a power of 2 */
+    occupancy_bitmap_t checksum_buckets_occupancy; /* non-empty buckets */
+    of_checksum_128_t *checksum_tree; /* see update_checksum_tree */
     uint16_t table_id;
     uint8_t checksum_buckets_shift; /* see checksum_buckets_shift */
     of_checksum_128_t checksum;
     of_table_name_t name;
+    uint64_t entry_bytes; /* memory used by entries, including keys and values */
+
+    /*
+     * Incremental resize of the checksum buckets
+     *
+     * While a resize is in progress old_checksum_buckets is non-NULL and
+     * holds the previous bucket array. Old buckets below migrate_idx have
+     * been moved into checksum_buckets and are empty. See
+     * find_checksum_bucket.
+     */
+    struct ind_core_gentable_checksum_bucket *old_checksum_buckets;
+    occupancy_bitmap_t old_checksum_buckets_occupancy;
+    uint32_t old_checksum_buckets_size;
+    uint32_t migrate_idx;
+    uint8_t old_checksum_buckets_shift;
+    bool resize_task_running;
+    indigo_cxn_id_t resize_cxn_id; /* paused until the resize finishes */
+    struct ind_core_gentable_pending_resize *pending_resizes; /* FIFO */
+
+    bool elide_noop_modify; /* see indigo_core_gentable_elide_noop_modify_set */
+
+    struct ind_core_gentable_index indexes[INDIGO_CORE_GENTABLE_MAX_INDEXES];
+    int num_indexes;
 };
 
+/*
+ * The key and value are stored as raw TLV list wire bytes in the same
+ * allocation as the entry, key first. LOCI views are bound onto them on
+ * demand with entry_key and entry_value.
+ *
+ * If a modify grows the value beyond the space reserved when the entry
+ * was allocated, the value moves to a separate allocation. The entry
+ * itself never moves.
+ */
 struct ind_core_gentable_entry {
     bighash_entry_t key_hash_entry;
     list_links_t checksum_links;
     void *priv;
-    of_list_bsn_tlv_t *key;
-    of_list_bsn_tlv_t *value;
+    uint8_t *value_data; /* points into data or a separate allocation */
+    struct ind_core_gentable_index_node *index_nodes; /* NULL if no indexes */
     of_checksum_128_t checksum;
     uint32_t refcount;
+    uint16_t key_len;
+    uint16_t value_len;
+    uint16_t value_inline_len; /* space reserved for the value in data */
+    uint8_t version;
+    uint8_t data[];
 };
 
 static indigo_core_gentable_t *gentables[MAX_GENTABLES];
@@ -107,12 +199,10 @@ indigo_core_gentable_register(
     uint32_t buckets_size,
     indigo_core_gentable_t **gentable_ptr)
 {
-    int i;
-
     AIM_TRUE_OR_DIE(ops->add != NULL || ops->add2 != NULL);
     AIM_TRUE_OR_DIE(ops->modify != NULL || ops->modify2 != NULL);
     AIM_TRUE_OR_DIE(ops->del != NULL || ops->del2 != NULL);
-    AIM_TRUE_OR_DIE(ops->get_stats != NULL);
+    AIM_TRUE_OR_DIE(ops->get_stats != NULL || ops->get_stats_bulk != NULL);
     AIM_TRUE_OR_DIE(buckets_size > 1);
     AIM_TRUE_OR_DIE(strlen(name) <= OF_MAX_TABLE_NAME_LEN);
 
@@ -132,16 +222,12 @@ indigo_core_gentable_register(
 
     gentable->key_hashtable = bighash_table_create(BIGHASH_AUTOGROW);
 
-    gentable->checksum_buckets = aim_malloc(sizeof(*gentable->checksum_buckets) *
-                                            gentable->checksum_buckets_size);
-
-    for (i = 0; i < gentable->checksum_buckets_size; i++) {
-        struct ind_core_gentable_checksum_bucket *bucket =
-            &gentable->checksum_buckets[i];
-        bucket->checksum.lo = 0;
-        bucket->checksum.hi = 0;
-        list_init(&bucket->entries);
-    }
+    gentable->checksum_buckets =
+        alloc_checksum_buckets(gentable->checksum_buckets_size);
+    occupancy_bitmap_init(&gentable->checksum_buckets_occupancy,
+                          gentable->checksum_buckets_size);
+    gentable->checksum_tree =
+        aim_zmalloc(sizeof(of_checksum_128_t) * gentable->checksum_buckets_size);
 
     gentables[gentable->table_id] = gentable;
     *gentable_ptr = gentable;
@@ -156,6 +242,7 @@ indigo_core_gentable_unregister(indigo_core_gentable_t *gentable)
     indigo_error_t rv;
     bighash_iter_t iter;
     bighash_entry_t *hash_entry;
+    int i;
 
     AIM_TRUE_OR_DIE(gentables[gentable->table_id] == gentable);
 
@@ -172,8 +259,27 @@ indigo_core_gentable_unregister(indigo_core_gentable_t *gentable)
 
     gentables[gentable->table_id] = NULL;
 
+    if (gentable->old_checksum_buckets != NULL) {
+        /* The resize task notices the table is gone and exits */
+        aim_free(gentable->old_checksum_buckets);
+        occupancy_bitmap_cleanup(&gentable->old_checksum_buckets_occupancy);
+        indigo_cxn_resume(gentable->resize_cxn_id);
+    }
+
+    while (gentable->pending_resizes != NULL) {
+        struct ind_core_gentable_pending_resize *pending = gentable->pending_resizes;
+        gentable->pending_resizes = pending->next;
+        indigo_cxn_resume(pending->cxn_id);
+        aim_free(pending);
+    }
+
     bighash_table_destroy(gentable->key_hashtable, NULL);
+    for (i = 0; i < gentable->num_indexes; i++) {
+        bighash_table_destroy(gentable->indexes[i].hashtable, NULL);
+    }
     aim_free(gentable->checksum_buckets);
+    occupancy_bitmap_cleanup(&gentable->checksum_buckets_occupancy);
+    aim_free(gentable->checksum_tree);
     aim_free(gentable);
 }
 
@@ -223,16 +329,22 @@ ind_core_bsn_gentable_entry_add_handler(
         }
 
         /* Allocate new entry */
-        entry = aim_zmalloc(sizeof(*entry));
-        entry->key = of_object_dup(&key);
+        entry = alloc_entry(gentable, &key, &value);
         entry->priv = priv;
 
         /* Insert into key bucket */
         bighash_insert(gentable->key_hashtable, &entry->key_hash_entry, hash_key(&key));
 
+        index_insert_entry(gentable, entry);
+
         gentable->num_entries++;
     } else {
         /* Modifying an existing entry */
+        if (gentable->elide_noop_modify && entry_unchanged(entry, obj, &value)) {
+            debug_counter_inc(&ind_core_gentable_modify_elided_counter);
+            return;
+        }
+
         if (gentable->ops->modify2 != NULL) {
             rv = gentable->ops->modify2(cxn_id, gentable->priv, entry->priv, &key, &value);
         } else {
@@ -244,25 +356,23 @@ ind_core_bsn_gentable_entry_add_handler(
             goto error;
         }
 
-        of_object_delete(entry->value);
+        set_entry_value(gentable, entry, &value);
+        index_update_entry(gentable, entry);
 
         /* Remove from old checksum bucket */
         checksum_bucket = find_checksum_bucket(gentable, &entry->checksum);
-        list_remove(&entry->checksum_links);
-        subtract_checksum(&checksum_bucket->checksum, &entry->checksum);
+        bucket_remove(gentable, checksum_bucket, entry);
 
         /* Remove from table checksum */
         subtract_checksum(&gentable->checksum, &entry->checksum);
     }
 
-    /* Update value and checksum */
-    entry->value = of_object_dup(&value);
+    /* Update checksum */
     of_bsn_gentable_entry_add_checksum_get(obj, &entry->checksum);
 
     /* Insert into checksum bucket */
     checksum_bucket = find_checksum_bucket(gentable, &entry->checksum);
-    list_push(&checksum_bucket->entries, &entry->checksum_links);
-    add_checksum(&checksum_bucket->checksum, &entry->checksum);
+    bucket_insert(gentable, checksum_bucket, entry);
 
     /* Add to table checksum */
     add_checksum(&gentable->checksum, &entry->checksum);
@@ -384,13 +494,28 @@ ind_core_bsn_gentable_clear_request_handler(
         return;
     }
 
+    if (checksum_mask.hi == 0 && checksum_mask.lo == 0 &&
+            gentable->ops->clear != NULL) {
+        uint32_t deleted_count = gentable->num_entries;
+        if (clear_all_entries(cxn_id, gentable) == INDIGO_ERROR_NONE) {
+            uint32_t xid;
+            of_bsn_gentable_clear_request_xid_get(obj, &xid);
+            of_bsn_gentable_clear_reply_t *reply = of_bsn_gentable_clear_reply_new(obj->version);
+            of_bsn_gentable_clear_reply_xid_set(reply, xid);
+            of_bsn_gentable_clear_reply_deleted_count_set(reply, deleted_count);
+            of_bsn_gentable_clear_reply_error_count_set(reply, 0);
+            indigo_cxn_send_controller_message(cxn_id, reply);
+            return;
+        }
+    }
+
     struct ind_core_gentable_clear_state *state = aim_zmalloc(sizeof(*state));
     state->cxn_id = cxn_id;
     state->version = obj->version;
     of_bsn_gentable_clear_request_xid_get(obj, &state->xid);
     indigo_cxn_pause(cxn_id);
 
-    rv = ind_core_gentable_spawn_iter_task(gentable, clear_iter, state,
+    rv = ind_core_gentable_spawn_iter_task(gentable, clear_iter, NULL, state,
                                            IND_SOC_NORMAL_PRIORITY,
                                            checksum, checksum_mask);
     if (rv < 0) {
@@ -400,6 +525,110 @@ ind_core_bsn_gentable_clear_request_handler(
     }
 }
 
+/*
+ * Checksum bucket resize task
+ *
+ * Resizing moves every entry to a new bucket. Rather than doing this in
+ * one go, the new array is installed immediately and old buckets are
+ * migrated a few at a time by this task. find_checksum_bucket, the
+ * iterator task and the bucket checksum readers (see
+ * add_unmigrated_checksums) consult both arrays until the migration is
+ * finished.
+ */
+
+struct ind_core_gentable_resize_task_state {
+    uint16_t table_id;
+    uint64_t generation_id;
+};
+
+/*
+ * Install a new bucket array and start migrating entries into it
+ *
+ * The caller has already paused cxn_id, which is resumed once the
+ * migration is done.
+ */
+static void
+start_resize(indigo_core_gentable_t *gentable, uint32_t new_buckets_size,
+             indigo_cxn_id_t cxn_id)
+{
+    AIM_ASSERT(gentable->old_checksum_buckets == NULL);
+
+    gentable->old_checksum_buckets = gentable->checksum_buckets;
+    gentable->old_checksum_buckets_occupancy = gentable->checksum_buckets_occupancy;
+    gentable->old_checksum_buckets_size = gentable->checksum_buckets_size;
+    gentable->old_checksum_buckets_shift = gentable->checksum_buckets_shift;
+    gentable->migrate_idx = 0;
+
+    gentable->checksum_buckets_size = new_buckets_size;
+    gentable->checksum_buckets =
+        alloc_checksum_buckets(gentable->checksum_buckets_size);
+    occupancy_bitmap_init(&gentable->checksum_buckets_occupancy,
+                          gentable->checksum_buckets_size);
+
+    /* The tree covers the new buckets and fills in as entries migrate */
+    aim_free(gentable->checksum_tree);
+    gentable->checksum_tree =
+        aim_zmalloc(sizeof(of_checksum_128_t) * gentable->checksum_buckets_size);
+
+    gentable->checksum_buckets_shift =
+        calc_checksum_buckets_shift(gentable->checksum_buckets_size);
+
+    gentable->resize_cxn_id = cxn_id;
+}
+
+/*
+ * Start the oldest deferred resize, if any
+ *
+ * Returns false if there was nothing to start.
+ */
+static bool
+start_pending_resize(indigo_core_gentable_t *gentable)
+{
+    struct ind_core_gentable_pending_resize *pending = gentable->pending_resizes;
+
+    if (pending == NULL) {
+        return false;
+    }
+
+    gentable->pending_resizes = pending->next;
+
+    if (pending->buckets_size == gentable->checksum_buckets_size) {
+        indigo_cxn_resume(pending->cxn_id);
+    } else {
+        start_resize(gentable, pending->buckets_size, pending->cxn_id);
+    }
+
+    aim_free(pending);
+    return true;
+}
+
+static ind_soc_task_status_t
+ind_core_gentable_resize_task_callback(void *cookie)
+{
+    struct ind_core_gentable_resize_task_state *state = cookie;
+    indigo_core_gentable_t *gentable = find_gentable_by_id(state->table_id);
+
+    if (gentable == NULL || gentable->generation_id != state->generation_id) {
+        aim_free(state);
+        return IND_SOC_TASK_FINISHED;
+    }
+
+    do {
+        if (gentable->old_checksum_buckets == NULL) {
+            if (!start_pending_resize(gentable)) {
+                gentable->resize_task_running = false;
+                aim_free(state);
+                return IND_SOC_TASK_FINISHED;
+            }
+            continue;
+        }
+
+        migrate_checksum_bucket(gentable);
+    } while (!ind_soc_should_yield());
+
+    return IND_SOC_TASK_CONTINUE;
+}
+
 void
 ind_core_bsn_gentable_set_buckets_size_handler(
     of_object_t *obj,
@@ -409,9 +638,7 @@ ind_core_bsn_gentable_set_buckets_size_handler(
     indigo_core_gentable_t *gentable;
     uint32_t xid;
     uint32_t new_buckets_size;
-    uint32_t old_buckets_size;
-    struct ind_core_gentable_checksum_bucket *old_buckets;
-    int i;
+    indigo_error_t rv;
 
     of_bsn_gentable_set_buckets_size_xid_get(obj, &xid);
     of_bsn_gentable_set_buckets_size_table_id_get(obj, &table_id);
@@ -436,93 +663,166 @@ ind_core_bsn_gentable_set_buckets_size_handler(
         return;
     }
 
-    if (new_buckets_size == gentable->checksum_buckets_size) {
-        return;
-    }
-
-    old_buckets_size = gentable->checksum_buckets_size;
-    old_buckets = gentable->checksum_buckets;
+    if (gentable->old_checksum_buckets != NULL || gentable->pending_resizes != NULL) {
+        /* Only one resize at a time; the resize task applies this one next */
+        struct ind_core_gentable_pending_resize *pending = aim_zmalloc(sizeof(*pending));
+        struct ind_core_gentable_pending_resize **tail = &gentable->pending_resizes;
 
-    gentable->checksum_buckets_size = new_buckets_size;
-    gentable->checksum_buckets = aim_malloc(sizeof(*gentable->checksum_buckets) *
-                                            gentable->checksum_buckets_size);
+        AIM_LOG_VERBOSE("Deferring resize of gentable %s until the current one finishes",
+                        gentable->name);
 
-    gentable->checksum_buckets_shift =
-        calc_checksum_buckets_shift(gentable->checksum_buckets_size);
+        pending->cxn_id = cxn_id;
+        pending->buckets_size = new_buckets_size;
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+        *tail = pending;
+        indigo_cxn_pause(cxn_id);
+        return;
+    }
 
-    for (i = 0; i < gentable->checksum_buckets_size; i++) {
-        struct ind_core_gentable_checksum_bucket *bucket =
-            &gentable->checksum_buckets[i];
-        bucket->checksum.lo = 0;
-        bucket->checksum.hi = 0;
-        list_init(&bucket->entries);
+    if (new_buckets_size == gentable->checksum_buckets_size) {
+        return;
     }
 
-    for (i = 0; i < old_buckets_size; i++) {
-        list_links_t *cur, *next;
-        LIST_FOREACH_SAFE(&old_buckets[i].entries, cur, next) {
-            struct ind_core_gentable_entry *entry =
-                container_of(cur, checksum_links, struct ind_core_gentable_entry);
+    /*
+     * Hold off further messages from this connection until the migration
+     * is done, so it sees the resize as complete.
+     */
+    indigo_cxn_pause(cxn_id);
+    start_resize(gentable, new_buckets_size, cxn_id);
 
-            /* Remove from old bucket */
-            list_remove(&entry->checksum_links);
+    if (!gentable->resize_task_running) {
+        struct ind_core_gentable_resize_task_state *state = aim_zmalloc(sizeof(*state));
+        state->table_id = gentable->table_id;
+        state->generation_id = gentable->generation_id;
 
-            /* Insert into new bucket */
-            struct ind_core_gentable_checksum_bucket *new_bucket;
-            new_bucket = find_checksum_bucket(gentable, &entry->checksum);
-            list_push(&new_bucket->entries, &entry->checksum_links);
-            add_checksum(&new_bucket->checksum, &entry->checksum);
+        rv = ind_soc_task_register(ind_core_gentable_resize_task_callback,
+                                   state, IND_SOC_NORMAL_PRIORITY);
+        if (rv < 0) {
+            AIM_LOG_INTERNAL("Failed to spawn gentable resize task: %s", indigo_strerror(rv));
+            aim_free(state);
+            finish_resize(gentable);
+        } else {
+            gentable->resize_task_running = true;
         }
     }
-
-    aim_free(old_buckets);
 }
 
+/*
+ * Entry stats are collected in batches of up to ENTRY_STATS_BATCH_SIZE
+ * entries, flushed at the end of each iterator step. The stats lists are
+ * allocated once per request and truncated between uses, and the reply
+ * entries are written in place in the reply message.
+ */
 struct ind_core_gentable_entry_stats_state {
     indigo_cxn_id_t cxn_id;
     of_version_t version;
     uint32_t xid;
     of_object_t *reply;
+    int batch_count;
+    struct ind_core_gentable_entry *batch[ENTRY_STATS_BATCH_SIZE];
+    of_list_bsn_tlv_t *stats[ENTRY_STATS_BATCH_SIZE];
 };
 
 static void
-entry_stats_iter(void *cookie, indigo_core_gentable_t *gentable,
-                 struct ind_core_gentable_entry *entry)
+entry_stats_state_free(struct ind_core_gentable_entry_stats_state *state)
 {
-    struct ind_core_gentable_entry_stats_state *state = cookie;
+    int i;
 
-    if (entry != NULL) {
-        of_list_bsn_gentable_entry_stats_entry_t stats_entries;
-        of_bsn_gentable_entry_stats_entry_t *stats_entry;
-        of_list_bsn_tlv_t stats;
+    for (i = 0; i < ENTRY_STATS_BATCH_SIZE; i++) {
+        if (state->stats[i] != NULL) {
+            of_object_delete(state->stats[i]);
+        }
+    }
 
-        stats_entry = of_bsn_gentable_entry_stats_entry_new(OF_VERSION_1_3);
-        AIM_TRUE_OR_DIE(of_bsn_gentable_entry_stats_entry_key_set(stats_entry, entry->key) == 0);
-        of_bsn_gentable_entry_stats_entry_stats_bind(stats_entry, &stats);
+    aim_free(state);
+}
 
-        gentable->ops->get_stats(gentable->priv, entry->priv, entry->key, &stats);
+static void
+entry_stats_append(struct ind_core_gentable_entry_stats_state *state,
+                   of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *stats)
+{
+    of_list_bsn_gentable_entry_stats_entry_t stats_entries;
+    of_bsn_gentable_entry_stats_entry_t stats_entry;
 
-        of_bsn_gentable_entry_stats_reply_entries_bind(state->reply, &stats_entries);
-        if (of_list_append(&stats_entries, stats_entry) < 0) {
-            of_bsn_gentable_entry_stats_reply_flags_set(state->reply,
-                                                        OF_STATS_REPLY_FLAG_REPLY_MORE);
-            indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+    of_bsn_gentable_entry_stats_entry_init(&stats_entry, state->reply->version, -1, 1);
 
-            state->reply = of_bsn_gentable_entry_stats_reply_new(state->version);
+    /* Start a new reply if this entry would not fit */
+    if (state->reply->length + stats_entry.length + key->length + stats->length >
+            state->reply->wbuf->alloc_bytes) {
+        of_bsn_gentable_entry_stats_reply_flags_set(state->reply,
+                                                    OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
 
-            of_bsn_gentable_entry_stats_reply_xid_set(state->reply, state->xid);
+        state->reply = of_bsn_gentable_entry_stats_reply_new(state->version);
+        of_bsn_gentable_entry_stats_reply_xid_set(state->reply, state->xid);
+    }
 
-            of_bsn_gentable_entry_stats_reply_entries_bind(state->reply, &stats_entries);
-            if (of_list_append(&stats_entries, stats_entry) < 0) {
-                AIM_DIE("unexpected failure appending to an empty stats list");
-            }
+    of_bsn_gentable_entry_stats_reply_entries_bind(state->reply, &stats_entries);
+    if (of_list_bsn_gentable_entry_stats_entry_append_bind(&stats_entries, &stats_entry)) {
+        AIM_DIE("unexpected failure appending to gentable entry stats list");
+    }
+
+    AIM_TRUE_OR_DIE(of_bsn_gentable_entry_stats_entry_key_set(&stats_entry, key) == 0);
+    AIM_TRUE_OR_DIE(of_bsn_gentable_entry_stats_entry_stats_set(&stats_entry, stats) == 0);
+}
+
+static void
+entry_stats_flush(void *cookie, indigo_core_gentable_t *gentable)
+{
+    struct ind_core_gentable_entry_stats_state *state = cookie;
+    of_object_storage_t key_storage[ENTRY_STATS_BATCH_SIZE];
+    of_list_bsn_tlv_t *keys[ENTRY_STATS_BATCH_SIZE];
+    void *entry_privs[ENTRY_STATS_BATCH_SIZE];
+    int i;
+
+    if (state->batch_count == 0) {
+        return;
+    }
+
+    for (i = 0; i < state->batch_count; i++) {
+        struct ind_core_gentable_entry *entry = state->batch[i];
+        keys[i] = entry_key(entry, &key_storage[i]);
+        entry_privs[i] = entry->priv;
+        truncate_of_object(state->stats[i]);
+    }
+
+    if (gentable->ops->get_stats_bulk != NULL) {
+        gentable->ops->get_stats_bulk(gentable->priv, entry_privs, keys,
+                                      state->stats, state->batch_count);
+    } else {
+        for (i = 0; i < state->batch_count; i++) {
+            gentable->ops->get_stats(gentable->priv, entry_privs[i], keys[i],
+                                     state->stats[i]);
         }
+    }
 
-        of_object_delete(stats_entry);
+    for (i = 0; i < state->batch_count; i++) {
+        entry_stats_append(state, keys[i], state->stats[i]);
+    }
+
+    state->batch_count = 0;
+}
+
+static void
+entry_stats_iter(void *cookie, indigo_core_gentable_t *gentable,
+                 struct ind_core_gentable_entry *entry)
+{
+    struct ind_core_gentable_entry_stats_state *state = cookie;
+
+    if (entry != NULL) {
+        state->batch[state->batch_count++] = entry;
+        if (state->batch_count == ENTRY_STATS_BATCH_SIZE) {
+            entry_stats_flush(state, gentable);
+        }
     } else {
+        if (gentable != NULL) {
+            entry_stats_flush(state, gentable);
+        }
         indigo_cxn_send_controller_message(state->cxn_id, state->reply);
         indigo_cxn_resume(state->cxn_id);
-        aim_free(state);
+        entry_stats_state_free(state);
     }
 }
 
@@ -538,6 +838,7 @@ ind_core_bsn_gentable_entry_stats_request_handler(
     struct ind_core_gentable_entry_stats_state *state;
     indigo_error_t rv;
     of_checksum_128_t checksum, checksum_mask;
+    int i;
 
     of_bsn_gentable_entry_stats_request_xid_get(obj, &xid);
     of_bsn_gentable_entry_stats_request_table_id_get(obj, &table_id);
@@ -562,16 +863,21 @@ ind_core_bsn_gentable_entry_stats_request_handler(
     state->version = obj->version;
     state->xid = xid;
     state->reply = reply;
+    for (i = 0; i < ENTRY_STATS_BATCH_SIZE; i++) {
+        state->stats[i] = of_list_bsn_tlv_new(OF_VERSION_1_3);
+        AIM_TRUE_OR_DIE(state->stats[i] != NULL);
+    }
     indigo_cxn_pause(cxn_id);
 
-    rv = ind_core_gentable_spawn_iter_task(gentable, entry_stats_iter, state,
+    rv = ind_core_gentable_spawn_iter_task(gentable, entry_stats_iter,
+                                           entry_stats_flush, state,
                                            IND_SOC_NORMAL_PRIORITY,
                                            checksum, checksum_mask);
     if (rv < 0) {
         AIM_LOG_INTERNAL("Failed to spawn gentable entry stats iter task: %s", indigo_strerror(rv));
         indigo_cxn_resume(cxn_id);
         of_object_delete(state->reply);
-        aim_free(state);
+        entry_stats_state_free(state);
     }
 }
 
@@ -591,11 +897,14 @@ entry_desc_stats_iter(void *cookie, indigo_core_gentable_t *gentable,
     if (entry != NULL) {
         of_list_bsn_gentable_entry_desc_stats_entry_t stats_entries;
         of_bsn_gentable_entry_desc_stats_entry_t *stats_entry;
+        of_object_storage_t key_storage, value_storage;
 
         stats_entry = of_bsn_gentable_entry_desc_stats_entry_new(OF_VERSION_1_3);
         of_bsn_gentable_entry_desc_stats_entry_checksum_set(stats_entry, entry->checksum);
-        AIM_TRUE_OR_DIE(of_bsn_gentable_entry_desc_stats_entry_key_set(stats_entry, entry->key) == 0);
-        AIM_TRUE_OR_DIE(of_bsn_gentable_entry_desc_stats_entry_value_set(stats_entry, entry->value) == 0);
+        AIM_TRUE_OR_DIE(of_bsn_gentable_entry_desc_stats_entry_key_set(
+            stats_entry, entry_key(entry, &key_storage)) == 0);
+        AIM_TRUE_OR_DIE(of_bsn_gentable_entry_desc_stats_entry_value_set(
+            stats_entry, entry_value(entry, &value_storage)) == 0);
 
         of_bsn_gentable_entry_desc_stats_reply_entries_bind(state->reply, &stats_entries);
         if (of_list_append(&stats_entries, stats_entry) < 0) {
@@ -659,7 +968,7 @@ ind_core_bsn_gentable_entry_desc_stats_request_handler(
     state->reply = reply;
     indigo_cxn_pause(cxn_id);
 
-    rv = ind_core_gentable_spawn_iter_task(gentable, entry_desc_stats_iter, state,
+    rv = ind_core_gentable_spawn_iter_task(gentable, entry_desc_stats_iter, NULL, state,
                                            IND_SOC_NORMAL_PRIORITY,
                                            checksum, checksum_mask);
     if (rv < 0) {
@@ -761,6 +1070,7 @@ ind_core_bsn_gentable_bucket_stats_request_handler(
     of_bsn_gentable_bucket_stats_reply_t *reply;
     int i;
     of_list_bsn_gentable_bucket_stats_entry_t stats_entries;
+    of_checksum_128_t *checksums = NULL;
 
     of_bsn_gentable_bucket_stats_request_xid_get(obj, &xid);
     of_bsn_gentable_bucket_stats_request_table_id_get(obj, &table_id);
@@ -780,6 +1090,20 @@ ind_core_bsn_gentable_bucket_stats_request_handler(
         return;
     }
 
+    if (gentable->old_checksum_buckets != NULL) {
+        /*
+         * The new buckets don't hold the entries that have not been
+         * migrated yet. Fold them in rather than waiting for the resize.
+         */
+        checksums = aim_malloc(sizeof(*checksums) * gentable->checksum_buckets_size);
+        for (i = 0; i < gentable->checksum_buckets_size; i++) {
+            checksums[i] = gentable->checksum_buckets[i].checksum;
+        }
+        add_unmigrated_checksums(gentable,
+                                 aim_log2_u32(gentable->checksum_buckets_size),
+                                 0, gentable->checksum_buckets_size, checksums);
+    }
+
     for (i = 0; i < gentable->checksum_buckets_size; i++) {
         struct ind_core_gentable_checksum_bucket *bucket =
             &gentable->checksum_buckets[i];
@@ -799,9 +1123,12 @@ ind_core_bsn_gentable_bucket_stats_request_handler(
             }
         }
 
-        of_bsn_gentable_bucket_stats_entry_checksum_set(&stats_entry, bucket->checksum);
+        of_bsn_gentable_bucket_stats_entry_checksum_set(
+            &stats_entry, checksums != NULL ? &checksums[i] : &bucket->checksum);
     }
 
+    aim_free(checksums);
+
     indigo_cxn_send_controller_message(cxn_id, reply);
 }
 
@@ -855,65 +1182,354 @@ calc_checksum_buckets_shift(uint32_t checksum_buckets_size)
     return 64 - i + 1;
 }
 
+static struct ind_core_gentable_checksum_bucket *
+alloc_checksum_buckets(uint32_t checksum_buckets_size)
+{
+    struct ind_core_gentable_checksum_bucket *buckets;
+    int i;
+
+    buckets = aim_malloc(sizeof(*buckets) * checksum_buckets_size);
+
+    for (i = 0; i < checksum_buckets_size; i++) {
+        struct ind_core_gentable_checksum_bucket *bucket = &buckets[i];
+        bucket->checksum.lo = 0;
+        bucket->checksum.hi = 0;
+        list_init(&bucket->entries);
+    }
+
+    return buckets;
+}
+
+/*
+ * Find the bucket an entry with the given checksum belongs in
+ *
+ * During a resize this is the old bucket if it has not been migrated yet.
+ */
 static struct ind_core_gentable_checksum_bucket *
 find_checksum_bucket(indigo_core_gentable_t *gentable, of_checksum_128_t *checksum)
 {
-    uint32_t idx = checksum->hi >> gentable->checksum_buckets_shift;
+    uint32_t idx;
+
+    if (gentable->old_checksum_buckets != NULL) {
+        idx = checksum->hi >> gentable->old_checksum_buckets_shift;
+        if (idx >= gentable->migrate_idx) {
+            return &gentable->old_checksum_buckets[idx];
+        }
+    }
+
+    idx = checksum->hi >> gentable->checksum_buckets_shift;
     return &gentable->checksum_buckets[idx];
 }
 
+/*
+ * Checksum tree
+ *
+ * The checksum tree lets a controller find differing buckets by
+ * descending from the root instead of fetching every bucket checksum.
+ * Node 1 is the root and the children of node n are 2n and 2n+1. The
+ * leaves are the buckets themselves (node checksum_buckets_size + i is
+ * bucket i), so the array only holds the interior nodes and index 0 is
+ * unused.
+ *
+ * Only buckets in the current array are covered. During a resize readers
+ * add in the entries not migrated yet with add_unmigrated_checksums.
+ */
 static void
-add_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src)
+update_checksum_tree(indigo_core_gentable_t *gentable, uint32_t idx,
+                     const of_checksum_128_t *checksum, bool add)
 {
-    dst->lo += src->lo;
-    dst->hi += src->hi + (dst->lo < src->lo);
+    uint32_t node;
+
+    for (node = (idx + gentable->checksum_buckets_size) / 2; node >= 1; node /= 2) {
+        if (add) {
+            add_checksum(&gentable->checksum_tree[node], checksum);
+        } else {
+            subtract_checksum(&gentable->checksum_tree[node], checksum);
+        }
+    }
 }
 
+/*
+ * Update the occupancy bitmap and checksum tree after adding or removing
+ * an entry from a bucket
+ */
 static void
-subtract_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src)
+update_bucket_summary(indigo_core_gentable_t *gentable,
+                      struct ind_core_gentable_checksum_bucket *bucket,
+                      const of_checksum_128_t *checksum, bool add)
 {
-    uint64_t prev_lo = dst->lo;
-    dst->lo -= src->lo;
-    dst->hi -= src->hi + (dst->lo > prev_lo);
+    occupancy_bitmap_t *occupancy;
+    uint32_t idx;
+
+    if (bucket >= gentable->checksum_buckets &&
+            bucket < gentable->checksum_buckets + gentable->checksum_buckets_size) {
+        occupancy = &gentable->checksum_buckets_occupancy;
+        idx = bucket - gentable->checksum_buckets;
+        update_checksum_tree(gentable, idx, checksum, add);
+    } else {
+        AIM_ASSERT(gentable->old_checksum_buckets != NULL);
+        occupancy = &gentable->old_checksum_buckets_occupancy;
+        idx = bucket - gentable->old_checksum_buckets;
+    }
+
+    if (list_empty(&bucket->entries)) {
+        occupancy_bitmap_clear(occupancy, idx);
+    } else {
+        occupancy_bitmap_set(occupancy, idx);
+    }
 }
 
-static uint32_t
-hash_key(of_list_bsn_tlv_t *key)
+static void
+bucket_insert(indigo_core_gentable_t *gentable,
+              struct ind_core_gentable_checksum_bucket *bucket,
+              struct ind_core_gentable_entry *entry)
 {
-    return murmur_hash(OF_OBJECT_BUFFER_INDEX(key, 0), key->length, 0);
+    list_push(&bucket->entries, &entry->checksum_links);
+    add_checksum(&bucket->checksum, &entry->checksum);
+    update_bucket_summary(gentable, bucket, &entry->checksum, true);
 }
 
-static indigo_error_t
-delete_entry(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable,
-             struct ind_core_gentable_entry *entry)
+static void
+bucket_remove(indigo_core_gentable_t *gentable,
+              struct ind_core_gentable_checksum_bucket *bucket,
+              struct ind_core_gentable_entry *entry)
 {
-    indigo_error_t rv;
-    struct ind_core_gentable_checksum_bucket *checksum_bucket;
+    list_remove(&entry->checksum_links);
+    subtract_checksum(&bucket->checksum, &entry->checksum);
+    update_bucket_summary(gentable, bucket, &entry->checksum, false);
+}
 
-    if (entry->refcount > 0) {
-        return INDIGO_ERROR_EXISTS;
-    }
+/*
+ * Move the entries of the next old bucket into the new bucket array
+ */
+static void
+migrate_checksum_bucket(indigo_core_gentable_t *gentable)
+{
+    struct ind_core_gentable_checksum_bucket *old_bucket =
+        &gentable->old_checksum_buckets[gentable->migrate_idx];
+    list_links_t *cur, *next;
 
-    if (gentable->ops->del2 != NULL) {
-        rv = gentable->ops->del2(cxn_id, gentable->priv, entry->priv, entry->key);
-    } else {
-        rv = gentable->ops->del(gentable->priv, entry->priv, entry->key);
+    occupancy_bitmap_clear(&gentable->old_checksum_buckets_occupancy,
+                           gentable->migrate_idx);
+    gentable->migrate_idx++;
+
+    LIST_FOREACH_SAFE(&old_bucket->entries, cur, next) {
+        struct ind_core_gentable_entry *entry =
+            container_of(cur, checksum_links, struct ind_core_gentable_entry);
+
+        /* The old bucket is discarded, so its checksum isn't updated */
+        list_remove(&entry->checksum_links);
+
+        bucket_insert(gentable, find_checksum_bucket(gentable, &entry->checksum),
+                      entry);
+    }
+
+    if (gentable->migrate_idx == gentable->old_checksum_buckets_size) {
+        aim_free(gentable->old_checksum_buckets);
+        gentable->old_checksum_buckets = NULL;
+        occupancy_bitmap_cleanup(&gentable->old_checksum_buckets_occupancy);
+        indigo_cxn_resume(gentable->resize_cxn_id);
+    }
+}
+
+static void
+finish_resize(indigo_core_gentable_t *gentable)
+{
+    while (gentable->old_checksum_buckets != NULL) {
+        migrate_checksum_bucket(gentable);
+    }
+}
+
+/* Top bits of the checksum, which select the node at that tree level */
+static uint32_t
+checksum_prefix(const of_checksum_128_t *checksum, uint32_t bits)
+{
+    return bits == 0 ? 0 : checksum->hi >> (64 - bits);
+}
+
+/*
+ * Add the entries still in old buckets to checksum tree nodes
+ *
+ * checksums holds count nodes of the new tree starting at the given index
+ * on the given level (the leaves are at level log2(checksum_buckets_size)).
+ * Old buckets are covered by the tree in whole when they are no finer than
+ * the requested level; otherwise their entries are walked individually.
+ */
+static void
+add_unmigrated_checksums(indigo_core_gentable_t *gentable, uint32_t level,
+                         uint32_t index, uint32_t count,
+                         of_checksum_128_t *checksums)
+{
+    uint32_t old_bits, first, last, j;
+
+    if (gentable->old_checksum_buckets == NULL || count == 0) {
+        return;
+    }
+
+    old_bits = aim_log2_u32(gentable->old_checksum_buckets_size);
+
+    if (old_bits > level) {
+        /* Each node covers several old buckets */
+        uint32_t shift = old_bits - level;
+        uint32_t k;
+
+        for (k = 0; k < count; k++) {
+            first = (index + k) << shift;
+            last = (index + k + 1) << shift;
+            for (j = first > gentable->migrate_idx ? first : gentable->migrate_idx;
+                 j < last; j++) {
+                add_checksum(&checksums[k], &gentable->old_checksum_buckets[j].checksum);
+            }
+        }
+    } else {
+        /* Each old bucket falls within one node or is split between several */
+        uint32_t shift = level - old_bits;
+
+        first = index >> shift;
+        last = (index + count - 1) >> shift;
+        for (j = first > gentable->migrate_idx ? first : gentable->migrate_idx;
+             j <= last; j++) {
+            struct ind_core_gentable_checksum_bucket *bucket =
+                &gentable->old_checksum_buckets[j];
+            list_links_t *cur;
+
+            if (shift == 0) {
+                add_checksum(&checksums[j - index], &bucket->checksum);
+                continue;
+            }
+
+            LIST_FOREACH(&bucket->entries, cur) {
+                struct ind_core_gentable_entry *entry =
+                    container_of(cur, checksum_links, struct ind_core_gentable_entry);
+                uint32_t node = checksum_prefix(&entry->checksum, level);
+                if (node >= index && node - index < count) {
+                    add_checksum(&checksums[node - index], &entry->checksum);
+                }
+            }
+        }
+    }
+}
+
+static void
+add_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src)
+{
+    dst->lo += src->lo;
+    dst->hi += src->hi + (dst->lo < src->lo);
+}
+
+static void
+subtract_checksum(of_checksum_128_t *dst, const of_checksum_128_t *src)
+{
+    uint64_t prev_lo = dst->lo;
+    dst->lo -= src->lo;
+    dst->hi -= src->hi + (dst->lo > prev_lo);
+}
+
+static uint32_t
+hash_key(of_list_bsn_tlv_t *key)
+{
+    return murmur_hash(OF_OBJECT_BUFFER_INDEX(key, 0), key->length, 0);
+}
+
+/*
+ * Delete every entry with a single call to the clear op
+ *
+ * The entries are then freed without calling del. Fails without changing
+ * the table if any entry is referenced or the clear op fails, in which
+ * case the caller falls back to deleting entries one at a time.
+ */
+static indigo_error_t
+clear_all_entries(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable)
+{
+    indigo_error_t rv;
+    bighash_iter_t iter;
+    bighash_entry_t *hash_entry;
+    uint32_t idx;
+
+    for (hash_entry = bighash_iter_start(gentable->key_hashtable, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct ind_core_gentable_entry *entry =
+            container_of(hash_entry, key_hash_entry, struct ind_core_gentable_entry);
+        if (entry->refcount > 0) {
+            return INDIGO_ERROR_EXISTS;
+        }
+    }
+
+    rv = gentable->ops->clear(cxn_id, gentable->priv);
+    if (rv < 0) {
+        AIM_LOG_VERBOSE("Failed to clear gentable %s, deleting entries individually: %s",
+                        gentable->name, indigo_strerror(rv));
+        return rv;
+    }
+
+    for (hash_entry = bighash_iter_start(gentable->key_hashtable, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct ind_core_gentable_entry *entry =
+            container_of(hash_entry, key_hash_entry, struct ind_core_gentable_entry);
+        bighash_remove(gentable->key_hashtable, &entry->key_hash_entry);
+        free_entry(gentable, entry);
+    }
+
+    if (gentable->old_checksum_buckets != NULL) {
+        /* Nothing left to migrate; the resize task notices and exits */
+        aim_free(gentable->old_checksum_buckets);
+        gentable->old_checksum_buckets = NULL;
+        occupancy_bitmap_cleanup(&gentable->old_checksum_buckets_occupancy);
+        indigo_cxn_resume(gentable->resize_cxn_id);
+    }
+
+    /* Only occupied buckets need resetting */
+    for (idx = occupancy_bitmap_next(&gentable->checksum_buckets_occupancy, 0);
+         idx < gentable->checksum_buckets_size;
+         idx = occupancy_bitmap_next(&gentable->checksum_buckets_occupancy, idx + 1)) {
+        struct ind_core_gentable_checksum_bucket *bucket = &gentable->checksum_buckets[idx];
+        bucket->checksum.hi = 0;
+        bucket->checksum.lo = 0;
+        list_init(&bucket->entries);
+        occupancy_bitmap_clear(&gentable->checksum_buckets_occupancy, idx);
+    }
+
+    memset(gentable->checksum_tree, 0,
+           sizeof(of_checksum_128_t) * gentable->checksum_buckets_size);
+
+    gentable->checksum.hi = 0;
+    gentable->checksum.lo = 0;
+    gentable->num_entries = 0;
+
+    return INDIGO_ERROR_NONE;
+}
+
+static indigo_error_t
+delete_entry(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable,
+             struct ind_core_gentable_entry *entry)
+{
+    indigo_error_t rv;
+    struct ind_core_gentable_checksum_bucket *checksum_bucket;
+    of_object_storage_t key_storage;
+    of_list_bsn_tlv_t *key;
+
+    if (entry->refcount > 0) {
+        return INDIGO_ERROR_EXISTS;
+    }
+
+    key = entry_key(entry, &key_storage);
+
+    if (gentable->ops->del2 != NULL) {
+        rv = gentable->ops->del2(cxn_id, gentable->priv, entry->priv, key);
+    } else {
+        rv = gentable->ops->del(gentable->priv, entry->priv, key);
     }
     if (rv < 0) {
         return rv;
     }
 
     bighash_remove(gentable->key_hashtable, &entry->key_hash_entry);
-    list_remove(&entry->checksum_links);
 
     checksum_bucket = find_checksum_bucket(gentable, &entry->checksum);
-
-    subtract_checksum(&checksum_bucket->checksum, &entry->checksum);
+    bucket_remove(gentable, checksum_bucket, entry);
     subtract_checksum(&gentable->checksum, &entry->checksum);
 
-    of_object_delete(entry->key);
-    of_object_delete(entry->value);
-    aim_free(entry);
+    free_entry(gentable, entry);
 
     gentable->num_entries--;
 
@@ -922,14 +1538,21 @@ delete_entry(indigo_cxn_id_t cxn_id, indigo_core_gentable_t *gentable,
 
 static struct ind_core_gentable_entry *
 find_entry_by_key(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key)
+{
+    return find_entry_by_key_hash(gentable, key, hash_key(key));
+}
+
+static struct ind_core_gentable_entry *
+find_entry_by_key_hash(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key,
+                       uint32_t hash)
 {
     bighash_entry_t *hash_entry;
 
-    for (hash_entry = bighash_first(gentable->key_hashtable, hash_key(key));
+    for (hash_entry = bighash_first(gentable->key_hashtable, hash);
          hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
         struct ind_core_gentable_entry *entry =
             container_of(hash_entry, key_hash_entry, struct ind_core_gentable_entry);
-        if (key_equality(key, entry->key)) {
+        if (key_equality(key, entry)) {
             return entry;
         }
     }
@@ -938,14 +1561,264 @@ find_entry_by_key(indigo_core_gentable_t *gentable, of_list_bsn_tlv_t *key)
 }
 
 static bool
-key_equality(of_list_bsn_tlv_t *a, of_list_bsn_tlv_t *b)
+key_equality(of_list_bsn_tlv_t *key, struct ind_core_gentable_entry *entry)
 {
-    if (a->length != b->length) {
+    if (key->length != entry->key_len) {
         return false;
     }
 
-    return memcmp(OF_OBJECT_BUFFER_INDEX(a, 0),
-                  OF_OBJECT_BUFFER_INDEX(b, 0), a->length) == 0;
+    return memcmp(OF_OBJECT_BUFFER_INDEX(key, 0), entry->data, key->length) == 0;
+}
+
+static uint32_t
+entry_alloc_size(uint16_t key_len, uint16_t value_inline_len)
+{
+    return sizeof(struct ind_core_gentable_entry) + key_len + value_inline_len;
+}
+
+static bool
+entry_value_is_inline(struct ind_core_gentable_entry *entry)
+{
+    return entry->value_data == entry->data + entry->key_len;
+}
+
+static struct ind_core_gentable_entry *
+alloc_entry(indigo_core_gentable_t *gentable,
+            of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value)
+{
+    struct ind_core_gentable_entry *entry;
+    uint32_t size;
+
+    AIM_TRUE_OR_DIE(key->length <= UINT16_MAX && value->length <= UINT16_MAX);
+
+    size = entry_alloc_size(key->length, value->length);
+    entry = aim_zmalloc(size);
+    entry->version = key->version;
+    entry->key_len = key->length;
+    entry->value_inline_len = value->length;
+    entry->value_len = value->length;
+    entry->value_data = entry->data + entry->key_len;
+    memcpy(entry->data, OF_OBJECT_BUFFER_INDEX(key, 0), key->length);
+    memcpy(entry->value_data, OF_OBJECT_BUFFER_INDEX(value, 0), value->length);
+
+    gentable->entry_bytes += size;
+
+    return entry;
+}
+
+static void
+free_entry(indigo_core_gentable_t *gentable, struct ind_core_gentable_entry *entry)
+{
+    index_remove_entry(gentable, entry);
+
+    if (!entry_value_is_inline(entry)) {
+        gentable->entry_bytes -= entry->value_len;
+        aim_free(entry->value_data);
+    }
+
+    gentable->entry_bytes -= entry_alloc_size(entry->key_len, entry->value_inline_len);
+    aim_free(entry);
+}
+
+/*
+ * Replace the value of an existing entry
+ *
+ * Uses the inline space if the new value fits, otherwise a separate
+ * allocation sized exactly for the value.
+ */
+static void
+set_entry_value(indigo_core_gentable_t *gentable,
+                struct ind_core_gentable_entry *entry,
+                of_list_bsn_tlv_t *value)
+{
+    AIM_TRUE_OR_DIE(value->length <= UINT16_MAX);
+
+    if (!entry_value_is_inline(entry)) {
+        gentable->entry_bytes -= entry->value_len;
+        aim_free(entry->value_data);
+        entry->value_data = entry->data + entry->key_len;
+    }
+
+    if (value->length > entry->value_inline_len) {
+        entry->value_data = aim_malloc(value->length);
+        gentable->entry_bytes += value->length;
+    }
+
+    entry->value_len = value->length;
+    memcpy(entry->value_data, OF_OBJECT_BUFFER_INDEX(value, 0), value->length);
+}
+
+/*
+ * Bind a TLV list object onto bytes owned by the gentable
+ *
+ * The returned object is only valid while the storage is in scope and the
+ * underlying entry is unchanged. It must not be passed to of_object_delete.
+ */
+static of_list_bsn_tlv_t *
+bind_tlv_list(of_object_storage_t *storage, of_version_t version,
+              uint8_t *data, uint16_t len)
+{
+    of_object_t *obj = &storage->obj;
+    of_wire_buffer_t *wbuf = &storage->wbuf;
+
+    memset(wbuf, 0, sizeof(*wbuf));
+    wbuf->buf = data;
+    wbuf->alloc_bytes = len;
+    wbuf->current_bytes = len;
+
+    of_list_bsn_tlv_init(obj, version, len, 1);
+    obj->wbuf = wbuf;
+    obj->obj_offset = 0;
+    obj->length = len;
+
+    return obj;
+}
+
+static of_list_bsn_tlv_t *
+entry_key(struct ind_core_gentable_entry *entry, of_object_storage_t *storage)
+{
+    return bind_tlv_list(storage, entry->version, entry->data, entry->key_len);
+}
+
+static of_list_bsn_tlv_t *
+entry_value(struct ind_core_gentable_entry *entry, of_object_storage_t *storage)
+{
+    return bind_tlv_list(storage, entry->version, entry->value_data, entry->value_len);
+}
+
+/*
+ * Returns true if an entry_add message would leave the entry as it is
+ */
+static bool
+entry_unchanged(struct ind_core_gentable_entry *entry, of_object_t *obj,
+                of_list_bsn_tlv_t *value)
+{
+    of_checksum_128_t checksum;
+    of_bsn_gentable_entry_add_checksum_get(obj, &checksum);
+
+    return checksum.hi == entry->checksum.hi &&
+        checksum.lo == entry->checksum.lo &&
+        value->version == entry->version &&
+        value->length == entry->value_len &&
+        !memcmp(OF_OBJECT_BUFFER_INDEX(value, 0), entry->value_data, entry->value_len);
+}
+
+
+/* Secondary indexes */
+
+static uint32_t
+hash_index_key(uint64_t index_key)
+{
+    return murmur_hash(&index_key, sizeof(index_key), 0);
+}
+
+/*
+ * Run the extract function of one index and link the node if the entry
+ * belongs in the index
+ */
+static void
+index_link(indigo_core_gentable_t *gentable, int index_id,
+           struct ind_core_gentable_index_node *node,
+           of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value)
+{
+    struct ind_core_gentable_index *index = &gentable->indexes[index_id];
+
+    node->present = index->extract(key, value, &node->index_key);
+    if (node->present) {
+        bighash_insert(index->hashtable, &node->hash_entry,
+                       hash_index_key(node->index_key));
+    }
+}
+
+static void
+index_unlink(indigo_core_gentable_t *gentable, int index_id,
+             struct ind_core_gentable_index_node *node)
+{
+    if (node->present) {
+        bighash_remove(gentable->indexes[index_id].hashtable, &node->hash_entry);
+        node->present = false;
+    }
+}
+
+static void
+index_insert_entry(indigo_core_gentable_t *gentable,
+                   struct ind_core_gentable_entry *entry)
+{
+    of_object_storage_t key_storage, value_storage;
+    of_list_bsn_tlv_t *key, *value;
+    int i;
+
+    if (gentable->num_indexes == 0) {
+        return;
+    }
+
+    entry->index_nodes =
+        aim_zmalloc(sizeof(*entry->index_nodes) * gentable->num_indexes);
+    gentable->entry_bytes += sizeof(*entry->index_nodes) * gentable->num_indexes;
+
+    key = entry_key(entry, &key_storage);
+    value = entry_value(entry, &value_storage);
+
+    for (i = 0; i < gentable->num_indexes; i++) {
+        entry->index_nodes[i].entry = entry;
+        index_link(gentable, i, &entry->index_nodes[i], key, value);
+    }
+}
+
+static void
+index_remove_entry(indigo_core_gentable_t *gentable,
+                   struct ind_core_gentable_entry *entry)
+{
+    int i;
+
+    if (entry->index_nodes == NULL) {
+        return;
+    }
+
+    for (i = 0; i < gentable->num_indexes; i++) {
+        index_unlink(gentable, i, &entry->index_nodes[i]);
+    }
+
+    aim_free(entry->index_nodes);
+    entry->index_nodes = NULL;
+    gentable->entry_bytes -= sizeof(*entry->index_nodes) * gentable->num_indexes;
+}
+
+/*
+ * Reindex an entry after its value changed
+ */
+static void
+index_update_entry(indigo_core_gentable_t *gentable,
+                   struct ind_core_gentable_entry *entry)
+{
+    of_object_storage_t key_storage, value_storage;
+    of_list_bsn_tlv_t *key, *value;
+    int i;
+
+    if (entry->index_nodes == NULL) {
+        return;
+    }
+
+    key = entry_key(entry, &key_storage);
+    value = entry_value(entry, &value_storage);
+
+    for (i = 0; i < gentable->num_indexes; i++) {
+        struct ind_core_gentable_index_node *node = &entry->index_nodes[i];
+        uint64_t index_key;
+        bool present = gentable->indexes[i].extract(key, value, &index_key);
+
+        if (present == node->present && (!present || index_key == node->index_key)) {
+            continue;
+        }
+
+        index_unlink(gentable, i, node);
+        if (present) {
+            node->present = true;
+            node->index_key = index_key;
+            bighash_insert(gentable->indexes[i].hashtable, &node->hash_entry,
+                           hash_index_key(index_key));
+        }
+    }
 }
 
 
@@ -962,6 +1835,7 @@ key_equality(of_list_bsn_tlv_t *a, of_list_bsn_tlv_t *b)
 
 struct ind_core_gentable_iter_task_state {
     ind_core_gentable_iter_task_callback_f callback;
+    ind_core_gentable_iter_task_flush_f flush;
     void *cookie;
     uint16_t table_id;
     uint64_t generation_id;
@@ -970,6 +1844,110 @@ struct ind_core_gentable_iter_task_state {
     of_checksum_128_t checksum_mask;
 };
 
+/* Mask of the low 'shift' bits */
+static uint64_t
+low_bits_mask(uint8_t shift)
+{
+    return shift >= 64 ? UINT64_MAX : ((uint64_t)1 << shift) - 1;
+}
+
+/*
+ * Visit entries in one bucket array from next_checksum up to range_last
+ */
+static void
+iter_checksum_buckets(struct ind_core_gentable_iter_task_state *state,
+                      indigo_core_gentable_t *gentable,
+                      struct ind_core_gentable_checksum_bucket *buckets,
+                      const occupancy_bitmap_t *occupancy,
+                      uint8_t buckets_shift, uint64_t range_last)
+{
+    uint64_t idx = buckets_shift >= 64 ? 0 : state->next_checksum.hi >> buckets_shift;
+    uint64_t last_idx = buckets_shift >= 64 ? 0 : range_last >> buckets_shift;
+
+    for (idx = occupancy_bitmap_next(occupancy, idx);
+         idx <= last_idx && idx < occupancy->size;
+         idx = occupancy_bitmap_next(occupancy, idx + 1)) {
+        list_links_t *cur, *next;
+        LIST_FOREACH_SAFE(&buckets[idx].entries, cur, next) {
+            struct ind_core_gentable_entry *entry =
+                container_of(cur, checksum_links, struct ind_core_gentable_entry);
+
+            if (entry->checksum.hi < state->next_checksum.hi) {
+                /* Buckets were shrunk */
+                continue;
+            }
+
+            if ((entry->checksum.hi & state->checksum_mask.hi) != state->checksum_prefix.hi) {
+                continue;
+            }
+
+            if ((entry->checksum.lo & state->checksum_mask.lo) != state->checksum_prefix.lo) {
+                continue;
+            }
+
+            state->callback(state->cookie, gentable, entry);
+        }
+    }
+}
+
+/*
+ * Find the lowest checksum (upper 64 bits) at or after 'from' that may be
+ * in an occupied bucket of one bucket array
+ *
+ * Returns false if there are no occupied buckets past 'from'.
+ */
+static bool
+next_occupied_checksum(const occupancy_bitmap_t *occupancy, uint8_t buckets_shift,
+                       uint64_t from, uint64_t *result)
+{
+    uint64_t idx = buckets_shift >= 64 ? 0 : from >> buckets_shift;
+    uint64_t next_idx = occupancy_bitmap_next(occupancy, idx);
+
+    if (next_idx >= occupancy->size) {
+        return false;
+    }
+
+    *result = next_idx == idx ? from : next_idx << buckets_shift;
+    return true;
+}
+
+/*
+ * Skip next_checksum past empty buckets in both bucket arrays
+ *
+ * Returns false if there are no occupied buckets left.
+ */
+static bool
+skip_empty_checksum_buckets(struct ind_core_gentable_iter_task_state *state,
+                            indigo_core_gentable_t *gentable)
+{
+    uint64_t from = state->next_checksum.hi;
+    uint64_t candidate, lowest = UINT64_MAX;
+    bool found = false;
+
+    if (next_occupied_checksum(&gentable->checksum_buckets_occupancy,
+                               gentable->checksum_buckets_shift,
+                               from, &candidate)) {
+        lowest = candidate;
+        found = true;
+    }
+
+    if (gentable->old_checksum_buckets != NULL &&
+            next_occupied_checksum(&gentable->old_checksum_buckets_occupancy,
+                                   gentable->old_checksum_buckets_shift,
+                                   from, &candidate)) {
+        if (!found || candidate < lowest) {
+            lowest = candidate;
+        }
+        found = true;
+    }
+
+    if (found) {
+        state->next_checksum.hi = lowest;
+    }
+
+    return found;
+}
+
 static ind_soc_task_status_t
 ind_core_gentable_iter_task_callback(void *cookie)
 {
@@ -992,52 +1970,57 @@ ind_core_gentable_iter_task_callback(void *cookie)
      * checksum in the next bucket. If the buckets were shrunk then this may be
      * somewhere in the middle of the checksum range of a bucket, in which case
      * we'll ignore the entries we've already seen.
+     *
+     * While a resize is in progress entries may be in either bucket array.
+     * Each step covers the checksum range of one bucket of the coarser array
+     * and visits the matching buckets of both arrays.
+     *
+     * The occupancy bitmaps let each step start at the next non-empty bucket,
+     * so a sparse table with many buckets costs time proportional to the
+     * number of occupied buckets rather than the size of the array.
      */
 
-    do {
-        struct ind_core_gentable_checksum_bucket *bucket =
-            find_checksum_bucket(gentable, &state->next_checksum);
+    /* End of the requested checksum range, 0 if it runs to the end */
+    uint64_t end_checksum_hi =
+        state->checksum_prefix.hi + (~state->checksum_mask.hi + 1);
 
-        list_links_t *cur, *next;
-        LIST_FOREACH_SAFE(&bucket->entries, cur, next) {
-            struct ind_core_gentable_entry *entry =
-                container_of(cur, checksum_links, struct ind_core_gentable_entry);
+    do {
+        if (!skip_empty_checksum_buckets(state, gentable) ||
+                (end_checksum_hi != 0 && state->next_checksum.hi >= end_checksum_hi)) {
+            /* Finished */
+            state->callback(state->cookie, gentable, NULL);
+            aim_free(state);
+            return IND_SOC_TASK_FINISHED;
+        }
 
-            if (entry->checksum.hi < state->next_checksum.hi) {
-                /* Buckets were shrunk */
-                continue;
-            }
+        uint8_t range_shift = gentable->checksum_buckets_shift;
+        if (gentable->old_checksum_buckets != NULL &&
+                gentable->old_checksum_buckets_shift > range_shift) {
+            range_shift = gentable->old_checksum_buckets_shift;
+        }
 
-            if ((entry->checksum.hi & state->checksum_mask.hi) != state->checksum_prefix.hi) {
-                continue;
-            }
+        /* Last checksum (upper 64 bits) in this step's range */
+        uint64_t range_last = state->next_checksum.hi | low_bits_mask(range_shift);
 
-            if ((entry->checksum.lo & state->checksum_mask.lo) != state->checksum_prefix.lo) {
-                continue;
-            }
+        iter_checksum_buckets(state, gentable, gentable->checksum_buckets,
+                              &gentable->checksum_buckets_occupancy,
+                              gentable->checksum_buckets_shift, range_last);
 
-            state->callback(state->cookie, gentable, entry);
+        if (gentable->old_checksum_buckets != NULL) {
+            iter_checksum_buckets(state, gentable, gentable->old_checksum_buckets,
+                                  &gentable->old_checksum_buckets_occupancy,
+                                  gentable->old_checksum_buckets_shift, range_last);
         }
 
-        const uint64_t bucket_interval = (uint64_t)1 << gentable->checksum_buckets_shift;
-        const uint64_t bucket_mask = ~(uint64_t)0 << gentable->checksum_buckets_shift;
-
-        /* Advance to next bucket */
-        state->next_checksum.hi += bucket_interval;
-
-        /* Reset to the lowest checksum in the bucket */
-        state->next_checksum.hi &= bucket_mask;
+        if (state->flush != NULL) {
+            state->flush(state->cookie, gentable);
+        }
 
-        /*
-         * Calculate the end of our bucket range.
-         *
-         * Basically, add the length of the checksum range to the start of the
-         * range and then mask to the beginning of a bucket.
-         */
-        uint64_t end_checksum_hi =
-            (state->checksum_prefix.hi + (~state->checksum_mask.hi + 1)) & bucket_mask;
+        /* Advance to the start of the next range, wrapping to 0 at the end */
+        state->next_checksum.hi = range_last + 1;
 
-        if (state->next_checksum.hi == end_checksum_hi) {
+        if (state->next_checksum.hi == 0 ||
+                (end_checksum_hi != 0 && state->next_checksum.hi >= end_checksum_hi)) {
             /* Finished */
             state->callback(state->cookie, gentable, NULL);
             aim_free(state);
@@ -1053,7 +2036,8 @@ ind_core_gentable_iter_task_callback(void *cookie)
  *
  * @param gentable Handle for a gentable instance
  * @param callback Function called for each flowtable entry
- * @param cookie Opaque value passed to callback
+ * @param flush Optional function called after each bucket has been visited
+ * @param cookie Opaque value passed to callback and flush
  * @param priority SocketManager task priority
  * @returns An error code
  *
@@ -1068,6 +2052,7 @@ static indigo_error_t
 ind_core_gentable_spawn_iter_task(
     indigo_core_gentable_t *gentable,
     ind_core_gentable_iter_task_callback_f callback,
+    ind_core_gentable_iter_task_flush_f flush,
     void *cookie,
     int priority,
     of_checksum_128_t checksum_prefix,
@@ -1078,6 +2063,7 @@ ind_core_gentable_spawn_iter_task(
     struct ind_core_gentable_iter_task_state *state = aim_zmalloc(sizeof(*state));
 
     state->callback = callback;
+    state->flush = flush;
     state->cookie = cookie;
     state->table_id = gentable->table_id;
     state->generation_id = gentable->generation_id;
@@ -1113,8 +2099,7 @@ indigo_core_gentable_acquire(indigo_core_gentable_t *gentable, of_object_t *key)
         return NULL;
     }
 
-    AIM_TRUE_OR_DIE(entry->refcount < UINT32_MAX);
-    entry->refcount++;
+    indigo_core_gentable_entry_acquire(entry);
     return entry->priv;
 }
 
@@ -1127,6 +2112,44 @@ indigo_core_gentable_release(indigo_core_gentable_t *gentable, of_object_t *key)
         return;
     }
 
+    indigo_core_gentable_entry_release(entry);
+}
+
+uint32_t
+indigo_core_gentable_key_hash(of_object_t *key)
+{
+    return hash_key(key);
+}
+
+indigo_core_gentable_entry_t *
+indigo_core_gentable_entry_lookup(indigo_core_gentable_t *gentable, of_object_t *key)
+{
+    return find_entry_by_key(gentable, key);
+}
+
+indigo_core_gentable_entry_t *
+indigo_core_gentable_entry_lookup_hash(indigo_core_gentable_t *gentable,
+                                       of_object_t *key, uint32_t hash)
+{
+    return find_entry_by_key_hash(gentable, key, hash);
+}
+
+void *
+indigo_core_gentable_entry_priv(indigo_core_gentable_entry_t *entry)
+{
+    return entry->priv;
+}
+
+void
+indigo_core_gentable_entry_acquire(indigo_core_gentable_entry_t *entry)
+{
+    AIM_TRUE_OR_DIE(entry->refcount < UINT32_MAX);
+    entry->refcount++;
+}
+
+void
+indigo_core_gentable_entry_release(indigo_core_gentable_entry_t *entry)
+{
     AIM_ASSERT(entry->refcount >= 1);
     entry->refcount--;
 }
@@ -1137,6 +2160,150 @@ indigo_core_gentable_id(indigo_core_gentable_t *gentable)
     return gentable->table_id;
 }
 
+void
+indigo_core_gentable_memory_stats_get(indigo_core_gentable_t *gentable,
+                                      indigo_core_gentable_memory_stats_t *stats)
+{
+    stats->num_entries = gentable->num_entries;
+    stats->entry_bytes = gentable->entry_bytes;
+    stats->bucket_bytes = (uint64_t)(sizeof(*gentable->checksum_buckets) +
+                                     sizeof(*gentable->checksum_tree)) *
+                          gentable->checksum_buckets_size;
+}
+
+void
+indigo_core_gentable_elide_noop_modify_set(indigo_core_gentable_t *gentable,
+                                           bool enable)
+{
+    gentable->elide_noop_modify = enable;
+}
+
+indigo_error_t
+indigo_core_gentable_index_register(indigo_core_gentable_t *gentable,
+                                    indigo_core_gentable_index_extract_f extract,
+                                    int *index_id)
+{
+    bighash_iter_t iter;
+    bighash_entry_t *hash_entry;
+
+    if (gentable->num_indexes >= INDIGO_CORE_GENTABLE_MAX_INDEXES) {
+        return INDIGO_ERROR_RESOURCE;
+    }
+
+    /*
+     * Each entry's index nodes are a single allocation, so existing entries
+     * are removed from the other indexes and reindexed with one more node.
+     */
+    for (hash_entry = bighash_iter_start(gentable->key_hashtable, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct ind_core_gentable_entry *entry =
+            container_of(hash_entry, key_hash_entry, struct ind_core_gentable_entry);
+        index_remove_entry(gentable, entry);
+    }
+
+    *index_id = gentable->num_indexes++;
+    gentable->indexes[*index_id].extract = extract;
+    gentable->indexes[*index_id].hashtable = bighash_table_create(BIGHASH_AUTOGROW);
+
+    for (hash_entry = bighash_iter_start(gentable->key_hashtable, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct ind_core_gentable_entry *entry =
+            container_of(hash_entry, key_hash_entry, struct ind_core_gentable_entry);
+        index_insert_entry(gentable, entry);
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+void
+indigo_core_gentable_index_foreach(indigo_core_gentable_t *gentable,
+                                   int index_id, uint64_t index_key,
+                                   indigo_core_gentable_index_iter_f callback,
+                                   void *cookie)
+{
+    bighash_entry_t *hash_entry;
+
+    AIM_TRUE_OR_DIE(index_id >= 0 && index_id < gentable->num_indexes);
+
+    for (hash_entry = bighash_first(gentable->indexes[index_id].hashtable,
+                                    hash_index_key(index_key));
+         hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
+        struct ind_core_gentable_index_node *node =
+            container_of(hash_entry, hash_entry, struct ind_core_gentable_index_node);
+        if (node->index_key == index_key) {
+            callback(cookie, node->entry);
+        }
+    }
+}
+
+indigo_error_t
+ind_core_gentable_checksum_tree_depth(uint16_t table_id, uint32_t *depth)
+{
+    indigo_core_gentable_t *gentable = find_gentable_by_id(table_id);
+    if (gentable == NULL) {
+        return INDIGO_ERROR_NOT_FOUND;
+    }
+
+    *depth = aim_log2_u32(gentable->checksum_buckets_size);
+    return INDIGO_ERROR_NONE;
+}
+
+indigo_error_t
+ind_core_gentable_checksum_tree_get(uint16_t table_id, uint32_t level,
+                                    uint32_t index, uint32_t count,
+                                    of_checksum_128_t *checksums)
+{
+    indigo_core_gentable_t *gentable = find_gentable_by_id(table_id);
+    uint32_t i;
+
+    if (gentable == NULL) {
+        return INDIGO_ERROR_NOT_FOUND;
+    }
+
+    if (level >= 32 || (1u << level) > gentable->checksum_buckets_size ||
+            index >= (1u << level) || count > (1u << level) - index) {
+        return INDIGO_ERROR_RANGE;
+    }
+
+    for (i = 0; i < count; i++) {
+        uint32_t node = (1u << level) + index + i;
+        if (node >= gentable->checksum_buckets_size) {
+            checksums[i] = gentable->checksum_buckets[node - gentable->checksum_buckets_size].checksum;
+        } else {
+            checksums[i] = gentable->checksum_tree[node];
+        }
+    }
+
+    add_unmigrated_checksums(gentable, level, index, count, checksums);
+
+    return INDIGO_ERROR_NONE;
+}
+
+void
+ind_core_gentable_stats(aim_pvs_t *pvs)
+{
+    int i;
+
+    aim_printf(pvs, "%-4s %-32s %10s %12s %12s %10s\n",
+               "id", "name", "entries", "entry bytes", "bucket bytes", "bytes/entry");
+
+    for (i = 0; i < MAX_GENTABLES; i++) {
+        indigo_core_gentable_t *gentable = gentables[i];
+        indigo_core_gentable_memory_stats_t stats;
+
+        if (gentable == NULL) {
+            continue;
+        }
+
+        indigo_core_gentable_memory_stats_get(gentable, &stats);
+
+        aim_printf(pvs, "%-4u %-32s %10u %12"PRIu64" %12"PRIu64" %10"PRIu64"\n",
+                   gentable->table_id, gentable->name, stats.num_entries,
+                   stats.entry_bytes, stats.bucket_bytes,
+                   stats.num_entries ? stats.entry_bytes / stats.num_entries : 0);
+    }
+}
+
 uint16_t
 indigo_core_gentable_id_lookup(const char *name)
 {
@@ -332,6 +332,148 @@ error:
     indigo_cxn_send_error_reply(cxn_id, obj, err_type, err_code);
 }
 
+/*
+ * Group stats and group desc replies
+ *
+ * Both are generated by a task that yields between batches of groups and
+ * splits the reply into REPLY_MORE segments as each message fills up. The
+ * task walks a snapshot of the group IDs taken when the request arrived,
+ * looking each one up again as it goes, so groups may be added or deleted
+ * while it runs. Groups deleted before the task reaches them are skipped.
+ */
+
+#define GROUP_STATS_BATCH_SIZE 32
+
+struct ind_core_group_stats_state {
+    indigo_cxn_id_t cxn_id;
+    uint32_t xid;
+    of_version_t version;
+    indigo_time_t current_time;
+    of_object_t *reply;
+    uint32_t *group_ids;
+    int num_groups;
+    int next;
+    /* Reused for every group */
+    of_object_t *entries[GROUP_STATS_BATCH_SIZE];
+};
+
+static uint32_t *
+group_ids_snapshot(uint32_t id, int *count)
+{
+    uint32_t *group_ids;
+
+    if (id == OF_GROUP_ALL) {
+        bighash_iter_t iter;
+        ind_core_group_t *group;
+        int n = 0;
+
+        group_ids = aim_malloc(sizeof(*group_ids) *
+                               (bighash_entry_count(ind_core_group_hashtable) + 1));
+
+        for (group = bighash_iter_start(ind_core_group_hashtable, &iter);
+                group; group = bighash_iter_next(&iter)) {
+            group_ids[n++] = group->id;
+        }
+
+        *count = n;
+    } else {
+        group_ids = aim_malloc(sizeof(*group_ids));
+        group_ids[0] = id;
+        *count = id <= OF_GROUP_MAX && ind_core_group_lookup(id) != NULL;
+    }
+
+    return group_ids;
+}
+
+static void
+group_stats_state_free(struct ind_core_group_stats_state *state)
+{
+    int i;
+
+    for (i = 0; i < GROUP_STATS_BATCH_SIZE; i++) {
+        if (state->entries[i] != NULL) {
+            of_object_delete(state->entries[i]);
+        }
+    }
+
+    if (state->reply != NULL) {
+        of_object_delete(state->reply);
+    }
+
+    aim_free(state->group_ids);
+    aim_free(state);
+}
+
+/*
+ * Collect up to GROUP_STATS_BATCH_SIZE groups that still exist
+ */
+static int
+group_stats_next_batch(struct ind_core_group_stats_state *state,
+                       ind_core_group_t **groups)
+{
+    int count = 0;
+
+    while (count < GROUP_STATS_BATCH_SIZE && state->next < state->num_groups) {
+        ind_core_group_t *group = ind_core_group_lookup(state->group_ids[state->next++]);
+        if (group != NULL) {
+            groups[count++] = group;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Append an entry to the reply, sending the current segment first if
+ * the entry doesn't fit
+ */
+static void
+group_stats_append(struct ind_core_group_stats_state *state, of_object_t *entry)
+{
+    of_object_t entries;
+
+    if (state->reply->object_id == OF_GROUP_STATS_REPLY) {
+        of_group_stats_reply_entries_bind(state->reply, &entries);
+    } else {
+        of_group_desc_stats_reply_entries_bind(state->reply, &entries);
+    }
+
+    if (of_list_append(&entries, entry) == 0) {
+        return;
+    }
+
+    if (state->reply->object_id == OF_GROUP_STATS_REPLY) {
+        of_group_stats_reply_flags_set(state->reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+
+        state->reply = of_group_stats_reply_new(state->version);
+        AIM_TRUE_OR_DIE(state->reply != NULL);
+        of_group_stats_reply_xid_set(state->reply, state->xid);
+        of_group_stats_reply_entries_bind(state->reply, &entries);
+    } else {
+        of_group_desc_stats_reply_flags_set(state->reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+
+        state->reply = of_group_desc_stats_reply_new(state->version);
+        AIM_TRUE_OR_DIE(state->reply != NULL);
+        of_group_desc_stats_reply_xid_set(state->reply, state->xid);
+        of_group_desc_stats_reply_entries_bind(state->reply, &entries);
+    }
+
+    if (of_list_append(&entries, entry) < 0) {
+        AIM_DIE("unexpected failure appending single group stats entry");
+    }
+}
+
+static void
+group_stats_finish(struct ind_core_group_stats_state *state)
+{
+    indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+    state->reply = NULL;
+    indigo_cxn_resume(state->cxn_id);
+    group_stats_state_free(state);
+}
+
 static void
 ind_core_group_stats_entry_populate(of_group_stats_entry_t *entry,
                                     ind_core_group_t *group,
@@ -345,109 +487,188 @@ ind_core_group_stats_entry_populate(of_group_stats_entry_t *entry,
     of_group_stats_entry_duration_sec_set(entry, duration_sec);
     of_group_stats_entry_duration_nsec_set(entry, duration_nsec);
     of_group_stats_entry_ref_count_set(entry, group->refcount);
+}
 
-    ind_core_group_table_t *table = group_table_for_id(group->id);
-    AIM_ASSERT(table != NULL);
+/*
+ * Fill in the stats entries for a batch of groups, using one
+ * entry_stats_get_bulk call per group table where possible
+ */
+static void
+group_stats_get_batch(struct ind_core_group_stats_state *state,
+                      ind_core_group_t **groups, int count)
+{
+    void *privs[GROUP_STATS_BATCH_SIZE];
+    ind_core_group_t *group_batch[GROUP_STATS_BATCH_SIZE];
+    of_group_stats_entry_t *entries[GROUP_STATS_BATCH_SIZE];
+    bool done[GROUP_STATS_BATCH_SIZE];
+    int i, j, n;
+
+    for (i = 0; i < count; i++) {
+        truncate_of_object(state->entries[i]);
+        ind_core_group_stats_entry_populate(state->entries[i], groups[i],
+                                            state->current_time);
+        done[i] = false;
+    }
 
-    table->ops->entry_stats_get(table->priv, group->priv, entry);
+    for (i = 0; i < count; i++) {
+        if (done[i]) {
+            continue;
+        }
+
+        ind_core_group_table_t *table = group_table_for_id(groups[i]->id);
+        AIM_ASSERT(table != NULL);
+
+        /* Collect the remaining groups in this table */
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (!done[j] && group_table_for_id(groups[j]->id) == table) {
+                done[j] = true;
+                privs[n] = groups[j]->priv;
+                group_batch[n] = groups[j];
+                entries[n] = state->entries[j];
+                n++;
+            }
+        }
+
+        if (table->ops->entry_stats_get_bulk != NULL &&
+                table->ops->entry_stats_get_bulk(table->priv, privs, entries,
+                                                 n) == INDIGO_ERROR_NONE) {
+            continue;
+        }
+
+        for (j = 0; j < n; j++) {
+            if (table->ops->entry_stats_get_bulk != NULL) {
+                /* Discard whatever the failed bulk call filled in */
+                truncate_of_object(entries[j]);
+                ind_core_group_stats_entry_populate(entries[j], group_batch[j],
+                                                    state->current_time);
+            }
+            table->ops->entry_stats_get(table->priv, privs[j], entries[j]);
+        }
+    }
 }
 
-/* TODO segment long replies */
-void
-ind_core_group_stats_request_handler(of_object_t *_obj,
-                                     indigo_cxn_id_t cxn_id)
+static ind_soc_task_status_t
+group_stats_task(void *cookie)
 {
-    of_group_stats_request_t *obj = _obj;
-    of_group_stats_reply_t *reply;
-    of_list_group_stats_entry_t entries;
-    of_group_stats_entry_t *entry;
-    uint32_t xid;
-    uint32_t id;
-    indigo_time_t current_time = INDIGO_CURRENT_TIME;
+    struct ind_core_group_stats_state *state = cookie;
+    ind_core_group_t *groups[GROUP_STATS_BATCH_SIZE];
+    int count, i;
 
-    of_group_stats_request_group_id_get(obj, &id);
-
-    reply = of_group_stats_reply_new(obj->version);
-    AIM_TRUE_OR_DIE(reply != NULL);
+    do {
+        count = group_stats_next_batch(state, groups);
+        if (count == 0) {
+            group_stats_finish(state);
+            return IND_SOC_TASK_FINISHED;
+        }
 
-    of_group_stats_request_xid_get(obj, &xid);
-    of_group_stats_reply_xid_set(reply, xid);
-    of_group_stats_reply_entries_bind(reply, &entries);
+        group_stats_get_batch(state, groups, count);
 
-    entry = of_group_stats_entry_new(entries.version);
-    AIM_TRUE_OR_DIE(entry != NULL);
+        for (i = 0; i < count; i++) {
+            group_stats_append(state, state->entries[i]);
+        }
+    } while (!ind_soc_should_yield());
 
-    if (id == OF_GROUP_ALL) {
-        bighash_iter_t iter;
-        ind_core_group_t *group;
-        for (group = bighash_iter_start(ind_core_group_hashtable, &iter);
-                group; group = bighash_iter_next(&iter)) {
-            ind_core_group_stats_entry_populate(entry, group, current_time);
+    return IND_SOC_TASK_CONTINUE;
+}
 
-            if (of_list_append(&entries, entry) < 0) {
-                break;
-            }
+static ind_soc_task_status_t
+group_desc_stats_task(void *cookie)
+{
+    struct ind_core_group_stats_state *state = cookie;
+    of_group_desc_stats_entry_t *entry = state->entries[0];
+    ind_core_group_t *groups[GROUP_STATS_BATCH_SIZE];
+    int count, i;
 
-            /* HACK unable to truncate existing object */
-            of_object_delete(entry);
-            entry = of_group_stats_entry_new(entries.version);
-            AIM_TRUE_OR_DIE(entry != NULL);
+    do {
+        count = group_stats_next_batch(state, groups);
+        if (count == 0) {
+            group_stats_finish(state);
+            return IND_SOC_TASK_FINISHED;
         }
-    } else if (id <= OF_GROUP_MAX) {
-        ind_core_group_t *group = ind_core_group_lookup(id);
-        if (group != NULL) {
-            ind_core_group_stats_entry_populate(entry, group, current_time);
 
-            if (of_list_append(&entries, entry) < 0) {
-                AIM_DIE("unexpected failure appending single group stats entry");
+        for (i = 0; i < count; i++) {
+            truncate_of_object(entry);
+            of_group_desc_stats_entry_group_type_set(entry, groups[i]->type);
+            of_group_desc_stats_entry_group_id_set(entry, groups[i]->id);
+            if (of_group_desc_stats_entry_buckets_set(entry, groups[i]->buckets) < 0) {
+                AIM_DIE("unexpected failure setting group desc stats entry buckets");
             }
+
+            group_stats_append(state, entry);
         }
+    } while (!ind_soc_should_yield());
+
+    return IND_SOC_TASK_CONTINUE;
+}
+
+static void
+group_stats_spawn_task(struct ind_core_group_stats_state *state,
+                       ind_soc_task_callback_f callback)
+{
+    indigo_cxn_pause(state->cxn_id);
+
+    if (ind_soc_task_register(callback, state, IND_SOC_NORMAL_PRIORITY) < 0) {
+        AIM_LOG_INTERNAL("Failed to spawn group stats task");
+        indigo_cxn_resume(state->cxn_id);
+        group_stats_state_free(state);
     }
+}
 
-    of_object_delete(entry);
+void
+ind_core_group_stats_request_handler(of_object_t *_obj,
+                                     indigo_cxn_id_t cxn_id)
+{
+    of_group_stats_request_t *obj = _obj;
+    struct ind_core_group_stats_state *state;
+    uint32_t id;
+    int i;
 
-    indigo_cxn_send_controller_message(cxn_id, reply);
+    state = aim_zmalloc(sizeof(*state));
+    state->cxn_id = cxn_id;
+    state->version = obj->version;
+    state->current_time = INDIGO_CURRENT_TIME;
+
+    of_group_stats_request_xid_get(obj, &state->xid);
+    of_group_stats_request_group_id_get(obj, &id);
+
+    state->reply = of_group_stats_reply_new(obj->version);
+    AIM_TRUE_OR_DIE(state->reply != NULL);
+    of_group_stats_reply_xid_set(state->reply, state->xid);
+
+    for (i = 0; i < GROUP_STATS_BATCH_SIZE; i++) {
+        state->entries[i] = of_group_stats_entry_new(obj->version);
+        AIM_TRUE_OR_DIE(state->entries[i] != NULL);
+    }
+
+    state->group_ids = group_ids_snapshot(id, &state->num_groups);
+
+    group_stats_spawn_task(state, group_stats_task);
 }
 
-/* TODO segment long replies */
 void
 ind_core_group_desc_stats_request_handler(of_object_t *_obj,
                                           indigo_cxn_id_t cxn_id)
 {
     of_group_desc_stats_request_t *obj = _obj;
-    of_group_desc_stats_reply_t *reply;
-    of_list_group_desc_stats_entry_t entries;
-    of_group_desc_stats_entry_t *entry;
-    uint32_t xid;
-    ind_core_group_t *group;
-    bighash_iter_t iter;
+    struct ind_core_group_stats_state *state;
 
-    reply = of_group_desc_stats_reply_new(obj->version);
-    AIM_TRUE_OR_DIE(reply != NULL);
+    state = aim_zmalloc(sizeof(*state));
+    state->cxn_id = cxn_id;
+    state->version = obj->version;
 
-    of_group_desc_stats_request_xid_get(obj, &xid);
-    of_group_desc_stats_reply_xid_set(reply, xid);
-    of_group_desc_stats_reply_entries_bind(reply, &entries);
+    of_group_desc_stats_request_xid_get(obj, &state->xid);
 
-    entry = of_group_desc_stats_entry_new(entries.version);
-    AIM_TRUE_OR_DIE(entry != NULL);
-
-    for (group = bighash_iter_start(ind_core_group_hashtable, &iter);
-            group; group = bighash_iter_next(&iter)) {
-        of_group_desc_stats_entry_group_type_set(entry, group->type);
-        of_group_desc_stats_entry_group_id_set(entry, group->id);
-        if (of_group_desc_stats_entry_buckets_set(entry, group->buckets) < 0) {
-            AIM_DIE("unexpected failure setting group desc stats entry buckets");
-        }
+    state->reply = of_group_desc_stats_reply_new(obj->version);
+    AIM_TRUE_OR_DIE(state->reply != NULL);
+    of_group_desc_stats_reply_xid_set(state->reply, state->xid);
 
-        if (of_list_append(&entries, entry) < 0) {
-            break;
-        }
-    }
+    state->entries[0] = of_group_desc_stats_entry_new(obj->version);
+    AIM_TRUE_OR_DIE(state->entries[0] != NULL);
 
-    of_object_delete(entry);
+    state->group_ids = group_ids_snapshot(OF_GROUP_ALL, &state->num_groups);
 
-    indigo_cxn_send_controller_message(cxn_id, reply);
+    group_stats_spawn_task(state, group_desc_stats_task);
 }
 
 void
@@ -118,6 +118,241 @@ ind_core_port_mod_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
 
 /****************************************************************/
 
+/*
+ * Port and queue stats collection
+ *
+ * When ports are registered, stats are fetched for up to
+ * PORT_STATS_BATCH_SIZE ports or queues at a time, with a single
+ * indigo_port_stats_get_many or indigo_port_queue_stats_get_many call if
+ * Forwarding implements them. The ports and queues to visit are
+ * snapshotted when the request arrives. A request that fits in one batch
+ * is answered immediately; larger ones are handed to a task that pauses
+ * the connection and yields between batches.
+ */
+
+/* Same as ENTRY_STATS_BATCH_SIZE in gentable_handlers.c */
+#define PORT_STATS_BATCH_SIZE 16
+
+struct ind_core_port_stats_state {
+    indigo_cxn_id_t cxn_id;
+    of_version_t version;
+    uint32_t xid;
+    of_object_t *reply;
+    int count;
+    int next;
+    of_port_no_t *port_nos;
+    uint32_t *queue_ids; /* NULL for port stats */
+    /* Reused for every batch */
+    int num_entries;
+    of_object_t *entries[PORT_STATS_BATCH_SIZE];
+};
+
+static void
+port_stats_state_free(struct ind_core_port_stats_state *state)
+{
+    int i;
+
+    for (i = 0; i < state->num_entries; i++) {
+        of_object_delete(state->entries[i]);
+    }
+
+    if (state->reply != NULL) {
+        of_object_delete(state->reply);
+    }
+
+    aim_free(state->port_nos);
+    aim_free(state->queue_ids);
+    aim_free(state);
+}
+
+/*
+ * Append an entry to the reply, sending the current segment first if
+ * the entry doesn't fit
+ */
+static void
+port_stats_append(struct ind_core_port_stats_state *state, of_object_t *entry)
+{
+    of_object_t entries;
+
+    if (state->queue_ids == NULL) {
+        of_port_stats_reply_entries_bind(state->reply, &entries);
+    } else {
+        of_queue_stats_reply_entries_bind(state->reply, &entries);
+    }
+
+    if (of_list_append(&entries, entry) == 0) {
+        return;
+    }
+
+    /* Message full, send current reply and start a new one */
+    if (state->queue_ids == NULL) {
+        of_port_stats_reply_flags_set(state->reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+
+        if ((state->reply = of_port_stats_reply_new(state->version)) == NULL) {
+            AIM_DIE("Failed to allocate port_stats reply message");
+        }
+
+        of_port_stats_reply_xid_set(state->reply, state->xid);
+        of_port_stats_reply_entries_bind(state->reply, &entries);
+    } else {
+        of_queue_stats_reply_flags_set(state->reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+
+        if ((state->reply = of_queue_stats_reply_new(state->version)) == NULL) {
+            AIM_DIE("Failed to allocate queue_stats reply message");
+        }
+
+        of_queue_stats_reply_xid_set(state->reply, state->xid);
+        of_queue_stats_reply_entries_bind(state->reply, &entries);
+    }
+
+    if (of_list_append(&entries, entry) < 0) {
+        AIM_DIE("Unexpectedly failed to append port/queue stats");
+    }
+}
+
+/*
+ * Fetch stats for the next 'count' ports or queues
+ *
+ * Sets ok[i] if entries[i] was filled in.
+ */
+static void
+port_stats_get_batch(struct ind_core_port_stats_state *state, int count, bool *ok)
+{
+    const of_port_no_t *port_nos = &state->port_nos[state->next];
+    indigo_error_t rv;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        of_object_truncate(state->entries[i]);
+        ok[i] = true;
+    }
+
+    if (state->queue_ids == NULL) {
+        if (indigo_port_stats_get_many &&
+                indigo_port_stats_get_many(port_nos, count, state->entries) == INDIGO_ERROR_NONE) {
+            return;
+        }
+
+        for (i = 0; i < count; i++) {
+            of_object_truncate(state->entries[i]);
+            rv = indigo_port_stats_get_one(port_nos[i], state->entries[i]);
+            if (rv) {
+                AIM_LOG_ERROR("Failed to get port stats for port %u: %s",
+                              port_nos[i], indigo_strerror(rv));
+                ok[i] = false;
+            }
+        }
+    } else {
+        const uint32_t *queue_ids = &state->queue_ids[state->next];
+
+        if (indigo_port_queue_stats_get_many &&
+                indigo_port_queue_stats_get_many(port_nos, queue_ids, count,
+                                                 state->entries) == INDIGO_ERROR_NONE) {
+            return;
+        }
+
+        for (i = 0; i < count; i++) {
+            of_object_truncate(state->entries[i]);
+            rv = indigo_port_queue_stats_get_one(port_nos[i], queue_ids[i],
+                                                 state->entries[i]);
+            if (rv) {
+                AIM_LOG_ERROR("Failed to get queue stats for port %u queue %u: %s",
+                              port_nos[i], queue_ids[i], indigo_strerror(rv));
+                ok[i] = false;
+            }
+        }
+    }
+}
+
+/*
+ * Fetch the next batch and append it to the reply
+ *
+ * Returns false once every port or queue has been visited.
+ */
+static bool
+port_stats_next_batch(struct ind_core_port_stats_state *state)
+{
+    bool ok[PORT_STATS_BATCH_SIZE];
+    int count = state->count - state->next;
+    int i;
+
+    if (count == 0) {
+        return false;
+    }
+
+    if (count > state->num_entries) {
+        count = state->num_entries;
+    }
+
+    port_stats_get_batch(state, count, ok);
+
+    for (i = 0; i < count; i++) {
+        if (ok[i]) {
+            port_stats_append(state, state->entries[i]);
+        }
+    }
+
+    state->next += count;
+    return true;
+}
+
+static void
+port_stats_finish(struct ind_core_port_stats_state *state)
+{
+    indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+    state->reply = NULL;
+    port_stats_state_free(state);
+}
+
+static ind_soc_task_status_t
+port_stats_task(void *cookie)
+{
+    struct ind_core_port_stats_state *state = cookie;
+
+    do {
+        if (!port_stats_next_batch(state)) {
+            indigo_cxn_resume(state->cxn_id);
+            port_stats_finish(state);
+            return IND_SOC_TASK_FINISHED;
+        }
+    } while (!ind_soc_should_yield());
+
+    return IND_SOC_TASK_CONTINUE;
+}
+
+static void
+port_stats_start(struct ind_core_port_stats_state *state,
+                 of_object_t *(*entry_new)(of_version_t version))
+{
+    int i;
+
+    state->num_entries = state->count < PORT_STATS_BATCH_SIZE ?
+        state->count : PORT_STATS_BATCH_SIZE;
+    for (i = 0; i < state->num_entries; i++) {
+        state->entries[i] = entry_new(state->version);
+        AIM_TRUE_OR_DIE(state->entries[i] != NULL);
+    }
+
+    if (state->count <= PORT_STATS_BATCH_SIZE) {
+        /* Single batch, no need to pause the connection */
+        (void) port_stats_next_batch(state);
+        port_stats_finish(state);
+        return;
+    }
+
+    indigo_cxn_pause(state->cxn_id);
+
+    if (ind_soc_task_register(port_stats_task, state, IND_SOC_NORMAL_PRIORITY) < 0) {
+        AIM_LOG_INTERNAL("Failed to spawn port stats task");
+        indigo_cxn_resume(state->cxn_id);
+        port_stats_state_free(state);
+    }
+}
+
+/****************************************************************/
+
 /**
  * Handle a port_stats_request message
  * @param cxn_id Connection handler for the owning connection
@@ -134,19 +369,23 @@ ind_core_port_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
     uint32_t xid = 0;
 
     if (ind_core_ports_registered > 0) {
-        reply = of_port_stats_reply_new(obj->version);
-        of_port_stats_entry_t *port_stats = of_port_stats_entry_new(reply->version);
+        struct ind_core_port_stats_state *state = aim_zmalloc(sizeof(*state));
+        state->cxn_id = cxn_id;
+        state->version = obj->version;
 
-        of_port_stats_request_xid_get(obj, &xid);
-        of_port_stats_reply_xid_set(reply, xid);
+        if ((state->reply = of_port_stats_reply_new(obj->version)) == NULL) {
+            AIM_DIE("Failed to allocate port_stats reply message");
+        }
 
-        of_list_port_stats_entry_t entries;
-        of_port_stats_reply_entries_bind(reply, &entries);
+        of_port_stats_request_xid_get(obj, &state->xid);
+        of_port_stats_reply_xid_set(state->reply, state->xid);
 
         of_port_no_t port_no;
         of_port_stats_request_port_no_get(obj, &port_no);
         bool all_ports = port_no == OF_PORT_DEST_WILDCARD;
 
+        state->port_nos = aim_malloc(sizeof(*state->port_nos) * ind_core_ports_registered);
+
         struct slot_allocator_iter iter;
         slot_allocator_iter_init(ind_core_port_allocator, &iter);
         uint32_t slot;
@@ -155,35 +394,14 @@ ind_core_port_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
             if (!all_ports && port->port_no != port_no) {
                 continue;
             }
-            of_object_truncate(port_stats);
-            indigo_error_t rv = indigo_port_stats_get_one(port->port_no, port_stats);
-            if (rv) {
-                AIM_LOG_ERROR("Failed to get port stats for port %u: %s",
-                              port->port_no, indigo_strerror(rv));
-            } else if (of_list_port_stats_entry_append(&entries, port_stats) < 0) {
-                /* Message full, send current reply and start a new one */
-                of_port_stats_reply_flags_set(reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
-                indigo_cxn_send_controller_message(cxn_id, reply);
-
-                if ((reply = of_port_stats_reply_new(obj->version)) == NULL) {
-                    AIM_DIE("Failed to allocate port_stats reply message");
-                }
-
-                of_port_stats_reply_xid_set(reply, xid);
-                of_port_stats_reply_entries_bind(reply, &entries);
-
-                if (of_list_port_stats_entry_append(&entries, port_stats) < 0) {
-                    AIM_DIE("Unexpectedly failed to append port stats");
-                }
-            }
+            state->port_nos[state->count++] = port->port_no;
 
             if (!all_ports) {
                 break;
             }
         }
 
-        of_port_stats_entry_delete(port_stats);
-        indigo_cxn_send_controller_message(cxn_id, reply);
+        port_stats_start(state, of_port_stats_entry_new);
     } else if (indigo_port_stats_get) {
         rv = indigo_port_stats_get(obj, &reply);
         if (rv == INDIGO_ERROR_NONE) {
@@ -259,14 +477,16 @@ ind_core_queue_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
     indigo_error_t rv;
 
     if (ind_core_ports_registered > 0) {
-        reply = of_queue_stats_reply_new(obj->version);
-        of_queue_stats_entry_t *queue_stats = of_queue_stats_entry_new(reply->version);
+        struct ind_core_port_stats_state *state = aim_zmalloc(sizeof(*state));
+        state->cxn_id = cxn_id;
+        state->version = obj->version;
 
-        of_queue_stats_request_xid_get(obj, &xid);
-        of_queue_stats_reply_xid_set(reply, xid);
+        if ((state->reply = of_queue_stats_reply_new(obj->version)) == NULL) {
+            AIM_DIE("Failed to allocate queue_stats reply message");
+        }
 
-        of_list_queue_stats_entry_t entries;
-        of_queue_stats_reply_entries_bind(reply, &entries);
+        of_queue_stats_request_xid_get(obj, &state->xid);
+        of_queue_stats_reply_xid_set(state->reply, state->xid);
 
         of_port_no_t port_no;
         of_queue_stats_request_port_no_get(obj, &port_no);
@@ -277,8 +497,19 @@ ind_core_queue_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
         bool all_queues = queue_id == OF_QUEUE_ALL;
 
         struct slot_allocator_iter iter;
-        slot_allocator_iter_init(ind_core_queue_allocator, &iter);
         uint32_t slot;
+        int max_queues = 0;
+
+        slot_allocator_iter_init(ind_core_queue_allocator, &iter);
+        while (slot_allocator_iter_next(&iter) != SLOT_INVALID) {
+            max_queues++;
+        }
+
+        /* Avoid a zero-size allocation */
+        state->port_nos = aim_malloc(sizeof(*state->port_nos) * (max_queues + 1));
+        state->queue_ids = aim_malloc(sizeof(*state->queue_ids) * (max_queues + 1));
+
+        slot_allocator_iter_init(ind_core_queue_allocator, &iter);
         while ((slot = slot_allocator_iter_next(&iter)) != SLOT_INVALID) {
             struct ind_core_queue *queue = &ind_core_queues[slot];
             if (!all_ports && queue->port_no != port_no) {
@@ -286,32 +517,12 @@ ind_core_queue_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
             } else if (!all_queues && queue->queue_id != queue_id) {
                 continue;
             }
-            of_object_truncate(queue_stats);
-            indigo_error_t rv = indigo_port_queue_stats_get_one(
-                queue->port_no, queue->queue_id, queue_stats);
-            if (rv) {
-                AIM_LOG_ERROR("Failed to get queue stats for port %u queue %u: %s",
-                              queue->port_no, queue->queue_id, indigo_strerror(rv));
-            } else if (of_list_queue_stats_entry_append(&entries, queue_stats) < 0) {
-                /* Message full, send current reply and start a new one */
-                of_queue_stats_reply_flags_set(reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
-                indigo_cxn_send_controller_message(cxn_id, reply);
-
-                if ((reply = of_queue_stats_reply_new(obj->version)) == NULL) {
-                    AIM_DIE("Failed to allocate queue_stats reply message");
-                }
-
-                of_queue_stats_reply_xid_set(reply, xid);
-                of_queue_stats_reply_entries_bind(reply, &entries);
-
-                if (of_list_queue_stats_entry_append(&entries, queue_stats) < 0) {
-                    AIM_DIE("Unexpectedly failed to append queue stats");
-                }
-            }
+            state->port_nos[state->count] = queue->port_no;
+            state->queue_ids[state->count] = queue->queue_id;
+            state->count++;
         }
 
-        of_queue_stats_entry_delete(queue_stats);
-        indigo_cxn_send_controller_message(cxn_id, reply);
+        port_stats_start(state, of_queue_stats_entry_new);
     } else if (indigo_port_queue_stats_get) {
         rv = indigo_port_queue_stats_get(obj, &reply);
         if (rv == INDIGO_ERROR_NONE) {
@@ -442,12 +653,14 @@ flow_mod_setup_query(of_flow_modify_t *obj, /* Works with add, mod, del */
     } else {
         query->table_id = TABLE_ID_ANY;
     }
-    of_match_t match;
-    if (of_flow_modify_match_get(obj, &match) < 0) {
-        AIM_LOG_ERROR("Failed to extract match from flow");
-        return INDIGO_ERROR_UNKNOWN;
+    if (!ind_core_match_wire_get(obj, FLOW_MOD_MATCH_OFFSET, &query->minimatch)) {
+        of_match_t match;
+        if (of_flow_modify_match_get(obj, &match) < 0) {
+            AIM_LOG_ERROR("Failed to extract match from flow");
+            return INDIGO_ERROR_UNKNOWN;
+        }
+        minimatch_init(&query->minimatch, &match);
     }
-    minimatch_init(&query->minimatch, &match);
     query->mode = query_mode;
     if (query_mode == OF_MATCH_STRICT) {
         query->check_priority = 1;
@@ -540,6 +753,15 @@ ind_core_flow_add_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
             AIM_LOG_TRACE("Overwriting existing flow");
             ind_core_table_t *table = ind_core_table_get(entry->table_id);
             AIM_ASSERT(table != NULL);
+
+            if (table->elide_noop_overwrite && ft_overwrite_is_noop(entry, obj)) {
+                AIM_LOG_TRACE("Flow unchanged, not calling Forwarding");
+                ft_overwrite_timeouts(ind_core_ft, entry, obj);
+                debug_counter_inc(&ft_overwrite_elided_counter);
+                minimatch_cleanup(&minimatch);
+                return;
+            }
+
             rv = table->ops->entry_modify(table->priv, cxn_id, entry->priv, obj);
 
             if (rv == INDIGO_ERROR_NONE) {
@@ -701,11 +923,19 @@ flow_mod_err_msg_send(indigo_error_t indigo_err, of_version_t ver,
 
 /****************************************************************/
 
+/*
+ * Non-strict flow-modify and flow-delete requests whose query visits at most
+ * this many flowtable entries are handled inline instead of in a task, which
+ * saves pausing the connection
+ */
+#define FLOW_MOD_INLINE_MAX_CANDIDATES 64
+
 /* State for non-strict flow-modify iteration */
 struct flow_modify_state {
     of_flow_modify_t *request;
     indigo_cxn_id_t cxn_id;
     int num_matched;
+    bool in_task;
 };
 
 /* Flowtable iterator for ind_core_flow_modify_handler */
@@ -735,11 +965,13 @@ modify_iter_cb(void *cookie, ft_entry_t *entry)
             /* OpenFlow 1.0.0, section 4.6, page 14.  Treat as an add */
             ind_core_flow_add_handler(state->request, state->cxn_id);
         } else {
-            AIM_LOG_TRACE("Finished flow modify task");
+            AIM_LOG_TRACE("Finished flow modify");
+        }
+        if (state->in_task) {
+            indigo_cxn_resume(state->cxn_id);
+            of_object_delete(state->request);
+            aim_free(state);
         }
-        indigo_cxn_resume(state->cxn_id);
-        of_object_delete(state->request);
-        aim_free(state);
     }
 }
 
@@ -757,17 +989,27 @@ ind_core_flow_modify_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
     int rv;
     of_meta_match_t query;
 
+    rv = flow_mod_setup_query(obj, &query, OF_MATCH_NON_STRICT, 1);
+    if (rv != INDIGO_ERROR_NONE) {
+        return;
+    }
+
+    if (ft_query_candidates(ind_core_ft, &query) <= FLOW_MOD_INLINE_MAX_CANDIDATES) {
+        struct flow_modify_state inline_state = {
+            .request = obj,
+            .cxn_id = cxn_id,
+            .num_matched = 0,
+            .in_task = false,
+        };
+        ft_iterate(ind_core_ft, &query, modify_iter_cb, &inline_state);
+        return;
+    }
+
     struct flow_modify_state *state = aim_malloc(sizeof(*state));
     state->request = of_object_dup(obj);
     state->num_matched = 0;
     state->cxn_id = cxn_id;
-
-    rv = flow_mod_setup_query(state->request, &query, OF_MATCH_NON_STRICT, 1);
-    if (rv != INDIGO_ERROR_NONE) {
-        of_object_delete(state->request);
-        aim_free(state);
-        return;
-    }
+    state->in_task = true;
 
     indigo_cxn_pause(cxn_id);
 
@@ -835,6 +1077,7 @@ ind_core_flow_modify_strict_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
 /* State for non-strict flow-delete iteration */
 struct flow_delete_state {
     indigo_cxn_id_t cxn_id;
+    bool in_task;
 };
 
 /* Flowtable iterator for ind_core_flow_delete_handler */
@@ -846,9 +1089,11 @@ delete_iter_cb(void *cookie, ft_entry_t *entry)
     if (entry != NULL) {
         ind_core_flow_entry_delete(entry, INDIGO_FLOW_REMOVED_DELETE, state->cxn_id);
     } else {
-        AIM_LOG_TRACE("Finished flow delete task");
-        indigo_cxn_resume(state->cxn_id);
-        aim_free(state);
+        AIM_LOG_TRACE("Finished flow delete");
+        if (state->in_task) {
+            indigo_cxn_resume(state->cxn_id);
+            aim_free(state);
+        }
     }
 }
 
@@ -866,15 +1111,32 @@ ind_core_flow_delete_handler(of_object_t *obj, indigo_cxn_id_t cxn_id)
     of_meta_match_t query;
     indigo_error_t rv;
 
-    struct flow_delete_state *state = aim_malloc(sizeof(*state));
-
     rv = flow_mod_setup_query(obj, &query, OF_MATCH_NON_STRICT, 0);
     if (rv != INDIGO_ERROR_NONE) {
-        aim_free(state);
         return;
     }
 
+    /* A delete matching every flow in one table may clear it in one go */
+    if (query.table_id != TABLE_ID_ANY && query.cookie_mask == 0 &&
+            query.minimatch.num_words == 0 &&
+            ind_core_table_clear(query.table_id, cxn_id) == INDIGO_ERROR_NONE) {
+        AIM_LOG_TRACE("Cleared flowtable %d", query.table_id);
+        metamatch_cleanup(&query);
+        return;
+    }
+
+    if (ft_query_candidates(ind_core_ft, &query) <= FLOW_MOD_INLINE_MAX_CANDIDATES) {
+        struct flow_delete_state inline_state = {
+            .cxn_id = cxn_id,
+            .in_task = false,
+        };
+        ft_iterate(ind_core_ft, &query, delete_iter_cb, &inline_state);
+        return;
+    }
+
+    struct flow_delete_state *state = aim_malloc(sizeof(*state));
     state->cxn_id = cxn_id;
+    state->in_task = true;
     indigo_cxn_pause(cxn_id);
 
     rv = ft_spawn_iter_task(ind_core_ft, &query, delete_iter_cb, state,
@@ -958,50 +1220,85 @@ struct ind_core_flow_stats_state {
     of_flow_stats_reply_t *reply;
 };
 
-static void
-ind_core_flow_stats_iter(void *cookie, ft_entry_t *entry)
+/*
+ * Build a flow stats entry with everything except the duration and counters
+ *
+ * The result is cached in the flowtable entry and reused by later flow
+ * stats requests until the flowtable entry changes.
+ */
+static of_flow_stats_entry_t *
+flow_stats_template_build(ft_entry_t *entry)
 {
-    struct ind_core_flow_stats_state *state = cookie;
-    uint32_t secs, nsecs;
-    indigo_error_t rv;
+    of_flow_stats_entry_t *stats_entry;
 
-    /* Allocate a reply if we don't already have one. */
-    if (state->reply == NULL) {
-        state->reply = of_flow_stats_reply_new(state->version);
-        if (state->reply == NULL) {
-            AIM_DIE("Failed to allocate of_flow_stats_reply");
-        }
+    stats_entry = of_flow_stats_entry_new(entry->effects.actions->version);
+    if (stats_entry == NULL) {
+        AIM_LOG_ERROR("Failed to allocate flow stats entry");
+        return NULL;
+    }
 
-        of_flow_stats_reply_xid_set(state->reply, state->xid);
-        of_flow_stats_reply_flags_set(state->reply, 1);
+    of_flow_stats_entry_cookie_set(stats_entry, entry->cookie);
+    of_flow_stats_entry_priority_set(stats_entry, entry->priority);
+    of_flow_stats_entry_idle_timeout_set(stats_entry, entry->idle_timeout);
+    of_flow_stats_entry_hard_timeout_set(stats_entry, entry->hard_timeout);
+    of_flow_stats_entry_table_id_set(stats_entry, entry->table_id);
+
+    if (stats_entry->version >= OF_VERSION_1_3) {
+        of_flow_stats_entry_flags_set(stats_entry, entry->flags);
     }
 
-    if (entry == NULL) {
-        /* Send last reply */
-        of_flow_stats_reply_flags_set(state->reply, 0);
-        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+    if (ind_core_match_wire_set(stats_entry, FLOW_STATS_ENTRY_MATCH_OFFSET,
+                                &entry->minimatch) < 0) {
+        of_match_t match;
+        minimatch_expand(&entry->minimatch, &match);
 
-        /* Clean up state */
-        indigo_cxn_resume(state->cxn_id);
-        aim_free(state);
-        return;
+        if (of_flow_stats_entry_match_set(stats_entry, &match)) {
+            AIM_LOG_INTERNAL("Failed to set match in flow stats entry");
+            of_object_delete(stats_entry);
+            return NULL;
+        }
+    }
+
+    if (stats_entry->version == OF_VERSION_1_0) {
+        if (of_flow_stats_entry_actions_set(
+                stats_entry, entry->effects.actions) < 0) {
+            AIM_LOG_INTERNAL("Failed to set actions list of flow stats entry");
+            of_object_delete(stats_entry);
+            return NULL;
+        }
+    } else {
+        if (of_flow_stats_entry_instructions_set(
+                stats_entry, entry->effects.instructions) < 0) {
+            AIM_LOG_INTERNAL("Failed to set instructions list of flow stats entry");
+            of_object_delete(stats_entry);
+            return NULL;
+        }
     }
 
-    indigo_fi_flow_stats_t flow_stats = {
-        .packets = -1,
-        .bytes = -1,
-    };
+    return stats_entry;
+}
 
-    ind_core_table_t *table = ind_core_table_get(entry->table_id);
-    AIM_ASSERT(table != NULL);
+static void
+ind_core_flow_stats_reply_alloc(struct ind_core_flow_stats_state *state)
+{
+    state->reply = of_flow_stats_reply_new(state->version);
+    if (state->reply == NULL) {
+        AIM_DIE("Failed to allocate of_flow_stats_reply");
+    }
 
-    rv = table->ops->entry_stats_get(table->priv, state->cxn_id,
-                                     entry->priv, &flow_stats);
+    of_flow_stats_reply_xid_set(state->reply, state->xid);
+    of_flow_stats_reply_flags_set(state->reply, 1);
+}
 
-    if (rv != INDIGO_ERROR_NONE) {
-        AIM_LOG_ERROR("Failed to get stats for flow "INDIGO_FLOW_ID_PRINTF_FORMAT": %s",
-                      entry->id, indigo_strerror(rv));
-        return;
+static void
+ind_core_flow_stats_append(struct ind_core_flow_stats_state *state,
+                           ft_entry_t *entry, indigo_fi_flow_stats_t *flow_stats)
+{
+    uint32_t secs, nsecs;
+
+    /* Allocate a reply if we don't already have one. */
+    if (state->reply == NULL) {
+        ind_core_flow_stats_reply_alloc(state);
     }
 
     /* Skip entry if stats request version is not equal to entry version */
@@ -1015,60 +1312,68 @@ ind_core_flow_stats_iter(void *cookie, ft_entry_t *entry)
     /* TODO use time from flow_stats? */
     calc_duration(state->current_time, entry->insert_time, &secs, &nsecs);
 
-    /* Set up the structures to append an entry to the list */
+    if (entry->stats_template == NULL) {
+        entry->stats_template = flow_stats_template_build(entry);
+        if (entry->stats_template == NULL) {
+            return;
+        }
+    }
+
+    /* Patch the dynamic fields and copy the template into the reply */
     {
         of_list_flow_stats_entry_t list;
-        of_flow_stats_entry_t stats_entry;
+        of_flow_stats_entry_t *stats_entry = entry->stats_template;
         of_flow_stats_reply_entries_bind(state->reply, &list);
-        of_flow_stats_entry_init(&stats_entry, state->reply->version, -1, 1);
-        if (of_list_flow_stats_entry_append_bind(&list, &stats_entry)) {
+
+        of_flow_stats_entry_duration_sec_set(stats_entry, secs);
+        of_flow_stats_entry_duration_nsec_set(stats_entry, nsecs);
+        of_flow_stats_entry_packet_count_set(stats_entry, flow_stats->packets);
+        of_flow_stats_entry_byte_count_set(stats_entry, flow_stats->bytes);
+
+        if (of_list_flow_stats_entry_append(&list, stats_entry) < 0) {
             AIM_LOG_INTERNAL("Failed to append to flow stats list");
             return;
         }
+    }
 
-        of_flow_stats_entry_cookie_set(&stats_entry, entry->cookie);
-        of_flow_stats_entry_priority_set(&stats_entry, entry->priority);
-        of_flow_stats_entry_idle_timeout_set(&stats_entry, entry->idle_timeout);
-        of_flow_stats_entry_hard_timeout_set(&stats_entry, entry->hard_timeout);
+    if (state->reply->length > (1 << 15)) { /* Last object would get too big */
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
+        state->reply = NULL;
+    }
+}
+
+static void
+ind_core_flow_stats_iter(void *cookie, ft_entry_t **entries, int count)
+{
+    struct ind_core_flow_stats_state *state = cookie;
+    indigo_fi_flow_stats_t flow_stats[FT_ITER_TASK_BATCH_SIZE];
+    indigo_error_t rvs[FT_ITER_TASK_BATCH_SIZE];
+    int i;
 
-        if (stats_entry.version >= OF_VERSION_1_3) {
-            of_flow_stats_entry_flags_set(&stats_entry, entry->flags);
+    if (count == 0) {
+        /* Send last reply */
+        if (state->reply == NULL) {
+            ind_core_flow_stats_reply_alloc(state);
         }
+        of_flow_stats_reply_flags_set(state->reply, 0);
+        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
 
-        of_match_t match;
-        minimatch_expand(&entry->minimatch, &match);
+        /* Clean up state */
+        indigo_cxn_resume(state->cxn_id);
+        aim_free(state);
+        return;
+    }
 
-        if (of_flow_stats_entry_match_set(&stats_entry, &match)) {
-            AIM_LOG_INTERNAL("Failed to set match in flow stats entry");
-            return;
-        }
+    ind_core_flow_stats_get_batch(state->cxn_id, entries, count, flow_stats, rvs, true);
 
-        if (stats_entry.version == entry->effects.actions->version) {
-            if (stats_entry.version == OF_VERSION_1_0) {
-                if (of_flow_stats_entry_actions_set(
-                        &stats_entry, entry->effects.actions) < 0) {
-                    AIM_LOG_INTERNAL("Failed to set actions list of flow stats entry");
-                    return;
-                }
-            } else {
-                if (of_flow_stats_entry_instructions_set(
-                        &stats_entry, entry->effects.instructions) < 0) {
-                    AIM_LOG_INTERNAL("Failed to set instructions list of flow stats entry");
-                    return;
-                }
-            }
+    for (i = 0; i < count; i++) {
+        if (rvs[i] != INDIGO_ERROR_NONE) {
+            AIM_LOG_ERROR("Failed to get stats for flow "INDIGO_FLOW_ID_PRINTF_FORMAT": %s",
+                          entries[i]->id, indigo_strerror(rvs[i]));
+            continue;
         }
 
-        of_flow_stats_entry_table_id_set(&stats_entry, entry->table_id);
-        of_flow_stats_entry_duration_sec_set(&stats_entry, secs);
-        of_flow_stats_entry_duration_nsec_set(&stats_entry, nsecs);
-        of_flow_stats_entry_packet_count_set(&stats_entry, flow_stats.packets);
-        of_flow_stats_entry_byte_count_set(&stats_entry, flow_stats.bytes);
-    }
-
-    if (state->reply->length > (1 << 15)) { /* Last object would get too big */
-        indigo_cxn_send_controller_message(state->cxn_id, state->reply);
-        state->reply = NULL;
+        ind_core_flow_stats_append(state, entries[i], &flow_stats[i]);
     }
 }
 
@@ -1089,12 +1394,14 @@ ind_core_flow_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
 
     /* Set up the query structure */
     INDIGO_MEM_SET(&query, 0, sizeof(query));
-    of_match_t match;
-    if (of_flow_stats_request_match_get(obj, &match) < 0) {
-        AIM_LOG_INTERNAL("Failed to get flow stats match");
-        return;
+    if (!ind_core_match_wire_get(obj, STATS_REQUEST_MATCH_OFFSET, &query.minimatch)) {
+        of_match_t match;
+        if (of_flow_stats_request_match_get(obj, &match) < 0) {
+            AIM_LOG_INTERNAL("Failed to get flow stats match");
+            return;
+        }
+        minimatch_init(&query.minimatch, &match);
     }
-    minimatch_init(&query.minimatch, &match);
     of_flow_stats_request_table_id_get(obj, &(query.table_id));
     if (obj->version >= OF_VERSION_1_1) {
         of_flow_stats_request_cookie_get(obj, &query.cookie);
@@ -1112,8 +1419,8 @@ ind_core_flow_stats_request_handler(of_object_t *_obj, indigo_cxn_id_t cxn_id)
     state->reply = NULL;
     indigo_cxn_pause(cxn_id);
 
-    rv = ft_spawn_iter_task(ind_core_ft, &query, ind_core_flow_stats_iter,
-                            state, IND_SOC_NORMAL_PRIORITY);
+    rv = ft_spawn_batch_iter_task(ind_core_ft, &query, ind_core_flow_stats_iter,
+                                  state, IND_SOC_NORMAL_PRIORITY);
     if (rv != INDIGO_ERROR_NONE) {
         AIM_LOG_INTERNAL("Failed to start flow stats iter: %s", indigo_strerror(rv));
         indigo_cxn_resume(cxn_id);
@@ -1133,32 +1440,27 @@ struct ind_core_aggregate_stats_state {
 };
 
 static void
-ind_core_aggregate_stats_iter(void *cookie, ft_entry_t *entry)
+ind_core_aggregate_stats_iter(void *cookie, ft_entry_t **entries, int count)
 {
     struct ind_core_aggregate_stats_state *state = cookie;
-    indigo_error_t rv;
-
-    if (entry != NULL) {
-        indigo_fi_flow_stats_t flow_stats = {
-            .packets = -1,
-            .bytes = -1,
-        };
+    indigo_fi_flow_stats_t flow_stats[FT_ITER_TASK_BATCH_SIZE];
+    indigo_error_t rvs[FT_ITER_TASK_BATCH_SIZE];
+    int i;
 
-        ind_core_table_t *table = ind_core_table_get(entry->table_id);
-        AIM_ASSERT(table != NULL);
+    if (count > 0) {
+        ind_core_flow_stats_get_batch(state->cxn_id, entries, count, flow_stats, rvs, true);
 
-        rv = table->ops->entry_stats_get(table->priv, state->cxn_id,
-                                         entry->priv, &flow_stats);
+        for (i = 0; i < count; i++) {
+            if (rvs[i] != INDIGO_ERROR_NONE) {
+                AIM_LOG_ERROR("Failed to get stats for flow "INDIGO_FLOW_ID_PRINTF_FORMAT": %s",
+                              entries[i]->id, indigo_strerror(rvs[i]));
+                continue;
+            }
 
-        if (rv != INDIGO_ERROR_NONE) {
-            AIM_LOG_ERROR("Failed to get stats for flow "INDIGO_FLOW_ID_PRINTF_FORMAT": %s",
-                          entry->id, indigo_strerror(rv));
-            return;
+            state->bytes += flow_stats[i].bytes;
+            state->packets += flow_stats[i].packets;
+            state->flows += 1;
         }
-
-        state->bytes += flow_stats.bytes;
-        state->packets += flow_stats.packets;
-        state->flows += 1;
     } else {
         of_aggregate_stats_reply_t* reply;
         reply = of_aggregate_stats_reply_new(state->version);
@@ -1194,12 +1496,14 @@ ind_core_aggregate_stats_request_handler(of_object_t *_obj,
 
     /* Set up the query structure */
     INDIGO_MEM_SET(&query, 0, sizeof(query));
-    of_match_t match;
-    if (of_aggregate_stats_request_match_get(obj, &match) < 0) {
-        AIM_LOG_INTERNAL("Failed to get aggregate stats match.");
-        return;
+    if (!ind_core_match_wire_get(obj, STATS_REQUEST_MATCH_OFFSET, &query.minimatch)) {
+        of_match_t match;
+        if (of_aggregate_stats_request_match_get(obj, &match) < 0) {
+            AIM_LOG_INTERNAL("Failed to get aggregate stats match.");
+            return;
+        }
+        minimatch_init(&query.minimatch, &match);
     }
-    minimatch_init(&query.minimatch, &match);
     of_aggregate_stats_request_table_id_get(obj, &(query.table_id));
     if (obj->version >= OF_VERSION_1_1) {
         of_aggregate_stats_request_cookie_get(obj, &query.cookie);
@@ -1218,8 +1522,8 @@ ind_core_aggregate_stats_request_handler(of_object_t *_obj,
     state->flows = 0;
     indigo_cxn_pause(cxn_id);
 
-    rv = ft_spawn_iter_task(ind_core_ft, &query, ind_core_aggregate_stats_iter,
-                            state, IND_SOC_NORMAL_PRIORITY);
+    rv = ft_spawn_batch_iter_task(ind_core_ft, &query, ind_core_aggregate_stats_iter,
+                                  state, IND_SOC_NORMAL_PRIORITY);
     if (rv != INDIGO_ERROR_NONE) {
         AIM_LOG_INTERNAL("Failed to start aggregate stats iter: %s", indigo_strerror(rv));
         indigo_cxn_resume(cxn_id);
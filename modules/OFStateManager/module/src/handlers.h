@@ -29,6 +29,18 @@
 #include <loci/loci.h>
 #include <indigo/of_connection_manager.h>
 
+/*
+ * Truncate the object to its initial length.
+ *
+ * This is called by the stats handlers to reuse a single allocated entry.
+ */
+static inline void
+truncate_of_object(of_object_t *obj)
+{
+    of_object_init_map[obj->object_id](obj, obj->version, -1, 0);
+    obj->wbuf->current_bytes = obj->length;
+}
+
 /* handlers.c */
 extern void ind_core_unhandled_message(
     of_object_t *obj,
@@ -0,0 +1,170 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Convert between the OXM match in a message and a minimatch without
+ * going through of_match_t
+ *
+ * of_match_t holds every match field, so expanding a minimatch into one
+ * and having LOCI serialize it costs far more than the handful of fields
+ * a typical flow actually uses. These helpers read and write the ofp_match
+ * directly. They only handle OpenFlow 1.2+ OXM matches with basic class
+ * fields; callers fall back to the LOCI accessors when they fail.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <loci/loci.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+
+#define OFPMT_OXM 1
+#define MATCH_HEADER_LEN 4
+#define OXM_HEADER_LEN 4
+#define OFPXMC_OPENFLOW_BASIC 0x8000
+#define OFPXMT_OFB_IN_PORT 0
+
+static inline uint16_t
+get_u16(const uint8_t *buf)
+{
+    return (buf[0] << 8) | buf[1];
+}
+
+static inline uint32_t
+get_u32(const uint8_t *buf)
+{
+    return ((uint32_t)buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+/* Returns the OXM list of the match at 'offset', or NULL */
+static const uint8_t *
+match_wire_oxms(of_object_t *obj, int offset, int *oxms_len)
+{
+    const uint8_t *match;
+    uint16_t length;
+
+    if (obj->version < OF_VERSION_1_2 || offset + MATCH_HEADER_LEN > obj->length) {
+        return NULL;
+    }
+
+    match = OF_OBJECT_BUFFER_INDEX(obj, offset);
+    length = get_u16(match + 2);
+
+    if (get_u16(match) != OFPMT_OXM || length < MATCH_HEADER_LEN ||
+            offset + length > obj->length) {
+        return NULL;
+    }
+
+    *oxms_len = length - MATCH_HEADER_LEN;
+    return match + MATCH_HEADER_LEN;
+}
+
+bool
+ind_core_match_wire_get(of_object_t *obj, int offset, minimatch_t *minimatch)
+{
+    const uint8_t *oxms;
+    int oxms_len;
+
+    if ((oxms = match_wire_oxms(obj, offset, &oxms_len)) == NULL) {
+        return false;
+    }
+
+    return minimatch_init_oxm(minimatch, obj->version, oxms, oxms_len) == 0;
+}
+
+bool
+ind_core_match_wire_in_port_get(of_object_t *obj, int offset, of_port_no_t *in_port)
+{
+    const uint8_t *oxm;
+    int oxms_len;
+
+    if ((oxm = match_wire_oxms(obj, offset, &oxms_len)) == NULL) {
+        return false;
+    }
+
+    while (oxms_len >= OXM_HEADER_LEN) {
+        int len = OXM_HEADER_LEN + oxm[3];
+
+        if (len > oxms_len) {
+            return false;
+        }
+
+        if (get_u16(oxm) == OFPXMC_OPENFLOW_BASIC &&
+                (oxm[2] >> 1) == OFPXMT_OFB_IN_PORT) {
+            if (oxm[2] & 1 || oxm[3] != 4) {
+                /* Masked */
+                return false;
+            }
+            *in_port = get_u32(oxm + OXM_HEADER_LEN);
+            return true;
+        }
+
+        oxm += len;
+        oxms_len -= len;
+    }
+
+    /* Not matched on */
+    *in_port = 0;
+    return true;
+}
+
+indigo_error_t
+ind_core_match_wire_set(of_object_t *obj, int offset, const minimatch_t *minimatch)
+{
+    uint8_t buf[MATCH_HEADER_LEN + MINIMATCH_OXM_MAX_LEN + 8];
+    const uint8_t *match;
+    int oxm_len, old_len, new_len;
+
+    if (obj->version < OF_VERSION_1_2 || minimatch->version != obj->version ||
+            offset + MATCH_HEADER_LEN > obj->length) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+
+    /* LOCI initializes the match to an empty OXM list */
+    match = OF_OBJECT_BUFFER_INDEX(obj, offset);
+    old_len = get_u16(match + 2);
+    if (get_u16(match) != OFPMT_OXM || old_len < MATCH_HEADER_LEN) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+    old_len = (old_len + 7) & ~7;
+    if (offset + old_len > obj->length) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+
+    oxm_len = minimatch_to_oxm(minimatch, buf + MATCH_HEADER_LEN, MINIMATCH_OXM_MAX_LEN);
+    if (oxm_len < 0) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+
+    buf[0] = 0;
+    buf[1] = OFPMT_OXM;
+    buf[2] = (MATCH_HEADER_LEN + oxm_len) >> 8;
+    buf[3] = (MATCH_HEADER_LEN + oxm_len) & 0xff;
+
+    new_len = (MATCH_HEADER_LEN + oxm_len + 7) & ~7;
+    memset(buf + MATCH_HEADER_LEN + oxm_len, 0, new_len - MATCH_HEADER_LEN - oxm_len);
+
+    of_wire_buffer_replace_data(OF_OBJECT_TO_WBUF(obj), obj->obj_offset + offset,
+                                old_len, buf, new_len);
+    of_object_parent_length_update(obj, new_len - old_len);
+
+    return INDIGO_ERROR_NONE;
+}
@@ -0,0 +1,130 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/**
+ * @file
+ * @brief Two-level occupancy bitmap
+ *
+ * Tracks which slots of a bucket array are non-empty. Each bit of the
+ * summary level covers one 64-bit word of the leaf level and is set when
+ * that word is non-zero, so finding the next occupied slot skips 4096
+ * empty slots per summary bit examined.
+ */
+
+#ifndef _OCCUPANCY_BITMAP_H_
+#define _OCCUPANCY_BITMAP_H_
+
+#include <AIM/aim.h>
+#include <stdint.h>
+
+typedef struct occupancy_bitmap {
+    uint32_t size; /* number of slots */
+    uint32_t num_leaves;
+    uint32_t num_summary;
+    uint64_t *leaves; /* bit per slot */
+    uint64_t *summary; /* bit per non-zero leaf word */
+} occupancy_bitmap_t;
+
+static inline void
+occupancy_bitmap_init(occupancy_bitmap_t *bitmap, uint32_t size)
+{
+    bitmap->size = size;
+    bitmap->num_leaves = (size + 63) / 64;
+    bitmap->num_summary = (bitmap->num_leaves + 63) / 64;
+    bitmap->leaves = aim_zmalloc(bitmap->num_leaves * sizeof(uint64_t));
+    bitmap->summary = aim_zmalloc(bitmap->num_summary * sizeof(uint64_t));
+}
+
+static inline void
+occupancy_bitmap_cleanup(occupancy_bitmap_t *bitmap)
+{
+    aim_free(bitmap->leaves);
+    aim_free(bitmap->summary);
+    bitmap->leaves = NULL;
+    bitmap->summary = NULL;
+    bitmap->size = 0;
+}
+
+static inline void
+occupancy_bitmap_set(occupancy_bitmap_t *bitmap, uint32_t idx)
+{
+    uint32_t leaf = idx / 64;
+    bitmap->leaves[leaf] |= (uint64_t)1 << (idx % 64);
+    bitmap->summary[leaf / 64] |= (uint64_t)1 << (leaf % 64);
+}
+
+static inline void
+occupancy_bitmap_clear(occupancy_bitmap_t *bitmap, uint32_t idx)
+{
+    uint32_t leaf = idx / 64;
+    bitmap->leaves[leaf] &= ~((uint64_t)1 << (idx % 64));
+    if (bitmap->leaves[leaf] == 0) {
+        bitmap->summary[leaf / 64] &= ~((uint64_t)1 << (leaf % 64));
+    }
+}
+
+/* Memory used by the bitmap, not including the struct itself */
+static inline uint64_t
+occupancy_bitmap_bytes(const occupancy_bitmap_t *bitmap)
+{
+    return (uint64_t)(bitmap->num_leaves + bitmap->num_summary) * sizeof(uint64_t);
+}
+
+/**
+ * Find the first occupied slot at or after 'idx'
+ *
+ * @returns The slot index, or the bitmap size if there is none
+ */
+static inline uint32_t
+occupancy_bitmap_next(const occupancy_bitmap_t *bitmap, uint32_t idx)
+{
+    uint32_t leaf, summary;
+    uint64_t bits;
+
+    if (idx >= bitmap->size) {
+        return bitmap->size;
+    }
+
+    /* Remainder of the current leaf word */
+    leaf = idx / 64;
+    bits = bitmap->leaves[leaf] & (~(uint64_t)0 << (idx % 64));
+    if (bits != 0) {
+        return leaf * 64 + __builtin_ctzll(bits);
+    }
+
+    /* Next non-zero leaf word according to the summary */
+    leaf++;
+    summary = leaf / 64;
+    if (summary >= bitmap->num_summary) {
+        return bitmap->size;
+    }
+
+    bits = bitmap->summary[summary] & (~(uint64_t)0 << (leaf % 64));
+    while (bits == 0) {
+        if (++summary >= bitmap->num_summary) {
+            return bitmap->size;
+        }
+        bits = bitmap->summary[summary];
+    }
+
+    leaf = summary * 64 + __builtin_ctzll(bits);
+    return leaf * 64 + __builtin_ctzll(bitmap->leaves[leaf]);
+}
+
+#endif /* _OCCUPANCY_BITMAP_H_ */
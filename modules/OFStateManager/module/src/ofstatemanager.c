@@ -74,6 +74,10 @@ debug_counter_t ft_flow_counter;
 debug_counter_t ft_add_counter;
 debug_counter_t ft_delete_counter;
 debug_counter_t ft_modify_counter;
+debug_counter_t ft_overwrite_elided_counter;
+debug_counter_t ft_effects_created_counter;
+debug_counter_t ft_effects_freed_counter;
+debug_counter_t ind_core_gentable_modify_elided_counter;
 debug_counter_t ft_forwarding_add_error_counter;
 
 
@@ -111,6 +115,11 @@ indigo_core_packet_in(of_packet_in_t *packet_in)
         return INDIGO_ERROR_NONE;
     }
 
+    if (!ind_core_packet_in_limit_check(packet_in)) {
+        of_object_delete(packet_in);
+        return INDIGO_ERROR_NONE;
+    }
+
     indigo_cxn_send_async_message(packet_in);
 
     return INDIGO_ERROR_NONE;
@@ -122,12 +131,14 @@ indigo_core_packet_in(of_packet_in_t *packet_in)
 /**
  * @brief Send a flow removed message for the given entry
  * @param entry The local flow table entry
+ * @param cxn_id Connection whose request removed the flow, if any
  */
 
 static void
 send_flow_removed_message(ft_entry_t *entry,
                           indigo_fi_flow_removed_t reason,
-                          indigo_fi_flow_stats_t *final_stats)
+                          indigo_fi_flow_stats_t *final_stats,
+                          indigo_cxn_id_t cxn_id)
 {
     of_flow_removed_t *msg;
     uint32_t secs;
@@ -161,13 +172,15 @@ send_flow_removed_message(ft_entry_t *entry,
         of_flow_removed_hard_timeout_set(msg, entry->hard_timeout);
     }
 
-    of_match_t match;
-    minimatch_expand(&entry->minimatch, &match);
+    if (ind_core_match_wire_set(msg, FLOW_REMOVED_MATCH_OFFSET, &entry->minimatch) < 0) {
+        of_match_t match;
+        minimatch_expand(&entry->minimatch, &match);
 
-    if (of_flow_removed_match_set(msg, &match)) {
-        AIM_LOG_INTERNAL("Failed to set match in flow removed message");
-        of_object_delete(msg);
-        return;
+        if (of_flow_removed_match_set(msg, &match)) {
+            AIM_LOG_INTERNAL("Failed to set match in flow removed message");
+            of_object_delete(msg);
+            return;
+        }
     }
 
     if (reason > INDIGO_FLOW_REMOVED_DELETE) {
@@ -188,7 +201,7 @@ send_flow_removed_message(ft_entry_t *entry,
     of_flow_removed_packet_count_set(msg, packets);
     of_flow_removed_byte_count_set(msg, bytes);
 
-    indigo_cxn_send_async_message(msg);
+    ind_core_flow_notification_send(msg, cxn_id);
 }
 
 
@@ -502,6 +515,11 @@ indigo_core_receive_controller_message(indigo_cxn_id_t cxn, of_object_t *obj)
 
 static of_dpid_t ind_core_dpid = OFSTATEMANAGER_CONFIG_DPID_DEFAULT;
 
+static void flow_entry_deleted(ind_core_table_t *table, ft_entry_t *entry,
+                               indigo_fi_flow_removed_t reason,
+                               indigo_fi_flow_stats_t *final_stats,
+                               indigo_cxn_id_t cxn_id);
+
 /* Allow the DPID to be set by the configuration */
 indigo_error_t
 indigo_core_dpid_set(of_dpid_t dpid)
@@ -601,6 +619,26 @@ ind_core_init(ind_core_config_t *config)
         "ofstatemanager.flow_modify",
         "Modify to the OpenFlow flowtable");
 
+    debug_counter_register(
+        &ft_overwrite_elided_counter,
+        "ofstatemanager.flow_overwrite_elided",
+        "Flow overwrite with unchanged instructions not sent to Forwarding");
+
+    debug_counter_register(
+        &ft_effects_created_counter,
+        "ofstatemanager.flow_effects_created",
+        "Shared action/instruction list created in the OpenFlow flowtable");
+
+    debug_counter_register(
+        &ft_effects_freed_counter,
+        "ofstatemanager.flow_effects_freed",
+        "Shared action/instruction list freed from the OpenFlow flowtable");
+
+    debug_counter_register(
+        &ind_core_gentable_modify_elided_counter,
+        "ofstatemanager.gentable_modify_elided",
+        "Gentable modify with unchanged value not sent to Forwarding");
+
     debug_counter_register(
         &ft_forwarding_add_error_counter,
         "ofstatemanager.forwarding_add_failure",
@@ -608,6 +646,14 @@ ind_core_init(ind_core_config_t *config)
 
     ind_core_histogram_handlers_init();
 
+    ind_core_checksum_tree_handlers_init();
+
+    ind_core_cookie_index_handlers_init();
+
+    ind_core_expiration_init();
+
+    ind_core_packet_in_limit_init();
+
     ind_core_init_done = 1;
 
     return INDIGO_ERROR_NONE;
@@ -645,10 +691,87 @@ ind_core_flow_entry_delete(ft_entry_t *entry, indigo_fi_flow_removed_t reason,
         /* Ignoring failure */
     }
 
+    flow_entry_deleted(table, entry, reason, &flow_stats, cxn_id);
+}
+
+/**
+ * @brief Delete several flow entries, batching the Forwarding deletes
+ *
+ * Flows in a table with an entry_delete_bulk op are deleted with one call
+ * per table. Otherwise, or if the bulk op fails, this is equivalent to
+ * calling ind_core_flow_entry_delete for each flow.
+ */
+
+void
+ind_core_flow_entry_delete_batch(ft_entry_t **entries, int count,
+                                 indigo_fi_flow_removed_t reason,
+                                 indigo_cxn_id_t cxn_id)
+{
+    void *privs[FT_ITER_TASK_BATCH_SIZE];
+    indigo_fi_flow_stats_t flow_stats[FT_ITER_TASK_BATCH_SIZE];
+    ft_entry_t *group[FT_ITER_TASK_BATCH_SIZE];
+    bool done[FT_ITER_TASK_BATCH_SIZE];
+    int i, j, n;
+
+    AIM_ASSERT(count <= FT_ITER_TASK_BATCH_SIZE);
+
+    for (i = 0; i < count; i++) {
+        done[i] = false;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (done[i]) {
+            continue;
+        }
+
+        ind_core_table_t *table = ind_core_table_get(entries[i]->table_id);
+        AIM_ASSERT(table != NULL);
+
+        /* Collect the remaining flows in this table */
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (!done[j] && entries[j]->table_id == entries[i]->table_id) {
+                done[j] = true;
+                group[n] = entries[j];
+                privs[n] = entries[j]->priv;
+                flow_stats[n] = (indigo_fi_flow_stats_t) {
+                    .packets = -1,
+                    .bytes = -1,
+                };
+                n++;
+            }
+        }
+
+        if (n > 1 && table->ops->entry_delete_bulk != NULL &&
+                table->ops->entry_delete_bulk(table->priv, cxn_id, privs,
+                                              n, flow_stats) == INDIGO_ERROR_NONE) {
+            AIM_LOG_TRACE("Removed %d flows from table %d", n, entries[i]->table_id);
+            for (j = 0; j < n; j++) {
+                flow_entry_deleted(table, group[j], reason, &flow_stats[j], cxn_id);
+            }
+            continue;
+        }
+
+        for (j = 0; j < n; j++) {
+            ind_core_flow_entry_delete(group[j], reason, cxn_id);
+        }
+    }
+}
+
+/*
+ * Bookkeeping after Forwarding has deleted a flow
+ */
+
+static void
+flow_entry_deleted(ind_core_table_t *table, ft_entry_t *entry,
+                   indigo_fi_flow_removed_t reason,
+                   indigo_fi_flow_stats_t *final_stats,
+                   indigo_cxn_id_t cxn_id)
+{
     if (entry->flags & OF_FLOW_MOD_FLAG_SEND_FLOW_REM) {
         /* See OF spec 1.0.1, section 3.5, page 6 */
         if (reason != INDIGO_FLOW_REMOVED_OVERWRITE) {
-            send_flow_removed_message(entry, reason, &flow_stats);
+            send_flow_removed_message(entry, reason, final_stats, cxn_id);
         }
     }
 
@@ -674,6 +797,10 @@ ind_core_enable_set(int enable)
         ind_soc_timer_event_register_with_priority(
             ind_core_expiration_timer, NULL,
             ind_core_config.stats_check_ms, IND_SOC_LOW_PRIORITY);
+        /* Expiration is already approximate, let it share wakeups */
+        ind_soc_timer_event_slack_set(
+            ind_core_expiration_timer, NULL,
+            ind_core_config.stats_check_ms / 4);
         ind_core_module_enabled = 1;
     } else if (!enable && ind_core_module_enabled) {
         AIM_LOG_VERBOSE("Disabling OF state mgr");
@@ -712,6 +839,14 @@ ind_core_finish(void)
         ind_core_enable_set(0);
     }
 
+    ind_core_counter_cache_finish();
+
+    ind_core_flow_notification_finish();
+
+    ind_core_expiration_finish();
+
+    ind_core_packet_in_limit_finish();
+
     ft_destroy(ind_core_ft);
 
     ind_core_test_gentable_finish();
@@ -969,6 +1104,7 @@ ind_core_ft_stats(aim_pvs_t *pvs)
     ft = ind_core_ft;
     aim_printf(pvs, "Flow table stats:\n");
     aim_printf(pvs, "  Current count:  %d\n", ft->current_count);
+    aim_printf(pvs, "  Effects:        %u\n", bighash_entry_count(ft->effects_hashtable));
     aim_printf(pvs, "  Adds:           %"PRIu64"\n", debug_counter_get(&ft_add_counter));
     aim_printf(pvs, "  Deletes:        %"PRIu64"\n", debug_counter_get(&ft_delete_counter));
     aim_printf(pvs, "  Modified:       %"PRIu64"\n", debug_counter_get(&ft_modify_counter));
@@ -29,6 +29,7 @@
 #include <OFStateManager/ofstatemanager_config.h>
 #include <OFStateManager/ofstatemanager.h>
 #include "ofstatemanager_int.h"
+#include "ft.h"
 #include "ofstatemanager_log.h"
 #include <stdlib.h>
 #include <cjson/cJSON.h>
@@ -126,8 +127,76 @@ static struct {
     of_desc_str_t mfr_desc;
     of_serial_num_t serial_num;
     of_dpid_t dpid;
+    int counter_cache_max_age_ms;
+    int counter_cache_refresh_rate;
+    int cookie_index_bits;
+    int cookie_index_shift;
+    int flow_notification_rate;
+    int flow_notification_max_queue;
+    int packet_in_limit_rate;
+    int packet_in_limit_burst;
+    int packet_in_limit_per_port;
+    int packet_in_limit_dedup_ms;
+    int packet_in_limit_max_classes;
 } staged_config;
 
+/**
+ * Get an optional non-negative integer from the JSON object with given key
+ *
+ * @returns 0 on success, -1 if the key is present but invalid
+ *
+ * If the key is not present, dest is set to default_value.
+ */
+
+static int
+get_optional_uint_default(int *dest, cJSON *root, char *key, int default_value)
+{
+    indigo_error_t err;
+
+    err = ind_cfg_lookup_int(root, key, dest);
+    if (err == INDIGO_ERROR_NOT_FOUND) {
+        *dest = default_value;
+    } else if (err < 0) {
+        AIM_LOG_ERROR("Config: Could not parse %s", key);
+        return -1;
+    } else if (*dest < 0) {
+        AIM_LOG_ERROR("Config: %s must not be negative", key);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+get_optional_uint(int *dest, cJSON *root, char *key)
+{
+    return get_optional_uint_default(dest, root, key, 0);
+}
+
+/**
+ * Get an optional boolean from the JSON object with given key
+ *
+ * @returns 0 on success, -1 if the key is present but not a boolean
+ *
+ * If the key is not present, dest is set to default_value.
+ */
+
+static int
+get_optional_bool_default(int *dest, cJSON *root, char *key, int default_value)
+{
+    indigo_error_t err;
+
+    err = ind_cfg_lookup_bool(root, key, dest);
+    if (err == INDIGO_ERROR_NOT_FOUND) {
+        *dest = default_value;
+    } else if (err < 0) {
+        AIM_LOG_ERROR("Config: %s must be a boolean", key);
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  * Get a fixed length string from the JSON object with given key
  *
@@ -207,6 +276,49 @@ ind_core_cfg_stage(cJSON *config)
         return err;
     }
 
+    err = 0;
+    err |= get_optional_uint(&staged_config.counter_cache_max_age_ms,
+                             config, "flow_counter_cache.max_age_ms");
+    err |= get_optional_uint(&staged_config.counter_cache_refresh_rate,
+                             config, "flow_counter_cache.refresh_rate");
+    err |= get_optional_uint_default(&staged_config.cookie_index_bits,
+                                     config, "flow_cookie_index.bits",
+                                     FT_COOKIE_INDEX_DEFAULT_BITS);
+    err |= get_optional_uint_default(&staged_config.cookie_index_shift,
+                                     config, "flow_cookie_index.shift",
+                                     FT_COOKIE_INDEX_DEFAULT_SHIFT);
+    err |= get_optional_uint(&staged_config.flow_notification_rate,
+                             config, "flow_notification.rate");
+    err |= get_optional_uint_default(&staged_config.flow_notification_max_queue,
+                                     config, "flow_notification.max_queue",
+                                     FLOW_NOTIFICATION_DEFAULT_MAX_QUEUE);
+    err |= get_optional_uint(&staged_config.packet_in_limit_rate,
+                             config, "packet_in_limit.rate");
+    err |= get_optional_uint(&staged_config.packet_in_limit_burst,
+                             config, "packet_in_limit.burst");
+    err |= get_optional_bool_default(&staged_config.packet_in_limit_per_port,
+                                     config, "packet_in_limit.per_port", 1);
+    err |= get_optional_uint(&staged_config.packet_in_limit_dedup_ms,
+                             config, "packet_in_limit.dedup_ms");
+    err |= get_optional_uint_default(&staged_config.packet_in_limit_max_classes,
+                                     config, "packet_in_limit.max_classes",
+                                     PACKET_IN_LIMIT_DEFAULT_MAX_CLASSES);
+    if (err != 0) {
+        /* Error message logged by get_optional_uint */
+        return INDIGO_ERROR_PARAM;
+    }
+
+    if (staged_config.cookie_index_bits > FT_COOKIE_INDEX_MAX_BITS) {
+        AIM_LOG_ERROR("Config: flow_cookie_index.bits must be at most %d",
+                      FT_COOKIE_INDEX_MAX_BITS);
+        return INDIGO_ERROR_PARAM;
+    }
+
+    if (staged_config.cookie_index_bits + staged_config.cookie_index_shift > 64) {
+        AIM_LOG_ERROR("Config: flow_cookie_index bit range must be within the 64 bit cookie");
+        return INDIGO_ERROR_PARAM;
+    }
+
     return INDIGO_ERROR_NONE;
 }
 
@@ -228,6 +340,17 @@ ind_core_cfg_commit(void)
     (void)ind_core_mfr_desc_set(staged_config.mfr_desc);
     (void)ind_core_serial_num_set(staged_config.serial_num);
     (void)indigo_core_dpid_set(staged_config.dpid);
+    ind_core_counter_cache_config_set(staged_config.counter_cache_max_age_ms,
+                                      staged_config.counter_cache_refresh_rate);
+    ind_core_cookie_index_config_set(staged_config.cookie_index_bits,
+                                     staged_config.cookie_index_shift);
+    ind_core_flow_notification_config_set(staged_config.flow_notification_rate,
+                                          staged_config.flow_notification_max_queue);
+    ind_core_packet_in_limit_config_set(staged_config.packet_in_limit_rate,
+                                        staged_config.packet_in_limit_burst,
+                                        staged_config.packet_in_limit_per_port != 0,
+                                        staged_config.packet_in_limit_dedup_ms,
+                                        staged_config.packet_in_limit_max_classes);
 }
 
 const struct ind_cfg_ops ind_core_cfg_ops = {
@@ -44,8 +44,18 @@ extern void ind_core_flow_entry_delete(ft_entry_t *entry,
                                        indigo_fi_flow_removed_t reason,
                                        indigo_cxn_id_t cxn_id);
 
+extern void ind_core_flow_entry_delete_batch(ft_entry_t **entries, int count,
+                                             indigo_fi_flow_removed_t reason,
+                                             indigo_cxn_id_t cxn_id);
+
 void ind_core_group_init(void);
 
+extern debug_counter_t ind_core_gentable_modify_elided_counter;
+
 void ind_core_histogram_handlers_init(void);
 
+void ind_core_checksum_tree_handlers_init(void);
+
+void ind_core_cookie_index_handlers_init(void);
+
 #endif /* OFSTATEMANAGER_DECS_H */
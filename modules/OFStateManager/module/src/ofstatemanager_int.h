@@ -36,6 +36,7 @@
 #include <SocketManager/socketmanager.h>
 #include <OFStateManager/ofstatemanager_config.h>
 #include <cjson/cJSON.h>
+#include <minimatch/minimatch.h>
 
 /**
  * Local state manager configuration data
@@ -82,6 +83,92 @@ extern const struct ind_cfg_ops ind_core_cfg_ops;
 void ind_core_test_gentable_init(void);
 void ind_core_test_gentable_finish(void);
 
+/*
+ * Gentable checksum tree
+ *
+ * Level 0 is the root and level 'depth' holds the checksum buckets.
+ * See gentable_handlers.c.
+ */
+indigo_error_t ind_core_gentable_checksum_tree_depth(
+    uint16_t table_id, uint32_t *depth);
+indigo_error_t ind_core_gentable_checksum_tree_get(
+    uint16_t table_id, uint32_t level, uint32_t index, uint32_t count,
+    of_checksum_128_t *checksums);
+
+/*
+ * Flow counter cache
+ *
+ * ind_core_flow_stats_get_batch fetches the counters of up to
+ * FT_ITER_TASK_BATCH_SIZE flows, using cached counters if use_cache is set
+ * and they are fresh enough. rvs[i] is the result for entries[i].
+ * See counter_cache.c.
+ */
+struct ft_entry_s;
+void ind_core_counter_cache_config_set(int max_age_ms, int refresh_rate);
+void ind_core_counter_cache_finish(void);
+void ind_core_flow_stats_get_batch(
+    indigo_cxn_id_t cxn_id, struct ft_entry_s **entries, int count,
+    indigo_fi_flow_stats_t *flow_stats, indigo_error_t *rvs, bool use_cache);
+
+/*
+ * Coalesced flow-removed and idle notifications
+ *
+ * ind_core_flow_notification_send takes ownership of the message. If cxn_id
+ * is specified it is sent immediately, otherwise it is queued and sent after
+ * the current task slice, subject to the rate limit. Producers should stop
+ * while ind_core_flow_notification_full returns true. See flow_notification.c.
+ */
+#define FLOW_NOTIFICATION_DEFAULT_MAX_QUEUE 65536
+void ind_core_flow_notification_config_set(int rate, int max_queue);
+void ind_core_flow_notification_send(of_object_t *msg, indigo_cxn_id_t cxn_id);
+int ind_core_flow_notification_pending(void);
+bool ind_core_flow_notification_full(void);
+void ind_core_flow_notification_finish(void);
+
+/*
+ * Flow cookie index
+ *
+ * See cookie_index_handlers.c.
+ */
+void ind_core_cookie_index_config_set(int bits, int shift);
+
+/*
+ * Packet-in rate limiting and deduplication
+ *
+ * ind_core_packet_in_limit_check returns false if the packet-in should be
+ * dropped. See packet_in_limit.c.
+ */
+#define PACKET_IN_LIMIT_DEFAULT_MAX_CLASSES 4096
+void ind_core_packet_in_limit_init(void);
+void ind_core_packet_in_limit_config_set(
+    int rate, int burst, bool per_port, int dedup_ms, int max_classes);
+bool ind_core_packet_in_limit_check(of_packet_in_t *packet_in);
+void ind_core_packet_in_limit_finish(void);
+
+/* Offsets of the ofp_match in OpenFlow 1.2+ objects */
+#define FLOW_MOD_MATCH_OFFSET 48
+#define FLOW_REMOVED_MATCH_OFFSET 48
+#define FLOW_STATS_ENTRY_MATCH_OFFSET 48
+#define STATS_REQUEST_MATCH_OFFSET 48
+#define BSN_FLOW_IDLE_MATCH_OFFSET 32
+#define PACKET_IN_MATCH_OFFSET(version) ((version) >= OF_VERSION_1_3 ? 24 : 16)
+
+/*
+ * Direct OXM match access
+ *
+ * 'offset' is the offset of the ofp_match within the object. The getters
+ * return false and the setter returns an error if the match can't be
+ * handled directly, in which case the caller should use LOCI.
+ * ind_core_match_wire_in_port_get reads only the in_port field.
+ * See match_wire.c.
+ */
+bool ind_core_match_wire_get(
+    of_object_t *obj, int offset, minimatch_t *minimatch);
+bool ind_core_match_wire_in_port_get(
+    of_object_t *obj, int offset, of_port_no_t *in_port);
+indigo_error_t ind_core_match_wire_set(
+    of_object_t *obj, int offset, const minimatch_t *minimatch);
+
 #include <OFStateManager/ofstatemanager.h>
 
 #endif /* __OFSTATEMANAGER_INT_H__ */
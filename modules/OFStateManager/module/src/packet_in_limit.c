@@ -0,0 +1,607 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * Packet-in rate limiting and deduplication
+ *
+ * Packet-ins that no listener consumed are sorted into classes by reason,
+ * table ID, and (if "packet_in_limit.per_port" is set, the default) ingress
+ * port. If "packet_in_limit.rate" is set, each class has a token bucket
+ * allowing that many packet-ins per second with a burst of
+ * "packet_in_limit.burst" (default one second's worth). At most
+ * "packet_in_limit.max_classes" classes are tracked; packet-ins in further
+ * classes share a single overflow class. A class that has seen no
+ * packet-ins for PACKET_IN_CLASS_IDLE_MS is forgotten, along with its
+ * counters, to make room for new ones.
+ *
+ * If "packet_in_limit.dedup_ms" is set, a packet-in is also dropped if a
+ * packet-in for the same flow in the same class was sent less than that
+ * many milliseconds ago. The flow is identified by the Ethernet, VLAN, IP,
+ * and TCP/UDP port headers of the packet. Duplicates are tracked in a
+ * fixed-size table, so some duplicates are missed when many flows are
+ * active at once. Each slot keeps the full flow key, so distinct flows
+ * are never mistaken for duplicates.
+ *
+ * The "packet_in_limit" generic stats request takes no TLVs. The reply has
+ * one entry per class, each with a uint64_list TLV containing the ingress
+ * port, reason, table ID, and the number of packet-ins sent, dropped by the
+ * rate limit, and dropped as duplicates. The overflow class is reported
+ * with port OFPP_ANY and reason and table ID 0xff once it has been used.
+ */
+
+#include "ofstatemanager_log.h"
+
+#include <OFStateManager/ofstatemanager_config.h>
+#include <indigo/indigo.h>
+#include <SocketManager/socketmanager.h>
+#include <loci/loci.h>
+#include <murmur/murmur.h>
+#include <BigHash/bighash.h>
+#include <debug_counter/debug_counter.h>
+#include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
+#include "handlers.h"
+
+#define PACKET_IN_DEDUP_SLOTS 4096
+#define PACKET_IN_DEDUP_MAX_VLANS 2
+#define PACKET_IN_DEDUP_PAYLOAD_BYTES 64
+/* MACs, VLAN IDs, ethertype, and the larger of the L3/L4 fields or payload */
+#define PACKET_IN_DEDUP_KEY_MAX \
+    (12 + 2 * PACKET_IN_DEDUP_MAX_VLANS + 2 + PACKET_IN_DEDUP_PAYLOAD_BYTES)
+#define PACKET_IN_HASH_SEED 0
+#define PACKET_IN_CLASS_IDLE_MS 60000
+
+struct packet_in_class_key {
+    of_port_no_t in_port;
+    uint8_t reason;
+    uint8_t table_id;
+    uint16_t pad;
+};
+
+struct packet_in_class {
+    bighash_entry_t hash_entry;
+    struct packet_in_class_key key;
+    int tokens;
+    indigo_time_t last_refill;
+    indigo_time_t last_used;
+    uint64_t sent;
+    uint64_t rate_limited;
+    uint64_t deduplicated;
+};
+
+struct packet_in_dedup_slot {
+    indigo_time_t time; /* 0 if empty */
+    struct packet_in_class_key class_key;
+    uint16_t key_len;
+    uint8_t key[PACKET_IN_DEDUP_KEY_MAX];
+};
+
+static int rate; /* packet-ins per second per class, 0 for unlimited */
+static int burst;
+static bool per_port = true;
+static int dedup_ms;
+static int max_classes = PACKET_IN_LIMIT_DEFAULT_MAX_CLASSES;
+
+static bighash_table_t *classes;
+static int num_classes;
+static bool aging_timer_registered;
+static struct packet_in_class overflow_class = {
+    .key = { .in_port = OF_PORT_DEST_WILDCARD, .reason = 0xff, .table_id = 0xff },
+};
+
+static struct packet_in_dedup_slot *dedup_table;
+
+static debug_counter_t rate_limit_drop_counter;
+static debug_counter_t dedup_drop_counter;
+
+static void handle_packet_in_limit_request(indigo_cxn_id_t cxn_id, of_bsn_generic_stats_request_t *req, void *priv);
+static void aging_timer(void *cookie);
+
+void
+ind_core_packet_in_limit_init(void)
+{
+    debug_counter_register(
+        &rate_limit_drop_counter,
+        "ofstatemanager.packet_in_rate_limit_drop",
+        "Packet-in dropped by the per-class rate limit");
+
+    debug_counter_register(
+        &dedup_drop_counter,
+        "ofstatemanager.packet_in_dedup_drop",
+        "Packet-in dropped as a duplicate of a recent packet-in");
+
+    indigo_core_generic_stats_register("packet_in_limit",
+                                       handle_packet_in_limit_request, NULL);
+}
+
+static void
+classes_clear(void)
+{
+    bighash_iter_t iter;
+    bighash_entry_t *hash_entry;
+
+    if (classes == NULL) {
+        return;
+    }
+
+    for (hash_entry = bighash_iter_start(classes, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct packet_in_class *class =
+            container_of(hash_entry, hash_entry, struct packet_in_class);
+        bighash_remove(classes, hash_entry);
+        aim_free(class);
+    }
+
+    num_classes = 0;
+    overflow_class.tokens = burst;
+    overflow_class.last_refill = INDIGO_CURRENT_TIME;
+    overflow_class.sent = 0;
+    overflow_class.rate_limited = 0;
+    overflow_class.deduplicated = 0;
+}
+
+void
+ind_core_packet_in_limit_config_set(int new_rate, int new_burst, bool new_per_port,
+                                    int new_dedup_ms, int new_max_classes)
+{
+    if (new_burst <= 0) {
+        new_burst = new_rate;
+    }
+
+    if (new_max_classes <= 0) {
+        new_max_classes = PACKET_IN_LIMIT_DEFAULT_MAX_CLASSES;
+    }
+
+    if (new_rate == rate && new_burst == burst && new_per_port == per_port &&
+            new_dedup_ms == dedup_ms && new_max_classes == max_classes) {
+        return;
+    }
+
+    rate = new_rate;
+    burst = new_burst;
+    per_port = new_per_port;
+    dedup_ms = new_dedup_ms;
+    max_classes = new_max_classes;
+
+    /* Start over with full buckets */
+    classes_clear();
+
+    if ((rate > 0 || dedup_ms > 0) && classes == NULL) {
+        classes = bighash_table_create(BIGHASH_AUTOGROW);
+        AIM_TRUE_OR_DIE(classes != NULL);
+    }
+
+    if ((rate > 0 || dedup_ms > 0) && !aging_timer_registered) {
+        if (ind_soc_timer_event_register_with_priority(
+                aging_timer, NULL, PACKET_IN_CLASS_IDLE_MS,
+                IND_SOC_LOW_PRIORITY) < 0) {
+            AIM_LOG_ERROR("Failed to register packet-in class aging timer");
+        } else {
+            aging_timer_registered = true;
+        }
+    } else if (rate <= 0 && dedup_ms <= 0 && aging_timer_registered) {
+        ind_soc_timer_event_unregister(aging_timer, NULL);
+        aging_timer_registered = false;
+    }
+
+    if (dedup_ms > 0) {
+        if (dedup_table == NULL) {
+            dedup_table = aim_malloc(sizeof(*dedup_table) * PACKET_IN_DEDUP_SLOTS);
+        }
+        memset(dedup_table, 0, sizeof(*dedup_table) * PACKET_IN_DEDUP_SLOTS);
+    } else {
+        aim_free(dedup_table);
+        dedup_table = NULL;
+    }
+}
+
+void
+ind_core_packet_in_limit_finish(void)
+{
+    if (aging_timer_registered) {
+        ind_soc_timer_event_unregister(aging_timer, NULL);
+        aging_timer_registered = false;
+    }
+
+    classes_clear();
+
+    if (classes != NULL) {
+        bighash_table_destroy(classes, NULL);
+        classes = NULL;
+    }
+
+    aim_free(dedup_table);
+    dedup_table = NULL;
+
+    rate = 0;
+    burst = 0;
+    per_port = true;
+    dedup_ms = 0;
+    max_classes = PACKET_IN_LIMIT_DEFAULT_MAX_CLASSES;
+}
+
+static void
+class_key_get(of_packet_in_t *packet_in, struct packet_in_class_key *key)
+{
+    memset(key, 0, sizeof(*key));
+
+    of_packet_in_reason_get(packet_in, &key->reason);
+
+    if (packet_in->version >= OF_VERSION_1_1) {
+        of_packet_in_table_id_get(packet_in, &key->table_id);
+    }
+
+    if (per_port) {
+        if (packet_in->version <= OF_VERSION_1_1) {
+            of_packet_in_in_port_get(packet_in, &key->in_port);
+        } else if (!ind_core_match_wire_in_port_get(
+                       packet_in, PACKET_IN_MATCH_OFFSET(packet_in->version),
+                       &key->in_port)) {
+            of_match_t match;
+            if (of_packet_in_match_get(packet_in, &match) == 0) {
+                key->in_port = match.fields.in_port;
+            }
+        }
+    }
+}
+
+/*
+ * Forget classes that have seen no packet-ins for PACKET_IN_CLASS_IDLE_MS
+ */
+static void
+aging_timer(void *cookie)
+{
+    bighash_iter_t iter;
+    bighash_entry_t *hash_entry;
+    indigo_time_t now = INDIGO_CURRENT_TIME;
+
+    if (classes == NULL) {
+        return;
+    }
+
+    for (hash_entry = bighash_iter_start(classes, &iter);
+         hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+        struct packet_in_class *class =
+            container_of(hash_entry, hash_entry, struct packet_in_class);
+        if (INDIGO_TIME_DIFF_ms(class->last_used, now) >= PACKET_IN_CLASS_IDLE_MS) {
+            AIM_LOG_TRACE("Removing idle packet-in class port %u reason %u table %u",
+                          class->key.in_port, class->key.reason, class->key.table_id);
+            bighash_remove(classes, hash_entry);
+            aim_free(class);
+            num_classes--;
+        }
+    }
+}
+
+static struct packet_in_class *
+class_lookup(const struct packet_in_class_key *key, uint32_t hash)
+{
+    bighash_entry_t *hash_entry;
+    struct packet_in_class *class;
+
+    for (hash_entry = bighash_first(classes, hash);
+         hash_entry != NULL; hash_entry = bighash_next(hash_entry)) {
+        class = container_of(hash_entry, hash_entry, struct packet_in_class);
+        if (!memcmp(&class->key, key, sizeof(*key))) {
+            return class;
+        }
+    }
+
+    if (num_classes >= max_classes) {
+        return &overflow_class;
+    }
+
+    class = aim_zmalloc(sizeof(*class));
+    class->key = *key;
+    class->tokens = burst;
+    class->last_refill = INDIGO_CURRENT_TIME;
+    bighash_insert(classes, &class->hash_entry, hash);
+    num_classes++;
+
+    return class;
+}
+
+static void
+refill_tokens(struct packet_in_class *class, indigo_time_t now)
+{
+    int elapsed_ms = INDIGO_TIME_DIFF_ms(class->last_refill, now);
+    int added = (int64_t)elapsed_ms * rate / 1000;
+
+    if (added > 0) {
+        class->tokens += added;
+        class->last_refill += (int64_t)added * 1000 / rate;
+    }
+
+    if (class->tokens >= burst) {
+        class->tokens = burst;
+        class->last_refill = now;
+    }
+}
+
+static inline uint16_t
+get_u16(const uint8_t *buf)
+{
+    return (buf[0] << 8) | buf[1];
+}
+
+static void
+flow_key_append(uint8_t *key, int *key_len, const uint8_t *src, int len)
+{
+    AIM_ASSERT(*key_len + len <= PACKET_IN_DEDUP_KEY_MAX);
+    memcpy(key + *key_len, src, len);
+    *key_len += len;
+}
+
+/*
+ * Extract the headers identifying the flow a packet belongs to
+ *
+ * Returns the length of the key written to 'key', which must hold
+ * PACKET_IN_DEDUP_KEY_MAX bytes.
+ */
+static int
+flow_key_get(const uint8_t *data, int len, uint8_t *key)
+{
+    uint8_t ethertype[2];
+    int key_len = 0;
+    int offset;
+    int vlans = 0;
+
+    if (len < 14) {
+        flow_key_append(key, &key_len, data, len);
+        return key_len;
+    }
+
+    /* Destination and source MAC */
+    flow_key_append(key, &key_len, data, 12);
+    memcpy(ethertype, data + 12, 2);
+    offset = 14;
+
+    /* VLAN tags */
+    while ((get_u16(ethertype) == 0x8100 || get_u16(ethertype) == 0x88a8) &&
+            offset + 4 <= len && vlans < PACKET_IN_DEDUP_MAX_VLANS) {
+        flow_key_append(key, &key_len, data + offset, 2);
+        memcpy(ethertype, data + offset + 2, 2);
+        offset += 4;
+        vlans++;
+    }
+
+    flow_key_append(key, &key_len, ethertype, 2);
+
+    if (get_u16(ethertype) == 0x0800 && offset + 20 <= len) {
+        const uint8_t *ip = data + offset;
+        int ihl = (ip[0] & 0xf) * 4;
+        bool first_fragment = (get_u16(ip + 6) & 0x1fff) == 0;
+
+        /* Protocol, source and destination addresses */
+        flow_key_append(key, &key_len, ip + 9, 1);
+        flow_key_append(key, &key_len, ip + 12, 8);
+
+        if ((ip[9] == 6 || ip[9] == 17) && first_fragment &&
+                ihl >= 20 && offset + ihl + 4 <= len) {
+            flow_key_append(key, &key_len, ip + ihl, 4);
+        }
+    } else if (get_u16(ethertype) == 0x86dd && offset + 40 <= len) {
+        const uint8_t *ip6 = data + offset;
+
+        /* Next header, source and destination addresses */
+        flow_key_append(key, &key_len, ip6 + 6, 1);
+        flow_key_append(key, &key_len, ip6 + 8, 32);
+
+        if ((ip6[6] == 6 || ip6[6] == 17) && offset + 44 <= len) {
+            flow_key_append(key, &key_len, ip6 + 40, 4);
+        }
+    } else {
+        /* Use the start of the payload as-is */
+        int n = len - offset < PACKET_IN_DEDUP_PAYLOAD_BYTES ?
+            len - offset : PACKET_IN_DEDUP_PAYLOAD_BYTES;
+        flow_key_append(key, &key_len, data + offset, n);
+    }
+
+    return key_len;
+}
+
+/* Returns true if a packet-in for the same flow was sent recently */
+static bool
+dedup_check(of_packet_in_t *packet_in, const struct packet_in_class_key *class_key,
+            uint32_t class_hash, indigo_time_t now)
+{
+    of_octets_t data;
+    struct packet_in_dedup_slot *slot;
+    uint8_t key[PACKET_IN_DEDUP_KEY_MAX];
+    int key_len;
+
+    of_packet_in_data_get(packet_in, &data);
+    key_len = flow_key_get(data.data, data.bytes, key);
+    slot = &dedup_table[murmur_hash(key, key_len, class_hash) % PACKET_IN_DEDUP_SLOTS];
+
+    /* Compare the whole key, a hash collision must not drop a new flow */
+    if (slot->time != 0 && INDIGO_TIME_DIFF_ms(slot->time, now) < dedup_ms &&
+            !memcmp(&slot->class_key, class_key, sizeof(*class_key)) &&
+            slot->key_len == key_len && !memcmp(slot->key, key, key_len)) {
+        return true;
+    }
+
+    slot->time = now;
+    slot->class_key = *class_key;
+    slot->key_len = key_len;
+    memcpy(slot->key, key, key_len);
+    return false;
+}
+
+bool
+ind_core_packet_in_limit_check(of_packet_in_t *packet_in)
+{
+    struct packet_in_class_key key;
+    struct packet_in_class *class;
+    indigo_time_t now;
+    uint32_t hash;
+
+    if (rate <= 0 && dedup_ms <= 0) {
+        return true;
+    }
+
+    now = INDIGO_CURRENT_TIME;
+
+    class_key_get(packet_in, &key);
+    hash = murmur_hash(&key, sizeof(key), PACKET_IN_HASH_SEED);
+    class = class_lookup(&key, hash);
+    class->last_used = now;
+
+    if (rate > 0) {
+        refill_tokens(class, now);
+        if (class->tokens <= 0) {
+            AIM_LOG_TRACE("Rate limiting packet-in on port %u reason %u table %u",
+                          key.in_port, key.reason, key.table_id);
+            class->rate_limited++;
+            debug_counter_inc(&rate_limit_drop_counter);
+            return false;
+        }
+    }
+
+    if (dedup_ms > 0 && dedup_check(packet_in, &key, hash, now)) {
+        AIM_LOG_TRACE("Dropping duplicate packet-in on port %u reason %u table %u",
+                      key.in_port, key.reason, key.table_id);
+        class->deduplicated++;
+        debug_counter_inc(&dedup_drop_counter);
+        return false;
+    }
+
+    if (rate > 0) {
+        class->tokens--;
+    }
+
+    class->sent++;
+    return true;
+}
+
+static void
+stats_entry_populate(of_object_t *entry, struct packet_in_class *class)
+{
+    of_object_t tlvs;
+    of_object_t tlv;
+    of_list_uint64_t uint64s;
+    int i;
+
+    of_bsn_generic_stats_entry_tlvs_bind(entry, &tlvs);
+
+    of_bsn_tlv_uint64_list_init(&tlv, tlvs.version, -1, 1);
+    of_list_bsn_tlv_append_bind(&tlvs, &tlv);
+
+    of_bsn_tlv_uint64_list_value_bind(&tlv, &uint64s);
+
+    uint64_t values[] = {
+        class->key.in_port,
+        class->key.reason,
+        class->key.table_id,
+        class->sent,
+        class->rate_limited,
+        class->deduplicated,
+    };
+
+    for (i = 0; i < AIM_ARRAYSIZE(values); i++) {
+        of_uint64_t elem;
+        of_uint64_init(&elem, uint64s.version, -1, 1);
+        of_list_uint64_append_bind(&uint64s, &elem);
+        of_uint64_value_set(&elem, values[i]);
+    }
+}
+
+static void
+stats_entry_append(indigo_cxn_id_t cxn_id, of_object_t **reply,
+                   of_object_t *entry, uint32_t xid)
+{
+    of_object_t entries;
+
+    of_bsn_generic_stats_reply_entries_bind(*reply, &entries);
+
+    if (of_list_append(&entries, entry) < 0) {
+        /* This entry didn't fit, send out the current message and
+         * allocate a new one. */
+        of_bsn_generic_stats_reply_flags_set(*reply, OF_STATS_REPLY_FLAG_REPLY_MORE);
+        indigo_cxn_send_controller_message(cxn_id, *reply);
+
+        *reply = of_bsn_generic_stats_reply_new((*reply)->version);
+        AIM_TRUE_OR_DIE(*reply != NULL);
+
+        of_bsn_generic_stats_reply_xid_set(*reply, xid);
+        of_bsn_generic_stats_reply_entries_bind(*reply, &entries);
+
+        if (of_list_append(&entries, entry) < 0) {
+            AIM_DIE("unexpected failure appending single packet_in_limit stats entry");
+        }
+    }
+
+    truncate_of_object(entry);
+}
+
+static void
+handle_packet_in_limit_request(
+    indigo_cxn_id_t cxn_id,
+    of_bsn_generic_stats_request_t *req,
+    void *priv)
+{
+    uint32_t xid;
+
+    of_bsn_generic_stats_request_xid_get(req, &xid);
+
+    of_object_t tlvs;
+    of_bsn_generic_stats_request_tlvs_bind(req, &tlvs);
+
+    of_object_t tlv;
+    if (of_list_bsn_tlv_first(&tlvs, &tlv) == 0) {
+        char err[128];
+        snprintf(err, sizeof(err), "Expected empty TLV list, found %s", of_class_name(&tlv));
+        indigo_cxn_send_bsn_error(cxn_id, req, err);
+        return;
+    }
+
+    of_object_t *reply = of_bsn_generic_stats_reply_new(req->version);
+    if (reply == NULL) {
+        AIM_LOG_ERROR("Failed to allocate bsn_generic_stats_reply");
+        return;
+    }
+
+    of_bsn_generic_stats_reply_xid_set(reply, xid);
+
+    of_object_t *entry = of_bsn_generic_stats_entry_new(req->version);
+    AIM_TRUE_OR_DIE(entry != NULL);
+
+    if (classes != NULL) {
+        bighash_iter_t iter;
+        bighash_entry_t *hash_entry;
+
+        for (hash_entry = bighash_iter_start(classes, &iter);
+             hash_entry != NULL; hash_entry = bighash_iter_next(&iter)) {
+            struct packet_in_class *class =
+                container_of(hash_entry, hash_entry, struct packet_in_class);
+            stats_entry_populate(entry, class);
+            stats_entry_append(cxn_id, &reply, entry, xid);
+        }
+    }
+
+    if (overflow_class.sent > 0 || overflow_class.rate_limited > 0 ||
+            overflow_class.deduplicated > 0) {
+        stats_entry_populate(entry, &overflow_class);
+        stats_entry_append(cxn_id, &reply, entry, xid);
+    }
+
+    of_object_delete(entry);
+
+    indigo_cxn_send_controller_message(cxn_id, reply);
+}
@@ -18,9 +18,10 @@
  ****************************************************************/
 
 /*
- * Port/queue registration APIs
+ * Port/queue/VLAN registration APIs
  *
- * These APIs allow OFStateManager to iterate over available ports and queues.
+ * These APIs allow OFStateManager to iterate over available ports, queues,
+ * and VLANs.
  */
 
 #include <indigo/of_state_manager.h>
@@ -37,6 +38,11 @@ struct ind_core_queue ind_core_queues[OFSTATEMANAGER_CONFIG_MAX_QUEUES];
 
 int ind_core_ports_registered;
 
+struct slot_allocator *ind_core_vlan_allocator;
+struct ind_core_vlan ind_core_vlans[IND_CORE_MAX_VLANS];
+
+int ind_core_vlans_registered;
+
 void
 indigo_core_port_register(of_port_no_t port_no, struct ind_core_port **handle)
 {
@@ -83,9 +89,36 @@ indigo_core_queue_unregister(struct ind_core_queue *handle)
     slot_allocator_free(ind_core_queue_allocator, slot);
 }
 
+void
+indigo_core_vlan_register(uint16_t vlan_vid, struct ind_core_vlan **handle)
+{
+    AIM_ASSERT(vlan_vid > 0 && vlan_vid < 4096);
+
+    uint32_t slot = slot_allocator_alloc(ind_core_vlan_allocator);
+    if (slot == SLOT_INVALID) {
+        AIM_DIE("Attempted to register more than %d VLANs", IND_CORE_MAX_VLANS);
+    }
+
+    AIM_ASSERT(slot < IND_CORE_MAX_VLANS);
+    *handle = &ind_core_vlans[slot];
+    ind_core_vlans[slot].vlan_vid = vlan_vid;
+    ind_core_vlans_registered++;
+}
+
+void
+indigo_core_vlan_unregister(struct ind_core_vlan *handle)
+{
+    AIM_ASSERT(ind_core_vlans_registered > 0);
+    ind_core_vlans_registered--;
+    uint32_t slot = handle - ind_core_vlans;
+    AIM_ASSERT(slot < IND_CORE_MAX_VLANS);
+    slot_allocator_free(ind_core_vlan_allocator, slot);
+}
+
 void
 ind_core_port_init(void)
 {
     ind_core_port_allocator = slot_allocator_create(OFSTATEMANAGER_CONFIG_MAX_PORTS);
     ind_core_queue_allocator = slot_allocator_create(OFSTATEMANAGER_CONFIG_MAX_QUEUES);
+    ind_core_vlan_allocator = slot_allocator_create(IND_CORE_MAX_VLANS);
 }
@@ -35,6 +35,13 @@ struct ind_core_queue {
     uint32_t queue_id;
 };
 
+struct ind_core_vlan {
+    uint16_t vlan_vid;
+};
+
+/* VLANs 1-4095 */
+#define IND_CORE_MAX_VLANS 4095
+
 extern struct slot_allocator *ind_core_port_allocator;
 extern struct ind_core_port ind_core_ports[OFSTATEMANAGER_CONFIG_MAX_PORTS]; 
 
@@ -44,6 +51,12 @@ extern struct ind_core_queue ind_core_queues[OFSTATEMANAGER_CONFIG_MAX_QUEUES];
 /* Number of ports currently registered */
 extern int ind_core_ports_registered;
 
+extern struct slot_allocator *ind_core_vlan_allocator;
+extern struct ind_core_vlan ind_core_vlans[IND_CORE_MAX_VLANS];
+
+/* Number of VLANs currently registered */
+extern int ind_core_vlans_registered;
+
 void ind_core_port_init(void);
 
 #endif
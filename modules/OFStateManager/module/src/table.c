@@ -33,19 +33,34 @@ ind_core_table_get(uint8_t table_id)
     return ind_core_tables[table_id];
 }
 
-void indigo_core_table_register(uint8_t table_id, const char *name,
-                                const indigo_core_table_ops_t *ops, void *priv)
+/*
+ * Delete every flow in a table, including dead ones left by
+ * ind_core_table_clear which Forwarding no longer has
+ */
+static void
+delete_table_flows(uint8_t table_id)
 {
-    AIM_TRUE_OR_DIE(strlen(name) <= OF_MAX_TABLE_NAME_LEN);
-
     list_links_t *cur, *next;
     ft_entry_t *entry;
     FT_ITER(ind_core_ft, entry, cur, next) {
-        if (entry->table_id == table_id) {
+        if (entry->table_id != table_id) {
+            continue;
+        }
+        if (ft_entry_dead(ind_core_ft, entry)) {
+            ft_delete(ind_core_ft, entry);
+        } else {
             ind_core_flow_entry_delete(entry, OF_FLOW_REMOVED_REASON_DELETE,
                                        INDIGO_CXN_ID_UNSPECIFIED);
         }
     }
+}
+
+void indigo_core_table_register(uint8_t table_id, const char *name,
+                                const indigo_core_table_ops_t *ops, void *priv)
+{
+    AIM_TRUE_OR_DIE(strlen(name) <= OF_MAX_TABLE_NAME_LEN);
+
+    delete_table_flows(table_id);
 
     ind_core_table_t *table = aim_zmalloc(sizeof(*table));
     strncpy(table->name, name, sizeof(table->name));
@@ -60,20 +75,99 @@ void indigo_core_table_register(uint8_t table_id, const char *name,
     AIM_LOG_VERBOSE("Registered flowtable \"%s\" with table id %d", name, table_id);
 }
 
-void indigo_core_table_unregister(uint8_t table_id)
+indigo_error_t
+indigo_core_table_elide_noop_overwrite_set(uint8_t table_id, bool enable)
 {
     ind_core_table_t *table = ind_core_tables[table_id];
-    AIM_TRUE_OR_DIE(table != NULL);
+    if (table == NULL) {
+        return INDIGO_ERROR_NOT_FOUND;
+    }
 
-    list_links_t *cur, *next;
-    ft_entry_t *entry;
-    FT_ITER(ind_core_ft, entry, cur, next) {
-        if (entry->table_id == table_id) {
-            ind_core_flow_entry_delete(entry, OF_FLOW_REMOVED_REASON_DELETE,
-                                       INDIGO_CXN_ID_UNSPECIFIED);
+    table->elide_noop_overwrite = enable;
+    return INDIGO_ERROR_NONE;
+}
+
+static void
+clear_reap_cb(void *cookie, ft_entry_t *entry)
+{
+    indigo_cxn_id_t *cxn_id = cookie;
+
+    if (entry != NULL) {
+        ft_delete(ind_core_ft, entry);
+    } else {
+        indigo_cxn_resume(*cxn_id);
+        aim_free(cxn_id);
+    }
+}
+
+/*
+ * Delete every flow in a table with a single call to the clear op
+ *
+ * The flows are then hidden from the flowtable at once and freed without
+ * calling entry_delete by a task, with the connection paused until it
+ * finishes. Fails without changing the table if the table has no clear
+ * op, a flow needs a flow-removed message, or the clear op fails, in which
+ * case the caller deletes the flows one at a time.
+ */
+indigo_error_t
+ind_core_table_clear(uint8_t table_id, indigo_cxn_id_t cxn_id)
+{
+    ind_core_table_t *table = ind_core_tables[table_id];
+    indigo_cxn_id_t *state;
+    indigo_error_t rv;
+
+    if (table == NULL || table->ops->clear == NULL || table_id >= FT_MAX_TABLES) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+
+    if (table->num_flows == 0) {
+        return INDIGO_ERROR_NONE;
+    }
+
+    if (ind_core_ft->tables[table_id].send_flow_rem_count > 0) {
+        return INDIGO_ERROR_NOT_SUPPORTED;
+    }
+
+    rv = table->ops->clear(table->priv, cxn_id);
+    if (rv < 0) {
+        AIM_LOG_VERBOSE("Failed to clear flowtable \"%s\", deleting flows individually: %s",
+                        table->name, indigo_strerror(rv));
+        return rv;
+    }
+
+    ft_table_kill(ind_core_ft, table_id);
+    table->num_flows = 0;
+
+    state = aim_malloc(sizeof(*state));
+    *state = cxn_id;
+    indigo_cxn_pause(cxn_id);
+
+    rv = ft_spawn_dead_iter_task(ind_core_ft, table_id, clear_reap_cb, state,
+                                 IND_SOC_NORMAL_PRIORITY);
+    if (rv < 0) {
+        list_links_t *cur, *next;
+        ft_entry_t *entry;
+
+        AIM_LOG_INTERNAL("Failed to spawn flowtable clear task: %s", indigo_strerror(rv));
+        FT_ITER(ind_core_ft, entry, cur, next) {
+            if (entry->table_id == table_id && ft_entry_dead(ind_core_ft, entry)) {
+                ft_delete(ind_core_ft, entry);
+            }
         }
+        indigo_cxn_resume(cxn_id);
+        aim_free(state);
     }
 
+    return INDIGO_ERROR_NONE;
+}
+
+void indigo_core_table_unregister(uint8_t table_id)
+{
+    ind_core_table_t *table = ind_core_tables[table_id];
+    AIM_TRUE_OR_DIE(table != NULL);
+
+    delete_table_flows(table_id);
+
     aim_free(table);
     ind_core_tables[table_id] = NULL;
     ind_core_num_tables_registered--;
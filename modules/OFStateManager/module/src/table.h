@@ -31,9 +31,12 @@ typedef struct ind_core_table_s {
     void *priv;
     const indigo_core_table_ops_t *ops;
     uint32_t num_flows;
+    bool elide_noop_overwrite; /* see indigo_core_table_elide_noop_overwrite_set */
 } ind_core_table_t;
 
 ind_core_table_t *ind_core_table_get(uint8_t table_id);
 
+indigo_error_t ind_core_table_clear(uint8_t table_id, indigo_cxn_id_t cxn_id);
+
 #endif
 
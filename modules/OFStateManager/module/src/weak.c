@@ -27,6 +27,7 @@
 #include <OFStateManager/ofstatemanager_config.h>
 #include <indigo/indigo.h>
 #include <indigo/forwarding.h>
+#include <indigo/port_manager.h>
 #include <loci/loci.h>
 
 #ifdef __GNUC__
@@ -45,6 +46,19 @@ indigo_fwd_vlan_stats_get(
     /* All counters default to -1 */
 }
 
+WEAK void
+indigo_fwd_vlan_stats_get_many(
+    const uint16_t *vlan_vids,
+    int count,
+    indigo_fi_vlan_stats_t *vlan_stats)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        indigo_fwd_vlan_stats_get(vlan_vids[i], &vlan_stats[i]);
+    }
+}
+
 WEAK void
 indigo_port_extended_stats_get(
     of_port_no_t port_no,
@@ -53,4 +67,17 @@ indigo_port_extended_stats_get(
     /* All counters default to -1 */
 }
 
+WEAK void
+indigo_port_extended_stats_get_many(
+    const of_port_no_t *port_nos,
+    int count,
+    indigo_fi_port_stats_t *port_stats)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        indigo_port_extended_stats_get(port_nos[i], &port_stats[i]);
+    }
+}
+
 #endif
@@ -45,12 +45,20 @@
 extern void handle_message(of_object_t *obj);
 extern int do_barrier(void);
 
+/* Defined in gentable_handlers.c */
+extern indigo_error_t ind_core_gentable_checksum_tree_depth(
+    uint16_t table_id, uint32_t *depth);
+extern indigo_error_t ind_core_gentable_checksum_tree_get(
+    uint16_t table_id, uint32_t level, uint32_t index, uint32_t count,
+    of_checksum_128_t *checksums);
+
 static void do_add(uint32_t port, of_mac_addr_t mac, uint8_t csum_hi);
 static void do_delete(uint32_t port);
 static void do_clear(void);
 static void do_entry_stats(void);
 static void do_set_buckets_size(uint32_t buckets_size);
 static void parse_key(of_list_bsn_tlv_t *key, of_port_no_t *port);
+static void parse_value(of_list_bsn_tlv_t *value, of_mac_addr_t *mac);
 
 struct test_entry {
     of_mac_addr_t mac;
@@ -67,8 +75,11 @@ struct test_table {
     int count_modify;
     int count_delete;
     int count_stats;
+    int count_stats_bulk;
     int count_starts;
     int count_finishes;
+    int count_clears;
+    indigo_error_t clear_rv;
     struct test_entry entries[NUM_ENTRIES];
 };
 
@@ -76,6 +87,8 @@ static struct test_table table;
 
 static indigo_core_gentable_ops_t test_ops;
 static indigo_core_gentable_ops_t test_ops2;
+static indigo_core_gentable_ops_t test_ops_bulk;
+static indigo_core_gentable_ops_t test_ops_clear;
 
 static const of_mac_addr_t mac1 = { { 0xab, 0xcd, 0xef, 0xff, 0xff, 0x01 } };
 static const of_mac_addr_t mac2 = { { 0xab, 0xcd, 0xef, 0xff, 0xff, 0x02 } };
@@ -181,6 +194,42 @@ test_gentable_entry_modify(void)
     return TEST_PASS;
 }
 
+static int
+test_gentable_elide_noop_modify(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 8, &gentable);
+    indigo_core_gentable_elide_noop_modify_set(gentable, true);
+
+    do_add(1, mac1, 0);
+    AIM_TRUE_OR_DIE(table.count_add == 1);
+
+    /* Same checksum and value */
+    do_add(1, mac1, 0);
+    AIM_TRUE_OR_DIE(table.count_modify == 0);
+
+    /* Same checksum, different value */
+    do_add(1, mac2, 0);
+    AIM_TRUE_OR_DIE(table.count_modify == 1);
+    AIM_TRUE_OR_DIE(!memcmp(&table.entries[1].mac, &mac2, sizeof(of_mac_addr_t)));
+
+    /* Different checksum, same value */
+    do_add(1, mac2, 1);
+    AIM_TRUE_OR_DIE(table.count_modify == 2);
+
+    /* Every modify is passed through once disabled */
+    indigo_core_gentable_elide_noop_modify_set(gentable, false);
+    do_add(1, mac2, 1);
+    AIM_TRUE_OR_DIE(table.count_modify == 3);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
 static int
 test_gentable_clear(void)
 {
@@ -211,6 +260,68 @@ test_gentable_clear(void)
     return TEST_PASS;
 }
 
+static int
+test_gentable_clear_op(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops_clear, &table, 10, 8, &gentable);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_id(gentable) == TABLE_ID);
+
+    /* Whole table clear uses the clear op */
+    do_add(1, mac1, 0x00);
+    do_add(2, mac2, 0x80);
+
+    memset(&table, 0, sizeof(table));
+    do_clear();
+    AIM_TRUE_OR_DIE(table.count_clears == 1);
+    AIM_TRUE_OR_DIE(table.count_delete == 0);
+    AIM_TRUE_OR_DIE(table.count_op == 1);
+
+    /* The entries are gone */
+    memset(&table, 0, sizeof(table));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(table.count_stats == 0);
+
+    do_add(1, mac1, 0x00);
+    AIM_TRUE_OR_DIE(table.count_add == 1);
+    AIM_TRUE_OR_DIE(table.count_modify == 0);
+
+    /* A referenced entry forces per-entry deletes */
+    do_add(2, mac2, 0x80);
+    {
+        of_object_t *tlv = of_bsn_tlv_port_new(OF_VERSION_1_3);
+        of_bsn_tlv_port_value_set(tlv, 1);
+        AIM_TRUE_OR_DIE(indigo_core_gentable_acquire(gentable, tlv) != NULL);
+
+        memset(&table, 0, sizeof(table));
+        do_clear();
+        AIM_TRUE_OR_DIE(table.count_clears == 0);
+        AIM_TRUE_OR_DIE(table.count_delete == 1);
+        AIM_TRUE_OR_DIE(table.entries[2].count_delete == 1);
+
+        indigo_core_gentable_release(gentable, tlv);
+        of_object_delete(tlv);
+    }
+
+    /* A failed clear op falls back to per-entry deletes */
+    do_add(2, mac2, 0x80);
+
+    memset(&table, 0, sizeof(table));
+    table.clear_rv = INDIGO_ERROR_UNKNOWN;
+    do_clear();
+    AIM_TRUE_OR_DIE(table.count_clears == 1);
+    AIM_TRUE_OR_DIE(table.count_delete == 2);
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_unregister(gentable);
+    AIM_TRUE_OR_DIE(table.count_op == 0);
+
+    return TEST_PASS;
+}
+
 static int
 test_gentable_entry_stats(void)
 {
@@ -241,6 +352,35 @@ test_gentable_entry_stats(void)
     return TEST_PASS;
 }
 
+static int
+test_gentable_entry_stats_bulk(void)
+{
+    int i;
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops_bulk, &table, 10, 8, &gentable);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_id(gentable) == TABLE_ID);
+
+    for (i = 0; i < NUM_ENTRIES; i++) {
+        do_add(i, mac1, 0);
+    }
+
+    /* All entries are in one checksum bucket */
+    memset(&table, 0, sizeof(table));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(table.count_stats_bulk == 1);
+    AIM_TRUE_OR_DIE(table.count_stats == NUM_ENTRIES);
+    for (i = 0; i < NUM_ENTRIES; i++) {
+        AIM_TRUE_OR_DIE(table.entries[i].count_stats == 1);
+    }
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
 static int
 test_gentable_long_running_task(void)
 {
@@ -311,6 +451,176 @@ test_gentable_long_running_task(void)
     return TEST_PASS;
 }
 
+static int
+test_gentable_set_buckets_size(void)
+{
+    int i;
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+    indigo_core_gentable_memory_stats_t stats;
+    uint64_t bucket_bytes;
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 4, &gentable);
+
+    for (i = 0; i < 8; i++) {
+        do_add(i, mac1, i << 5);
+    }
+
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    bucket_bytes = stats.bucket_bytes;
+
+    /* Grow; the barrier waits for the migration to finish */
+    do_set_buckets_size(16);
+    do_barrier();
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.bucket_bytes == bucket_bytes * 4);
+
+    /* Modify an entry while a shrink is in progress */
+    do_set_buckets_size(2);
+    do_add(0, mac2, 0);
+    AIM_TRUE_OR_DIE(!memcmp(&table.entries[0].mac, &mac2, sizeof(of_mac_addr_t)));
+    do_delete(7);
+    AIM_TRUE_OR_DIE(table.entries[7].count_delete == 1);
+
+    /* Entries are all still reachable by iteration */
+    memset(&table, 0, sizeof(table));
+    do_clear();
+    AIM_TRUE_OR_DIE(table.count_delete == 7);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
+static int
+test_gentable_sparse_buckets(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops_bulk, &table, 10, 65536, &gentable);
+
+    /* A few entries spread across a large bucket array */
+    do_add(1, mac1, 0x00);
+    do_add(2, mac1, 0x7f);
+    do_add(3, mac1, 0xff);
+
+    /* Only the occupied buckets are visited */
+    memset(&table, 0, sizeof(table));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(table.count_stats_bulk == 3);
+    AIM_TRUE_OR_DIE(table.count_stats == 3);
+
+    /* Entries stay reachable while they move between bucket arrays */
+    do_set_buckets_size(4);
+    do_delete(2);
+    memset(&table, 0, sizeof(table));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(table.count_stats == 2);
+    AIM_TRUE_OR_DIE(table.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(table.entries[3].count_stats == 1);
+
+    /* The emptied bucket is skipped */
+    memset(&table, 0, sizeof(table));
+    do_clear();
+    AIM_TRUE_OR_DIE(table.count_delete == 2);
+
+    memset(&table, 0, sizeof(table));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(table.count_stats == 0);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
+static int
+test_gentable_checksum_tree(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+    of_checksum_128_t nodes[8];
+    uint32_t depth;
+    const uint64_t lo = 0xFFEECCBBAA998877L;
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 8, &gentable);
+
+    /* Buckets 0, 4 and 7 */
+    do_add(1, mac1, 0x00);
+    do_add(2, mac1, 0x80);
+    do_add(3, mac1, 0xe0);
+
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_depth(TABLE_ID, &depth) == 0);
+    AIM_TRUE_OR_DIE(depth == 3);
+
+    /* Root, the low halves carry twice */
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 0, 0, 1, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == (0x80ULL << 56) + (0xe0ULL << 56) + 2);
+    AIM_TRUE_OR_DIE(nodes[0].lo == lo * 3);
+
+    /* Second level */
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 1, 0, 2, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[1].hi == (0x80ULL << 56) + (0xe0ULL << 56) + 1);
+    AIM_TRUE_OR_DIE(nodes[1].lo == lo * 2);
+
+    /* Leaves are the buckets */
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 3, 0, 8, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[4].hi == 0x80ULL << 56 && nodes[4].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[7].hi == 0xe0ULL << 56 && nodes[7].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[1].hi == 0 && nodes[1].lo == 0);
+
+    /* Out of range */
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 4, 0, 1, nodes) < 0);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 1, 1, 2, nodes) < 0);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 1, 2, 0, nodes) < 0);
+
+    /* Deleting an entry updates its ancestors */
+    do_delete(3);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 1, 1, 1, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0x80ULL << 56 && nodes[0].lo == lo);
+
+    /* The tree is rebuilt over the new buckets */
+    do_set_buckets_size(2);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_depth(TABLE_ID, &depth) == 0);
+    AIM_TRUE_OR_DIE(depth == 1);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 1, 0, 2, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[1].hi == 0x80ULL << 56 && nodes[1].lo == lo);
+    do_barrier();
+
+    /* Growing splits each old bucket between several leaves */
+    do_set_buckets_size(8);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_depth(TABLE_ID, &depth) == 0);
+    AIM_TRUE_OR_DIE(depth == 3);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 3, 0, 8, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[4].hi == 0x80ULL << 56 && nodes[4].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[1].hi == 0 && nodes[1].lo == 0);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 2, 2, 2, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0x80ULL << 56 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[1].hi == 0 && nodes[1].lo == 0);
+
+    /* A second resize waits for the first */
+    do_set_buckets_size(4);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_depth(TABLE_ID, &depth) == 0);
+    AIM_TRUE_OR_DIE(depth == 3);
+    do_barrier();
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_depth(TABLE_ID, &depth) == 0);
+    AIM_TRUE_OR_DIE(depth == 2);
+    AIM_TRUE_OR_DIE(ind_core_gentable_checksum_tree_get(TABLE_ID, 2, 0, 4, nodes) == 0);
+    AIM_TRUE_OR_DIE(nodes[0].hi == 0 && nodes[0].lo == lo);
+    AIM_TRUE_OR_DIE(nodes[2].hi == 0x80ULL << 56 && nodes[2].lo == lo);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
 static int
 test_gentable_lookup(void)
 {
@@ -404,6 +714,192 @@ test_gentable_acquire(void)
     return TEST_PASS;
 }
 
+static int
+test_gentable_entry_handle(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+    indigo_core_gentable_entry_t *entry;
+    uint32_t hash;
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 8, &gentable);
+
+    do_add(1, mac1, 0);
+
+    of_object_t *tlv = of_bsn_tlv_port_new(OF_VERSION_1_3);
+    of_bsn_tlv_port_value_set(tlv, 1);
+
+    entry = indigo_core_gentable_entry_lookup(gentable, tlv);
+    AIM_TRUE_OR_DIE(entry != NULL);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_entry_priv(entry) == &table.entries[1]);
+
+    hash = indigo_core_gentable_key_hash(tlv);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_entry_lookup_hash(gentable, tlv, hash) == entry);
+
+    /* Deletion is not allowed while a reference exists to the entry */
+    indigo_core_gentable_entry_acquire(entry);
+    memset(&table, 0, sizeof(table));
+    do_delete(1);
+    AIM_TRUE_OR_DIE(table.count_op == 0);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_entry_lookup(gentable, tlv) == entry);
+
+    indigo_core_gentable_entry_release(entry);
+    do_delete(1);
+    AIM_TRUE_OR_DIE(table.entries[1].count_delete == 1);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_entry_lookup(gentable, tlv) == NULL);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_entry_lookup_hash(gentable, tlv, hash) == NULL);
+
+    of_object_delete(tlv);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
+/* Index entries by the last byte of the MAC, except mac3 */
+static bool
+extract_mac_index(of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value, uint64_t *index_key)
+{
+    of_mac_addr_t mac;
+    parse_value(value, &mac);
+    *index_key = mac.addr[5];
+    return mac.addr[5] != mac3.addr[5];
+}
+
+/* Index entries by port parity */
+static bool
+extract_port_index(of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value, uint64_t *index_key)
+{
+    of_port_no_t port;
+    parse_key(key, &port);
+    *index_key = port % 2;
+    return true;
+}
+
+/* Collects a bitmap of the ports of matching entries */
+static void
+index_iter(void *cookie, indigo_core_gentable_entry_t *entry)
+{
+    uint32_t *ports = cookie;
+    struct test_entry *test_entry = indigo_core_gentable_entry_priv(entry);
+    *ports |= 1 << (test_entry - table.entries);
+}
+
+static uint32_t
+index_ports(indigo_core_gentable_t *gentable, int index_id, uint64_t index_key)
+{
+    uint32_t ports = 0;
+    indigo_core_gentable_index_foreach(gentable, index_id, index_key,
+                                       index_iter, &ports);
+    return ports;
+}
+
+static int
+test_gentable_index(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+    int mac_index, port_index, i;
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 8, &gentable);
+    AIM_TRUE_OR_DIE(indigo_core_gentable_index_register(gentable, extract_mac_index, &mac_index) == 0);
+
+    do_add(1, mac1, 0);
+    do_add(2, mac1, 0);
+    do_add(3, mac2, 0);
+    do_add(4, mac3, 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 1) == ((1 << 1) | (1 << 2)));
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 2) == (1 << 3));
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 3) == 0);
+
+    /* Modify moves entries between secondary keys */
+    do_add(2, mac2, 0);
+    do_add(4, mac1, 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 1) == ((1 << 1) | (1 << 4)));
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 2) == ((1 << 2) | (1 << 3)));
+
+    do_add(1, mac3, 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 1) == (1 << 4));
+
+    /* An index added later covers existing entries */
+    AIM_TRUE_OR_DIE(indigo_core_gentable_index_register(gentable, extract_port_index, &port_index) == 0);
+    AIM_TRUE_OR_DIE(port_index != mac_index);
+    AIM_TRUE_OR_DIE(index_ports(gentable, port_index, 0) == ((1 << 2) | (1 << 4)));
+    AIM_TRUE_OR_DIE(index_ports(gentable, port_index, 1) == ((1 << 1) | (1 << 3)));
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 2) == ((1 << 2) | (1 << 3)));
+
+    /* Deleted entries leave every index */
+    do_delete(3);
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 2) == (1 << 2));
+    AIM_TRUE_OR_DIE(index_ports(gentable, port_index, 1) == (1 << 1));
+
+    do_clear();
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 1) == 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, mac_index, 2) == 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, port_index, 0) == 0);
+    AIM_TRUE_OR_DIE(index_ports(gentable, port_index, 1) == 0);
+
+    for (i = 2; i < INDIGO_CORE_GENTABLE_MAX_INDEXES; i++) {
+        int index_id;
+        AIM_TRUE_OR_DIE(indigo_core_gentable_index_register(gentable, extract_port_index, &index_id) == 0);
+    }
+    {
+        int index_id;
+        AIM_TRUE_OR_DIE(indigo_core_gentable_index_register(gentable, extract_port_index, &index_id) == INDIGO_ERROR_RESOURCE);
+    }
+
+    do_add(5, mac1, 0);
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
+static int
+test_gentable_memory_stats(void)
+{
+    indigo_core_gentable_t *gentable;
+    of_table_name_t name = "gentable 0";
+    indigo_core_gentable_memory_stats_t stats;
+    uint64_t entry_bytes;
+
+    memset(&table, 0, sizeof(table));
+    indigo_core_gentable_register(name, &test_ops, &table, 10, 8, &gentable);
+
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.num_entries == 0);
+    AIM_TRUE_OR_DIE(stats.entry_bytes == 0);
+    AIM_TRUE_OR_DIE(stats.bucket_bytes > 0);
+
+    do_add(1, mac1, 0);
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.num_entries == 1);
+    AIM_TRUE_OR_DIE(stats.entry_bytes > 0);
+    entry_bytes = stats.entry_bytes;
+
+    /* Same-sized entries use the same amount of memory */
+    do_add(2, mac2, 0);
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.num_entries == 2);
+    AIM_TRUE_OR_DIE(stats.entry_bytes == entry_bytes * 2);
+
+    /* Modifying a value in place does not change memory usage */
+    do_add(1, mac3, 0);
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.entry_bytes == entry_bytes * 2);
+
+    do_delete(1);
+    do_delete(2);
+    indigo_core_gentable_memory_stats_get(gentable, &stats);
+    AIM_TRUE_OR_DIE(stats.num_entries == 0);
+    AIM_TRUE_OR_DIE(stats.entry_bytes == 0);
+
+    indigo_core_gentable_unregister(gentable);
+
+    return TEST_PASS;
+}
+
 static int
 test_gentable_lookup_by_name(void)
 {
@@ -460,11 +956,20 @@ test_gentable(void)
     RUN_TEST(gentable_entry_add);
     RUN_TEST(gentable_entry_delete);
     RUN_TEST(gentable_entry_modify);
+    RUN_TEST(gentable_elide_noop_modify);
     RUN_TEST(gentable_clear);
+    RUN_TEST(gentable_clear_op);
     RUN_TEST(gentable_entry_stats);
+    RUN_TEST(gentable_entry_stats_bulk);
     RUN_TEST(gentable_long_running_task);
+    RUN_TEST(gentable_set_buckets_size);
+    RUN_TEST(gentable_sparse_buckets);
+    RUN_TEST(gentable_checksum_tree);
     RUN_TEST(gentable_lookup);
     RUN_TEST(gentable_acquire);
+    RUN_TEST(gentable_entry_handle);
+    RUN_TEST(gentable_index);
+    RUN_TEST(gentable_memory_stats);
     RUN_TEST(gentable_lookup_by_name);
     RUN_TEST(gentable_start_finish);
     return TEST_PASS;
@@ -760,3 +1265,57 @@ static indigo_core_gentable_ops_t test_ops2 = {
     .start = test_gentable_start,
     .finish = test_gentable_finish,
 };
+
+static void
+test_gentable_get_stats_bulk(void *table_priv, void **entry_privs, of_list_bsn_tlv_t **keys, of_list_bsn_tlv_t **stats, int count)
+{
+    struct test_table *table = table_priv;
+    int i;
+
+    table->count_stats_bulk++;
+
+    for (i = 0; i < count; i++) {
+        of_port_no_t port;
+        parse_key(keys[i], &port);
+
+        AIM_TRUE_OR_DIE(port < NUM_ENTRIES);
+
+        struct test_entry *entry = &table->entries[port];
+        AIM_TRUE_OR_DIE(entry == entry_privs[i]);
+
+        of_object_t *tlv = of_bsn_tlv_rx_packets_new(OF_VERSION_1_3);
+        of_bsn_tlv_rx_packets_value_set(tlv, 100);
+        of_list_append(stats[i], tlv);
+        of_object_delete(tlv);
+
+        table->count_stats++;
+        entry->count_stats++;
+    }
+}
+
+static indigo_core_gentable_ops_t test_ops_bulk = {
+    .add2 = test_gentable_add,
+    .modify2 = test_gentable_modify,
+    .del2 = test_gentable_delete,
+    .get_stats_bulk = test_gentable_get_stats_bulk,
+};
+
+static indigo_error_t
+test_gentable_clear_all(indigo_cxn_id_t cxn_id, void *table_priv)
+{
+    struct test_table *table = table_priv;
+    table->count_clears++;
+    if (table->clear_rv < 0) {
+        return table->clear_rv;
+    }
+    table->count_op++;
+    return INDIGO_ERROR_NONE;
+}
+
+static indigo_core_gentable_ops_t test_ops_clear = {
+    .add2 = test_gentable_add,
+    .modify2 = test_gentable_modify,
+    .del2 = test_gentable_delete,
+    .get_stats = test_gentable_get_stats,
+    .clear = test_gentable_clear_all,
+};
@@ -73,6 +73,8 @@ struct test_table_stats {
     int count_modify;
     int count_delete;
     int count_stats;
+    int count_stats_bulk;
+    indigo_error_t stats_bulk_rv;
     struct test_entry_stats entries[NUM_ENTRIES];
 };
 
@@ -80,6 +82,7 @@ static struct test_table table;
 static struct test_table_stats stats;
 
 static indigo_core_group_table_ops_t test_ops;
+static indigo_core_group_table_ops_t test_ops_stats_bulk;
 
 static inline uint32_t
 entry_id_to_group_id(uint32_t entry_id)
@@ -280,6 +283,40 @@ test_group_table_entry_stats(void)
     return TEST_PASS;
 }
 
+static int
+test_group_table_entry_stats_bulk(void)
+{
+    memset(&table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    table.magic = TABLE_MAGIC;
+    indigo_core_group_table_register(TABLE_ID, "test", &test_ops_stats_bulk, &table);
+
+    do_add(1, OF_GROUP_TYPE_SELECT, 1000);
+    do_add(2, OF_GROUP_TYPE_SELECT, 2000);
+    do_add(3, OF_GROUP_TYPE_SELECT, 3000);
+
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats_bulk == 1);
+    AIM_TRUE_OR_DIE(stats.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[2].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[3].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.count_stats == 3);
+
+    /* A failed bulk op falls back to per-group reads */
+    memset(&stats, 0, sizeof(stats));
+    stats.stats_bulk_rv = INDIGO_ERROR_UNKNOWN;
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats_bulk == 1);
+    AIM_TRUE_OR_DIE(stats.count_stats == 6);
+
+    memset(&stats, 0, sizeof(stats));
+    indigo_core_group_table_unregister(TABLE_ID);
+    AIM_TRUE_OR_DIE(stats.count_delete == 3);
+
+    return TEST_PASS;
+}
+
 static int
 test_group_table_entry_refcount(void)
 {
@@ -330,6 +367,7 @@ test_group_table(void)
     RUN_TEST(group_table_entry_modify_type);
     RUN_TEST(group_table_entry_dup_add);
     RUN_TEST(group_table_entry_stats);
+    RUN_TEST(group_table_entry_stats_bulk);
     RUN_TEST(group_table_entry_refcount);
     return TEST_PASS;
 }
@@ -502,3 +540,27 @@ static indigo_core_group_table_ops_t test_ops = {
     op_entry_delete,
     op_entry_stats_get,
 };
+
+static indigo_error_t
+op_entry_stats_get_bulk(void *table_priv, void **entry_privs,
+                        of_group_stats_entry_t **group_stats, int count)
+{
+    int i;
+
+    stats.count_stats_bulk++;
+
+    for (i = 0; i < count; i++) {
+        AIM_TRUE_OR_DIE(op_entry_stats_get(table_priv, entry_privs[i],
+                                           group_stats[i]) == INDIGO_ERROR_NONE);
+    }
+
+    return stats.stats_bulk_rv;
+}
+
+static indigo_core_group_table_ops_t test_ops_stats_bulk = {
+    .entry_create = op_entry_create,
+    .entry_modify = op_entry_modify,
+    .entry_delete = op_entry_delete,
+    .entry_stats_get = op_entry_stats_get,
+    .entry_stats_get_bulk = op_entry_stats_get_bulk,
+};
@@ -45,6 +45,7 @@
 #include <locitest/test_common.h>
 
 #include "ofstatemanager_decs.h"
+#include "ofstatemanager_int.h"
 
 /* Defined in gentable_test.c */
 int test_gentable(void);
@@ -94,6 +95,9 @@ int test_generic_stats(void);
  */
 static int outstanding_op_cnt;
 
+/* Number of entry_modify calls into the table */
+static int modify_count;
+
 /* Used by populate_table and depopulate_table to track entry pointers */
 static ft_entry_t *entries[TEST_FLOW_COUNT];
 
@@ -124,6 +128,7 @@ op_entry_modify(void *table_priv, indigo_cxn_id_t cxn_id,
                 void *entry_priv, of_flow_modify_t *obj)
 {
     AIM_LOG_VERBOSE("flow modify called");
+    modify_count++;
     return INDIGO_ERROR_NONE;
 }
 
@@ -893,6 +898,62 @@ test_ft_iterator(void)
     return TEST_PASS;
 }
 
+static int
+test_ft_checksum_tree(void)
+{
+    ft_instance_t ft;
+    ft_table_t *table;
+    of_flow_add_t *flow_add;
+    of_match_t match;
+    minimatch_t minimatch;
+    ft_entry_t *entries[3];
+    uint64_t cookies[3] = { 0x0000000000000001, 0x8000000000000002, 0xf000000000000003 };
+    uint32_t i, depth;
+
+    ft = ft_create();
+    TEST_ASSERT(ft != NULL);
+    table = &ft->tables[0];
+
+    flow_add = of_flow_add_new(OF_VERSION_1_0);
+    TEST_ASSERT(of_flow_add_OF_VERSION_1_0_populate(flow_add, 1) != 0);
+    TEST_ASSERT(of_flow_add_match_get(flow_add, &match) == 0);
+
+    for (i = 0; i < 3; i++) {
+        of_flow_add_cookie_set(flow_add, cookies[i]);
+        minimatch_init(&minimatch, &match);
+        TEST_INDIGO_OK(ft_add(ft, TEST_ENT_ID + i, flow_add, &minimatch, &entries[i]));
+        TEST_ASSERT(entries[i]->table_id == 0);
+    }
+
+    depth = aim_log2_u32(table->checksum_buckets_size);
+
+    /* The root covers the whole table and each level sums to it */
+    TEST_ASSERT(ft_checksum_tree_node(table, 0, 0) == table->checksum);
+    TEST_ASSERT(ft_checksum_tree_node(table, 1, 0) == cookies[0]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 1, 1) == cookies[1] + cookies[2]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 2, 2) == cookies[1]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 2, 3) == cookies[2]);
+    TEST_ASSERT(ft_checksum_tree_node(table, depth, table->checksum_buckets_size - 1) ==
+                table->checksum_buckets[table->checksum_buckets_size - 1]);
+
+    /* Deleting a flow updates its ancestors */
+    ft_delete(ft, entries[1]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 0, 0) == cookies[0] + cookies[2]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 1, 1) == cookies[2]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 2, 2) == 0);
+
+    /* Resizing rebuilds the tree */
+    TEST_INDIGO_OK(ft_set_checksum_buckets_size(ft, 0, 4));
+    TEST_ASSERT(ft_checksum_tree_node(table, 0, 0) == cookies[0] + cookies[2]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 2, 0) == cookies[0]);
+    TEST_ASSERT(ft_checksum_tree_node(table, 2, 3) == cookies[2]);
+
+    ft_destroy(ft);
+    of_object_delete(flow_add);
+
+    return TEST_PASS;
+}
+
 struct iter_task_state {
     ft_instance_t ft;
     int finished;
@@ -959,6 +1020,418 @@ test_ft_iter_task(void)
     return TEST_PASS;
 }
 
+struct batch_iter_task_state {
+    int entries_seen;
+    int batches;
+    int max_batch;
+    int finished;
+};
+
+static void
+batch_iter_task_cb(void *cookie, ft_entry_t **entries, int count)
+{
+    struct batch_iter_task_state *state = cookie;
+
+    if (count == 0) {
+        state->finished++;
+        return;
+    }
+
+    state->entries_seen += count;
+    state->batches++;
+    if (count > state->max_batch) {
+        state->max_batch = count;
+    }
+}
+
+static int
+test_ft_batch_iter_task(void)
+{
+    ft_instance_t ft;
+    struct batch_iter_task_state state = { 0 };
+    of_match_t match;
+
+    ft = ft_create();
+    TEST_ASSERT(populate_table(ft, TEST_FLOW_COUNT, &match) == 0);
+
+    TEST_INDIGO_OK(ft_spawn_batch_iter_task(ft, NULL, batch_iter_task_cb, &state,
+                                            IND_SOC_NORMAL_PRIORITY));
+    while (state.finished == 0) {
+        ind_soc_select_and_run(0);
+    }
+
+    TEST_ASSERT(state.finished == 1);
+    TEST_ASSERT(state.entries_seen == TEST_FLOW_COUNT);
+    TEST_ASSERT(state.max_batch == FT_ITER_TASK_BATCH_SIZE);
+    TEST_ASSERT(state.batches == (TEST_FLOW_COUNT + FT_ITER_TASK_BATCH_SIZE - 1) / FT_ITER_TASK_BATCH_SIZE);
+
+    TEST_ASSERT(depopulate_table(ft) == 0);
+    ft_destroy(ft);
+
+    return TEST_PASS;
+}
+
+/* Set up a non-strict query matching every flow with the given cookie */
+static void
+init_cookie_query(of_meta_match_t *query, uint64_t cookie, uint64_t cookie_mask)
+{
+    of_match_t match;
+
+    INDIGO_MEM_SET(&match, 0, sizeof(match));
+    match.version = OF_VERSION_1_0;
+
+    INDIGO_MEM_SET(query, 0, sizeof(*query));
+    minimatch_init(&query->minimatch, &match);
+    query->table_id = TABLE_ID_ANY;
+    query->mode = OF_MATCH_NON_STRICT;
+    query->cookie = cookie;
+    query->cookie_mask = cookie_mask;
+}
+
+/* Add a flow with the given table and cookie */
+static int
+add_flow_cookie(ft_instance_t ft, int id, uint8_t table_id, uint64_t cookie,
+                ft_entry_t **entry_p)
+{
+    of_flow_add_t *flow_add;
+    of_match_t match;
+    minimatch_t minimatch;
+
+    flow_add = of_flow_add_new(OF_VERSION_1_3);
+    of_flow_add_table_id_set(flow_add, table_id);
+    of_flow_add_cookie_set(flow_add, cookie);
+
+    INDIGO_MEM_SET(&match, 0, sizeof(match));
+    match.version = OF_VERSION_1_3;
+    match.fields.eth_type = TEST_ETH_TYPE(id);
+    match.masks.eth_type = 0xffff;
+    minimatch_init(&minimatch, &match);
+
+    TEST_INDIGO_OK(ft_add(ft, TEST_KEY(id), flow_add, &minimatch, entry_p));
+    of_object_delete(flow_add);
+    return 0;
+}
+
+/* Counts visited flows, and those outside the query's cookie mask */
+struct cookie_iter_state {
+    uint64_t cookie;
+    uint64_t cookie_mask;
+    int count;
+    int mismatched;
+};
+
+static void
+cookie_iter_cb(void *cookie, ft_entry_t *entry)
+{
+    struct cookie_iter_state *state = cookie;
+    if (entry != NULL) {
+        state->count++;
+        if ((entry->cookie & state->cookie_mask) != (state->cookie & state->cookie_mask)) {
+            state->mismatched++;
+        }
+    }
+}
+
+static int
+iterate_cookie_query(ft_instance_t ft, of_meta_match_t *query)
+{
+    struct cookie_iter_state state = {
+        .cookie = query->cookie,
+        .cookie_mask = query->cookie_mask,
+    };
+
+    ft_iterate(ft, query, cookie_iter_cb, &state);
+    TEST_ASSERT(state.mismatched == 0);
+    return state.count;
+}
+
+#define ITERATE_TEST_TABLE1_FLOWS 40
+#define ITERATE_TEST_TABLE2_FLOWS 100
+#define ITERATE_TEST_FLOWS (ITERATE_TEST_TABLE1_FLOWS + ITERATE_TEST_TABLE2_FLOWS)
+
+static int
+test_ft_iterate(void)
+{
+    ft_instance_t ft;
+    ft_entry_t *flows[ITERATE_TEST_FLOWS];
+    of_meta_match_t query;
+    int i;
+
+    ft = ft_create();
+
+    /*
+     * Table 1 spreads its flows over four buckets of the default index
+     * (the top cookie byte), each with a distinct exact cookie. Table 2
+     * only uses bucket 0.
+     */
+    for (i = 0; i < ITERATE_TEST_TABLE1_FLOWS; i++) {
+        TEST_OK(add_flow_cookie(ft, i, 1, ((uint64_t)(i % 4) << 56) | i, &flows[i]));
+    }
+    for (; i < ITERATE_TEST_FLOWS; i++) {
+        TEST_OK(add_flow_cookie(ft, i, 2, i, &flows[i]));
+    }
+
+    /* Without a cookie the whole flowtable is scanned */
+    init_cookie_query(&query, 0, 0);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ITERATE_TEST_FLOWS);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == ITERATE_TEST_FLOWS);
+
+    /* Unless it names a table, then only that table is */
+    init_cookie_query(&query, 0, 0);
+    query.table_id = 1;
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ITERATE_TEST_TABLE1_FLOWS);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == ITERATE_TEST_TABLE1_FLOWS);
+
+    /* A cookie covering the index only scans its bucket */
+    init_cookie_query(&query, (uint64_t)1 << 56, 0xff00000000000000);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ITERATE_TEST_TABLE1_FLOWS / 4);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == ITERATE_TEST_TABLE1_FLOWS / 4);
+
+    /* The table list is used when it is shorter than the bucket */
+    init_cookie_query(&query, 0, 0xff00000000000000);
+    TEST_ASSERT(ft_query_candidates(ft, &query) ==
+                ITERATE_TEST_TABLE1_FLOWS / 4 + ITERATE_TEST_TABLE2_FLOWS);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) ==
+                ITERATE_TEST_TABLE1_FLOWS / 4 + ITERATE_TEST_TABLE2_FLOWS);
+    init_cookie_query(&query, 0, 0xff00000000000000);
+    query.table_id = 1;
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ITERATE_TEST_TABLE1_FLOWS);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == ITERATE_TEST_TABLE1_FLOWS / 4);
+
+    /* A full cookie match only scans its exact cookie */
+    init_cookie_query(&query, ((uint64_t)1 << 56) | 5, ~(uint64_t)0);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 1);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == 1);
+
+    init_cookie_query(&query, ((uint64_t)2 << 56) | 5, ~(uint64_t)0);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 0);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == 0);
+
+    for (i = 0; i < ITERATE_TEST_FLOWS; i++) {
+        ft_delete(ft, flows[i]);
+    }
+    TEST_ASSERT(ft->tables[1].flow_count == 0);
+    TEST_ASSERT(list_empty(&ft->tables[2].flows));
+    ft_destroy(ft);
+
+    return TEST_PASS;
+}
+
+#define COOKIE_INDEX_TEST_FLOWS 5
+
+static int
+test_ft_cookie_index(void)
+{
+    ft_instance_t ft;
+    ft_iterator_t iter;
+    ft_cookie_index_stats_t stats;
+    of_meta_match_t query;
+    ft_entry_t *flows[COOKIE_INDEX_TEST_FLOWS];
+    ft_entry_t *entry;
+    int i;
+
+    /*
+     * Flows 0-2 share top byte 0x01 and flows 1-2 share an exact cookie.
+     * Flows 3-4 share the low nibble 3.
+     */
+    static const uint64_t cookies[COOKIE_INDEX_TEST_FLOWS] = {
+        0x0100000000000001,
+        0x0100000000000002,
+        0x0100000000000002,
+        0x0200000000000003,
+        0x0000000000000013,
+    };
+
+    ft = ft_create();
+    for (i = 0; i < COOKIE_INDEX_TEST_FLOWS; i++) {
+        TEST_OK(add_flow_cookie(ft, i, 1, cookies[i], &flows[i]));
+    }
+
+    /* The default index covers the top byte */
+    ft_cookie_index_stats_get(ft, &stats);
+    TEST_ASSERT(stats.bits == 8);
+    TEST_ASSERT(stats.shift == 56);
+    TEST_ASSERT(stats.buckets == 256);
+    TEST_ASSERT(stats.nonempty_buckets == 3);
+    TEST_ASSERT(stats.max_bucket_count == 3);
+    TEST_ASSERT(stats.exact_cookies == 4);
+    TEST_ASSERT(stats.max_exact_cookie_count == 2);
+
+    init_cookie_query(&query, 0x0100000000000000, 0xff00000000000000);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 3);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == 3);
+
+    init_cookie_query(&query, 0x0200000000000000, 0xff00000000000000);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 1);
+    ft_iterator_init(&iter, ft, &query);
+    TEST_ASSERT(ft_iterator_next(&iter) == flows[3]);
+    TEST_ASSERT(ft_iterator_next(&iter) == NULL);
+    ft_iterator_cleanup(&iter);
+
+    init_cookie_query(&query, 0x3, 0xf);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ft->current_count);
+    metamatch_cleanup(&query);
+
+    /* Flows sharing a bucket are told apart by the exact cookie index */
+    init_cookie_query(&query, cookies[1], ~(uint64_t)0);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 2);
+    ft_iterator_init(&iter, ft, &query);
+    for (i = 0; (entry = ft_iterator_next(&iter)) != NULL; i++) {
+        TEST_ASSERT(entry == flows[1] || entry == flows[2]);
+    }
+    TEST_ASSERT(i == 2);
+    ft_iterator_cleanup(&iter);
+
+    init_cookie_query(&query, cookies[0], ~(uint64_t)0);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 1);
+    ft_iterator_init(&iter, ft, &query);
+    TEST_ASSERT(ft_iterator_next(&iter) == flows[0]);
+    TEST_ASSERT(ft_iterator_next(&iter) == NULL);
+    ft_iterator_cleanup(&iter);
+
+    /* Index on the low nibble instead */
+    TEST_INDIGO_OK(ft_set_cookie_index(ft, 4, 0));
+
+    ft_cookie_index_stats_get(ft, &stats);
+    TEST_ASSERT(stats.bits == 4);
+    TEST_ASSERT(stats.shift == 0);
+    TEST_ASSERT(stats.buckets == 16);
+    TEST_ASSERT(stats.nonempty_buckets == 3);
+    TEST_ASSERT(stats.max_bucket_count == 2);
+    TEST_ASSERT(stats.exact_cookies == 4);
+    TEST_ASSERT(stats.max_exact_cookie_count == 2);
+
+    init_cookie_query(&query, 0x0100000000000000, 0xff00000000000000);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == ft->current_count);
+    metamatch_cleanup(&query);
+
+    init_cookie_query(&query, 0x3, 0xf);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 2);
+    ft_iterator_init(&iter, ft, &query);
+    for (i = 0; (entry = ft_iterator_next(&iter)) != NULL; i++) {
+        TEST_ASSERT(entry == flows[3] || entry == flows[4]);
+    }
+    TEST_ASSERT(i == 2);
+    ft_iterator_cleanup(&iter);
+
+    init_cookie_query(&query, 0x4, 0xf);
+    TEST_ASSERT(ft_query_candidates(ft, &query) == 0);
+    TEST_ASSERT(iterate_cookie_query(ft, &query) == 0);
+
+    /* Rebuilding is deferred while an iterator walks a bucket */
+    init_cookie_query(&query, 0x3, 0xf);
+    ft_iterator_init(&iter, ft, &query);
+    TEST_ASSERT(ft_set_cookie_index(ft, 8, 56) == INDIGO_ERROR_PENDING);
+    TEST_ASSERT(ft->cookie_index_bits == 4);
+    TEST_ASSERT(ft_iterator_next(&iter) != NULL);
+    ft_iterator_cleanup(&iter);
+    TEST_ASSERT(ft->cookie_index_bits == 8);
+    TEST_ASSERT(ft->cookie_index_shift == 56);
+
+    TEST_ASSERT(ft_set_cookie_index(ft, FT_COOKIE_INDEX_MAX_BITS + 1, 0) == INDIGO_ERROR_PARAM);
+    TEST_ASSERT(ft_set_cookie_index(ft, 8, 60) == INDIGO_ERROR_PARAM);
+
+    for (i = 0; i < COOKIE_INDEX_TEST_FLOWS; i++) {
+        ft_delete(ft, flows[i]);
+    }
+    bighash_iter_t hash_iter;
+    TEST_ASSERT(bighash_iter_start(ft->exact_cookie_hashtable, &hash_iter) == NULL);
+    ft_destroy(ft);
+
+    return TEST_PASS;
+}
+
+/* Flows with identical effects share one interned list */
+static int
+test_ft_effects(void)
+{
+    ft_instance_t ft;
+    of_flow_add_t *flow_add;
+    of_match_t match;
+    ft_effects_t *shared;
+    int idx;
+
+    ft = ft_create();
+    TEST_ASSERT(populate_table(ft, TEST_FLOW_COUNT, &match) == 0);
+
+    shared = entries[0]->shared_effects;
+    TEST_ASSERT(shared != NULL);
+    TEST_ASSERT(shared->refcount == TEST_FLOW_COUNT);
+    for (idx = 0; idx < TEST_FLOW_COUNT; idx++) {
+        TEST_ASSERT(entries[idx]->shared_effects == shared);
+        TEST_ASSERT(entries[idx]->effects.actions == shared->list);
+    }
+
+    /* Modifying one flow gives it its own list */
+    flow_add = of_flow_add_new(OF_VERSION_1_0);
+    TEST_ASSERT(of_flow_add_OF_VERSION_1_0_populate(flow_add, 2) != 0);
+    TEST_INDIGO_OK(ft_entry_modify_effects(ft, entries[0], flow_add));
+    TEST_ASSERT(entries[0]->shared_effects != shared);
+    TEST_ASSERT(entries[0]->shared_effects->refcount == 1);
+    TEST_ASSERT(shared->refcount == TEST_FLOW_COUNT - 1);
+
+    /* Modifying it again with the same effects is a no-op */
+    shared = entries[0]->shared_effects;
+    TEST_INDIGO_OK(ft_entry_modify_effects(ft, entries[0], flow_add));
+    TEST_ASSERT(entries[0]->shared_effects == shared);
+    TEST_ASSERT(shared->refcount == 1);
+
+    /* And modifying another flow to match shares it */
+    TEST_INDIGO_OK(ft_entry_modify_effects(ft, entries[1], flow_add));
+    TEST_ASSERT(entries[1]->shared_effects == shared);
+    TEST_ASSERT(shared->refcount == 2);
+    of_object_delete(flow_add);
+
+    TEST_ASSERT(depopulate_table(ft) == 0);
+    bighash_iter_t iter;
+    TEST_ASSERT(bighash_iter_start(ft->effects_hashtable, &iter) == NULL);
+    ft_destroy(ft);
+
+    return TEST_PASS;
+}
+
+/* Changing an entry drops its cached flow stats entry */
+static int
+test_ft_stats_template(void)
+{
+    ft_instance_t ft;
+    of_flow_add_t *flow_add;
+    of_match_t match;
+
+    ft = ft_create();
+    TEST_ASSERT(populate_table(ft, TEST_FLOW_COUNT, &match) == 0);
+
+    flow_add = of_flow_add_new(OF_VERSION_1_0);
+    TEST_ASSERT(of_flow_add_OF_VERSION_1_0_populate(flow_add, 2) != 0);
+
+    /* Keep the overwrites away from the expiration queue */
+    of_flow_add_idle_timeout_set(flow_add, 0);
+    of_flow_add_hard_timeout_set(flow_add, 0);
+    entries[1]->idle_timeout = entries[1]->hard_timeout = 0;
+    entries[2]->idle_timeout = entries[2]->hard_timeout = 0;
+
+    entries[0]->stats_template = of_flow_stats_entry_new(OF_VERSION_1_0);
+    TEST_INDIGO_OK(ft_entry_modify_effects(ft, entries[0], flow_add));
+    TEST_ASSERT(entries[0]->stats_template == NULL);
+
+    entries[1]->stats_template = of_flow_stats_entry_new(OF_VERSION_1_0);
+    ft_overwrite_timeouts(ft, entries[1], flow_add);
+    TEST_ASSERT(entries[1]->stats_template == NULL);
+
+    entries[2]->stats_template = of_flow_stats_entry_new(OF_VERSION_1_0);
+    ft_overwrite(ft, entries[2], flow_add);
+    TEST_ASSERT(entries[2]->stats_template == NULL);
+
+    /* Freed with the entry */
+    entries[3]->stats_template = of_flow_stats_entry_new(OF_VERSION_1_0);
+
+    of_object_delete(flow_add);
+    TEST_ASSERT(depopulate_table(ft) == 0);
+    ft_destroy(ft);
+
+    return TEST_PASS;
+}
+
 static int
 test_hello(void)
 {
@@ -1183,6 +1656,56 @@ test_modify(void)
     return TEST_PASS;
 }
 
+/* Overwrite a flow with identical and changed flow-adds */
+static int
+test_overwrite_elided(void)
+{
+    of_flow_add_t *flow_add;
+    int start_count;
+
+    TEST_INDIGO_OK(indigo_core_table_elide_noop_overwrite_set(0, true));
+
+    flow_add = of_flow_add_new(OF_VERSION_1_3);
+    TEST_ASSERT(flow_add != NULL);
+    TEST_ASSERT(of_flow_add_OF_VERSION_1_3_populate(flow_add, 1) != 0);
+    of_flow_add_table_id_set(flow_add, 0);
+    of_flow_add_flags_set(flow_add, 0);
+    of_flow_add_cookie_set(flow_add, 0x1234);
+    of_flow_add_idle_timeout_set(flow_add, 0);
+    of_flow_add_hard_timeout_set(flow_add, 0);
+
+    handle_message(of_object_dup(flow_add));
+    TEST_INDIGO_OK(do_barrier());
+    CHECK_FLOW_COUNT(ind_core_ft, 1);
+    start_count = modify_count;
+
+    /* Identical flow-add doesn't reach Forwarding */
+    handle_message(of_object_dup(flow_add));
+    TEST_INDIGO_OK(do_barrier());
+    CHECK_FLOW_COUNT(ind_core_ft, 1);
+    TEST_ASSERT(modify_count == start_count);
+
+    /* A changed cookie does */
+    of_flow_add_cookie_set(flow_add, 0x5678);
+    handle_message(of_object_dup(flow_add));
+    TEST_INDIGO_OK(do_barrier());
+    CHECK_FLOW_COUNT(ind_core_ft, 1);
+    TEST_ASSERT(modify_count == start_count + 1);
+
+    /* Every overwrite reaches Forwarding once disabled */
+    TEST_INDIGO_OK(indigo_core_table_elide_noop_overwrite_set(0, false));
+    handle_message(flow_add);
+    TEST_INDIGO_OK(do_barrier());
+    TEST_ASSERT(modify_count == start_count + 2);
+
+    TEST_ASSERT(delete_all_entries(ind_core_ft) == TEST_PASS);
+    TEST_ASSERT(ind_core_ft->current_count == 0);
+
+    TEST_ASSERT(indigo_core_table_elide_noop_overwrite_set(1, true) == INDIGO_ERROR_NOT_FOUND);
+
+    return TEST_PASS;
+}
+
 /* Add n flows, delete one by one */
 int
 test_modify_strict(void)
@@ -1412,6 +1935,129 @@ test_message_listeners(void)
     return TEST_PASS;
 }
 
+static void
+send_flow_notifications(int count, indigo_cxn_id_t cxn_id)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        ind_core_flow_notification_send(of_flow_removed_new(OF_VERSION_1_0), cxn_id);
+    }
+}
+
+static int
+test_flow_notification(void)
+{
+    memset(async_message_counters, 0, sizeof(async_message_counters));
+
+    /* Notifications are held until the current task slice ends */
+    send_flow_notifications(10, INDIGO_CXN_ID_UNSPECIFIED);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 0);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 10);
+    ind_soc_select_and_run(0);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 10);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 0);
+
+    /* A rate limit allows a burst of one second's worth */
+    ind_core_flow_notification_config_set(5, 8);
+    send_flow_notifications(10, INDIGO_CXN_ID_UNSPECIFIED);
+    ind_soc_select_and_run(0);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 15);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 5);
+    TEST_ASSERT(!ind_core_flow_notification_full());
+
+    /* Notifications for a connection bypass the shaper */
+    send_flow_notifications(2, 0);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 17);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 5);
+    TEST_ASSERT(outstanding_op_cnt == 0);
+
+    /* A full queue sends its oldest message instead of dropping */
+    send_flow_notifications(5, INDIGO_CXN_ID_UNSPECIFIED);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 19);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 8);
+    TEST_ASSERT(ind_core_flow_notification_full());
+
+    ind_core_flow_notification_config_set(0, 0);
+    ind_soc_select_and_run(0);
+    TEST_ASSERT(async_message_counters[OF_FLOW_REMOVED] == 27);
+    TEST_ASSERT(ind_core_flow_notification_pending() == 0);
+
+    return TEST_PASS;
+}
+
+static void
+send_packet_in_version(of_version_t version, of_port_no_t in_port, uint8_t fill)
+{
+    uint8_t data[64];
+    of_octets_t octets = { .data = data, .bytes = sizeof(data) };
+    of_packet_in_t *obj = of_packet_in_new(version);
+
+    memset(data, fill, sizeof(data));
+    if (version == OF_VERSION_1_0) {
+        of_packet_in_in_port_set(obj, in_port);
+    } else {
+        of_match_t match;
+        memset(&match, 0, sizeof(match));
+        match.fields.in_port = in_port;
+        match.masks.in_port = ~0;
+        AIM_TRUE_OR_DIE(of_packet_in_match_set(obj, &match) == 0);
+    }
+    AIM_TRUE_OR_DIE(of_packet_in_data_set(obj, &octets) == 0);
+
+    AIM_TRUE_OR_DIE(indigo_core_packet_in(obj) == INDIGO_ERROR_NONE);
+}
+
+static void
+send_packet_in(of_port_no_t in_port, uint8_t fill)
+{
+    send_packet_in_version(OF_VERSION_1_0, in_port, fill);
+}
+
+static int
+test_packet_in_limit(void)
+{
+    int i;
+
+    memset(async_message_counters, 0, sizeof(async_message_counters));
+
+    /* Each port gets its own burst */
+    ind_core_packet_in_limit_config_set(2, 0, true, 0, 0);
+    for (i = 0; i < 5; i++) {
+        send_packet_in(1, i);
+    }
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 2);
+    for (i = 0; i < 5; i++) {
+        send_packet_in(2, i);
+    }
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 4);
+
+    /* Repeated packet-ins for the same flow are dropped */
+    ind_core_packet_in_limit_config_set(0, 0, true, 1000, 0);
+    send_packet_in(1, 0);
+    send_packet_in(1, 0);
+    send_packet_in(1, 0);
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 5);
+    send_packet_in(1, 1);
+    send_packet_in(2, 0);
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 7);
+
+    ind_core_packet_in_limit_config_set(0, 0, true, 0, 0);
+    send_packet_in(1, 0);
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 8);
+
+    /* The ingress port comes from the OXM match in OpenFlow 1.3 */
+    ind_core_packet_in_limit_config_set(2, 0, true, 0, 0);
+    for (i = 0; i < 5; i++) {
+        send_packet_in_version(OF_VERSION_1_3, 1, i);
+        send_packet_in_version(OF_VERSION_1_3, 2, i);
+    }
+    TEST_ASSERT(async_message_counters[OF_PACKET_IN] == 12);
+
+    ind_core_packet_in_limit_config_set(0, 0, true, 0, 0);
+
+    return TEST_PASS;
+}
+
 int
 aim_main(int argc, char* argv[])
 {
@@ -1423,7 +2069,13 @@ aim_main(int argc, char* argv[])
 
     RUN_TEST(ft_hash);
     RUN_TEST(ft_iterator);
+    RUN_TEST(ft_checksum_tree);
     RUN_TEST(ft_iter_task);
+    RUN_TEST(ft_batch_iter_task);
+    RUN_TEST(ft_iterate);
+    RUN_TEST(ft_cookie_index);
+    RUN_TEST(ft_effects);
+    RUN_TEST(ft_stats_template);
 
     /* Init Core */
     MEMSET(&core, 0, sizeof(core));
@@ -1443,10 +2095,13 @@ aim_main(int argc, char* argv[])
     RUN_TEST(exact_add_del);
     RUN_TEST(modify);
     RUN_TEST(modify_strict);
+    RUN_TEST(overwrite_elided);
 
     RUN_TEST(packet_in_listeners);
     RUN_TEST(port_status_listeners);
     RUN_TEST(message_listeners);
+    RUN_TEST(flow_notification);
+    RUN_TEST(packet_in_limit);
 
     if (test_gentable() != TEST_PASS) {
         return 1;
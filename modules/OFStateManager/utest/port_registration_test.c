@@ -31,6 +31,7 @@
 #include <locitest/unittest.h>
 #include <locitest/test_common.h>
 #include <SocketManager/socketmanager.h>
+#include <indigo/forwarding.h>
 
 #define QUEUES_PER_PORT OFSTATEMANAGER_CONFIG_MAX_QUEUES/OFSTATEMANAGER_CONFIG_MAX_PORTS
 
@@ -46,6 +47,11 @@ extern int do_barrier(void);
 
 struct port_counters port_counters[OFSTATEMANAGER_CONFIG_MAX_PORTS];
 
+static int port_stats_get_many_calls;
+static int queue_stats_get_many_calls;
+static int vlan_stats_get_many_calls;
+static int vlan_stats_get_many_count;
+
 indigo_error_t
 indigo_port_desc_stats_get_one(of_port_no_t port_no, of_port_desc_t *port_desc)
 {
@@ -83,6 +89,38 @@ indigo_port_queue_stats_get_one(of_port_no_t port_no, uint32_t queue_id, of_queu
     return INDIGO_ERROR_NONE;
 }
 
+indigo_error_t
+indigo_port_stats_get_many(const of_port_no_t *port_nos, int count,
+                           of_port_stats_entry_t **port_stats)
+{
+    int i;
+
+    port_stats_get_many_calls++;
+
+    for (i = 0; i < count; i++) {
+        AIM_TRUE_OR_DIE(indigo_port_stats_get_one(port_nos[i], port_stats[i]) == INDIGO_ERROR_NONE);
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+indigo_error_t
+indigo_port_queue_stats_get_many(const of_port_no_t *port_nos,
+                                 const uint32_t *queue_ids, int count,
+                                 of_queue_stats_entry_t **queue_stats)
+{
+    int i;
+
+    queue_stats_get_many_calls++;
+
+    for (i = 0; i < count; i++) {
+        AIM_TRUE_OR_DIE(indigo_port_queue_stats_get_one(
+            port_nos[i], queue_ids[i], queue_stats[i]) == INDIGO_ERROR_NONE);
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
 indigo_error_t
 indigo_port_queue_desc_get_one(of_port_no_t port_no, uint32_t queue_id, of_queue_desc_t *queue_desc)
 {
@@ -90,6 +128,20 @@ indigo_port_queue_desc_get_one(of_port_no_t port_no, uint32_t queue_id, of_queue
     return INDIGO_ERROR_NONE;
 }
 
+void
+indigo_fwd_vlan_stats_get_many(const uint16_t *vlan_vids, int count,
+                               indigo_fi_vlan_stats_t *vlan_stats)
+{
+    int i;
+
+    vlan_stats_get_many_calls++;
+    vlan_stats_get_many_count += count;
+
+    for (i = 0; i < count; i++) {
+        vlan_stats[i].rx_packets = vlan_vids[i];
+    }
+}
+
 static int
 test_port_desc_stats(void)
 {
@@ -124,10 +176,11 @@ test_port_stats(void)
     of_port_stats_request_t *obj = of_port_stats_request_new(OF_VERSION_1_4);
     of_port_stats_request_port_no_set(obj, OF_PORT_DEST_WILDCARD);
     handle_message(obj);
-    do_barrier();
 
+    /* A single batch is answered without spawning a task */
     AIM_TRUE_OR_DIE(port_counters[1].stats == 1);
     AIM_TRUE_OR_DIE(port_counters[2].stats == 1);
+    do_barrier();
 
     /* Request for a single port */
     memset(port_counters, 0, sizeof(port_counters));
@@ -367,6 +420,7 @@ test_port_stats_multipart(void)
     }
 
     memset(port_counters, 0, sizeof(port_counters));
+    port_stats_get_many_calls = 0;
     of_port_stats_request_t *obj = of_port_stats_request_new(OF_VERSION_1_4);
     of_port_stats_request_port_no_set(obj, OF_PORT_DEST_WILDCARD);
     handle_message(obj);
@@ -376,6 +430,10 @@ test_port_stats_multipart(void)
         AIM_TRUE_OR_DIE(port_counters[i].stats == 1);
     }
 
+    /* Ports are fetched in batches */
+    AIM_TRUE_OR_DIE(port_stats_get_many_calls > 0);
+    AIM_TRUE_OR_DIE(port_stats_get_many_calls < OFSTATEMANAGER_CONFIG_MAX_PORTS);
+
     for (i = 0; i < OFSTATEMANAGER_CONFIG_MAX_PORTS; i++) {
         indigo_core_port_unregister(port_handles[i]);
     }
@@ -398,6 +456,7 @@ test_queue_stats_multipart(void)
     }
 
     memset(port_counters, 0, sizeof(port_counters));
+    queue_stats_get_many_calls = 0;
     of_queue_stats_request_t *obj = of_queue_stats_request_new(OF_VERSION_1_4);
     of_queue_stats_request_port_no_set(obj, OF_PORT_DEST_WILDCARD);
     of_queue_stats_request_queue_id_set(obj, OF_QUEUE_ALL);
@@ -410,6 +469,10 @@ test_queue_stats_multipart(void)
         }
     }
 
+    /* Queues are fetched in batches */
+    AIM_TRUE_OR_DIE(queue_stats_get_many_calls > 0);
+    AIM_TRUE_OR_DIE(queue_stats_get_many_calls < OFSTATEMANAGER_CONFIG_MAX_QUEUES);
+
     for (i = 0; i < OFSTATEMANAGER_CONFIG_MAX_PORTS; i++) {
         for (j = 0; j < QUEUES_PER_PORT; j++) {
             indigo_core_queue_unregister(queue_handles[i][j]);
@@ -420,6 +483,30 @@ test_queue_stats_multipart(void)
     return TEST_PASS;
 }
 
+static int
+test_vlan_counter_stats(void)
+{
+    struct ind_core_vlan *handle1, *handle2;
+    indigo_core_vlan_register(10, &handle1);
+    indigo_core_vlan_register(20, &handle2);
+
+    /* Only the registered VLANs are fetched, in a single call */
+    vlan_stats_get_many_calls = 0;
+    vlan_stats_get_many_count = 0;
+    of_bsn_vlan_counter_stats_request_t *obj = of_bsn_vlan_counter_stats_request_new(OF_VERSION_1_3);
+    of_bsn_vlan_counter_stats_request_vlan_vid_set(obj, 0xffff);
+    handle_message(obj);
+    do_barrier();
+
+    AIM_TRUE_OR_DIE(vlan_stats_get_many_calls == 1);
+    AIM_TRUE_OR_DIE(vlan_stats_get_many_count == 2);
+
+    indigo_core_vlan_unregister(handle1);
+    indigo_core_vlan_unregister(handle2);
+
+    return TEST_PASS;
+}
+
 int
 test_port_registration(void)
 {
@@ -431,5 +518,6 @@ test_port_registration(void)
     RUN_TEST(port_desc_stats_multipart);
     RUN_TEST(port_stats_multipart);
     RUN_TEST(queue_stats_multipart);
+    RUN_TEST(vlan_counter_stats);
     return TEST_PASS;
 }
@@ -32,6 +32,9 @@
 #include <locitest/test_common.h>
 #include <SocketManager/socketmanager.h>
 #include <indigo/forwarding.h>
+#include <ofstatemanager_int.h>
+#include <ofstatemanager_decs.h>
+#include <expiration.h>
 
 #define TABLE_ID 1
 #define NUM_ENTRIES 10
@@ -42,9 +45,12 @@ extern void handle_message(of_object_t *obj);
 extern int do_barrier(void);
 
 static void do_add(uint32_t port, uint32_t meter);
+static void do_add_hard_timeout(uint32_t port, uint32_t meter, uint16_t hard_timeout);
+static void do_add_flags(uint32_t port, uint32_t meter, uint16_t hard_timeout, uint16_t flags);
 static void do_modify(uint32_t port, uint32_t meter) __attribute__((unused));
 static void do_delete(uint32_t port) __attribute__((unused));
 static void do_entry_stats(void) __attribute__((unused));
+static void do_delete_all(void);
 
 struct test_entry_stats;
 
@@ -75,6 +81,11 @@ struct test_table_stats {
     int count_delete;
     int count_stats;
     int count_hit_status;
+    int count_clear;
+    indigo_error_t clear_rv;
+    int count_stats_bulk;
+    indigo_error_t stats_bulk_rv;
+    int count_delete_bulk;
     struct test_entry_stats entries[NUM_ENTRIES];
 };
 
@@ -82,6 +93,9 @@ static struct test_table table;
 static struct test_table_stats stats;
 
 static indigo_core_table_ops_t test_ops;
+static indigo_core_table_ops_t test_ops_clear;
+static indigo_core_table_ops_t test_ops_stats_bulk;
+static indigo_core_table_ops_t test_ops_delete_bulk;
 
 static int
 test_table_entry_add(void)
@@ -211,6 +225,182 @@ test_table_entry_stats(void)
     return TEST_PASS;
 }
 
+static int
+test_table_clear(void)
+{
+    memset(&table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    table.magic = TABLE_MAGIC;
+    indigo_core_table_register(TABLE_ID, "test", &test_ops_clear, &table);
+
+    /* Deleting every flow in the table uses the clear op */
+    do_add(1, 1000);
+    do_add(2, 2000);
+
+    memset(&stats, 0, sizeof(stats));
+    do_delete_all();
+    AIM_TRUE_OR_DIE(stats.count_clear == 1);
+    AIM_TRUE_OR_DIE(stats.count_delete == 0);
+    AIM_TRUE_OR_DIE(stats.count_op == 1);
+    AIM_TRUE_OR_DIE(ind_core_ft->current_count == 0);
+
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats == 0);
+
+    /* A failed clear op falls back to per-flow deletes */
+    do_add(1, 1000);
+    do_add(2, 2000);
+    AIM_TRUE_OR_DIE(stats.count_add == 2);
+
+    memset(&stats, 0, sizeof(stats));
+    stats.clear_rv = INDIGO_ERROR_UNKNOWN;
+    do_delete_all();
+    AIM_TRUE_OR_DIE(stats.count_clear == 1);
+    AIM_TRUE_OR_DIE(stats.count_delete == 2);
+
+    /* A flow that needs a flow-removed message skips the clear op */
+    do_add(1, 1000);
+    do_add_flags(2, 2000, 0, OF_FLOW_MOD_FLAG_SEND_FLOW_REM);
+
+    memset(&stats, 0, sizeof(stats));
+    do_delete_all();
+    AIM_TRUE_OR_DIE(stats.count_clear == 0);
+    AIM_TRUE_OR_DIE(stats.count_delete == 2);
+
+    memset(&stats, 0, sizeof(stats));
+    indigo_core_table_unregister(TABLE_ID);
+    AIM_TRUE_OR_DIE(stats.count_op == 0);
+
+    return TEST_PASS;
+}
+
+static int
+test_table_entry_stats_bulk(void)
+{
+    memset(&table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    table.magic = TABLE_MAGIC;
+    indigo_core_table_register(TABLE_ID, "test", &test_ops_stats_bulk, &table);
+
+    do_add(1, 1000);
+    do_add(2, 2000);
+
+    /* One bulk call covers both flows */
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats_bulk == 1);
+    AIM_TRUE_OR_DIE(stats.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[2].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.count_stats == 2);
+
+    /* A failed bulk call falls back to per-flow calls */
+    memset(&stats, 0, sizeof(stats));
+    stats.stats_bulk_rv = INDIGO_ERROR_UNKNOWN;
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats_bulk == 1);
+    AIM_TRUE_OR_DIE(stats.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[2].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.count_stats == 2);
+
+    memset(&stats, 0, sizeof(stats));
+    indigo_core_table_unregister(TABLE_ID);
+    AIM_TRUE_OR_DIE(stats.count_delete == 2);
+
+    return TEST_PASS;
+}
+
+static int
+test_table_counter_cache(void)
+{
+    memset(&table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    table.magic = TABLE_MAGIC;
+    indigo_core_table_register(TABLE_ID, "test", &test_ops, &table);
+
+    do_add(1, 1000);
+    do_add(2, 2000);
+
+    /* The second request is served from the cache */
+    ind_core_counter_cache_config_set(60000, 0);
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[2].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.count_stats == 2);
+
+    /* Modifying a flow drops its cached counters */
+    do_modify(1, 3000);
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.entries[1].count_stats == 1);
+    AIM_TRUE_OR_DIE(stats.entries[2].count_stats == 0);
+
+    /* Disabled cache reads every time */
+    ind_core_counter_cache_config_set(0, 0);
+    memset(&stats, 0, sizeof(stats));
+    do_entry_stats();
+    AIM_TRUE_OR_DIE(stats.count_stats == 2);
+
+    memset(&stats, 0, sizeof(stats));
+    indigo_core_table_unregister(TABLE_ID);
+    AIM_TRUE_OR_DIE(stats.count_delete == 2);
+
+    return TEST_PASS;
+}
+
+static bool expiration_done;
+
+static void
+expiration_callback(void *cookie)
+{
+    indigo_time_t *now = cookie;
+    expiration_done = ind_core_expiration_run(*now);
+}
+
+/* Run the expiration engine from inside the event loop, as if at 'now' */
+static void
+do_expiration(indigo_time_t now)
+{
+    expiration_done = false;
+    AIM_TRUE_OR_DIE(ind_soc_timer_event_register(
+        expiration_callback, &now, IND_SOC_TIMER_IMMEDIATE) == 0);
+    ind_soc_select_and_run(0);
+    AIM_TRUE_OR_DIE(expiration_done);
+}
+
+static int
+test_table_expiration_bulk(void)
+{
+    indigo_time_t now;
+
+    memset(&table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    table.magic = TABLE_MAGIC;
+    indigo_core_table_register(TABLE_ID, "test", &test_ops_delete_bulk, &table);
+
+    do_add_hard_timeout(1, 1000, 1);
+    do_add_hard_timeout(2, 2000, 1);
+    do_add_hard_timeout(3, 3000, 1);
+
+    /* Nothing is due yet */
+    now = INDIGO_CURRENT_TIME;
+    do_expiration(now);
+    AIM_TRUE_OR_DIE(stats.count_delete == 0);
+
+    /* All three flows are deleted with a single bulk op */
+    do_expiration(now + 2000);
+    AIM_TRUE_OR_DIE(stats.count_delete_bulk == 1);
+    AIM_TRUE_OR_DIE(stats.count_delete == 3);
+
+    memset(&stats, 0, sizeof(stats));
+    indigo_core_table_unregister(TABLE_ID);
+    AIM_TRUE_OR_DIE(stats.count_delete == 0);
+
+    return TEST_PASS;
+}
+
 int
 test_table(void)
 {
@@ -218,6 +408,10 @@ test_table(void)
     RUN_TEST(table_entry_delete);
     RUN_TEST(table_entry_modify);
     RUN_TEST(table_entry_stats);
+    RUN_TEST(table_clear);
+    RUN_TEST(table_entry_stats_bulk);
+    RUN_TEST(table_counter_cache);
+    RUN_TEST(table_expiration_bulk);
     return TEST_PASS;
 }
 
@@ -225,10 +419,24 @@ test_table(void)
 
 static void
 do_add(uint32_t port, uint32_t meter)
+{
+    do_add_hard_timeout(port, meter, 0);
+}
+
+static void
+do_add_hard_timeout(uint32_t port, uint32_t meter, uint16_t hard_timeout)
+{
+    do_add_flags(port, meter, hard_timeout, 0);
+}
+
+static void
+do_add_flags(uint32_t port, uint32_t meter, uint16_t hard_timeout, uint16_t flags)
 {
     of_object_t *obj = of_flow_add_new(OF_VERSION_1_3);
     of_flow_add_xid_set(obj, 0x12345678);
     of_flow_add_table_id_set(obj, TABLE_ID);
+    of_flow_add_hard_timeout_set(obj, hard_timeout);
+    of_flow_add_flags_set(obj, flags);
     {
         of_match_t match;
         memset(&match, 0, sizeof(match));
@@ -307,6 +515,19 @@ do_delete(uint32_t port)
     do_barrier();
 }
 
+static void
+do_delete_all(void)
+{
+    of_object_t *obj = of_flow_delete_new(OF_VERSION_1_3);
+    of_flow_delete_xid_set(obj, 0x12345678);
+    of_flow_delete_table_id_set(obj, TABLE_ID);
+    of_flow_delete_out_port_set(obj, OF_PORT_DEST_WILDCARD);
+    of_flow_delete_out_group_set(obj, OF_GROUP_ANY);
+
+    handle_message(obj);
+    do_barrier();
+}
+
 static void
 do_entry_stats()
 {
@@ -459,3 +680,85 @@ static indigo_core_table_ops_t test_ops = {
     op_entry_stats_get,
     op_entry_hit_status_get,
 };
+
+static indigo_error_t
+op_table_clear(void *table_priv, indigo_cxn_id_t cxn_id)
+{
+    struct test_table *table = table_priv;
+    AIM_TRUE_OR_DIE(table->magic == TABLE_MAGIC);
+
+    stats.count_clear++;
+    if (stats.clear_rv < 0) {
+        return stats.clear_rv;
+    }
+
+    stats.count_op++;
+
+    return INDIGO_ERROR_NONE;
+}
+
+static indigo_core_table_ops_t test_ops_clear = {
+    .entry_create = op_entry_create,
+    .entry_modify = op_entry_modify,
+    .entry_delete = op_entry_delete,
+    .entry_stats_get = op_entry_stats_get,
+    .entry_hit_status_get = op_entry_hit_status_get,
+    .clear = op_table_clear,
+};
+
+static indigo_error_t
+op_entry_stats_get_bulk(void *table_priv, indigo_cxn_id_t cxn_id,
+                        void **entry_privs, int count,
+                        indigo_fi_flow_stats_t *flow_stats)
+{
+    int i;
+
+    stats.count_stats_bulk++;
+    if (stats.stats_bulk_rv < 0) {
+        return stats.stats_bulk_rv;
+    }
+
+    for (i = 0; i < count; i++) {
+        indigo_error_t rv = op_entry_stats_get(table_priv, cxn_id,
+                                               entry_privs[i], &flow_stats[i]);
+        AIM_TRUE_OR_DIE(rv == INDIGO_ERROR_NONE);
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+static indigo_core_table_ops_t test_ops_stats_bulk = {
+    .entry_create = op_entry_create,
+    .entry_modify = op_entry_modify,
+    .entry_delete = op_entry_delete,
+    .entry_stats_get = op_entry_stats_get,
+    .entry_hit_status_get = op_entry_hit_status_get,
+    .entry_stats_get_bulk = op_entry_stats_get_bulk,
+};
+
+static indigo_error_t
+op_entry_delete_bulk(void *table_priv, indigo_cxn_id_t cxn_id,
+                     void **entry_privs, int count,
+                     indigo_fi_flow_stats_t *flow_stats)
+{
+    int i;
+
+    stats.count_delete_bulk++;
+
+    for (i = 0; i < count; i++) {
+        indigo_error_t rv = op_entry_delete(table_priv, cxn_id,
+                                            entry_privs[i], &flow_stats[i]);
+        AIM_TRUE_OR_DIE(rv == INDIGO_ERROR_NONE);
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+static indigo_core_table_ops_t test_ops_delete_bulk = {
+    .entry_create = op_entry_create,
+    .entry_modify = op_entry_modify,
+    .entry_delete = op_entry_delete,
+    .entry_stats_get = op_entry_stats_get,
+    .entry_hit_status_get = op_entry_hit_status_get,
+    .entry_delete_bulk = op_entry_delete_bulk,
+};
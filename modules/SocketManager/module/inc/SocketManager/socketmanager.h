@@ -259,6 +259,26 @@ indigo_error_t ind_soc_timer_event_unregister(
     ind_soc_timer_callback_f callback,
     void *cookie);
 
+/**
+ * Set how late a timer event may run
+ *
+ * @param callback Timer callback function
+ * @param cookie Opaque data passed to callback
+ * @param slack_ms Milliseconds the callback may be delayed past its deadline
+ *
+ * The event loop sleeps until the earliest deadline plus slack of all
+ * waiting timers and then runs every timer that has become due, so timers
+ * with nearby deadlines share one wakeup. Immediate timers ignore slack.
+ *
+ * New timers start with SOCKETMANAGER_CONFIG_TIMER_SLACK_MS. The slack
+ * is kept when the timer is re-registered.
+ */
+
+indigo_error_t ind_soc_timer_event_slack_set(
+    ind_soc_timer_callback_f callback,
+    void *cookie,
+    int slack_ms);
+
 /****************************************************************
  * Task functions
  ****************************************************************/
@@ -290,6 +310,21 @@ indigo_error_t ind_soc_task_register(
     ind_soc_task_callback_f callback,
     void *cookie, ind_soc_priority_t priority);
 
+/**
+ * Unregister a task
+ *
+ * @param callback Task callback function
+ * @param cookie Opaque data passed to callback
+ *
+ * The task to unregister is keyed on both the callback and cookie. It is
+ * not called again, and may be unregistered from any callback including
+ * its own.
+ */
+
+indigo_error_t ind_soc_task_unregister(
+    ind_soc_task_callback_f callback,
+    void *cookie);
+
 
 typedef struct ind_soc_config_s {
     uint32_t flags; /* Ignored */
@@ -385,6 +420,7 @@ extern indigo_error_t ind_soc_finish(void);
 extern int unit_test_soc_timer_event_count_get(void);
 extern int unit_test_soc_socket_count_get(void);
 extern int unit_test_soc_socket_events_get(int socket_id);
+extern uint64_t unit_test_soc_wakeup_count_get(void);
 
 
 #endif /* __SOCKETMANAGER_H__ */
@@ -148,6 +148,16 @@
 #define SOCKETMANAGER_CONFIG_TIMER_PEEK_MS 1024
 #endif
 
+/**
+ * SOCKETMANAGER_CONFIG_TIMER_SLACK_MS
+ *
+ * Default milliseconds a timer may run late so that it can share a wakeup with other timers */
+
+
+#ifndef SOCKETMANAGER_CONFIG_TIMER_SLACK_MS
+#define SOCKETMANAGER_CONFIG_TIMER_SLACK_MS 0
+#endif
+
 /**
  * SOCKETMANAGER_CONFIG_MAX_SOCKETS
  *
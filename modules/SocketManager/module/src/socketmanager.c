@@ -115,6 +115,7 @@ typedef struct timer_event_s {
     ind_soc_timer_callback_f callback;
     void *cookie;
     int repeat_time_ms;
+    int slack_ms; /* How late the timer may fire to share a wakeup */
     ind_soc_priority_t priority;
 } timer_event_t;
 
@@ -122,6 +123,7 @@ static timer_event_t timer_event[SOCKETMANAGER_CONFIG_MAX_TIMERS];
 static timer_wheel_t *timer_wheel;
 static list_head_t ready_timers; /* contains timer_event_t through ready_links */
 static int num_timers = 0;
+static int num_slack_timers = 0; /* Registered timers with nonzero slack */
 
 #define TIMER_EVENT_VALID(idx) (timer_event[idx].callback != NULL)
 
@@ -142,7 +144,11 @@ typedef struct ind_soc_task_s {
 /* Sorted in descending priority order */
 static list_head_t tasks;
 
+/* Set while process_tasks runs; unregistered tasks are freed by it */
+static bool processing_tasks;
+
 static struct histogram *latency_histogram;
+static debug_counter_t wakeup_counter;
 
 
 /* Return index for timer; -1 if not found.  Use only with valid callback */
@@ -193,12 +199,16 @@ soc_mgr_init(void)
     list_init(&ready_timers);
 
     latency_histogram = histogram_create("socman.latency");
+
+    debug_counter_register(&wakeup_counter, "socketmanager.wakeups",
+                           "Number of times the event loop returned from poll");
 }
 
 static void
 soc_mgr_denit(void)
 {
     histogram_destroy(latency_histogram);
+    debug_counter_unregister(&wakeup_counter);
 }
 
 indigo_error_t
@@ -379,6 +389,46 @@ ind_soc_run_status_set(ind_soc_run_status_t s)
 }
 
 
+/* Slack actually applied to a timer; immediate timers never wait */
+static int
+timer_effective_slack(const timer_event_t *timer)
+{
+    if (timer->repeat_time_ms == IND_SOC_TIMER_IMMEDIATE) {
+        return 0;
+    }
+    return timer->slack_ms;
+}
+
+/*
+ * Return the latest time we can sleep until without running any waiting
+ * timer later than its deadline plus slack.
+ *
+ * Sleeping until then lets every timer whose deadline falls in the window
+ * run in a single wakeup.
+ */
+static indigo_time_t
+find_coalesced_wakeup(void)
+{
+    indigo_time_t wakeup = (indigo_time_t)-1;
+    int idx;
+
+    FOREACH_TIMER_EVENT(idx) {
+        timer_event_t *timer = &timer_event[idx];
+        indigo_time_t latest;
+
+        if (timer->state != TIMER_STATE_WAITING) {
+            continue;
+        }
+
+        latest = timer->timer_wheel_entry.deadline + timer_effective_slack(timer);
+        if (latest < wakeup) {
+            wakeup = latest;
+        }
+    }
+
+    return wakeup;
+}
+
 /*
  * Return the time in ms until the next timer could fire, or -1 if no timers
  * are active.
@@ -386,19 +436,39 @@ ind_soc_run_status_set(ind_soc_run_status_t s)
 static int
 find_next_timer_expiration(indigo_time_t now)
 {
+    indigo_time_t wakeup;
+
     if (!list_empty(&ready_timers)) {
         return 0;
     }
 
-    timer_wheel_entry_t *entry =
-        timer_wheel_peek(timer_wheel, now + SOCKETMANAGER_CONFIG_TIMER_PEEK_MS);
-    if (entry) {
-        return entry->deadline - now;
-    } else if (num_timers > 0) {
-        return SOCKETMANAGER_CONFIG_TIMER_PEEK_MS;
-    } else {
+    if (num_timers == 0) {
         return -1;
     }
+
+    if (num_slack_timers == 0) {
+        timer_wheel_entry_t *entry =
+            timer_wheel_peek(timer_wheel, now + SOCKETMANAGER_CONFIG_TIMER_PEEK_MS);
+        if (entry) {
+            return entry->deadline - now;
+        }
+    }
+
+    /*
+     * Either some timers may run late or nothing is due within the peek
+     * window. Find the exact wakeup rather than polling again every
+     * TIMER_PEEK_MS while idle.
+     */
+    wakeup = find_coalesced_wakeup();
+    if (wakeup == (indigo_time_t)-1) {
+        return -1;
+    } else if (wakeup <= now) {
+        return 0;
+    } else if (wakeup - now > INT_MAX) {
+        return INT_MAX;
+    } else {
+        return wakeup - now;
+    }
 }
 
 /* Pull expired timers off the timer wheel and add them to the ready list */
@@ -459,6 +529,9 @@ process_timers(ind_soc_priority_t priority)
             /* De-register one-shot immediate timers */
             timer->state = TIMER_STATE_FREE;
             num_timers--;
+            if (timer->slack_ms > 0) {
+                num_slack_timers--;
+            }
         } else {
             timer_wheel_insert(timer_wheel, &timer->timer_wheel_entry,
                                now + timer->repeat_time_ms);
@@ -511,6 +584,7 @@ ind_soc_timer_event_register_with_priority(
     }
 
     timer_event[idx].repeat_time_ms = repeat_time_ms;
+    timer_event[idx].slack_ms = SOCKETMANAGER_CONFIG_TIMER_SLACK_MS;
     timer_event[idx].callback = callback;
     timer_event[idx].cookie = cookie;
     timer_event[idx].priority = priority;
@@ -518,6 +592,9 @@ ind_soc_timer_event_register_with_priority(
                        INDIGO_CURRENT_TIME + repeat_time_ms);
     timer_event[idx].state = TIMER_STATE_WAITING;
     num_timers++;
+    if (timer_event[idx].slack_ms > 0) {
+        num_slack_timers++;
+    }
 
     return INDIGO_ERROR_NONE;
 }
@@ -550,6 +627,37 @@ ind_soc_timer_event_unregister(ind_soc_timer_callback_f callback, void *cookie)
 
     timer_event[idx].state = TIMER_STATE_FREE;
     num_timers--;
+    if (timer_event[idx].slack_ms > 0) {
+        num_slack_timers--;
+    }
+
+    return INDIGO_ERROR_NONE;
+}
+
+indigo_error_t
+ind_soc_timer_event_slack_set(ind_soc_timer_callback_f callback, void *cookie,
+                              int slack_ms)
+{
+    int idx;
+
+    if (slack_ms < 0) {
+        AIM_LOG_INTERNAL("Invalid slack for timer: %d", slack_ms);
+        return INDIGO_ERROR_PARAM;
+    }
+
+    if ((idx = timer_event_find(callback, cookie)) < 0) {
+        AIM_LOG_TRACE("Timer event %p, %p not found for slack set",
+                      callback, cookie);
+        return INDIGO_ERROR_NOT_FOUND;
+    }
+
+    if (timer_event[idx].slack_ms > 0) {
+        num_slack_timers--;
+    }
+    timer_event[idx].slack_ms = slack_ms;
+    if (timer_event[idx].slack_ms > 0) {
+        num_slack_timers++;
+    }
 
     return INDIGO_ERROR_NONE;
 }
@@ -628,6 +736,29 @@ ind_soc_task_register(ind_soc_task_callback_f callback,
     return INDIGO_ERROR_NONE;
 }
 
+indigo_error_t
+ind_soc_task_unregister(ind_soc_task_callback_f callback, void *cookie)
+{
+    list_links_t *cur;
+
+    LIST_FOREACH(&tasks, cur) {
+        ind_soc_task_t *task = container_of(cur, links, ind_soc_task_t);
+        if (task->callback == callback && task->cookie == cookie) {
+            if (processing_tasks) {
+                /* process_tasks may hold a pointer to it */
+                task->callback = NULL;
+            } else {
+                list_remove(&task->links);
+                aim_free(task);
+            }
+            return INDIGO_ERROR_NONE;
+        }
+    }
+
+    AIM_LOG_TRACE("Task %p, %p not found for unregister", callback, cookie);
+    return INDIGO_ERROR_NOT_FOUND;
+}
+
 
 indigo_error_t
 ind_soc_init(ind_soc_config_t *config)
@@ -760,18 +891,27 @@ static void
 process_tasks(ind_soc_priority_t priority)
 {
     struct list_links *cur, *next;
+    processing_tasks = true;
     LIST_FOREACH_SAFE(&tasks, cur, next) {
         ind_soc_task_t *task = container_of(cur, links, ind_soc_task_t);
+        if (task->callback == NULL) {
+            /* Unregistered */
+            list_remove(&task->links);
+            aim_free(task);
+            continue;
+        }
         if (task->priority < priority) {
             break;
         }
         before_callback();
-        if (task->callback(task->cookie) == IND_SOC_TASK_FINISHED) {
+        if (task->callback(task->cookie) == IND_SOC_TASK_FINISHED ||
+                task->callback == NULL) {
             list_remove(&task->links);
             aim_free(task);
         }
         after_callback();
     }
+    processing_tasks = false;
 }
 
 /*
@@ -850,6 +990,7 @@ ind_soc_select_and_run(int run_for_ms)
         AIM_LOG_TRACE("polling %d fds, timeout %d ms", num_pollfds, timeout_ms);
         rv = poll(pollfds, num_pollfds, timeout_ms);
         AIM_LOG_TRACE("poll returned %d", rv);
+        debug_counter_inc(&wakeup_counter);
 
         if (rv < 0 && errno != EINTR) {
             AIM_LOG_ERROR("Error in poll: %s", strerror(errno));
@@ -917,3 +1058,9 @@ unit_test_soc_socket_events_get(int socket_id)
 {
     return pollfds[POLLFD_INDEX(socket_id)].events;
 }
+
+uint64_t
+unit_test_soc_wakeup_count_get(void)
+{
+    return debug_counter_get(&wakeup_counter);
+}
@@ -0,0 +1,397 @@
+/****************************************************************
+ *
+ *        Copyright 2017, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/******************************************************************************
+ *
+ *  /utest/bench.c
+ *
+ *  SocketManager event loop benchmark
+ *
+ *  Run the unit test binary with "bench" as the first argument:
+ *
+ *      utest bench [-s sockets] [-t timers] [-k tasks] [-d duration_ms] [-p]
+ *
+ *  Each socketpair keeps one timestamped message in flight: the read
+ *  callback records how long the message waited to be dispatched and then
+ *  immediately sends the next one. Timers record how late they ran. Tasks
+ *  do a token amount of work and record, per priority, how long they
+ *  waited between returning CONTINUE and being called again.
+ *
+ *  Everything runs at normal priority by default. With -p, sockets, timers
+ *  and tasks are spread round-robin across priorities; since the socket
+ *  load is saturating, only the highest priority level then makes progress,
+ *  which measures the cost of the priority scan rather than fairness.
+ *
+ *  Only the public SocketManager API is used, so the same benchmark runs
+ *  unchanged against any event loop backend.
+ *
+ *****************************************************************************/
+
+#include <SocketManager/socketmanager_config.h>
+#include <SocketManager/socketmanager.h>
+#include <indigo/assert.h>
+#include <indigo/time.h>
+#include <AIM/aim.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "socketmanager_log.h"
+
+#define BENCH_MAX_SAMPLES (4*1024*1024)
+#define BENCH_NUM_PRIORITIES \
+    (IND_SOC_HIGHEST_PRIORITY - IND_SOC_LOWEST_PRIORITY + 1)
+
+struct bench_config {
+    int num_sockets;
+    int num_timers;
+    int num_tasks;
+    int duration_ms;
+    bool spread_priorities;
+};
+
+struct bench_socket {
+    int fds[2];
+};
+
+struct bench_timer {
+    int period_ms;
+    uint64_t expected_ns;
+};
+
+struct bench_task {
+    ind_soc_priority_t priority;
+    uint64_t returned_ns;
+};
+
+/* Latency samples in nanoseconds */
+struct bench_samples {
+    uint32_t *values;
+    int count;
+    uint64_t dropped;
+};
+
+static struct bench_samples socket_latency;
+static struct bench_samples timer_lateness;
+static struct bench_samples task_latency[BENCH_NUM_PRIORITIES];
+
+static uint64_t socket_dispatches;
+static uint64_t timer_dispatches;
+static uint64_t task_dispatches;
+static uint64_t callback_ns;
+static int bench_stop;
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+bench_sample(struct bench_samples *samples, uint64_t value)
+{
+    if (samples->count < BENCH_MAX_SAMPLES) {
+        samples->values[samples->count++] =
+            value > UINT32_MAX ? UINT32_MAX : value;
+    } else {
+        samples->dropped++;
+    }
+}
+
+static int
+bench_compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t
+bench_percentile(struct bench_samples *samples, double pct)
+{
+    int idx;
+
+    if (samples->count == 0) {
+        return 0;
+    }
+
+    idx = (int)(samples->count * pct / 100.0);
+    if (idx >= samples->count) {
+        idx = samples->count - 1;
+    }
+
+    return samples->values[idx];
+}
+
+static void
+bench_report_latency(const char *name, struct bench_samples *samples)
+{
+    qsort(samples->values, samples->count, sizeof(samples->values[0]),
+          bench_compare_u32);
+
+    printf("  %-22s samples=%d p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus",
+           name, samples->count,
+           bench_percentile(samples, 50) / 1000.0,
+           bench_percentile(samples, 99) / 1000.0,
+           bench_percentile(samples, 99.9) / 1000.0,
+           bench_percentile(samples, 100) / 1000.0);
+    if (samples->dropped > 0) {
+        printf(" (dropped %"PRIu64")", samples->dropped);
+    }
+    printf("\n");
+}
+
+static ind_soc_priority_t
+bench_priority(const struct bench_config *config, int i)
+{
+    if (!config->spread_priorities) {
+        return IND_SOC_NORMAL_PRIORITY;
+    }
+    return IND_SOC_LOWEST_PRIORITY + (i % BENCH_NUM_PRIORITIES);
+}
+
+static void
+bench_send(struct bench_socket *sock)
+{
+    uint64_t ts = bench_now_ns();
+    if (write(sock->fds[1], &ts, sizeof(ts)) != sizeof(ts)) {
+        AIM_DIE("Benchmark write failed: %s", strerror(errno));
+    }
+}
+
+static void
+bench_socket_ready(
+    int socket_id,
+    void *cookie,
+    int read_ready,
+    int write_ready,
+    int error_seen)
+{
+    struct bench_socket *sock = cookie;
+    uint64_t start = bench_now_ns();
+    uint64_t sent;
+
+    if (read(socket_id, &sent, sizeof(sent)) != sizeof(sent)) {
+        AIM_DIE("Benchmark read failed: %s", strerror(errno));
+    }
+
+    bench_sample(&socket_latency, start - sent);
+    socket_dispatches++;
+
+    bench_send(sock);
+
+    callback_ns += bench_now_ns() - start;
+}
+
+static void
+bench_timer_ready(void *cookie)
+{
+    struct bench_timer *timer = cookie;
+    uint64_t start = bench_now_ns();
+
+    bench_sample(&timer_lateness,
+                 start > timer->expected_ns ? start - timer->expected_ns : 0);
+    timer->expected_ns = start + (uint64_t)timer->period_ms * 1000000;
+    timer_dispatches++;
+
+    callback_ns += bench_now_ns() - start;
+}
+
+static ind_soc_task_status_t
+bench_task_ready(void *cookie)
+{
+    struct bench_task *task = cookie;
+    uint64_t start = bench_now_ns();
+    volatile int i, work = 0;
+
+    bench_sample(&task_latency[task->priority - IND_SOC_LOWEST_PRIORITY],
+                 start - task->returned_ns);
+
+    for (i = 0; i < 100; i++) {
+        work += i;
+    }
+
+    task_dispatches++;
+    task->returned_ns = bench_now_ns();
+    callback_ns += task->returned_ns - start;
+
+    return bench_stop ? IND_SOC_TASK_FINISHED : IND_SOC_TASK_CONTINUE;
+}
+
+static int
+bench_usage(void)
+{
+    printf("usage: bench [-s sockets] [-t timers] [-k tasks] [-d duration_ms] [-p]\n");
+    return 1;
+}
+
+int
+socketmanager_bench_main(int argc, char *argv[])
+{
+    struct bench_config config = {
+        .num_sockets = 64,
+        .num_timers = SOCKETMANAGER_CONFIG_MAX_TIMERS / 2,
+        .num_tasks = 4,
+        .duration_ms = 2000,
+    };
+    struct bench_socket *sockets;
+    struct bench_timer *timers;
+    struct bench_task *tasks;
+    uint64_t start_ns, elapsed_ns, wakeups;
+    uint64_t dispatches;
+    int i, opt;
+
+    optind = 1;
+    while ((opt = getopt(argc, argv, "s:t:k:d:p")) != -1) {
+        switch (opt) {
+        case 's': config.num_sockets = atoi(optarg); break;
+        case 't': config.num_timers = atoi(optarg); break;
+        case 'k': config.num_tasks = atoi(optarg); break;
+        case 'd': config.duration_ms = atoi(optarg); break;
+        case 'p': config.spread_priorities = true; break;
+        default: return bench_usage();
+        }
+    }
+
+    if (config.num_sockets < 0 || config.num_timers < 0 ||
+            config.num_tasks < 0 || config.duration_ms <= 0) {
+        return bench_usage();
+    }
+
+    if (config.num_timers > SOCKETMANAGER_CONFIG_MAX_TIMERS) {
+        printf("Limiting timers to SOCKETMANAGER_CONFIG_MAX_TIMERS (%d)\n",
+               SOCKETMANAGER_CONFIG_MAX_TIMERS);
+        config.num_timers = SOCKETMANAGER_CONFIG_MAX_TIMERS;
+    }
+
+    socket_latency.values = aim_zmalloc(BENCH_MAX_SAMPLES * sizeof(uint32_t));
+    timer_lateness.values = aim_zmalloc(BENCH_MAX_SAMPLES * sizeof(uint32_t));
+
+    sockets = aim_zmalloc((config.num_sockets + 1) * sizeof(*sockets));
+    timers = aim_zmalloc((config.num_timers + 1) * sizeof(*timers));
+    tasks = aim_zmalloc((config.num_tasks + 1) * sizeof(*tasks));
+
+    for (i = 0; i < config.num_sockets; i++) {
+        struct bench_socket *sock = &sockets[i];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock->fds) < 0) {
+            AIM_DIE("socketpair failed: %s", strerror(errno));
+        }
+        INDIGO_ASSERT(ind_soc_socket_register_with_priority(
+            sock->fds[0], bench_socket_ready, sock, bench_priority(&config, i)) == 0);
+    }
+
+    for (i = 0; i < config.num_timers; i++) {
+        struct bench_timer *timer = &timers[i];
+        timer->period_ms = 1 + (i % 50);
+        timer->expected_ns = bench_now_ns() + (uint64_t)timer->period_ms * 1000000;
+        INDIGO_ASSERT(ind_soc_timer_event_register_with_priority(
+            bench_timer_ready, timer, timer->period_ms, bench_priority(&config, i)) == 0);
+    }
+
+    for (i = 0; i < config.num_tasks; i++) {
+        struct bench_task *task = &tasks[i];
+        struct bench_samples *samples;
+        task->priority = bench_priority(&config, i);
+        task->returned_ns = bench_now_ns();
+        samples = &task_latency[task->priority - IND_SOC_LOWEST_PRIORITY];
+        if (samples->values == NULL) {
+            samples->values = aim_zmalloc(BENCH_MAX_SAMPLES * sizeof(uint32_t));
+        }
+        INDIGO_ASSERT(ind_soc_task_register(
+            bench_task_ready, task, task->priority) == 0);
+    }
+
+    /* Prime each socketpair with one message */
+    for (i = 0; i < config.num_sockets; i++) {
+        bench_send(&sockets[i]);
+    }
+
+    printf("SocketManager benchmark: %d sockets, %d timers, %d tasks, %d ms\n",
+           config.num_sockets, config.num_timers, config.num_tasks,
+           config.duration_ms);
+
+    wakeups = unit_test_soc_wakeup_count_get();
+    start_ns = bench_now_ns();
+    ind_soc_select_and_run(config.duration_ms);
+    elapsed_ns = bench_now_ns() - start_ns;
+    wakeups = unit_test_soc_wakeup_count_get() - wakeups;
+
+    dispatches = socket_dispatches + timer_dispatches + task_dispatches;
+
+    printf("Results:\n");
+    printf("  elapsed                %.1f ms\n", elapsed_ns / 1e6);
+    printf("  dispatches             %"PRIu64" (sockets %"PRIu64", timers %"PRIu64", tasks %"PRIu64")\n",
+           dispatches, socket_dispatches, timer_dispatches, task_dispatches);
+    printf("  throughput             %.0f dispatches/s\n",
+           dispatches / (elapsed_ns / 1e9));
+    printf("  loop iterations        %"PRIu64"\n", wakeups);
+    if (wakeups > 0) {
+        printf("  overhead/iteration     %.2f us\n",
+               (elapsed_ns - callback_ns) / 1e3 / wakeups);
+    }
+    if (dispatches > 0) {
+        printf("  overhead/dispatch      %.2f us\n",
+               (elapsed_ns - callback_ns) / 1e3 / dispatches);
+    }
+    bench_report_latency("socket dispatch delay", &socket_latency);
+    bench_report_latency("timer lateness", &timer_lateness);
+    for (i = 0; i < BENCH_NUM_PRIORITIES; i++) {
+        char name[32];
+        if (task_latency[i].values == NULL) {
+            continue;
+        }
+        snprintf(name, sizeof(name), "task start (prio %d)",
+                 IND_SOC_LOWEST_PRIORITY + i);
+        bench_report_latency(name, &task_latency[i]);
+    }
+
+    /* Clean up; tasks unregister themselves on the next iteration */
+    bench_stop = 1;
+    ind_soc_select_and_run(0);
+    for (i = 0; i < config.num_timers; i++) {
+        ind_soc_timer_event_unregister(bench_timer_ready, &timers[i]);
+    }
+    for (i = 0; i < config.num_sockets; i++) {
+        ind_soc_socket_unregister(sockets[i].fds[0]);
+        close(sockets[i].fds[0]);
+        close(sockets[i].fds[1]);
+    }
+
+    aim_free(sockets);
+    aim_free(timers);
+    aim_free(tasks);
+    aim_free(socket_latency.values);
+    aim_free(timer_lateness.values);
+    for (i = 0; i < BENCH_NUM_PRIORITIES; i++) {
+        aim_free(task_latency[i].values);
+        task_latency[i].values = NULL;
+    }
+
+    return 0;
+}
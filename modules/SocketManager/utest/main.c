@@ -30,6 +30,7 @@
 
 #include <SocketManager/socketmanager.h>
 #include <stdio.h>
+#include <string.h>
 #include <indigo/assert.h>
 #include <indigo/time.h>
 #include <unistd.h>
@@ -43,6 +44,8 @@
 
 #include "socketmanager_log.h"
 
+int socketmanager_bench_main(int argc, char *argv[]);
+
 static int sigalrm_write_fd = -1;
 static int task_counter_limit = 1;
 
@@ -431,6 +434,50 @@ test_future_timer(void)
     INDIGO_ASSERT(ind_soc_timer_event_unregister(timer_callback, &count) == 0);
 }
 
+static void
+timer_callback_timestamp(void *cookie)
+{
+    indigo_time_t *time_ptr = cookie;
+    *time_ptr = INDIGO_CURRENT_TIME;
+    printf("Timestamp timer callback called\n");
+}
+
+static void
+test_timer_slack(void)
+{
+    indigo_time_t start, early = 0, late = 0;
+
+    /* Can't set slack on an unknown timer */
+    INDIGO_ASSERT(ind_soc_timer_event_slack_set(
+        timer_callback_timestamp, &early, 10) == INDIGO_ERROR_NOT_FOUND);
+
+    start = INDIGO_CURRENT_TIME;
+    INDIGO_ASSERT(ind_soc_timer_event_register(
+        timer_callback_timestamp, &early, 100) == 0);
+    INDIGO_ASSERT(ind_soc_timer_event_register(
+        timer_callback_timestamp, &late, 250) == 0);
+
+    INDIGO_ASSERT(ind_soc_timer_event_slack_set(
+        timer_callback_timestamp, &early, -1) == INDIGO_ERROR_PARAM);
+    INDIGO_ASSERT(ind_soc_timer_event_slack_set(
+        timer_callback_timestamp, &early, 200) == 0);
+
+    /* The early timer may wait for the late one */
+    ind_soc_select_and_run(200);
+    INDIGO_ASSERT(early == 0);
+    INDIGO_ASSERT(late == 0);
+
+    /* Both should fire in the same wakeup */
+    ind_soc_select_and_run(150);
+    INDIGO_ASSERT(early != 0);
+    INDIGO_ASSERT(late != 0);
+    INDIGO_ASSERT(INDIGO_TIME_DIFF_ms(start, early) >= 250);
+    INDIGO_ASSERT(INDIGO_TIME_DIFF_ms(start, early) <= 300);
+
+    INDIGO_ASSERT(ind_soc_timer_event_unregister(timer_callback_timestamp, &early) == 0);
+    INDIGO_ASSERT(ind_soc_timer_event_unregister(timer_callback_timestamp, &late) == 0);
+}
+
 static ind_soc_task_status_t
 task_callback(void *cookie)
 {
@@ -508,6 +555,13 @@ test_task(void)
     INDIGO_ASSERT(counters[0] == 0);
     INDIGO_ASSERT(counters[1] == 0);
 
+    /* No task should run after unregistering */
+    INDIGO_ASSERT(ind_soc_task_register(task_callback, &counters[0], 0) == INDIGO_ERROR_NONE);
+    INDIGO_ASSERT(ind_soc_task_unregister(task_callback, &counters[0]) == INDIGO_ERROR_NONE);
+    INDIGO_ASSERT(ind_soc_task_unregister(task_callback, &counters[0]) == INDIGO_ERROR_NOT_FOUND);
+    ind_soc_select_and_run(0);
+    INDIGO_ASSERT(counters[0] == 0);
+
     /* Task should yield after 10 ms */
     INDIGO_ASSERT(ind_soc_task_register(task_callback_yield, &counters[0], 0) == INDIGO_ERROR_NONE);
     memset(counters, 0, sizeof(counters));
@@ -680,10 +734,15 @@ aim_main(int argc, char* argv[])
 
     printf("Init returned %d\n", ind_soc_init(&config));
 
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        return socketmanager_bench_main(argc - 1, argv + 1);
+    }
+
     test_timer_mgmt();
     test_periodic_timer();
     test_immediate_timer();
     test_future_timer();
+    test_timer_slack();
     test_socket();
     test_socket_mgmt();
     test_task();
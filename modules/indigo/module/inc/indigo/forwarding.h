@@ -70,6 +70,21 @@ void indigo_fwd_vlan_stats_get(
     uint16_t vlan_vid,
     indigo_fi_vlan_stats_t *vlan_stats);
 
+/**
+ * @brief VLAN stats for multiple VLANs
+ * @param vlan_vids The IDs of the VLANs whose stats are to be retrieved
+ * @param count Number of VLANs
+ * @param [out] vlan_stats Statistics for each VLAN
+ *
+ * Same semantics as indigo_fwd_vlan_stats_get for each VLAN. Optional; the
+ * default implementation calls indigo_fwd_vlan_stats_get for each VLAN.
+ */
+
+void indigo_fwd_vlan_stats_get_many(
+    const uint16_t *vlan_vids,
+    int count,
+    indigo_fi_vlan_stats_t *vlan_stats);
+
 /**
  * @brief Packet out operation
  * @param packet_out The LOXI packet out message
@@ -248,6 +248,34 @@ typedef struct indigo_core_gentable_ops {
      */
     indigo_error_t (*finish)(
         indigo_cxn_id_t cxn_id, void *table_priv);
+
+    /**
+     * @brief Get stats for a batch of entries (optional)
+     * @param table_priv Table private data
+     * @param entry_privs Entry private data for each entry
+     * @param keys Entry keys (identical to keys from add)
+     * @param stats Stats lists to be filled in, one per entry
+     * @param count Number of entries in the batch
+     *
+     * If set, this is used instead of get_stats for entry stats requests.
+     * The keys and stats lists are only valid for the duration of the call.
+     */
+    void (*get_stats_bulk)(
+        void *table_priv, void **entry_privs, of_list_bsn_tlv_t **keys,
+        of_list_bsn_tlv_t **stats, int count);
+
+    /**
+     * @brief Delete every entry in the table (optional)
+     * @param cxn_id Controller connection ID
+     * @param table_priv Table private data
+     *
+     * If set, a gentable_clear request covering the whole table calls this
+     * once instead of calling del for each entry. The implementation must
+     * free the private data of every entry. If it fails the table is left
+     * unchanged and the entries are deleted one at a time instead.
+     */
+    indigo_error_t (*clear)(
+        indigo_cxn_id_t cxn_id, void *table_priv);
 } indigo_core_gentable_ops_t;
 
 /*
@@ -321,6 +349,78 @@ indigo_core_gentable_acquire(indigo_core_gentable_t *gentable, of_object_t *key)
 void
 indigo_core_gentable_release(indigo_core_gentable_t *gentable, of_object_t *key);
 
+/**
+ * @brief Opaque handle to a gentable entry
+ *
+ * A handle stays valid until the entry is deleted. Holding a reference
+ * with indigo_core_gentable_entry_acquire prevents deletion.
+ */
+typedef struct ind_core_gentable_entry indigo_core_gentable_entry_t;
+
+/*
+ * @brief Hash a gentable key
+ * @param key
+ *
+ * Callers that look up the same key repeatedly can cache the result and
+ * pass it to indigo_core_gentable_entry_lookup_hash.
+ */
+
+uint32_t
+indigo_core_gentable_key_hash(of_object_t *key);
+
+/*
+ * @brief Lookup a gentable entry handle by key
+ * @param gentable
+ * @param key
+ *
+ * Returns the entry handle, or NULL if not found.
+ *
+ * The key can be either a single TLV or a list of TLVs.
+ */
+
+indigo_core_gentable_entry_t *
+indigo_core_gentable_entry_lookup(indigo_core_gentable_t *gentable, of_object_t *key);
+
+/*
+ * @brief Lookup a gentable entry handle by key and precomputed hash
+ * @param gentable
+ * @param key
+ * @param hash Result of indigo_core_gentable_key_hash for this key
+ *
+ * Returns the entry handle, or NULL if not found.
+ */
+
+indigo_core_gentable_entry_t *
+indigo_core_gentable_entry_lookup_hash(indigo_core_gentable_t *gentable,
+                                       of_object_t *key, uint32_t hash);
+
+/*
+ * @brief Get the private data for a gentable entry
+ * @param entry
+ */
+
+void *
+indigo_core_gentable_entry_priv(indigo_core_gentable_entry_t *entry);
+
+/*
+ * @brief Acquire a reference to a gentable entry by handle
+ * @param entry
+ *
+ * Delete operations on the gentable entry will be rejected until all
+ * references to it are released.
+ */
+
+void
+indigo_core_gentable_entry_acquire(indigo_core_gentable_entry_t *entry);
+
+/*
+ * @brief Release a reference to a gentable entry by handle
+ * @param entry
+ */
+
+void
+indigo_core_gentable_entry_release(indigo_core_gentable_entry_t *entry);
+
 /*
  * @brief Get the table ID of a gentable
  * @param gentable
@@ -331,6 +431,107 @@ indigo_core_gentable_release(indigo_core_gentable_t *gentable, of_object_t *key)
 uint16_t
 indigo_core_gentable_id(indigo_core_gentable_t *gentable);
 
+/**
+ * @brief Memory used by a gentable
+ *
+ * entry_bytes covers the entries themselves including their keys and
+ * values. bucket_bytes covers the checksum buckets array.
+ */
+typedef struct indigo_core_gentable_memory_stats {
+    uint32_t num_entries;
+    uint64_t entry_bytes;
+    uint64_t bucket_bytes;
+} indigo_core_gentable_memory_stats_t;
+
+/*
+ * @brief Get the memory usage of a gentable
+ * @param gentable
+ * @param [out] stats
+ */
+
+void
+indigo_core_gentable_memory_stats_get(indigo_core_gentable_t *gentable,
+                                      indigo_core_gentable_memory_stats_t *stats);
+
+/*
+ * @brief Skip modifies that don't change an entry
+ * @param gentable
+ * @param enable
+ *
+ * When enabled, an entry_add for an existing key with the same checksum and
+ * value as the current entry does not call the modify operation. Only enable
+ * this if the table's state depends on nothing but the key and value, so
+ * that a controller replaying its full state costs no driver writes.
+ * Disabled by default.
+ */
+
+void
+indigo_core_gentable_elide_noop_modify_set(indigo_core_gentable_t *gentable,
+                                           bool enable);
+
+/**
+ * Maximum number of secondary indexes per gentable
+ */
+#define INDIGO_CORE_GENTABLE_MAX_INDEXES 4
+
+/**
+ * @brief Extract a secondary index key from a gentable entry
+ * @param key Entry key
+ * @param value Entry value
+ * @param [out] index_key Secondary key, for example a port number
+ *
+ * Returns true if the entry should be indexed under index_key, false if
+ * it doesn't belong in the index.
+ */
+typedef bool (*indigo_core_gentable_index_extract_f)(
+    of_list_bsn_tlv_t *key, of_list_bsn_tlv_t *value, uint64_t *index_key);
+
+/**
+ * @brief Callback for indigo_core_gentable_index_foreach
+ * @param cookie Cookie passed to indigo_core_gentable_index_foreach
+ * @param entry Matching entry
+ */
+typedef void (*indigo_core_gentable_index_iter_f)(
+    void *cookie, indigo_core_gentable_entry_t *entry);
+
+/*
+ * @brief Add a secondary index to a gentable
+ * @param gentable
+ * @param extract Function returning the secondary key of an entry
+ * @param [out] index_id Identifies the index in indigo_core_gentable_index_foreach
+ *
+ * OFStateManager maintains the index as entries are added, modified and
+ * deleted, calling 'extract' each time. Existing entries are indexed
+ * immediately. Indexes are normally added right after registering the
+ * gentable.
+ *
+ * Returns INDIGO_ERROR_RESOURCE if the gentable already has
+ * INDIGO_CORE_GENTABLE_MAX_INDEXES indexes.
+ */
+
+indigo_error_t
+indigo_core_gentable_index_register(indigo_core_gentable_t *gentable,
+                                    indigo_core_gentable_index_extract_f extract,
+                                    int *index_id);
+
+/*
+ * @brief Call a function for each entry with the given secondary key
+ * @param gentable
+ * @param index_id Index returned by indigo_core_gentable_index_register
+ * @param index_key Secondary key to look up
+ * @param callback Called once for each matching entry
+ * @param cookie Passed to callback
+ *
+ * The cost is proportional to the number of matching entries. The callback
+ * must not add or delete gentable entries.
+ */
+
+void
+indigo_core_gentable_index_foreach(indigo_core_gentable_t *gentable,
+                                   int index_id, uint64_t index_key,
+                                   indigo_core_gentable_index_iter_f callback,
+                                   void *cookie);
+
 /**
  * @brief Get the table ID of a gentable from its name.
  * @param name Gentable name; should be same as that passed when registering.
@@ -500,6 +701,53 @@ typedef struct indigo_core_table_ops_s {
     indigo_error_t (*table_stats_get)(
         void *table_priv, indigo_cxn_id_t cxn_id,
         indigo_fi_table_stats_t *table_stats);
+
+    /**
+     * Delete every entry in the table (optional)
+     * @param table_priv Private data passed to indigo_core_table_register
+     * @param cxn_id Connection requesting this operation
+     *
+     * If set, a flow delete that matches every flow in the table calls this
+     * once instead of calling entry_delete for each flow. The implementation
+     * must deallocate the private data of every entry. Not used if any flow
+     * in the table needs a flow-removed message, since that requires the
+     * final stats of each flow. If it fails the table is left unchanged and
+     * the flows are deleted one at a time instead.
+     */
+    indigo_error_t (*clear)(
+        void *table_priv, indigo_cxn_id_t cxn_id);
+
+    /**
+     * Retrieve stats for several entries at once (optional)
+     * @param table_priv Private data passed to indigo_core_table_register
+     * @param cxn_id Connection requesting this operation
+     * @param entry_privs Private data of each entry
+     * @param count Number of entries
+     * @param [out] flow_stats Current stats of each entry
+     *
+     * Used by flow and aggregate stats requests instead of calling
+     * entry_stats_get for each flow. If it fails, entry_stats_get is called
+     * for each flow instead.
+     */
+    indigo_error_t (*entry_stats_get_bulk)(
+        void *table_priv, indigo_cxn_id_t cxn_id, void **entry_privs,
+        int count, indigo_fi_flow_stats_t *flow_stats);
+
+    /**
+     * Delete several entries at once (optional)
+     * @param table_priv Private data passed to indigo_core_table_register
+     * @param cxn_id Connection requesting this operation
+     * @param entry_privs Private data of each entry
+     * @param count Number of entries
+     * @param [out] flow_stats Final stats of each entry
+     *
+     * Used when flows expire instead of calling entry_delete for each flow.
+     * If it fails the table must be left unchanged, and entry_delete is
+     * called for each flow instead.
+     */
+    indigo_error_t (*entry_delete_bulk)(
+        void *table_priv, indigo_cxn_id_t cxn_id, void **entry_privs,
+        int count, indigo_fi_flow_stats_t *flow_stats);
 } indigo_core_table_ops_t;
 
 /**
@@ -520,6 +768,18 @@ void indigo_core_table_register(uint8_t table_id, const char *name, const indigo
  */
 void indigo_core_table_unregister(uint8_t table_id);
 
+/**
+ * Skip flow overwrites that don't change a flow
+ *
+ * When enabled, a flow-add that strictly matches an existing flow with the
+ * same cookie, flags and instructions does not call entry_modify. The
+ * timeouts and duration are still reset as for any overwrite. Disabled by
+ * default.
+ *
+ * Returns INDIGO_ERROR_NOT_FOUND if the table is not registered.
+ */
+indigo_error_t indigo_core_table_elide_noop_overwrite_set(uint8_t table_id, bool enable);
+
 
 /****************************************************************
  *
@@ -601,6 +861,21 @@ typedef struct indigo_core_group_table_ops_s {
     indigo_error_t (*entry_stats_get)(
         void *table_priv, void *entry_priv,
         of_group_stats_entry_t *stats);
+
+    /**
+     * Retrieve stats for multiple entries (optional)
+     * @param table_priv Private data passed to indigo_core_group_table_register
+     * @param entry_privs Private data returned by the entry_create operation
+     * @param stats LOCI of_group_stats_entry_t objects to be filled in, one
+     *              per entry
+     * @param count Number of entries
+     *
+     * Used by group stats requests. If this returns an error the entries are
+     * reset and entry_stats_get is called for each entry instead.
+     */
+    indigo_error_t (*entry_stats_get_bulk)(
+        void *table_priv, void **entry_privs,
+        of_group_stats_entry_t **stats, int count);
 } indigo_core_group_table_ops_t;
 
 /**
@@ -658,7 +933,7 @@ void *indigo_core_group_lookup(uint32_t group_id);
 
 
 /****************************************************************
- * Port/Queue registration
+ * Port/Queue/VLAN registration
  ****************************************************************/
 
 /* Opaque handle for a port */
@@ -691,6 +966,24 @@ indigo_core_queue_register(of_port_no_t port_no, uint32_t queue_id, struct ind_c
 void
 indigo_core_queue_unregister(struct ind_core_queue *handle);
 
+/* Opaque handle for a VLAN */
+struct ind_core_vlan;
+
+/**
+ * Register an active VLAN
+ *
+ * Once any VLAN is registered, BSN VLAN counter stats requests for all
+ * VLANs only fetch stats for the registered VLANs.
+ */
+void
+indigo_core_vlan_register(uint16_t vlan_vid, struct ind_core_vlan **handle);
+
+/**
+ * Unregister a VLAN
+ */
+void
+indigo_core_vlan_unregister(struct ind_core_vlan *handle);
+
 /****************************************************************
  * Generic stats
  ****************************************************************/
@@ -195,6 +195,22 @@ indigo_error_t indigo_port_stats_get_one(
     of_port_no_t port_no,
     of_port_stats_entry_t *port_stats) AIM_COMPILER_ATTR_WEAK;
 
+/**
+ * @brief Get port stats for multiple ports
+ * @param port_nos Port numbers
+ * @param count Number of ports
+ * @param port_stats LOXI objects to populate, one per port
+ * @return Return code from operation
+ *
+ * Optional. If this is not implemented or returns an error,
+ * indigo_port_stats_get_one is called for each port instead.
+ */
+
+indigo_error_t indigo_port_stats_get_many(
+    const of_port_no_t *port_nos,
+    int count,
+    of_port_stats_entry_t **port_stats) AIM_COMPILER_ATTR_WEAK;
+
 /**
  * @brief Process an extended port stats request
  * @param port_no The OpenFlow port number
@@ -210,6 +226,22 @@ void indigo_port_extended_stats_get(
     of_port_no_t port_no,
     indigo_fi_port_stats_t *port_stats);
 
+/**
+ * @brief Process an extended port stats request for multiple ports
+ * @param port_nos The OpenFlow port numbers
+ * @param count Number of ports
+ * @param [out] port_stats Statistics for each port
+ *
+ * Same semantics as indigo_port_extended_stats_get for each port. Optional;
+ * the default implementation calls indigo_port_extended_stats_get for each
+ * port.
+ */
+
+void indigo_port_extended_stats_get_many(
+    const of_port_no_t *port_nos,
+    int count,
+    indigo_fi_port_stats_t *port_stats);
+
 /**
  * @brief Process an OF queue config request
  * @param queue_config_request The LOXI request message
@@ -252,6 +284,24 @@ indigo_error_t indigo_port_queue_stats_get_one(
     uint32_t queue_id,
     of_queue_stats_entry_t *queue_stats) AIM_COMPILER_ATTR_WEAK;
 
+/**
+ * @brief Get queue stats for multiple queues
+ * @param port_nos Port number of each queue
+ * @param queue_ids Queue IDs
+ * @param count Number of queues
+ * @param queue_stats LOXI objects to populate, one per queue
+ * @return Return code from operation
+ *
+ * Optional. If this is not implemented or returns an error,
+ * indigo_port_queue_stats_get_one is called for each queue instead.
+ */
+
+indigo_error_t indigo_port_queue_stats_get_many(
+    const of_port_no_t *port_nos,
+    const uint32_t *queue_ids,
+    int count,
+    of_queue_stats_entry_t **queue_stats) AIM_COMPILER_ATTR_WEAK;
+
 /**
  * @brief Process an OF queue desc request
  * @param queue_desc_request The LOXI request message
@@ -95,6 +95,42 @@ bool minimatch_overlap(const minimatch_t *a, const minimatch_t *b);
  */
 uint32_t minimatch_hash(const minimatch_t *minimatch, uint32_t seed);
 
+/**
+ * Maximum length of the OXM TLVs written by minimatch_to_oxm
+ */
+#define MINIMATCH_OXM_MAX_LEN 448
+
+/**
+ * Initialize a minimatch directly from OXM TLVs
+ *
+ * Equivalent to parsing the match with LOCI and calling minimatch_init,
+ * without building an of_match_t.
+ *
+ * @param minimatch Minimatch to be initialized
+ * @param version OpenFlow version of the message, 1.2 or later
+ * @param oxms The OXM TLVs of an ofp_match, without its header or padding
+ * @param len Length of the OXM TLVs
+ * @returns 0 on success, or -1 if the TLVs are malformed or include a field
+ *          not supported by the codec, in which case the caller should fall
+ *          back to LOCI. The minimatch is only initialized on success.
+ *
+ * Must be cleaned up with minimatch_cleanup.
+ */
+int minimatch_init_oxm(minimatch_t *minimatch, of_version_t version,
+                       const uint8_t *oxms, int len);
+
+/**
+ * Serialize a minimatch as OXM TLVs
+ *
+ * @param minimatch Minimatch to serialize
+ * @param buf Output buffer, MINIMATCH_OXM_MAX_LEN bytes is always enough
+ * @param len Size of buf
+ * @returns The number of bytes written, or -1 if the minimatch is from an
+ *          OpenFlow version without OXMs, uses a field not supported by the
+ *          codec or does not fit in buf
+ */
+int minimatch_to_oxm(const minimatch_t *minimatch, uint8_t *buf, int len);
+
 /**
  * Move a minimatch
  *
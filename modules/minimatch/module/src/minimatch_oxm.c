@@ -0,0 +1,359 @@
+/****************************************************************
+ *
+ *        Copyright 2018, Big Switch Networks, Inc.
+ *
+ * Licensed under the Eclipse Public License, Version 1.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *        http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the
+ * License.
+ *
+ ****************************************************************/
+
+/*
+ * OXM codec
+ *
+ * Converts between OXM TLVs and minimatch without going through an
+ * of_match_t. Only the word of the match fields touched by each TLV is
+ * initialized, instead of clearing and scanning the whole of_match_t.
+ *
+ * The codec handles the fields of the OpenFlow basic OXM class listed in
+ * oxm_fields. Values are stored in of_match_fields_t the same way LOCI
+ * stores them: integers in host byte order, MAC and IPv6 addresses in wire
+ * order, and masked values ANDed with their mask. Anything else, such as
+ * experimenter OXMs, makes the codec fail so that the caller can fall back
+ * to LOCI.
+ */
+
+#include <minimatch/minimatch.h>
+#include <AIM/aim.h>
+#include <stddef.h>
+
+#define OXM_CLASS_OPENFLOW_BASIC 0x8000
+#define OXM_HEADER_LEN 4
+
+struct oxm_field {
+    uint8_t field;      /* OXM field number in the OpenFlow basic class */
+    uint8_t size;       /* bytes, both on the wire and in of_match_fields_t */
+    bool wire_order;    /* stored as bytes rather than a host order integer */
+    uint16_t offset;    /* offset in of_match_fields_t */
+};
+
+#define OXM_FIELD(_field, _name, _wire_order) \
+    { _field, sizeof(((of_match_fields_t *)0)->_name), _wire_order, \
+      offsetof(of_match_fields_t, _name) }
+
+/* Indexed by OXM field number */
+static const struct oxm_field oxm_fields[] = {
+    OXM_FIELD(0, in_port, false),
+    OXM_FIELD(1, in_phy_port, false),
+    OXM_FIELD(2, metadata, false),
+    OXM_FIELD(3, eth_dst, true),
+    OXM_FIELD(4, eth_src, true),
+    OXM_FIELD(5, eth_type, false),
+    OXM_FIELD(6, vlan_vid, false),
+    OXM_FIELD(7, vlan_pcp, false),
+    OXM_FIELD(8, ip_dscp, false),
+    OXM_FIELD(9, ip_ecn, false),
+    OXM_FIELD(10, ip_proto, false),
+    OXM_FIELD(11, ipv4_src, false),
+    OXM_FIELD(12, ipv4_dst, false),
+    OXM_FIELD(13, tcp_src, false),
+    OXM_FIELD(14, tcp_dst, false),
+    OXM_FIELD(15, udp_src, false),
+    OXM_FIELD(16, udp_dst, false),
+    OXM_FIELD(17, sctp_src, false),
+    OXM_FIELD(18, sctp_dst, false),
+    OXM_FIELD(19, icmpv4_type, false),
+    OXM_FIELD(20, icmpv4_code, false),
+    OXM_FIELD(21, arp_op, false),
+    OXM_FIELD(22, arp_spa, false),
+    OXM_FIELD(23, arp_tpa, false),
+    OXM_FIELD(24, arp_sha, true),
+    OXM_FIELD(25, arp_tha, true),
+    OXM_FIELD(26, ipv6_src, true),
+    OXM_FIELD(27, ipv6_dst, true),
+    OXM_FIELD(28, ipv6_flabel, false),
+    OXM_FIELD(29, icmpv6_type, false),
+    OXM_FIELD(30, icmpv6_code, false),
+    OXM_FIELD(31, ipv6_nd_target, true),
+    OXM_FIELD(32, ipv6_nd_sll, true),
+    OXM_FIELD(33, ipv6_nd_tll, true),
+    OXM_FIELD(34, mpls_label, false),
+    OXM_FIELD(35, mpls_tc, false),
+};
+
+#define OXM_FIELD_MAX_SIZE 16
+
+/*
+ * Convert between wire order and the of_match_fields_t representation
+ */
+static void
+oxm_value_decode(const struct oxm_field *desc, const uint8_t *wire, uint8_t *dst)
+{
+    uint64_t value = 0;
+    int i;
+
+    if (desc->wire_order || desc->size == 1) {
+        memcpy(dst, wire, desc->size);
+        return;
+    }
+
+    for (i = 0; i < desc->size; i++) {
+        value = (value << 8) | wire[i];
+    }
+
+    switch (desc->size) {
+    case 2: { uint16_t v = value; memcpy(dst, &v, sizeof(v)); break; }
+    case 4: { uint32_t v = value; memcpy(dst, &v, sizeof(v)); break; }
+    case 8: memcpy(dst, &value, sizeof(value)); break;
+    default: AIM_DIE("unexpected OXM field size %d", desc->size);
+    }
+}
+
+static void
+oxm_value_encode(const struct oxm_field *desc, const uint8_t *src, uint8_t *wire)
+{
+    uint64_t value;
+    int i;
+
+    if (desc->wire_order || desc->size == 1) {
+        memcpy(wire, src, desc->size);
+        return;
+    }
+
+    switch (desc->size) {
+    case 2: { uint16_t v; memcpy(&v, src, sizeof(v)); value = v; break; }
+    case 4: { uint32_t v; memcpy(&v, src, sizeof(v)); value = v; break; }
+    case 8: memcpy(&value, src, sizeof(value)); break;
+    default: AIM_DIE("unexpected OXM field size %d", desc->size);
+    }
+
+    for (i = desc->size - 1; i >= 0; i--) {
+        wire[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+/*
+ * Sparse view of of_match_fields_t
+ *
+ * Only words with their bit set in the bitmap are initialized.
+ */
+struct sparse_match {
+    uint32_t bitmap[(OF_MATCH_FIELDS_WORDS+31)/32];
+    uint32_t fields[OF_MATCH_FIELDS_WORDS];
+    uint32_t masks[OF_MATCH_FIELDS_WORDS];
+};
+
+static bool
+sparse_word_present(const struct sparse_match *sparse, int word)
+{
+    return (sparse->bitmap[word/32] >> (word % 32)) & 1;
+}
+
+/* Initialize the words covering a field, zeroing any not yet present */
+static void
+sparse_touch(struct sparse_match *sparse, const struct oxm_field *desc)
+{
+    int word;
+
+    for (word = desc->offset / 4; word <= (desc->offset + desc->size - 1) / 4; word++) {
+        if (!sparse_word_present(sparse, word)) {
+            sparse->bitmap[word/32] |= 1 << (word % 32);
+            sparse->fields[word] = 0;
+            sparse->masks[word] = 0;
+        }
+    }
+}
+
+/* Read a field, treating words that are not present as zero */
+static void
+sparse_read(const struct sparse_match *sparse, const uint32_t *words,
+            const struct oxm_field *desc, uint8_t *dst)
+{
+    int i;
+
+    for (i = 0; i < desc->size; i++) {
+        int byte = desc->offset + i;
+        int word = byte / 4;
+        if (sparse_word_present(sparse, word)) {
+            dst[i] = ((const uint8_t *)&words[word])[byte % 4];
+        } else {
+            dst[i] = 0;
+        }
+    }
+}
+
+static bool
+all_zero(const uint8_t *data, int len)
+{
+    int i;
+    for (i = 0; i < len; i++) {
+        if (data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+minimatch_init_oxm(minimatch_t *minimatch, of_version_t version,
+                   const uint8_t *oxms, int len)
+{
+    struct sparse_match sparse;
+    uint64_t seen = 0;
+    int offset = 0;
+    int i, idx, num_words = 0;
+
+    if (version < OF_VERSION_1_2) {
+        return -1;
+    }
+
+    memset(sparse.bitmap, 0, sizeof(sparse.bitmap));
+
+    while (offset < len) {
+        const uint8_t *oxm = oxms + offset;
+        uint8_t value[OXM_FIELD_MAX_SIZE], mask[OXM_FIELD_MAX_SIZE];
+        const struct oxm_field *desc;
+
+        if (len - offset < OXM_HEADER_LEN) {
+            return -1;
+        }
+
+        uint16_t oxm_class = (oxm[0] << 8) | oxm[1];
+        uint8_t field = oxm[2] >> 1;
+        bool hasmask = oxm[2] & 1;
+        uint8_t payload_len = oxm[3];
+
+        if (oxm_class != OXM_CLASS_OPENFLOW_BASIC ||
+                field >= AIM_ARRAYSIZE(oxm_fields) ||
+                (seen & ((uint64_t)1 << field)) ||
+                len - offset - OXM_HEADER_LEN < payload_len) {
+            return -1;
+        }
+
+        desc = &oxm_fields[field];
+        if (payload_len != (hasmask ? 2 : 1) * desc->size) {
+            return -1;
+        }
+
+        seen |= (uint64_t)1 << field;
+
+        oxm_value_decode(desc, oxm + OXM_HEADER_LEN, value);
+        if (hasmask) {
+            oxm_value_decode(desc, oxm + OXM_HEADER_LEN + desc->size, mask);
+            for (i = 0; i < desc->size; i++) {
+                value[i] &= mask[i];
+            }
+        } else {
+            memset(mask, 0xff, desc->size);
+        }
+
+        sparse_touch(&sparse, desc);
+        memcpy((uint8_t *)sparse.fields + desc->offset, value, desc->size);
+        memcpy((uint8_t *)sparse.masks + desc->offset, mask, desc->size);
+
+        offset += OXM_HEADER_LEN + payload_len;
+    }
+
+    /* Drop words left with an all-zero mask by zero-masked TLVs */
+    for (i = 0; i < OF_MATCH_FIELDS_WORDS; i++) {
+        if (sparse_word_present(&sparse, i)) {
+            if (sparse.masks[i] == 0) {
+                sparse.bitmap[i/32] &= ~(1 << (i % 32));
+            } else {
+                num_words += 2;
+            }
+        }
+    }
+
+    minimatch->version = version;
+    minimatch->num_words = num_words;
+    memcpy(minimatch->bitmap, sparse.bitmap, sizeof(minimatch->bitmap));
+    minimatch->words = aim_malloc(sizeof(uint32_t) * num_words);
+
+    idx = 0;
+    for (i = 0; i < OF_MATCH_FIELDS_WORDS; i++) {
+        if (sparse_word_present(&sparse, i)) {
+            minimatch->words[idx++] = sparse.fields[i];
+            minimatch->words[idx++] = sparse.masks[i];
+        }
+    }
+
+    return 0;
+}
+
+int
+minimatch_to_oxm(const minimatch_t *minimatch, uint8_t *buf, int len)
+{
+    struct sparse_match sparse;
+    int i, j, idx = 0;
+    int offset = 0;
+
+    if (minimatch->version < OF_VERSION_1_2) {
+        return -1;
+    }
+
+    memcpy(sparse.bitmap, minimatch->bitmap, sizeof(sparse.bitmap));
+    for (i = 0; i < OF_MATCH_FIELDS_WORDS; i++) {
+        if (sparse_word_present(&sparse, i)) {
+            sparse.fields[i] = minimatch->words[idx++];
+            sparse.masks[i] = minimatch->words[idx++];
+        }
+    }
+
+    for (i = 0; i < AIM_ARRAYSIZE(oxm_fields); i++) {
+        const struct oxm_field *desc = &oxm_fields[i];
+        uint8_t value[OXM_FIELD_MAX_SIZE], mask[OXM_FIELD_MAX_SIZE];
+        bool hasmask = false;
+
+        sparse_read(&sparse, sparse.masks, desc, mask);
+        if (all_zero(mask, desc->size)) {
+            continue;
+        }
+
+        sparse_read(&sparse, sparse.fields, desc, value);
+
+        for (j = 0; j < desc->size; j++) {
+            if (mask[j] != 0xff) {
+                hasmask = true;
+            }
+        }
+
+        int oxm_len = OXM_HEADER_LEN + (hasmask ? 2 : 1) * desc->size;
+        if (len - offset < oxm_len) {
+            return -1;
+        }
+
+        buf[offset] = OXM_CLASS_OPENFLOW_BASIC >> 8;
+        buf[offset+1] = OXM_CLASS_OPENFLOW_BASIC & 0xff;
+        buf[offset+2] = (desc->field << 1) | hasmask;
+        buf[offset+3] = oxm_len - OXM_HEADER_LEN;
+        oxm_value_encode(desc, value, buf + offset + OXM_HEADER_LEN);
+        if (hasmask) {
+            oxm_value_encode(desc, mask, buf + offset + OXM_HEADER_LEN + desc->size);
+        }
+        offset += oxm_len;
+
+        /* Clear the mask so leftover fields can be detected below */
+        sparse_touch(&sparse, desc);
+        memset((uint8_t *)sparse.masks + desc->offset, 0, desc->size);
+    }
+
+    /* Fail if any masked field has no OXM in the table */
+    for (i = 0; i < OF_MATCH_FIELDS_WORDS; i++) {
+        if (sparse_word_present(&sparse, i) && sparse.masks[i] != 0) {
+            return -1;
+        }
+    }
+
+    return offset;
+}
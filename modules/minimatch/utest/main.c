@@ -144,6 +144,117 @@ test_basic(void)
     minimatch_cleanup(&c);
 }
 
+/* Check the OXM codec against LOCI's serialization of the same match */
+static void
+check_oxm(of_match_t *match)
+{
+    of_octets_t octets;
+    minimatch_t a, b, c;
+    uint8_t buf[MINIMATCH_OXM_MAX_LEN];
+    int match_len, len;
+
+    AIM_ASSERT(of_match_serialize(match->version, match, &octets) == 0, "");
+
+    /* Skip the ofp_match header; the length excludes padding */
+    match_len = (octets.data[2] << 8) | octets.data[3];
+
+    minimatch_init(&a, match);
+    AIM_ASSERT(minimatch_init_oxm(&b, match->version, octets.data + 4, match_len - 4) == 0, "");
+    AIM_ASSERT(minimatch_equal(&a, &b), "");
+
+    len = minimatch_to_oxm(&a, buf, sizeof(buf));
+    AIM_ASSERT(len >= 0, "");
+    AIM_ASSERT(minimatch_init_oxm(&c, match->version, buf, len) == 0, "");
+    AIM_ASSERT(minimatch_equal(&a, &c), "");
+
+    minimatch_cleanup(&a);
+    minimatch_cleanup(&b);
+    minimatch_cleanup(&c);
+    free(octets.data);
+}
+
+static void
+test_oxm(void)
+{
+    minimatch_t a;
+    uint8_t buf[MINIMATCH_OXM_MAX_LEN];
+
+    of_match_t match1 = {
+        .version = OF_VERSION_1_3,
+        .fields = {
+            .in_port = 5,
+            .metadata = 0x123456789abcdef0,
+            .eth_dst = { { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc } },
+            .vlan_vid = 0x1567,
+            .eth_type = 0x0800,
+            .ip_proto = 6,
+            .ipv4_src = 0x0a000000,
+            .tcp_dst = 80,
+        },
+        .masks = {
+            .in_port = 0xffffffff,
+            .metadata = 0xffff0000ffff0000,
+            .eth_dst = { { 0xff, 0xff, 0xff, 0x00, 0x00, 0x00 } },
+            .vlan_vid = 0x1fff,
+            .eth_type = 0xffff,
+            .ip_proto = 0xff,
+            .ipv4_src = 0xff000000,
+            .tcp_dst = 0xffff,
+        },
+    };
+
+    of_match_t match2 = {
+        .version = OF_VERSION_1_3,
+        .fields = {
+            .eth_type = 0x86dd,
+            .ipv6_dst = { { 0x20, 0x01, 0x0d, 0xb8 } },
+            .icmpv6_type = 135,
+            .ipv6_nd_target = { { 0xfe, 0x80, [15] = 0x01 } },
+            .mpls_tc = 3,
+        },
+        .masks = {
+            .eth_type = 0xffff,
+            .ipv6_dst = { { 0xff, 0xff, 0xff, 0xff } },
+            .icmpv6_type = 0xff,
+            .ipv6_nd_target = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } },
+            .mpls_tc = 0xff,
+        },
+    };
+
+    /* Fields outside the OpenFlow basic class aren't handled */
+    of_match_t match3 = {
+        .version = OF_VERSION_1_3,
+        .fields = { .eth_type = 0x0800, .bsn_vrf = 1 },
+        .masks = { .eth_type = 0xffff, .bsn_vrf = 0xffff },
+    };
+
+    of_match_t empty = { .version = OF_VERSION_1_3 };
+
+    check_oxm(&match1);
+    check_oxm(&match2);
+    check_oxm(&empty);
+
+    minimatch_init(&a, &match3);
+    AIM_ASSERT(minimatch_to_oxm(&a, buf, sizeof(buf)) == -1, "");
+    minimatch_cleanup(&a);
+
+    /* OpenFlow 1.0 has no OXMs */
+    match1.version = OF_VERSION_1_0;
+    minimatch_init(&a, &match1);
+    AIM_ASSERT(minimatch_to_oxm(&a, buf, sizeof(buf)) == -1, "");
+    minimatch_cleanup(&a);
+    AIM_ASSERT(minimatch_init_oxm(&a, OF_VERSION_1_0, buf, 0) == -1, "");
+
+    /* Experimenter and truncated TLVs are rejected */
+    {
+        const uint8_t experimenter[] = { 0xff, 0xff, 0x00, 0x08, 0x00, 0x5c, 0x16, 0xc7, 0x00, 0x00, 0x00, 0x01 };
+        const uint8_t truncated[] = { 0x80, 0x00, 0x0a, 0x02, 0x06 };
+        AIM_ASSERT(minimatch_init_oxm(&a, OF_VERSION_1_3, experimenter, sizeof(experimenter)) == -1, "");
+        AIM_ASSERT(minimatch_init_oxm(&a, OF_VERSION_1_3, truncated, sizeof(truncated)) == -1, "");
+    }
+}
+
 void
 random_match(of_match_t *match)
 {
@@ -216,6 +327,7 @@ int
 main(int argc, char* argv[])
 {
     test_basic();
+    test_oxm();
     test_random();
     return 0;
 }